@@ -0,0 +1,201 @@
+// Throughput of the JPEG compression core at 480p, 720p, 1080p and 4K.
+//
+// Reports the source throughput in RGBA bytes (bytes_per_second) and the time per pixel (time_per_pixel, e.g. 15ns).
+// The JPEG files are written to /dev/null, so the disk is not measured.
+// The YUV frames are counted as RGBA bytes too, so every case of a resolution has the same scale.
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "JPEGCompress.h"
+
+namespace {
+
+const char *kOutput = "/dev/null";
+
+// A smooth gradient with some texture, closer to a photo than random noise.
+std::vector<BYTE> makeRgba(uint32_t width, uint32_t height) {
+    std::vector<BYTE> rgba((size_t) width * height * 4);
+    BYTE *p = rgba.data();
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            p[0] = (BYTE) (x * 255 / width);
+            p[1] = (BYTE) (y * 255 / height);
+            p[2] = (BYTE) (128 + 127 * std::sin(x * 0.05) * std::cos(y * 0.05));
+            p[3] = 0xFF;
+            p += 4;
+        }
+    }
+    return rgba;
+}
+
+void setThroughput(benchmark::State &state, uint32_t width, uint32_t height) {
+    int64_t pixels = (int64_t) width * height;
+    state.SetBytesProcessed((int64_t) state.iterations() * pixels * 4);
+    state.counters["time_per_pixel"] = benchmark::Counter((double) state.iterations() * pixels,
+                                                          benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+void resolutions(benchmark::internal::Benchmark *b) {
+    b->Args({640, 480})->Args({1280, 720})->Args({1920, 1080})->Args({3840, 2160});
+    b->ArgNames({"w", "h"})->Unit(benchmark::kMillisecond);
+}
+
+void BM_RgbaToRgb(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<BYTE> rgba = makeRgba(w, h);
+    std::vector<BYTE> rgb((size_t) w * h * 3);
+    for (auto _ : state) {
+        rgbaToRgb(rgba.data(), w, h, w * 4, rgb.data());
+        benchmark::DoNotOptimize(rgb.data());
+    }
+    setThroughput(state, w, h);
+}
+
+// The whole compressBitmap path: RGBA -> RGB -> JPEG.
+void BM_CompressBitmap(benchmark::State &state, bool optimize) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<BYTE> rgba = makeRgba(w, h);
+    std::vector<BYTE> rgb((size_t) w * h * 3);
+    for (auto _ : state) {
+        rgbaToRgb(rgba.data(), w, h, w * 4, rgb.data());
+        if (write_JPEG_file(rgb.data(), w, h, 80, kOutput, optimize) != 0) {
+            state.SkipWithError("write_JPEG_file failed");
+            break;
+        }
+    }
+    setThroughput(state, w, h);
+}
+
+// The RGBA rows straight into the compressor, without the RGB copy.
+void BM_CompressRgba(benchmark::State &state, bool optimize) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<BYTE> rgba = makeRgba(w, h);
+    for (auto _ : state) {
+        if (compressRgbaToFile(rgba.data(), w, h, w * 4, 80, kOutput, optimize) != 0) {
+            state.SkipWithError("compressRgbaToFile failed");
+            break;
+        }
+    }
+    setThroughput(state, w, h);
+}
+
+// Into a reused buffer of jpegBufferSize() bytes, without a file.
+void BM_CompressRgbaToMemory(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<BYTE> rgba = makeRgba(w, h);
+    std::vector<BYTE> buffer(jpegBufferSize(w, h));
+    for (auto _ : state) {
+        BYTE *jpeg = buffer.data();
+        size_t jpegSize = buffer.size();
+        if (compressRgbaToMemory(rgba.data(), w, h, w * 4, 80, false, &jpeg, &jpegSize) != 0) {
+            state.SkipWithError("compressRgbaToMemory failed");
+            break;
+        }
+    }
+    setThroughput(state, w, h);
+}
+
+// An I420 (uvPixelStride 1) or NV21 (uvPixelStride 2) frame straight into the DCT, into a reused buffer.
+void BM_CompressYuv(benchmark::State &state, uint32_t uvPixelStride) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    uint32_t chromaWidth = (w + 1) / 2, chromaHeight = (h + 1) / 2;
+    std::vector<BYTE> rgba = makeRgba(w, h);
+    std::vector<BYTE> yPlane((size_t) w * h), uvPlanes((size_t) chromaWidth * chromaHeight * 2);
+    for (size_t i = 0; i < yPlane.size(); i++) yPlane[i] = rgba[i * 4 + 1];
+    for (size_t i = 0; i < uvPlanes.size(); i++) uvPlanes[i] = rgba[i * 4 + 2];
+    YuvPlanes planes;
+    if (uvPixelStride == 1) {
+        planes = {yPlane.data(), w, uvPlanes.data(), chromaWidth, uvPlanes.data() + uvPlanes.size() / 2, chromaWidth,
+                  1};
+    } else {
+        planes = {yPlane.data(), w, uvPlanes.data() + 1, chromaWidth * 2, uvPlanes.data(), chromaWidth * 2, 2};
+    }
+    std::vector<BYTE> buffer(jpegBufferSize(w, h));
+    for (auto _ : state) {
+        BYTE *jpeg = buffer.data();
+        size_t jpegSize = buffer.size();
+        if (compressYuvToMemory(planes, w, h, 80, false, &jpeg, &jpegSize) != 0) {
+            state.SkipWithError("compressYuvToMemory failed");
+            break;
+        }
+    }
+    setThroughput(state, w, h);
+}
+
+void burstSizes(benchmark::internal::Benchmark *b) {
+    b->Args({16, 16})->Args({160, 120})->Args({320, 240})->Args({640, 480})->Args({1920, 1080});
+    b->ArgNames({"w", "h"})->Unit(benchmark::kMicrosecond);
+}
+
+// A burst of same size frames, every one with its own compressor and a buffer grown from scratch, then freed.
+void BM_BurstOneShot(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<BYTE> rgba = makeRgba(w, h);
+    for (auto _ : state) {
+        BYTE *jpeg = nullptr;
+        size_t jpegSize = 0;
+        if (compressRgbaToMemory(rgba.data(), w, h, w * 4, 80, false, &jpeg, &jpegSize) != 0) {
+            state.SkipWithError("compressRgbaToMemory failed");
+            break;
+        }
+        free(jpeg);
+    }
+    setThroughput(state, w, h);
+}
+
+// The same burst through one JpegEncoder and its own buffer.
+void BM_BurstEncoder(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<BYTE> rgba = makeRgba(w, h);
+    JpegEncoder encoder;
+    for (auto _ : state) {
+        BYTE *jpeg = nullptr;
+        size_t jpegSize = 0;
+        if (encoder.compressRgba(rgba.data(), w, h, w * 4, 80, false, &jpeg, &jpegSize) != 0) {
+            state.SkipWithError("JpegEncoder::compressRgba failed");
+            break;
+        }
+    }
+    setThroughput(state, w, h);
+}
+
+void parallelSizes(benchmark::internal::Benchmark *b) {
+    for (int64_t threads : {1, 2, 4, 8}) {
+        b->Args({3840, 2160, threads})->Args({4000, 3000, threads});
+    }
+    b->ArgNames({"w", "h", "threads"})->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+// Strips of MCU rows compressed on several threads and joined, into a reused buffer. Wall clock time.
+void BM_CompressParallel(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1), threads = (uint32_t) state.range(2);
+    std::vector<BYTE> rgba = makeRgba(w, h);
+    std::vector<BYTE> buffer(jpegBufferSize(w, h));
+    for (auto _ : state) {
+        BYTE *jpeg = buffer.data();
+        size_t jpegSize = buffer.size();
+        if (compressRgbaToMemoryParallel(rgba.data(), w, h, w * 4, 80, threads, &jpeg, &jpegSize) != 0) {
+            state.SkipWithError("compressRgbaToMemoryParallel failed");
+            break;
+        }
+    }
+    setThroughput(state, w, h);
+}
+
+}  // namespace
+
+BENCHMARK(BM_RgbaToRgb)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_CompressBitmap, q80, false)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_CompressBitmap, q80_optimize, true)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_CompressRgba, q80, false)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_CompressRgba, q80_optimize, true)->Apply(resolutions);
+BENCHMARK(BM_CompressRgbaToMemory)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_CompressYuv, i420, 1)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_CompressYuv, nv21, 2)->Apply(resolutions);
+BENCHMARK(BM_BurstOneShot)->Apply(burstSizes);
+BENCHMARK(BM_BurstEncoder)->Apply(burstSizes);
+BENCHMARK(BM_CompressParallel)->Apply(parallelSizes);
@@ -0,0 +1,64 @@
+// Decoding a 4K JPEG whole, at 1/2, 1/4 and 1/8 of its size, and a 640x480 region of it.
+//
+// Reports the time per image and the time per decoded pixel (time_per_pixel).
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "JPEGDecompress.h"
+
+namespace {
+
+const uint32_t kWidth = 3840, kHeight = 2160;
+
+// A smooth gradient with some texture, closer to a photo than random noise.
+std::vector<BYTE> makeJpeg() {
+    std::vector<BYTE> rgba((size_t) kWidth * kHeight * 4);
+    BYTE *p = rgba.data();
+    for (uint32_t y = 0; y < kHeight; y++) {
+        for (uint32_t x = 0; x < kWidth; x++) {
+            p[0] = (BYTE) (x * 255 / kWidth);
+            p[1] = (BYTE) (y * 255 / kHeight);
+            p[2] = (BYTE) (128 + 127 * std::sin(x * 0.05) * std::cos(y * 0.05));
+            p[3] = 0xFF;
+            p += 4;
+        }
+    }
+    BYTE *jpeg = nullptr;
+    size_t jpegSize = 0;
+    compressRgbaToMemory(rgba.data(), kWidth, kHeight, kWidth * 4, 90, false, &jpeg, &jpegSize);
+    std::vector<BYTE> result(jpeg, jpeg + jpegSize);
+    free(jpeg);
+    return result;
+}
+
+void decode(benchmark::State &state, uint32_t scaleDenom, uint32_t left, uint32_t top, uint32_t w, uint32_t h) {
+    std::vector<BYTE> jpeg = makeJpeg();
+    std::vector<BYTE> rgba((size_t) w * h * 4);
+    for (auto _ : state) {
+        if (decodeJpegToRgba(jpeg.data(), jpeg.size(), scaleDenom, left, top, w, h, rgba.data(), w * 4) != 0) {
+            state.SkipWithError("decodeJpegToRgba failed");
+            break;
+        }
+    }
+    state.counters["time_per_pixel"] = benchmark::Counter((double) state.iterations() * w * h,
+                                                          benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+void BM_DecodeScaled(benchmark::State &state) {
+    uint32_t scaleDenom = (uint32_t) state.range(0);
+    decode(state, scaleDenom, 0, 0, (kWidth + scaleDenom - 1) / scaleDenom, (kHeight + scaleDenom - 1) / scaleDenom);
+}
+
+// The center of the image, at full size.
+void BM_DecodeRegion(benchmark::State &state) {
+    decode(state, 1, (kWidth - 640) / 2, (kHeight - 480) / 2, 640, 480);
+}
+
+}  // namespace
+
+BENCHMARK(BM_DecodeScaled)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->ArgName("scale_denom")->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DecodeRegion)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,637 @@
+#include "JPEGCompress.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "JPEGError.h"
+
+void rgbaToRgb(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, BYTE *rgb) {
+    BYTE r, g, b;
+    uint32_t color;
+    for (uint32_t i = 0; i < h; i++) {
+        const BYTE *pixelsColor = rgba + (size_t) i * stride;
+        for (uint32_t j = 0; j < w; j++) {
+            // 取出一个像素  去调了alpha，然后保存到data中，对应指针++
+            color = *((const uint32_t *) pixelsColor);
+
+            // 在jni层中，Bitmap像素点的值是ABGR，而不是ARGB，也就是说，高端到低端：A，B，G，R
+            b = ((color & 0x00FF0000) >> 16);
+            g = ((color & 0x0000FF00) >> 8);
+            r = ((color & 0x000000FF));
+
+            // jpeg压缩需要的是rgb
+            //  for example, R,G,B,R,G,B,R,G,B,... for 24-bit RGB color.
+            *rgb = r;
+            *(rgb + 1) = g;
+            *(rgb + 2) = b;
+            rgb += 3;
+            pixelsColor += 4;
+        }
+    }
+}
+
+// 一次交给 jpeg_write_scanlines 的行数，4:2:0 下正好是一个 MCU 行
+static const uint32_t kScanlineBatch = 16;
+
+/**
+ * 设置压缩参数。必须在 jpeg_set_defaults 之后再设置 optimize_coding，jpeg_set_defaults 会把它重置为 FALSE。
+ * 始终使用 Huffman 编码：算术编码的 JPEG 很多解码器（包括部分 Android 版本的 Skia）都不支持。
+ */
+static void setCompressParameters(j_compress_ptr cinfo, uint32_t w, uint32_t h, J_COLOR_SPACE colorSpace,
+                                  int components, int quality, bool optimize) {
+    cinfo->image_width = w;      /* image width and height, in pixels */
+    cinfo->image_height = h;
+    cinfo->input_components = components; /* # of color components per pixel */
+    cinfo->in_color_space = colorSpace;   /* colorspace of input image */
+    // 其它参数 全部设置默认参数
+    jpeg_set_defaults(cinfo);
+    /*  源码地址：
+      [http://androidos.net.cn/androidossearch?query=SkImageDecoder_libjpeg.cpp](http://androidos.net.cn/androidossearch?query=SkImageDecoder_libjpeg.cpp)
+
+      >=android 7.0 后的源码已经设置为true了
+      ...省略其它代码
+      Tells libjpeg-turbo to compute optimal Huffman coding tables
+      for the image.  This improves compression at the cost of
+      slower encode performance.
+      cinfo.optimize_coding = TRUE;
+      jpeg_set_quality(&cinfo, quality, TRUE);
+      ...省略其它代码*/
+    cinfo->optimize_coding = optimize;
+    //设置质量
+    jpeg_set_quality(cinfo, quality, TRUE /* limit to baseline-JPEG values */);
+}
+
+/**
+ * 把 [data] 中 image_height 行、每行相隔 [stride] 字节的像素交给压缩器，每次 [kScanlineBatch] 行，不复制像素。
+ */
+static void writeRows(j_compress_ptr cinfo, const BYTE *data, uint32_t stride) {
+    JSAMPROW row_pointer[kScanlineBatch];
+    while (cinfo->next_scanline < cinfo->image_height) {
+        uint32_t count = cinfo->image_height - cinfo->next_scanline;
+        if (count > kScanlineBatch) count = kScanlineBatch;
+        for (uint32_t i = 0; i < count; i++) {
+            row_pointer[i] = (JSAMPROW) (data + (size_t) (cinfo->next_scanline + i) * stride);
+        }
+        //此方法会将 next_scanline 加上实际写入的行数
+        jpeg_write_scanlines(cinfo, row_pointer, count);
+    }
+}
+
+/**
+ * 把 YUV 4:2:0 的三个平面直接交给 DCT（raw_data_in），跳过颜色转换和降采样，每次一个 iMCU 行（16 行 Y、8 行 U/V）。
+ *
+ * libjpeg 会读到每个分量的宽高补齐到 8 的倍数为止，图像下方补齐的行指向最后一行。
+ * 宽度不是 8 的倍数或者 U/V 交错存放（NV21/NV12）时，逐行复制到一个 iMCU 行大小的临时缓冲区，右边补齐的列重复最后一列；
+ * 否则直接使用平面中的行，不复制。
+ */
+static void writeYuvRows(j_compress_ptr cinfo, const YuvPlanes &planes) {
+    const BYTE *bases[3] = {planes.y, planes.u, planes.v};
+    const uint32_t strides[3] = {planes.yStride, planes.uStride, planes.vStride};
+    const uint32_t pixelStrides[3] = {1, planes.uvPixelStride, planes.uvPixelStride};
+    const uint32_t widths[3] = {cinfo->image_width, (cinfo->image_width + 1) / 2, (cinfo->image_width + 1) / 2};
+    const uint32_t heights[3] = {cinfo->image_height, (cinfo->image_height + 1) / 2, (cinfo->image_height + 1) / 2};
+
+    JSAMPROW rows[3][kScanlineBatch];
+    JSAMPARRAY image[3] = {rows[0], rows[1], rows[2]};
+    uint32_t rowCounts[3], paddedWidths[3];
+    BYTE *scratch[3];
+    for (int c = 0; c < 3; c++) {
+        jpeg_component_info *component = &cinfo->comp_info[c];
+        rowCounts[c] = (uint32_t) component->v_samp_factor * DCTSIZE;
+        paddedWidths[c] = (uint32_t) component->width_in_blocks * DCTSIZE;
+        bool copy = pixelStrides[c] != 1 || paddedWidths[c] != widths[c];
+        // 由 libjpeg 的内存池分配，出错 longjmp 时也会随 jpeg_destroy_compress 释放
+        scratch[c] = !copy ? nullptr : (BYTE *) (*cinfo->mem->alloc_large)(
+                (j_common_ptr) cinfo, JPOOL_IMAGE, (size_t) rowCounts[c] * paddedWidths[c]);
+    }
+
+    for (uint32_t row = 0; cinfo->next_scanline < cinfo->image_height; row++) {
+        for (int c = 0; c < 3; c++) {
+            for (uint32_t i = 0; i < rowCounts[c]; i++) {
+                uint32_t y = row * rowCounts[c] + i;
+                if (y >= heights[c]) y = heights[c] - 1;
+                const BYTE *src = bases[c] + (size_t) y * strides[c];
+                if (scratch[c] == nullptr) {
+                    rows[c][i] = (JSAMPROW) src;
+                    continue;
+                }
+                BYTE *dst = scratch[c] + (size_t) i * paddedWidths[c];
+                for (uint32_t x = 0; x < widths[c]; x++) dst[x] = src[(size_t) x * pixelStrides[c]];
+                memset(dst + widths[c], dst[widths[c] - 1], paddedWidths[c] - widths[c]);
+                rows[c][i] = dst;
+            }
+        }
+        //此方法会将 next_scanline 加上一个 iMCU 行的行数
+        jpeg_write_raw_data(cinfo, image, rowCounts[0]);
+    }
+}
+
+/**
+ * 压缩到内存的 destination manager。
+ * 调用者提供的缓冲区写满即失败，不会越界；否则用 malloc 分配的缓冲区写满时用 realloc 加倍。
+ */
+struct memory_destination_mgr {
+    struct jpeg_destination_mgr pub;
+    BYTE *buffer;
+    size_t capacity;
+    bool growable;
+};
+typedef struct memory_destination_mgr *memory_destination_ptr;
+
+METHODDEF(void) init_memory_destination(j_compress_ptr cinfo) {
+    auto dest = (memory_destination_ptr) cinfo->dest;
+    dest->pub.next_output_byte = dest->buffer;
+    dest->pub.free_in_buffer = dest->capacity;
+}
+
+METHODDEF(boolean) empty_memory_output_buffer(j_compress_ptr cinfo) {
+    auto dest = (memory_destination_ptr) cinfo->dest;
+    // 调用者的缓冲区不够大，见 jpegBufferSize()
+    if (!dest->growable) ERREXIT(cinfo, JERR_BUFFER_SIZE);
+    size_t capacity = dest->capacity * 2;
+    auto buffer = (BYTE *) realloc(dest->buffer, capacity);
+    if (buffer == nullptr) ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
+    dest->pub.next_output_byte = buffer + dest->capacity;
+    dest->pub.free_in_buffer = capacity - dest->capacity;
+    dest->buffer = buffer;
+    dest->capacity = capacity;
+    return TRUE;
+}
+
+METHODDEF(void) term_memory_destination(j_compress_ptr) {
+}
+
+/**
+ * 压缩的输入：[yuv] 不为 nullptr 时是它的三个平面，否则是 [data] 中每行相隔 [stride] 字节、[colorSpace] 格式的像素。
+ */
+struct compress_source {
+    const BYTE *data;
+    uint32_t stride;
+    J_COLOR_SPACE colorSpace;
+    int components;
+    const YuvPlanes *yuv;
+};
+
+static void setMemoryDestination(j_compress_ptr cinfo, memory_destination_mgr *memory) {
+    memory->pub.init_destination = init_memory_destination;
+    memory->pub.empty_output_buffer = empty_memory_output_buffer;
+    memory->pub.term_destination = term_memory_destination;
+    cinfo->dest = &memory->pub;
+}
+
+/**
+ * 用已经创建并设置好输出的 [cinfo] 压缩 [source] 中 [w] x [h] 的图像。
+ * [setParameters] 为 false 时沿用上一张图像的参数，只更新宽高，省去 jpeg_set_defaults 和 jpeg_set_quality。
+ * [restartRows] 不为 0 时每隔这么多 MCU 行写入一个重启标记（RSTn）。
+ */
+static void compressImage(j_compress_ptr cinfo, const compress_source &source, uint32_t w, uint32_t h, int quality,
+                          bool optimize, bool setParameters, int restartRows) {
+    /* Step 3: set parameters for compression */
+
+    if (setParameters) {
+        setCompressParameters(cinfo, w, h, source.colorSpace, source.components, quality, optimize);
+        cinfo->restart_in_rows = restartRows;
+    } else {
+        cinfo->image_width = w;
+        cinfo->image_height = h;
+    }
+    // YUV 平面直接作为 JPEG 的 YCbCr 分量，jpeg_set_defaults 已经设置为 4:2:0 采样
+    cinfo->raw_data_in = source.yuv != nullptr;
+
+    /* Step 4: Start compressor */
+
+    jpeg_start_compress(cinfo, TRUE);
+
+    /* Step 5: while (scan lines remain to be written) */
+    /*           jpeg_write_scanlines(...); */
+
+    if (source.yuv != nullptr) {
+        writeYuvRows(cinfo, *source.yuv);
+    } else {
+        writeRows(cinfo, source.data, source.stride);
+    }
+
+    /* Step 6: Finish compression */
+    jpeg_finish_compress(cinfo);
+}
+
+/**
+ * 压缩 [source] 中 [w] x [h] 的图像，写入 [outfile]，[outfile] 为 nullptr 时写入 [memory]。
+ */
+static int compressRows(const compress_source &source, uint32_t w, uint32_t h, int quality, bool optimize,
+                        int restartRows, FILE *outfile, memory_destination_mgr *memory) {
+    //jpeg的结构体，保存的比如宽、高、位深、图片格式等信息
+    struct jpeg_compress_struct cinfo{};
+
+    /* Step 1: allocate and initialize JPEG compression object */
+
+    /* We set up the normal JPEG error routines, then override error_exit. */
+    struct my_error_mgr jem{};
+    cinfo.err = jpeg_std_error(&jem.pub);
+    jem.pub.error_exit = my_error_exit;
+    /* Establish the setjmp return context for my_error_exit to use. */
+    if (setjmp(jem.setjmp_buffer)) {
+        /* If we get here, the JPEG code has signaled an error.
+         * We need to clean up the JPEG object and return.
+         */
+        jpeg_destroy_compress(&cinfo);
+        return -1;
+    }
+    jpeg_create_compress(&cinfo);
+
+    /* Step 2: specify data destination (eg, a file) */
+
+    if (outfile != nullptr) {
+        jpeg_stdio_dest(&cinfo, outfile);
+    } else {
+        setMemoryDestination(&cinfo, memory);
+    }
+
+    compressImage(&cinfo, source, w, h, quality, optimize, true, restartRows);
+
+    /* Step 7: release JPEG compression object */
+
+    /* This is an important step since it will release a good deal of memory. */
+    jpeg_destroy_compress(&cinfo);
+
+    /* And we're done! */
+    return 0;
+}
+
+static int compressToFile(const compress_source &source, uint32_t w, uint32_t h, int quality,
+                          const char *outFilename, bool optimize) {
+    FILE *outfile = fopen(outFilename, "wb");
+    if (outfile == nullptr) {
+        LOGE("can't open %s", outFilename);
+        return -1;
+    }
+    int result = compressRows(source, w, h, quality, optimize, 0, outfile, nullptr);
+    /* After finish_compress, we can close the output file. */
+    fclose(outfile);
+    return result;
+}
+
+static int compressToMemory(const compress_source &source, uint32_t w, uint32_t h, int quality, bool optimize,
+                            int restartRows, BYTE **jpeg, size_t *jpegSize) {
+    memory_destination_mgr memory{};
+    memory.growable = *jpeg == nullptr;
+    if (memory.growable) {
+        // 常见质量下 JPEG 约为每像素 1~2 bit，从每像素 2 bit 开始，不够再加倍
+        memory.capacity = (size_t) w * h / 4 + 4096;
+        memory.buffer = (BYTE *) malloc(memory.capacity);
+        if (memory.buffer == nullptr) return -1;
+    } else {
+        memory.buffer = *jpeg;
+        memory.capacity = *jpegSize;
+    }
+    if (compressRows(source, w, h, quality, optimize, restartRows, nullptr, &memory) != 0) {
+        if (memory.growable) free(memory.buffer);
+        return -1;
+    }
+    *jpeg = memory.buffer;
+    *jpegSize = memory.capacity - memory.pub.free_in_buffer;
+    return 0;
+}
+
+int write_JPEG_file(BYTE *data, uint32_t w, uint32_t h, int quality,
+                    const char *outFilename, bool optimize) {
+    compress_source source = {data, w * 3, JCS_RGB, 3, nullptr};
+    return compressToFile(source, w, h, quality, outFilename, optimize);
+}
+
+int compressRgbaToFile(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, int quality,
+                       const char *outFilename, bool optimize) {
+    // libjpeg-turbo 的扩展色彩空间：直接读取 R,G,B,A 排列的像素并忽略 A，省去 RGB 中间缓冲和一次转换
+    compress_source source = {rgba, stride, JCS_EXT_RGBA, 4, nullptr};
+    return compressToFile(source, w, h, quality, outFilename, optimize);
+}
+
+size_t jpegBufferSize(uint32_t w, uint32_t h) {
+    // 与 tjBufSize() 相同的 4:2:0 上限：每个 16x16 的 MCU 最多 6 个 8x8 块，每块最多 64 * 2 字节，再加上文件头
+    return ((size_t) w + 15) / 16 * 16 * (((size_t) h + 15) / 16 * 16) * 3 + 2048;
+}
+
+int compressRgbaToMemory(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, int quality, bool optimize,
+                         BYTE **jpeg, size_t *jpegSize) {
+    compress_source source = {rgba, stride, JCS_EXT_RGBA, 4, nullptr};
+    return compressToMemory(source, w, h, quality, optimize, 0, jpeg, jpegSize);
+}
+
+int compressYuvToFile(const YuvPlanes &planes, uint32_t w, uint32_t h, int quality, const char *outFilename,
+                      bool optimize) {
+    compress_source source = {nullptr, 0, JCS_YCbCr, 3, &planes};
+    return compressToFile(source, w, h, quality, outFilename, optimize);
+}
+
+int compressYuvToMemory(const YuvPlanes &planes, uint32_t w, uint32_t h, int quality, bool optimize,
+                        BYTE **jpeg, size_t *jpegSize) {
+    compress_source source = {nullptr, 0, JCS_YCbCr, 3, &planes};
+    return compressToMemory(source, w, h, quality, optimize, 0, jpeg, jpegSize);
+}
+
+// ===== 并行压缩 =====
+
+// 4:2:0 的一个 MCU 行的像素行数，条带按它对齐
+static const uint32_t kMcuHeight = 16;
+static const uint32_t kMaxThreadCount = 16;
+
+/**
+ * 图像的一个水平条带，从第 [firstMcuRow] 个 MCU 行开始，单独压缩成一个每个 MCU 行一个重启间隔的 JPEG。
+ */
+struct compress_strip {
+    compress_source source;
+    YuvPlanes yuv;
+    uint32_t firstMcuRow;
+    uint32_t height;
+    BYTE *jpeg;
+    size_t size;
+    // 文件头（到 SOS 段为止）的长度，之后是熵编码数据，最后是 EOI
+    size_t headerSize;
+    // 第一个条带中 SOF0 段的位置，拼接后要改成整张图像的高度
+    size_t sofOffset;
+    int result;
+};
+
+/**
+ * 找到 SOS 段之后熵编码数据开始的位置，以及 SOF0 段的位置。格式不对时返回 0。
+ */
+static size_t findScanData(const BYTE *jpeg, size_t size, size_t *sofOffset) {
+    size_t pos = 2;
+    while (pos + 4 <= size && jpeg[pos] == 0xFF) {
+        BYTE marker = jpeg[pos + 1];
+        size_t length = ((size_t) jpeg[pos + 2] << 8) | jpeg[pos + 3];
+        if (marker == 0xC0) *sofOffset = pos;
+        if (marker == 0xDA) return pos + 2 + length;
+        pos += 2 + length;
+    }
+    return 0;
+}
+
+/**
+ * 条带中的重启标记从 RST0 开始编号，加上 [offset] 后与整张图像中的编号一致。
+ * 熵编码数据中的 0xFF 都会填充为 0xFF 0x00，所以 0xFF 0xD0~0xD7 只会是重启标记。
+ */
+static void renumberRestartMarkers(BYTE *data, size_t size, uint32_t offset) {
+    for (size_t i = 0; i + 1 < size; i++) {
+        if (data[i] != 0xFF) continue;
+        i++;
+        if ((data[i] & 0xF8) == 0xD0) data[i] = (BYTE) (0xD0 | ((data[i] + offset) & 7));
+    }
+}
+
+static void compressStrip(compress_strip *strip, uint32_t w, int quality) {
+    strip->jpeg = nullptr;
+    strip->result = compressToMemory(strip->source, w, strip->height, quality, false, 1, &strip->jpeg, &strip->size);
+    if (strip->result != 0) return;
+    strip->sofOffset = 0;
+    strip->headerSize = findScanData(strip->jpeg, strip->size, &strip->sofOffset);
+    if (strip->headerSize == 0 || strip->sofOffset == 0 || strip->size < strip->headerSize + 2) {
+        strip->result = -1;
+        return;
+    }
+    renumberRestartMarkers(strip->jpeg + strip->headerSize, strip->size - strip->headerSize - 2, strip->firstMcuRow);
+}
+
+/**
+ * 把图像按 MCU 行分成最多 [threadCount] 个条带，每个条带在一个线程中压缩，再拼接成一个 baseline JPEG：
+ * 第一个条带的文件头（高度改为整张图像的高度），各条带的熵编码数据，条带之间补上一个重启标记，最后是 EOI。
+ *
+ * 每个 MCU 行都是一个重启间隔，条带从重启间隔的边界开始，DC 预测也从 0 开始，所以结果和一个线程、
+ * restart_in_rows = 1 压缩的 JPEG 完全相同，与线程数无关。
+ * 各条带必须使用相同的 Huffman 表，所以总是使用标准表，不支持 optimize_coding。
+ */
+static int compressParallel(const compress_source &source, uint32_t w, uint32_t h, int quality,
+                            uint32_t threadCount, BYTE **jpeg, size_t *jpegSize) {
+    if (w == 0 || h == 0 || w > JPEG_MAX_DIMENSION || h > JPEG_MAX_DIMENSION) {
+        LOGE("Invalid image size: %ux%u", w, h);
+        return -1;
+    }
+    uint32_t mcuRows = (h + kMcuHeight - 1) / kMcuHeight;
+    uint32_t count = threadCount < 1 ? 1 : threadCount > kMaxThreadCount ? kMaxThreadCount : threadCount;
+    if (count > mcuRows) count = mcuRows;
+
+    std::vector<compress_strip> strips(count);
+    for (uint32_t k = 0; k < count; k++) {
+        compress_strip &strip = strips[k];
+        uint32_t firstRow = k * mcuRows / count * kMcuHeight;
+        uint32_t endRow = (k + 1) * mcuRows / count * kMcuHeight;
+        strip.firstMcuRow = firstRow / kMcuHeight;
+        strip.height = (endRow < h ? endRow : h) - firstRow;
+        strip.source = source;
+        if (source.yuv != nullptr) {
+            // firstRow 是 16 的倍数，U/V 从第 firstRow / 2 行开始
+            strip.yuv = *source.yuv;
+            strip.yuv.y += (size_t) firstRow * strip.yuv.yStride;
+            strip.yuv.u += (size_t) firstRow / 2 * strip.yuv.uStride;
+            strip.yuv.v += (size_t) firstRow / 2 * strip.yuv.vStride;
+            strip.source.yuv = &strip.yuv;
+        } else {
+            strip.source.data += (size_t) firstRow * source.stride;
+        }
+    }
+
+    // 第一个条带在调用者的线程中压缩
+    std::vector<std::thread> threads;
+    for (uint32_t k = 1; k < count; k++) {
+        threads.emplace_back(compressStrip, &strips[k], w, quality);
+    }
+    compressStrip(&strips[0], w, quality);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    int result = 0;
+    size_t size = strips[0].headerSize + 2;
+    for (const compress_strip &strip : strips) {
+        if (strip.result != 0) result = -1;
+        else size += strip.size - strip.headerSize - 2 + (strip.firstMcuRow == 0 ? 0 : 2);
+    }
+    BYTE *output = nullptr;
+    if (result == 0) {
+        if (*jpeg == nullptr) {
+            output = (BYTE *) malloc(size);
+        } else if (*jpegSize >= size) {
+            output = *jpeg;
+        } else {
+            // 调用者的缓冲区不够大，见 jpegBufferSize()
+            LOGE("The JPEG buffer is too small. Required: %zu bytes, capacity: %zu bytes.", size, *jpegSize);
+        }
+        if (output == nullptr) result = -1;
+    }
+    if (result == 0) {
+        const compress_strip &first = strips[0];
+        BYTE *out = output;
+        memcpy(out, first.jpeg, first.headerSize);
+        out[first.sofOffset + 5] = (BYTE) (h >> 8);
+        out[first.sofOffset + 6] = (BYTE) h;
+        out += first.headerSize;
+        for (const compress_strip &strip : strips) {
+            if (strip.firstMcuRow != 0) {
+                // 上一个条带的最后一个 MCU 行结束，下一个重启间隔开始
+                *out++ = 0xFF;
+                *out++ = (BYTE) (0xD0 | ((strip.firstMcuRow - 1) & 7));
+            }
+            size_t dataSize = strip.size - strip.headerSize - 2;
+            memcpy(out, strip.jpeg + strip.headerSize, dataSize);
+            out += dataSize;
+        }
+        *out++ = 0xFF;
+        *out++ = 0xD9;
+        *jpeg = output;
+        *jpegSize = size;
+    }
+    for (compress_strip &strip : strips) {
+        free(strip.jpeg);
+    }
+    return result;
+}
+
+int compressRgbaToMemoryParallel(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, int quality,
+                                 uint32_t threadCount, BYTE **jpeg, size_t *jpegSize) {
+    compress_source source = {rgba, stride, JCS_EXT_RGBA, 4, nullptr};
+    return compressParallel(source, w, h, quality, threadCount, jpeg, jpegSize);
+}
+
+int compressRgbaToFileParallel(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, int quality,
+                               uint32_t threadCount, const char *outFilename) {
+    BYTE *jpeg = nullptr;
+    size_t size = 0;
+    if (compressRgbaToMemoryParallel(rgba, w, h, stride, quality, threadCount, &jpeg, &size) != 0) {
+        return -1;
+    }
+    FILE *outfile = fopen(outFilename, "wb");
+    if (outfile == nullptr) {
+        LOGE("can't open %s", outFilename);
+        free(jpeg);
+        return -1;
+    }
+    bool written = fwrite(jpeg, 1, size, outfile) == size;
+    free(jpeg);
+    return fclose(outfile) == 0 && written ? 0 : -1;
+}
+
+int compressYuvToMemoryParallel(const YuvPlanes &planes, uint32_t w, uint32_t h, int quality, uint32_t threadCount,
+                                BYTE **jpeg, size_t *jpegSize) {
+    compress_source source = {nullptr, 0, JCS_YCbCr, 3, &planes};
+    return compressParallel(source, w, h, quality, threadCount, jpeg, jpegSize);
+}
+
+/**
+ * 一直保留的压缩器和输出缓冲区，以及上一张图像的参数。
+ */
+struct JpegEncoder::Context {
+    struct jpeg_compress_struct cinfo;
+    struct my_error_mgr jem;
+    memory_destination_mgr memory;
+    // 调用者没有提供缓冲区时使用，在图像之间保留，只会变大
+    BYTE *buffer;
+    size_t capacity;
+    // 上一张图像成功设置的参数，都相同时不必再调用 jpeg_set_defaults 和 jpeg_set_quality
+    bool configured;
+    J_COLOR_SPACE colorSpace;
+    int quality;
+    bool optimize;
+    // optimize_coding 会把为图像计算的 Huffman 表写回 cinfo。jpeg_set_defaults 会把标准表复制回已有的表，
+    // 但参数相同时不会调用它，所以保存一份标准表，不优化的图像压缩前恢复，不依赖是否调用了 jpeg_set_defaults
+    JHUFF_TBL standardDcTables[2];
+    JHUFF_TBL standardAcTables[2];
+};
+
+JpegEncoder::JpegEncoder() : context_(new Context()) {
+    context_->cinfo.err = jpeg_std_error(&context_->jem.pub);
+    context_->jem.pub.error_exit = my_error_exit;
+    if (setjmp(context_->jem.setjmp_buffer)) {
+        // 内存不足，compress() 会返回 -1
+        jpeg_destroy_compress(&context_->cinfo);
+        delete context_;
+        context_ = nullptr;
+        return;
+    }
+    jpeg_create_compress(&context_->cinfo);
+    context_->cinfo.in_color_space = JCS_RGB;
+    context_->cinfo.input_components = 3;
+    jpeg_set_defaults(&context_->cinfo);
+    for (int i = 0; i < 2; i++) {
+        context_->standardDcTables[i] = *context_->cinfo.dc_huff_tbl_ptrs[i];
+        context_->standardAcTables[i] = *context_->cinfo.ac_huff_tbl_ptrs[i];
+    }
+}
+
+JpegEncoder::~JpegEncoder() {
+    if (context_ == nullptr) return;
+    jpeg_destroy_compress(&context_->cinfo);
+    free(context_->buffer);
+    delete context_;
+}
+
+int JpegEncoder::compress(const compress_source &source, uint32_t w, uint32_t h, int quality, bool optimize,
+                          BYTE **jpeg, size_t *jpegSize) {
+    if (context_ == nullptr) return -1;
+    Context *context = context_;
+    // 在 Context 中而不是栈上，longjmp 回来后仍然可以读取
+    memory_destination_mgr &memory = context->memory;
+    memory = memory_destination_mgr();
+    memory.growable = *jpeg == nullptr;
+    if (memory.growable) {
+        if (context->buffer == nullptr) {
+            // 常见质量下 JPEG 约为每像素 1~2 bit，从每像素 2 bit 开始，不够再加倍
+            context->capacity = (size_t) w * h / 4 + 4096;
+            context->buffer = (BYTE *) malloc(context->capacity);
+            if (context->buffer == nullptr) return -1;
+        }
+        memory.buffer = context->buffer;
+        memory.capacity = context->capacity;
+    } else {
+        memory.buffer = *jpeg;
+        memory.capacity = *jpegSize;
+    }
+
+    if (setjmp(context->jem.setjmp_buffer)) {
+        // 压缩器回到空闲状态，参数不再可信，下一张图像重新设置
+        jpeg_abort_compress(&context->cinfo);
+        context->configured = false;
+        if (memory.growable) {
+            context->buffer = memory.buffer;
+            context->capacity = memory.capacity;
+        }
+        return -1;
+    }
+    bool setParameters = !context->configured || context->colorSpace != source.colorSpace ||
+                         context->quality != quality || context->optimize != optimize;
+    // 先标记为未设置，压缩成功后才记录参数
+    context->configured = false;
+    if (!optimize) {
+        for (int i = 0; i < 2; i++) {
+            *context->cinfo.dc_huff_tbl_ptrs[i] = context->standardDcTables[i];
+            *context->cinfo.ac_huff_tbl_ptrs[i] = context->standardAcTables[i];
+        }
+    }
+    setMemoryDestination(&context->cinfo, &memory);
+    compressImage(&context->cinfo, source, w, h, quality, optimize, setParameters, 0);
+    context->configured = true;
+    context->colorSpace = source.colorSpace;
+    context->quality = quality;
+    context->optimize = optimize;
+
+    if (memory.growable) {
+        context->buffer = memory.buffer;
+        context->capacity = memory.capacity;
+    }
+    *jpeg = memory.buffer;
+    *jpegSize = memory.capacity - memory.pub.free_in_buffer;
+    return 0;
+}
+
+int JpegEncoder::compressRgba(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, int quality, bool optimize,
+                              BYTE **jpeg, size_t *jpegSize) {
+    compress_source source = {rgba, stride, JCS_EXT_RGBA, 4, nullptr};
+    return compress(source, w, h, quality, optimize, jpeg, jpegSize);
+}
+
+int JpegEncoder::compressYuv(const YuvPlanes &planes, uint32_t w, uint32_t h, int quality, bool optimize,
+                             BYTE **jpeg, size_t *jpegSize) {
+    compress_source source = {nullptr, 0, JCS_YCbCr, 3, &planes};
+    return compress(source, w, h, quality, optimize, jpeg, jpegSize);
+}
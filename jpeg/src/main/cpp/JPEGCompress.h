@@ -0,0 +1,165 @@
+#ifndef LEOANDROIDBASEUTIL_JPEGCOMPRESS_H
+#define LEOANDROIDBASEUTIL_JPEGCOMPRESS_H
+
+#include <cstddef>
+#include <cstdint>
+
+typedef uint8_t BYTE;
+
+/**
+ * Convert the RGBA_8888 pixels of an Android Bitmap into tightly packed RGB.
+ *
+ * In native code the bytes of a pixel are R, G, B, A in memory, so read as an uint32_t on
+ * a little endian CPU it is ABGR from the high byte to the low byte.
+ *
+ * @param rgba [h] rows of [w] pixels, [stride] bytes per row.
+ * @param rgb [w] * [h] * 3 bytes.
+ */
+void rgbaToRgb(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, BYTE *rgb);
+
+/**
+ * Compress tightly packed RGB [data] into the JPEG file [outFilename].
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int write_JPEG_file(BYTE *data, uint32_t w, uint32_t h, int quality,
+                    const char *outFilename, bool optimize);
+
+/**
+ * Compress the RGBA_8888 pixels of an Android Bitmap into the JPEG file [outFilename].
+ *
+ * The rows are read in place, in batches of scanlines, so neither an RGB copy nor [rgbaToRgb] is needed.
+ * The alpha channel is ignored. The result is the same as [rgbaToRgb] followed by [write_JPEG_file].
+ *
+ * @param rgba [h] rows of [w] pixels, [stride] bytes per row.
+ * @return 0 on success, -1 on failure.
+ */
+int compressRgbaToFile(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, int quality,
+                       const char *outFilename, bool optimize);
+
+/**
+ * The largest JPEG [compressRgbaToMemory] can produce for a [w] x [h] image, whatever the pixels and the quality.
+ */
+size_t jpegBufferSize(uint32_t w, uint32_t h);
+
+/**
+ * Compress the RGBA_8888 pixels of an Android Bitmap into memory, without going through a file.
+ *
+ * @param rgba [h] rows of [w] pixels, [stride] bytes per row.
+ * @param jpeg In: a buffer of [jpegSize] bytes owned by the caller, or a pointer to nullptr.
+ * The compression fails when the JPEG doesn't fit into the caller's buffer, which never happens with
+ * [jpegBufferSize] bytes. With nullptr a buffer is allocated with malloc() and grown as needed,
+ * the caller frees it with free(). Out: the JPEG.
+ * @param jpegSize In: the size of the caller's buffer. Out: the size of the JPEG.
+ * @return 0 on success, -1 on failure. Nothing is allocated on failure.
+ */
+int compressRgbaToMemory(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, int quality, bool optimize,
+                         BYTE **jpeg, size_t *jpegSize);
+
+/**
+ * The planes of a YUV 4:2:0 image, as described by android.media.Image.Plane.
+ *
+ * I420 has [uvPixelStride] 1. NV21 and NV12 have [uvPixelStride] 2, with [u] and [v] one byte apart
+ * in the same interleaved plane: `u = vu + 1, v = vu` for NV21.
+ * The U and V planes are (w + 1) / 2 x (h + 1) / 2.
+ */
+struct YuvPlanes {
+    const BYTE *y;
+    uint32_t yStride;
+    const BYTE *u;
+    uint32_t uStride;
+    const BYTE *v;
+    uint32_t vStride;
+    uint32_t uvPixelStride;
+};
+
+/**
+ * Compress a YUV 4:2:0 image into the JPEG file [outFilename].
+ *
+ * The planes become the YCbCr components of the JPEG as they are, so there is neither a conversion to RGB
+ * nor the conversion back inside libjpeg. The image must be full range BT.601 (JFIF), as camera frames are.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int compressYuvToFile(const YuvPlanes &planes, uint32_t w, uint32_t h, int quality, const char *outFilename,
+                      bool optimize);
+
+/**
+ * Compress a YUV 4:2:0 image into memory, see [compressYuvToFile] and [compressRgbaToMemory].
+ */
+int compressYuvToMemory(const YuvPlanes &planes, uint32_t w, uint32_t h, int quality, bool optimize,
+                        BYTE **jpeg, size_t *jpegSize);
+
+/**
+ * Compress the RGBA_8888 pixels of an Android Bitmap on up to [threadCount] threads, for very large images.
+ *
+ * The image is split into horizontal strips of whole MCU rows (16 pixel rows), which are compressed at the same time
+ * and joined into one baseline JPEG. Every MCU row is a restart interval (DRI and RST0-RST7 markers), so a strip
+ * starts at an interval boundary. The JPEG is the same whatever [threadCount], and decodes to the same pixels as
+ * [compressRgbaToMemory], a few bytes per MCU row larger.
+ * The standard Huffman tables are always used, the strips can't share optimized ones.
+ *
+ * @param jpeg See [compressRgbaToMemory]. With nullptr the buffer has exactly the size of the JPEG.
+ * @return 0 on success, -1 on failure.
+ */
+int compressRgbaToMemoryParallel(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, int quality,
+                                 uint32_t threadCount, BYTE **jpeg, size_t *jpegSize);
+
+/**
+ * [compressRgbaToMemoryParallel] into the JPEG file [outFilename].
+ */
+int compressRgbaToFileParallel(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, int quality,
+                               uint32_t threadCount, const char *outFilename);
+
+/**
+ * Compress a YUV 4:2:0 image on up to [threadCount] threads, see [compressRgbaToMemoryParallel]
+ * and [compressYuvToFile].
+ */
+int compressYuvToMemoryParallel(const YuvPlanes &planes, uint32_t w, uint32_t h, int quality, uint32_t threadCount,
+                                BYTE **jpeg, size_t *jpegSize);
+
+struct compress_source;
+
+/**
+ * A compressor kept between images, for bursts of frames.
+ *
+ * The one shot functions create a libjpeg compressor, set up its parameters and tables and grow a new output buffer
+ * for every image. The encoder does all of that once: as long as the quality, the optimize flag and the kind of
+ * input (RGBA or YUV) stay the same, only the size of the image is updated. The result is the same as the one
+ * shot functions.
+ *
+ * Not thread safe, use one encoder per thread.
+ */
+class JpegEncoder {
+public:
+    JpegEncoder();
+
+    ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder &) = delete;
+
+    JpegEncoder &operator=(const JpegEncoder &) = delete;
+
+    /**
+     * See [compressRgbaToMemory]. With a pointer to nullptr [jpeg] points into a buffer of the encoder,
+     * which is kept between images and valid until the next call. It must not be freed.
+     */
+    int compressRgba(const BYTE *rgba, uint32_t w, uint32_t h, uint32_t stride, int quality, bool optimize,
+                     BYTE **jpeg, size_t *jpegSize);
+
+    /**
+     * See [compressYuvToMemory] and [compressRgba].
+     */
+    int compressYuv(const YuvPlanes &planes, uint32_t w, uint32_t h, int quality, bool optimize,
+                    BYTE **jpeg, size_t *jpegSize);
+
+private:
+    struct Context;
+
+    int compress(const compress_source &source, uint32_t w, uint32_t h, int quality, bool optimize,
+                 BYTE **jpeg, size_t *jpegSize);
+
+    Context *context_;
+};
+
+#endif //LEOANDROIDBASEUTIL_JPEGCOMPRESS_H
@@ -0,0 +1,124 @@
+#include "JPEGDecompress.h"
+
+#include <cstring>
+
+#include "JPEGError.h"
+
+// 一次交给 jpeg_read_scanlines 的最多行数
+static const uint32_t kScanlineBatch = 16;
+// 裁剪时区域两边多解码的列数
+static const uint32_t kCropMargin = 2;
+
+static bool isSupportedScale(uint32_t scaleDenom) {
+    return scaleDenom == 1 || scaleDenom == 2 || scaleDenom == 4 || scaleDenom == 8;
+}
+
+/**
+ * 读取文件头，设置缩放比例和 RGBA 输出，并计算输出的宽高（output_width、output_height）。
+ */
+static void readHeader(j_decompress_ptr cinfo, const BYTE *jpeg, size_t jpegSize, uint32_t scaleDenom) {
+    jpeg_mem_src(cinfo, jpeg, (unsigned long) jpegSize);
+    jpeg_read_header(cinfo, TRUE);
+    // DCT 域缩放：每个 8x8 块直接用 8 / scaleDenom 点的 IDCT 还原，不需要先解码出原图
+    cinfo->scale_num = 1;
+    cinfo->scale_denom = scaleDenom;
+    // libjpeg-turbo 的扩展色彩空间：直接输出 Bitmap 的 R,G,B,A 排列，A 为 0xFF
+    cinfo->out_color_space = JCS_EXT_RGBA;
+    jpeg_calc_output_dimensions(cinfo);
+}
+
+int getJpegScaledSize(const BYTE *jpeg, size_t jpegSize, uint32_t scaleDenom, uint32_t *w, uint32_t *h) {
+    if (!isSupportedScale(scaleDenom)) {
+        LOGE("Unsupported scale 1/%u", scaleDenom);
+        return -1;
+    }
+    struct jpeg_decompress_struct cinfo{};
+    struct my_error_mgr jem{};
+    cinfo.err = jpeg_std_error(&jem.pub);
+    jem.pub.error_exit = my_error_exit;
+    if (setjmp(jem.setjmp_buffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+    jpeg_create_decompress(&cinfo);
+    readHeader(&cinfo, jpeg, jpegSize, scaleDenom);
+    *w = cinfo.output_width;
+    *h = cinfo.output_height;
+    jpeg_destroy_decompress(&cinfo);
+    return 0;
+}
+
+int decodeJpegToRgba(const BYTE *jpeg, size_t jpegSize, uint32_t scaleDenom, uint32_t left, uint32_t top,
+                     uint32_t w, uint32_t h, BYTE *rgba, uint32_t stride) {
+    if (!isSupportedScale(scaleDenom)) {
+        LOGE("Unsupported scale 1/%u", scaleDenom);
+        return -1;
+    }
+    struct jpeg_decompress_struct cinfo{};
+
+    /* We set up the normal JPEG error routines, then override error_exit. */
+    struct my_error_mgr jem{};
+    cinfo.err = jpeg_std_error(&jem.pub);
+    jem.pub.error_exit = my_error_exit;
+    /* Establish the setjmp return context for my_error_exit to use. */
+    if (setjmp(jem.setjmp_buffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+    jpeg_create_decompress(&cinfo);
+    readHeader(&cinfo, jpeg, jpegSize, scaleDenom);
+    if (w == 0 || h == 0 || (uint64_t) left + w > cinfo.output_width || (uint64_t) top + h > cinfo.output_height) {
+        LOGE("The region %ux%u at (%u, %u) is outside of the %ux%u image", w, h, left, top, cinfo.output_width,
+             cinfo.output_height);
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+    jpeg_start_decompress(&cinfo);
+
+    // 只解码覆盖区域的 iMCU 列。fancy upsampling 会把裁剪的左右边缘当作图像边缘处理（见 libjpeg.txt），
+    // 所以两边各多留 kCropMargin 列，区域内的像素才和完整解码的一样。
+    // 起点会向左对齐到 iMCU 边界，解码出的行比区域宽，这时先解码到临时行再复制出区域，否则直接解码到 [rgba] 中
+    JDIMENSION xoffset = left > kCropMargin ? left - kCropMargin : 0;
+    JDIMENSION end = (uint64_t) left + w + kCropMargin < cinfo.output_width ? left + w + kCropMargin
+                                                                             : cinfo.output_width;
+    JDIMENSION cropWidth = end - xoffset;
+    if (cropWidth < cinfo.output_width) {
+        jpeg_crop_scanline(&cinfo, &xoffset, &cropWidth);
+    }
+    uint32_t skippedColumns = left - xoffset;
+    JSAMPARRAY scratch = nullptr;
+    if (skippedColumns != 0 || cropWidth != w) {
+        // 由 libjpeg 的内存池分配，随 jpeg_destroy_decompress 释放
+        scratch = (*cinfo.mem->alloc_sarray)((j_common_ptr) &cinfo, JPOOL_IMAGE, cropWidth * 4, kScanlineBatch);
+    }
+
+    // 区域上方的整个 iMCU 行只做熵解码，跳过 IDCT、上采样和颜色转换
+    if (top > 0) {
+        jpeg_skip_scanlines(&cinfo, top);
+    }
+
+    JSAMPROW rows[kScanlineBatch];
+    uint32_t y = 0;
+    while (y < h) {
+        uint32_t count = h - y;
+        if (count > kScanlineBatch) count = kScanlineBatch;
+        for (uint32_t i = 0; i < count; i++) {
+            rows[i] = scratch != nullptr ? scratch[i] : (JSAMPROW) (rgba + (size_t) (y + i) * stride);
+        }
+        JDIMENSION read = jpeg_read_scanlines(&cinfo, rows, count);
+        if (read == 0) {
+            jpeg_destroy_decompress(&cinfo);
+            return -1;
+        }
+        if (scratch != nullptr) {
+            for (uint32_t i = 0; i < read; i++) {
+                memcpy(rgba + (size_t) (y + i) * stride, scratch[i] + (size_t) skippedColumns * 4, (size_t) w * 4);
+            }
+        }
+        y += read;
+    }
+
+    // 区域下方的行不再解码，直接销毁而不调用 jpeg_finish_decompress
+    jpeg_destroy_decompress(&cinfo);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef LEOANDROIDBASEUTIL_JPEGDECOMPRESS_H
+#define LEOANDROIDBASEUTIL_JPEGDECOMPRESS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "JPEGCompress.h"
+
+/**
+ * Read the size of the [jpeg] of [jpegSize] bytes decoded at 1 / [scaleDenom] of its size,
+ * which is the full size divided by [scaleDenom] and rounded up.
+ *
+ * Only the header is parsed.
+ *
+ * @param scaleDenom 1, 2, 4 or 8.
+ * @return 0 on success, -1 on failure.
+ */
+int getJpegScaledSize(const BYTE *jpeg, size_t jpegSize, uint32_t scaleDenom, uint32_t *w, uint32_t *h);
+
+/**
+ * Decode the [w] x [h] region at ([left], [top]) of the [jpeg] scaled to 1 / [scaleDenom] into RGBA_8888 pixels,
+ * the layout of an Android Bitmap. The alpha channel is 0xFF.
+ *
+ * The scaling happens in the DCT domain, so the 1/8 thumbnail of a photo costs a small part of a full decode.
+ * The rows above the region are mostly only entropy decoded, the ones below it are not decoded at all. The columns are cropped to the iMCU columns covering the region.
+ *
+ * @param left, top, w, h The region, in the pixels of the scaled image, see [getJpegScaledSize].
+ * @param rgba [h] rows of [w] pixels, [stride] bytes per row.
+ * @return 0 on success, -1 on failure, e.g. a region outside of the image.
+ */
+int decodeJpegToRgba(const BYTE *jpeg, size_t jpegSize, uint32_t scaleDenom, uint32_t left, uint32_t top,
+                     uint32_t w, uint32_t h, BYTE *rgba, uint32_t stride);
+
+#endif //LEOANDROIDBASEUTIL_JPEGDECOMPRESS_H
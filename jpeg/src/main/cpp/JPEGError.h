@@ -0,0 +1,43 @@
+#ifndef LEOANDROIDBASEUTIL_JPEGERROR_H
+#define LEOANDROIDBASEUTIL_JPEGERROR_H
+
+// 压缩和解压共用的 libjpeg 错误处理：出错时 longjmp 回到调用者设置的 setjmp_buffer，而不是 exit()。
+
+#include <csetjmp>
+#include <cstdio>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <jpeglib.h>
+#include <jerror.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __ANDROID__
+#include <android/log.h>
+
+#define LOG_TAG "LEO-JPEG"
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR,LOG_TAG,__VA_ARGS__)
+#else
+#define LOGE(...) fprintf(stderr, __VA_ARGS__)
+#endif
+
+struct my_error_mgr {
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmp_buffer; /* for return to caller */
+};
+typedef struct my_error_mgr *my_error_ptr;
+
+inline void my_error_exit(j_common_ptr cinfo) {
+    auto myerr = (my_error_ptr) cinfo->err;
+    (*cinfo->err->output_message)(cinfo);
+    LOGE("jpeg_message_table[%d]:%s", myerr->pub.msg_code,
+         myerr->pub.jpeg_message_table[myerr->pub.msg_code]);
+    longjmp(myerr->setjmp_buffer, 1);
+}
+
+#endif //LEOANDROIDBASEUTIL_JPEGERROR_H
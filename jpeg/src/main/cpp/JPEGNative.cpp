@@ -1,8 +1,11 @@
 #include <jni.h>
 #include <string>
+#include <cstdlib>
+#include <cstring>
 #include <android/bitmap.h>
 #include <android/log.h>
-#include <csetjmp>
+#include "JPEGCompress.h"
+#include "JPEGDecompress.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,175 +23,454 @@ extern "C" {
 
 #define JPEG_PACKAGE_BASE "com/leovp/jpeg/"
 
-typedef uint8_t BYTE;
-
-struct my_error_mgr {
-    struct jpeg_error_mgr pub;
-    jmp_buf setjmp_buffer; /* for return to caller */
-};
-typedef struct my_error_mgr *my_error_ptr;
-
-METHODDEF(void) my_error_exit(j_common_ptr cinfo) {
-    auto myerr = (my_error_ptr) cinfo->err;
-    (*cinfo->err->output_message)(cinfo);
-    LOGE("jpeg_message_table[%d]:%s", myerr->pub.msg_code,
-         myerr->pub.jpeg_message_table[myerr->pub.msg_code]);
-    longjmp(myerr->setjmp_buffer, 1);
+// 在 JNI_OnLoad 中缓存，用于创建返回给 Java 的 direct ByteBuffer
+static jclass g_byteBufferClass = nullptr;
+static jmethodID g_allocateDirect = nullptr;
+// JPEGEncoder.ctx，保存 native 的 JpegEncoder 指针
+static jfieldID g_encoderCtx = nullptr;
+
+/**
+ * 锁定 RGBA_8888 格式的 [bitmap] 的像素。成功时返回 true，调用者负责 AndroidBitmap_unlockPixels。
+ * 压缩期间一直锁定像素，libjpeg-turbo 直接逐批读取 Bitmap 的行，不再复制出 RGB 数据。
+ */
+static bool lockRgbaBitmap(JNIEnv *env, jobject bitmap, AndroidBitmapInfo *info, BYTE **pixels) {
+    //获取Bitmap信息
+    if (AndroidBitmap_getInfo(env, bitmap, info) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        return false;
+    }
+    if (info->format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE("Only RGBA_8888 bitmaps are supported, format=%d", info->format);
+        return false;
+    }
+    //读取Bitmap所有像素信息
+    return AndroidBitmap_lockPixels(env, bitmap, (void **) pixels) == ANDROID_BITMAP_RESULT_SUCCESS;
 }
 
+JNIEXPORT jint JNICALL compressBitmap(JNIEnv *env, __attribute__((unused)) jobject,
+                                      jobject bitmap,
+                                      jint quality,
+                                      jstring outFilPath,
+                                      jboolean optimize) {
+    AndroidBitmapInfo android_bitmap_info;
+    BYTE *pixelsColor;
+    if (!lockRgbaBitmap(env, bitmap, &android_bitmap_info, &pixelsColor)) {
+        return -1;
+    }
+    //获取bitmap的 宽，高
+    uint32_t w = android_bitmap_info.width;
+    uint32_t h = android_bitmap_info.height;
 
-int write_JPEG_file(BYTE *data, uint32_t w, uint32_t h, int quality,
-                    const char *outFilename, jboolean optimize) {
-    //jpeg的结构体，保存的比如宽、高、位深、图片格式等信息
-    struct jpeg_compress_struct cinfo{};
+//    LOGE("bitmap w=%d h=%d", w, h);
 
-    /* Step 1: allocate and initialize JPEG compression object */
+    char *path = (char *) env->GetStringUTFChars(outFilPath, nullptr);
+//    LOGE("path=%s", path);
 
-    /* We set up the normal JPEG error routines, then override error_exit. */
-    struct my_error_mgr jem{};
-    cinfo.err = jpeg_std_error(&jem.pub);
-    jem.pub.error_exit = my_error_exit;
-    /* Establish the setjmp return context for my_error_exit to use. */
-    if (setjmp(jem.setjmp_buffer)) {
-        /* If we get here, the JPEG code has signaled an error.
-         and return.
-         */
+    // Libjpeg进行压缩
+    int resultCode = compressRgbaToFile(pixelsColor, w, h, android_bitmap_info.stride, quality, path, optimize);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    env->ReleaseStringUTFChars(outFilPath, path);
+    return resultCode == -1 ? -1 : 0;
+}
+
+JNIEXPORT jint JNICALL getJpegBufferSize(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jobject,
+                                         jint width,
+                                         jint height) {
+    if (width <= 0 || height <= 0) {
         return -1;
     }
-    jpeg_create_compress(&cinfo);
+    size_t size = jpegBufferSize((uint32_t) width, (uint32_t) height);
+    return size > INT32_MAX ? -1 : (jint) size;
+}
 
-    /* Step 2: specify data destination (eg, a file) */
+/**
+ * 取出写入 JPEG 的 direct ByteBuffer 的地址和容量，总是从缓冲区的开头开始写入。
+ */
+static bool getOutputBuffer(JNIEnv *env, jobject buffer, BYTE **address, size_t *size) {
+    *address = buffer == nullptr ? nullptr : (BYTE *) env->GetDirectBufferAddress(buffer);
+    jlong capacity = *address == nullptr ? 0 : env->GetDirectBufferCapacity(buffer);
+    if (capacity <= 0) {
+        LOGE("The JPEG buffer must be a direct ByteBuffer.");
+        return false;
+    }
+    *size = (size_t) capacity;
+    return true;
+}
+
+/**
+ * 压缩 RGBA_8888 格式的 [bitmap]，[encoder] 为 nullptr 时使用一次性的压缩对象。
+ * [jpeg] 和 [size] 的含义和 compressRgbaToMemory 相同。
+ */
+static int compressBitmapToMemory(JNIEnv *env, JpegEncoder *encoder, jobject bitmap, jint quality, jboolean optimize,
+                                  BYTE **jpeg, size_t *size) {
+    AndroidBitmapInfo android_bitmap_info;
+    BYTE *pixelsColor;
+    if (!lockRgbaBitmap(env, bitmap, &android_bitmap_info, &pixelsColor)) {
+        return -1;
+    }
+    int resultCode = encoder != nullptr
+                     ? encoder->compressRgba(pixelsColor, android_bitmap_info.width, android_bitmap_info.height,
+                                             android_bitmap_info.stride, quality, optimize, jpeg, size)
+                     : compressRgbaToMemory(pixelsColor, android_bitmap_info.width, android_bitmap_info.height,
+                                            android_bitmap_info.stride, quality, optimize, jpeg, size);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return resultCode;
+}
 
-    FILE *outfile = fopen(outFilename, "wb");
-    if (outfile == nullptr) {
-        LOGE("can't open %s", outFilename);
+JNIEXPORT jint JNICALL compressBitmapInto(JNIEnv *env, __attribute__((unused)) jobject,
+                                          jobject bitmap,
+                                          jint quality,
+                                          jobject buffer,
+                                          jboolean optimize) {
+    BYTE *address;
+    size_t size;
+    if (!getOutputBuffer(env, buffer, &address, &size)) {
         return -1;
     }
-    jpeg_stdio_dest(&cinfo, outfile);
+    int resultCode = compressBitmapToMemory(env, nullptr, bitmap, quality, optimize, &address, &size);
+    return resultCode == -1 ? -1 : (jint) size;
+}
 
-    /* Step 3: set parameters for compression */
+JNIEXPORT jobject JNICALL compressBitmapToBuffer(JNIEnv *env, __attribute__((unused)) jobject,
+                                                 jobject bitmap,
+                                                 jint quality,
+                                                 jboolean optimize) {
+    // 压缩到按需增长的 native 缓冲区，再复制到大小正好的 direct ByteBuffer 中，由 GC 负责回收
+    BYTE *jpeg = nullptr;
+    size_t size = 0;
+    if (compressBitmapToMemory(env, nullptr, bitmap, quality, optimize, &jpeg, &size) == -1) {
+        return nullptr;
+    }
+    jobject buffer = nullptr;
+    if (size <= INT32_MAX) {
+        buffer = env->CallStaticObjectMethod(g_byteBufferClass, g_allocateDirect, (jint) size);
+    }
+    if (buffer != nullptr) {
+        memcpy(env->GetDirectBufferAddress(buffer), jpeg, size);
+    }
+    free(jpeg);
+    return buffer;
+}
 
-    cinfo.image_width = w;      /* image width and height, in pixels */
-    cinfo.image_height = h;
-    cinfo.input_components = 3;           /* # of color components per pixel */
-    cinfo.in_color_space = JCS_RGB;       /* colorspace of input image */
+JNIEXPORT jint JNICALL compressBitmapParallel(JNIEnv *env, __attribute__((unused)) jobject,
+                                              jobject bitmap,
+                                              jint quality,
+                                              jstring outFilPath,
+                                              jint threadCount) {
+    AndroidBitmapInfo android_bitmap_info;
+    BYTE *pixelsColor;
+    if (!lockRgbaBitmap(env, bitmap, &android_bitmap_info, &pixelsColor)) {
+        return -1;
+    }
+    const char *path = env->GetStringUTFChars(outFilPath, nullptr);
+    int resultCode = compressRgbaToFileParallel(pixelsColor, android_bitmap_info.width, android_bitmap_info.height,
+                                                android_bitmap_info.stride, quality, (uint32_t) threadCount, path);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    env->ReleaseStringUTFChars(outFilPath, path);
+    return resultCode == -1 ? -1 : 0;
+}
 
-    /*  源码地址：
-      [http://androidos.net.cn/androidossearch?query=SkImageDecoder_libjpeg.cpp](http://androidos.net.cn/androidossearch?query=SkImageDecoder_libjpeg.cpp)
+JNIEXPORT jint JNICALL compressBitmapIntoParallel(JNIEnv *env, __attribute__((unused)) jobject,
+                                                  jobject bitmap,
+                                                  jint quality,
+                                                  jobject buffer,
+                                                  jint threadCount) {
+    BYTE *address;
+    size_t size;
+    AndroidBitmapInfo android_bitmap_info;
+    BYTE *pixelsColor;
+    if (!getOutputBuffer(env, buffer, &address, &size) ||
+        !lockRgbaBitmap(env, bitmap, &android_bitmap_info, &pixelsColor)) {
+        return -1;
+    }
+    int resultCode = compressRgbaToMemoryParallel(pixelsColor, android_bitmap_info.width, android_bitmap_info.height,
+                                                  android_bitmap_info.stride, quality, (uint32_t) threadCount,
+                                                  &address, &size);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return resultCode == -1 ? -1 : (jint) size;
+}
 
-      >=android 7.0 后的源码已经设置为true了
-      ...省略其它代码
-      Tells libjpeg-turbo to compute optimal Huffman coding tables
-      for the image.  This improves compression at the cost of
-      slower encode performance.
-      cinfo.optimize_coding = TRUE;
-      jpeg_set_quality(&cinfo, quality, TRUE);
-      ...省略其它代码*/
+/**
+ * 取出 direct ByteBuffer 的地址，总是从缓冲区的开头开始，忽略 position。
+ * 不是 direct ByteBuffer 或者容量小于 [minCapacity] 时返回 nullptr。
+ */
+static const BYTE *getBufferAddress(JNIEnv *env, jobject buffer, jlong minCapacity, const char *name) {
+    auto *address = buffer == nullptr ? nullptr : (const BYTE *) env->GetDirectBufferAddress(buffer);
+    if (address == nullptr) {
+        LOGE("%s must be a direct ByteBuffer.", name);
+        return nullptr;
+    }
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (capacity < minCapacity) {
+        LOGE("%s is too small. Required: %lld bytes, capacity: %lld bytes.", name, (long long) minCapacity,
+             (long long) capacity);
+        return nullptr;
+    }
+    return address;
+}
 
+/**
+ * 检查 YUV 4:2:0 图像的参数并取出三个平面。参数不正确时返回 false。
+ */
+static bool getYuvPlanes(JNIEnv *env, jobject yBuffer, jint yRowStride, jobject uBuffer, jint uRowStride,
+                         jobject vBuffer, jint vRowStride, jint uvPixelStride, jint width, jint height,
+                         YuvPlanes *planes) {
+    if (width <= 0 || height <= 0 || (uvPixelStride != 1 && uvPixelStride != 2)) {
+        LOGE("Invalid YUV image: %dx%d, uvPixelStride=%d", width, height, uvPixelStride);
+        return false;
+    }
+    jint chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    jlong chromaRowSize = (jlong) (chromaWidth - 1) * uvPixelStride + 1;
+    if (yRowStride < width || uRowStride < chromaRowSize || vRowStride < chromaRowSize) {
+        LOGE("Invalid YUV row strides: %d, %d, %d", yRowStride, uRowStride, vRowStride);
+        return false;
+    }
+    // 最后一行不需要包含行尾的填充，和 android.media.Image 的平面一致
+    planes->y = getBufferAddress(env, yBuffer, (jlong) yRowStride * (height - 1) + width, "yBuffer");
+    planes->u = getBufferAddress(env, uBuffer, (jlong) uRowStride * (chromaHeight - 1) + chromaRowSize, "uBuffer");
+    planes->v = getBufferAddress(env, vBuffer, (jlong) vRowStride * (chromaHeight - 1) + chromaRowSize, "vBuffer");
+    planes->yStride = (uint32_t) yRowStride;
+    planes->uStride = (uint32_t) uRowStride;
+    planes->vStride = (uint32_t) vRowStride;
+    planes->uvPixelStride = (uint32_t) uvPixelStride;
+    return planes->y != nullptr && planes->u != nullptr && planes->v != nullptr;
+}
 
-    cinfo.optimize_coding = optimize;
-    //哈夫曼编码和算术编码，TRUE=arithmetic coding, FALSE=Huffman
-    if (optimize) {
-        cinfo.arith_code = false;
-    } else {
-        cinfo.arith_code = true;
+JNIEXPORT jint JNICALL compressYuv(JNIEnv *env, __attribute__((unused)) jobject,
+                                   jobject yBuffer, jint yRowStride,
+                                   jobject uBuffer, jint uRowStride,
+                                   jobject vBuffer, jint vRowStride,
+                                   jint uvPixelStride,
+                                   jint width, jint height,
+                                   jint quality,
+                                   jstring outFilPath,
+                                   jboolean optimize) {
+    YuvPlanes planes;
+    if (!getYuvPlanes(env, yBuffer, yRowStride, uBuffer, uRowStride, vBuffer, vRowStride, uvPixelStride,
+                      width, height, &planes)) {
+        return -1;
     }
-    // 其它参数 全部设置默认参数
-    jpeg_set_defaults(&cinfo);
-    //设置质量
-    jpeg_set_quality(&cinfo, quality, TRUE /* limit to baseline-JPEG values */);
+    const char *path = env->GetStringUTFChars(outFilPath, nullptr);
+    int resultCode = compressYuvToFile(planes, (uint32_t) width, (uint32_t) height, quality, path, optimize);
+    env->ReleaseStringUTFChars(outFilPath, path);
+    return resultCode == -1 ? -1 : 0;
+}
 
-    /* Step 4: Start compressor */
+JNIEXPORT jint JNICALL compressYuvInto(JNIEnv *env, __attribute__((unused)) jobject,
+                                       jobject yBuffer, jint yRowStride,
+                                       jobject uBuffer, jint uRowStride,
+                                       jobject vBuffer, jint vRowStride,
+                                       jint uvPixelStride,
+                                       jint width, jint height,
+                                       jint quality,
+                                       jobject buffer,
+                                       jboolean optimize) {
+    YuvPlanes planes;
+    BYTE *address;
+    size_t size;
+    if (!getYuvPlanes(env, yBuffer, yRowStride, uBuffer, uRowStride, vBuffer, vRowStride, uvPixelStride,
+                      width, height, &planes) || !getOutputBuffer(env, buffer, &address, &size)) {
+        return -1;
+    }
+    int resultCode = compressYuvToMemory(planes, (uint32_t) width, (uint32_t) height, quality, optimize,
+                                         &address, &size);
+    return resultCode == -1 ? -1 : (jint) size;
+}
 
-    jpeg_start_compress(&cinfo, TRUE);
+JNIEXPORT jint JNICALL compressYuvIntoParallel(JNIEnv *env, __attribute__((unused)) jobject,
+                                               jobject yBuffer, jint yRowStride,
+                                               jobject uBuffer, jint uRowStride,
+                                               jobject vBuffer, jint vRowStride,
+                                               jint uvPixelStride,
+                                               jint width, jint height,
+                                               jint quality,
+                                               jobject buffer,
+                                               jint threadCount) {
+    YuvPlanes planes;
+    BYTE *address;
+    size_t size;
+    if (!getYuvPlanes(env, yBuffer, yRowStride, uBuffer, uRowStride, vBuffer, vRowStride, uvPixelStride,
+                      width, height, &planes) || !getOutputBuffer(env, buffer, &address, &size)) {
+        return -1;
+    }
+    int resultCode = compressYuvToMemoryParallel(planes, (uint32_t) width, (uint32_t) height, quality,
+                                                 (uint32_t) threadCount, &address, &size);
+    return resultCode == -1 ? -1 : (jint) size;
+}
 
+JNIEXPORT jintArray JNICALL getScaledSize(JNIEnv *env, __attribute__((unused)) jobject,
+                                          jobject jpegBuffer,
+                                          jint jpegSize,
+                                          jint scaleDenom) {
+    const BYTE *jpeg = getBufferAddress(env, jpegBuffer, jpegSize, "jpegBuffer");
+    uint32_t w, h;
+    if (jpeg == nullptr || jpegSize <= 0 ||
+        getJpegScaledSize(jpeg, (size_t) jpegSize, (uint32_t) scaleDenom, &w, &h) != 0) {
+        return nullptr;
+    }
+    jint size[2] = {(jint) w, (jint) h};
+    jintArray result = env->NewIntArray(2);
+    if (result != nullptr) {
+        env->SetIntArrayRegion(result, 0, 2, size);
+    }
+    return result;
+}
 
-    /* Step 5: while (scan lines remain to be written) */
-    /*           jpeg_write_scanlines(...); */
+JNIEXPORT jboolean JNICALL decodeInto(JNIEnv *env, __attribute__((unused)) jobject,
+                                      jobject jpegBuffer,
+                                      jint jpegSize,
+                                      jint scaleDenom,
+                                      jint left, jint top, jint width, jint height,
+                                      jobject bitmap) {
+    const BYTE *jpeg = getBufferAddress(env, jpegBuffer, jpegSize, "jpegBuffer");
+    if (jpeg == nullptr || jpegSize <= 0 || left < 0 || top < 0 || width <= 0 || height <= 0) {
+        return JNI_FALSE;
+    }
+    AndroidBitmapInfo android_bitmap_info;
+    BYTE *pixels;
+    if (!lockRgbaBitmap(env, bitmap, &android_bitmap_info, &pixels)) {
+        return JNI_FALSE;
+    }
+    int resultCode = -1;
+    if ((uint32_t) width <= android_bitmap_info.width && (uint32_t) height <= android_bitmap_info.height) {
+        // 直接解码到 Bitmap 的像素中
+        resultCode = decodeJpegToRgba(jpeg, (size_t) jpegSize, (uint32_t) scaleDenom, (uint32_t) left,
+                                      (uint32_t) top, (uint32_t) width, (uint32_t) height, pixels,
+                                      android_bitmap_info.stride);
+    } else {
+        LOGE("The bitmap %ux%u is smaller than the region %dx%d", android_bitmap_info.width,
+             android_bitmap_info.height, width, height);
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return resultCode == 0 ? JNI_TRUE : JNI_FALSE;
+}
 
-    JSAMPROW row_pointer[1];
-    uint32_t row_stride;
-    //一行的RGB数量
-    row_stride = cinfo.image_width * 3; /* JSAMPLEs per row in image_buffer */
-    //一行一行遍历
-    while (cinfo.next_scanline < cinfo.image_height) {
-        //得到一行的首地址
-        row_pointer[0] = &data[cinfo.next_scanline * row_stride];
-        //此方法会将jcs.next_scanline加1
-        jpeg_write_scanlines(&cinfo, row_pointer, 1);//row_pointer就是一行的首地址，1：写入的行数
+JNIEXPORT jboolean JNICALL decodeIntoBuffer(JNIEnv *env, __attribute__((unused)) jobject,
+                                            jobject jpegBuffer,
+                                            jint jpegSize,
+                                            jint scaleDenom,
+                                            jint left, jint top, jint width, jint height,
+                                            jobject buffer,
+                                            jint stride) {
+    const BYTE *jpeg = getBufferAddress(env, jpegBuffer, jpegSize, "jpegBuffer");
+    if (jpeg == nullptr || jpegSize <= 0 || left < 0 || top < 0 || width <= 0 || height <= 0 ||
+        (jlong) stride < (jlong) width * 4) {
+        return JNI_FALSE;
     }
-    /* Step 6: Finish compression */
-    jpeg_finish_compress(&cinfo);
-    /* After finish_compress, we can close the output file. */
-    fclose(outfile);
+    auto *rgba = (BYTE *) getBufferAddress(env, buffer, (jlong) stride * (height - 1) + (jlong) width * 4, "buffer");
+    if (rgba == nullptr) {
+        return JNI_FALSE;
+    }
+    int resultCode = decodeJpegToRgba(jpeg, (size_t) jpegSize, (uint32_t) scaleDenom, (uint32_t) left,
+                                      (uint32_t) top, (uint32_t) width, (uint32_t) height, rgba, (uint32_t) stride);
+    return resultCode == 0 ? JNI_TRUE : JNI_FALSE;
+}
 
-    /* Step 7: release JPEG compression object */
+// ===== JPEGEncoder =====
 
-    /* This is an important step since it will release a good deal of memory. */
-    jpeg_destroy_compress(&cinfo);
+static JpegEncoder *getEncoder(JNIEnv *env, jobject thiz) {
+    auto *encoder = (JpegEncoder *) env->GetLongField(thiz, g_encoderCtx);
+    if (encoder == nullptr) {
+        LOGE("The JPEGEncoder has been released.");
+    }
+    return encoder;
+}
 
-    /* And we're done! */
-    return 0;
+/**
+ * 返回指向 [encoder] 内部缓冲区的 direct ByteBuffer，不复制 JPEG 数据。
+ * 缓冲区在下一次压缩或者释放 [encoder] 之前有效。
+ */
+static jobject wrapEncoderBuffer(JNIEnv *env, int resultCode, BYTE *jpeg, size_t size) {
+    if (resultCode == -1 || size > INT32_MAX) {
+        return nullptr;
+    }
+    return env->NewDirectByteBuffer(jpeg, (jlong) size);
 }
 
-JNIEXPORT jint JNICALL compressBitmap(JNIEnv *env, __attribute__((unused)) jobject,
-                                      jobject bitmap,
-                                      jint quality,
-                                      jstring outFilPath,
-                                      jboolean optimize) {
-    //获取Bitmap信息
-    AndroidBitmapInfo android_bitmap_info;
-    AndroidBitmap_getInfo(env, bitmap, &android_bitmap_info);
-    //获取bitmap的 宽，高，format
-    uint32_t w = android_bitmap_info.width;
-    uint32_t h = android_bitmap_info.height;
+JNIEXPORT void JNICALL encoderCreate(JNIEnv *env, jobject thiz) {
+    auto *encoder = (JpegEncoder *) env->GetLongField(thiz, g_encoderCtx);
+    if (encoder == nullptr) {
+        env->SetLongField(thiz, g_encoderCtx, (jlong) new JpegEncoder());
+    }
+}
 
-//    LOGE("bitmap w=%d h=%d", w, h);
+JNIEXPORT void JNICALL encoderRelease(JNIEnv *env, jobject thiz) {
+    auto *encoder = (JpegEncoder *) env->GetLongField(thiz, g_encoderCtx);
+    env->SetLongField(thiz, g_encoderCtx, 0);
+    delete encoder;
+}
 
-    //读取Bitmap所有像素信息
-    BYTE *pixelsColor;
-    AndroidBitmap_lockPixels(env, bitmap, (void **) &pixelsColor);
-
-    int i, j;
-    BYTE r, g, b;
-    //存储RGB所有像素点
-    BYTE *data = (BYTE *) malloc(w * h * 3);
-    // 临时保存指向像素内存的首地址
-    BYTE *tempData = data;
-
-    uint32_t color;
-    for (i = 0; i < h; i++) {
-        for (j = 0; j < w; j++) {
-            // 取出一个像素  去调了alpha，然后保存到data中，对应指针++
-            color = *((uint32_t *) pixelsColor);
-
-            // 在jni层中，Bitmap像素点的值是ABGR，而不是ARGB，也就是说，高端到低端：A，B，G，R
-            b = ((color & 0x00FF0000) >> 16);
-            g = ((color & 0x0000FF00) >> 8);
-            r = ((color & 0x000000FF));
-
-            // jpeg压缩需要的是rgb
-            //  for example, R,G,B,R,G,B,R,G,B,... for 24-bit RGB color.
-            *data = r;
-            *(data + 1) = g;
-            *(data + 2) = b;
-            data += 3;
-            pixelsColor += 4;
-        }
+JNIEXPORT jint JNICALL encoderCompressBitmapInto(JNIEnv *env, jobject thiz,
+                                                 jobject bitmap,
+                                                 jint quality,
+                                                 jobject buffer,
+                                                 jboolean optimize) {
+    JpegEncoder *encoder = getEncoder(env, thiz);
+    BYTE *address;
+    size_t size;
+    if (encoder == nullptr || !getOutputBuffer(env, buffer, &address, &size)) {
+        return -1;
     }
-    AndroidBitmap_unlockPixels(env, bitmap);
+    int resultCode = compressBitmapToMemory(env, encoder, bitmap, quality, optimize, &address, &size);
+    return resultCode == -1 ? -1 : (jint) size;
+}
 
-    char *path = (char *) env->GetStringUTFChars(outFilPath, nullptr);
-//    LOGE("path=%s", path);
+JNIEXPORT jobject JNICALL encoderCompressBitmap(JNIEnv *env, jobject thiz,
+                                                jobject bitmap,
+                                                jint quality,
+                                                jboolean optimize) {
+    JpegEncoder *encoder = getEncoder(env, thiz);
+    if (encoder == nullptr) {
+        return nullptr;
+    }
+    BYTE *jpeg = nullptr;
+    size_t size = 0;
+    int resultCode = compressBitmapToMemory(env, encoder, bitmap, quality, optimize, &jpeg, &size);
+    return wrapEncoderBuffer(env, resultCode, jpeg, size);
+}
 
-    // Libjpeg进行压缩
-    int resultCode = write_JPEG_file(tempData, w, h, quality, path, optimize);
-    if (resultCode == -1) {
+JNIEXPORT jint JNICALL encoderCompressYuvInto(JNIEnv *env, jobject thiz,
+                                              jobject yBuffer, jint yRowStride,
+                                              jobject uBuffer, jint uRowStride,
+                                              jobject vBuffer, jint vRowStride,
+                                              jint uvPixelStride,
+                                              jint width, jint height,
+                                              jint quality,
+                                              jobject buffer,
+                                              jboolean optimize) {
+    JpegEncoder *encoder = getEncoder(env, thiz);
+    YuvPlanes planes;
+    BYTE *address;
+    size_t size;
+    if (encoder == nullptr ||
+        !getYuvPlanes(env, yBuffer, yRowStride, uBuffer, uRowStride, vBuffer, vRowStride, uvPixelStride,
+                      width, height, &planes) || !getOutputBuffer(env, buffer, &address, &size)) {
         return -1;
     }
-    env->ReleaseStringUTFChars(outFilPath, path);
-    free(tempData);
-    return 0;
+    int resultCode = encoder->compressYuv(planes, (uint32_t) width, (uint32_t) height, quality, optimize,
+                                          &address, &size);
+    return resultCode == -1 ? -1 : (jint) size;
+}
+
+JNIEXPORT jobject JNICALL encoderCompressYuv(JNIEnv *env, jobject thiz,
+                                             jobject yBuffer, jint yRowStride,
+                                             jobject uBuffer, jint uRowStride,
+                                             jobject vBuffer, jint vRowStride,
+                                             jint uvPixelStride,
+                                             jint width, jint height,
+                                             jint quality,
+                                             jboolean optimize) {
+    JpegEncoder *encoder = getEncoder(env, thiz);
+    YuvPlanes planes;
+    if (encoder == nullptr ||
+        !getYuvPlanes(env, yBuffer, yRowStride, uBuffer, uRowStride, vBuffer, vRowStride, uvPixelStride,
+                      width, height, &planes)) {
+        return nullptr;
+    }
+    BYTE *jpeg = nullptr;
+    size_t size = 0;
+    int resultCode = encoder->compressYuv(planes, (uint32_t) width, (uint32_t) height, quality, optimize,
+                                          &jpeg, &size);
+    return wrapEncoderBuffer(env, resultCode, jpeg, size);
 }
 
 // =============================
@@ -196,6 +478,48 @@ JNIEXPORT jint JNICALL compressBitmap(JNIEnv *env, __attribute__((unused)) jobje
 static JNINativeMethod methods[] = {
         {"compressBitmap", "(Landroid/graphics/Bitmap;ILjava/lang/String;Z)I",
          (void *) compressBitmap},
+        {"getJpegBufferSize", "(II)I",
+         (void *) getJpegBufferSize},
+        {"compressBitmapInto", "(Landroid/graphics/Bitmap;ILjava/nio/ByteBuffer;Z)I",
+         (void *) compressBitmapInto},
+        {"compressBitmapToBuffer", "(Landroid/graphics/Bitmap;IZ)Ljava/nio/ByteBuffer;",
+         (void *) compressBitmapToBuffer},
+        {"compressYuv",
+         "(Ljava/nio/ByteBuffer;ILjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;IIIIILjava/lang/String;Z)I",
+         (void *) compressYuv},
+        {"compressYuvInto",
+         "(Ljava/nio/ByteBuffer;ILjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;IIIIILjava/nio/ByteBuffer;Z)I",
+         (void *) compressYuvInto},
+        {"compressBitmapParallel", "(Landroid/graphics/Bitmap;ILjava/lang/String;I)I",
+         (void *) compressBitmapParallel},
+        {"compressBitmapIntoParallel", "(Landroid/graphics/Bitmap;ILjava/nio/ByteBuffer;I)I",
+         (void *) compressBitmapIntoParallel},
+        {"compressYuvIntoParallel",
+         "(Ljava/nio/ByteBuffer;ILjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;IIIIILjava/nio/ByteBuffer;I)I",
+         (void *) compressYuvIntoParallel},
+        {"getScaledSize", "(Ljava/nio/ByteBuffer;II)[I",
+         (void *) getScaledSize},
+        {"decodeInto", "(Ljava/nio/ByteBuffer;IIIIIILandroid/graphics/Bitmap;)Z",
+         (void *) decodeInto},
+        {"decodeIntoBuffer", "(Ljava/nio/ByteBuffer;IIIIIILjava/nio/ByteBuffer;I)Z",
+         (void *) decodeIntoBuffer},
+};
+
+static JNINativeMethod encoderMethods[] = {
+        {"create", "()V",
+         (void *) encoderCreate},
+        {"release", "()V",
+         (void *) encoderRelease},
+        {"compressBitmapInto", "(Landroid/graphics/Bitmap;ILjava/nio/ByteBuffer;Z)I",
+         (void *) encoderCompressBitmapInto},
+        {"compressBitmap", "(Landroid/graphics/Bitmap;IZ)Ljava/nio/ByteBuffer;",
+         (void *) encoderCompressBitmap},
+        {"compressYuvInto",
+         "(Ljava/nio/ByteBuffer;ILjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;IIIIILjava/nio/ByteBuffer;Z)I",
+         (void *) encoderCompressYuvInto},
+        {"compressYuv",
+         "(Ljava/nio/ByteBuffer;ILjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;IIIIIZ)Ljava/nio/ByteBuffer;",
+         (void *) encoderCompressYuv},
 };
 
 JNIEXPORT jint JNI_OnLoad(JavaVM *vm, __attribute__((unused)) void *reserved) {
@@ -205,6 +529,17 @@ JNIEXPORT jint JNI_OnLoad(JavaVM *vm, __attribute__((unused)) void *reserved) {
         return JNI_ERR;
     }
 
+    jclass byteBufferClass = env->FindClass("java/nio/ByteBuffer");
+    if (byteBufferClass == nullptr) {
+        return JNI_ERR;
+    }
+    g_byteBufferClass = (jclass) env->NewGlobalRef(byteBufferClass);
+    env->DeleteLocalRef(byteBufferClass);
+    g_allocateDirect = env->GetStaticMethodID(g_byteBufferClass, "allocateDirect", "(I)Ljava/nio/ByteBuffer;");
+    if (g_allocateDirect == nullptr) {
+        return JNI_ERR;
+    }
+
     jclass clz = env->FindClass(JPEG_PACKAGE_BASE"JPEGUtil");
     if (clz == nullptr) {
         return JNI_ERR;
@@ -214,5 +549,15 @@ JNIEXPORT jint JNI_OnLoad(JavaVM *vm, __attribute__((unused)) void *reserved) {
         return JNI_ERR;
     }
 
+    jclass encoderClass = env->FindClass(JPEG_PACKAGE_BASE"JPEGEncoder");
+    if (encoderClass == nullptr) {
+        return JNI_ERR;
+    }
+    g_encoderCtx = env->GetFieldID(encoderClass, "ctx", "J");
+    if (g_encoderCtx == nullptr ||
+        env->RegisterNatives(encoderClass, encoderMethods, sizeof(encoderMethods) / sizeof(encoderMethods[0]))) {
+        return JNI_ERR;
+    }
+
     return JNI_VERSION_1_6;
 }
@@ -0,0 +1,135 @@
+package com.leovp.jpeg
+
+import android.graphics.Bitmap
+import android.graphics.ImageFormat
+import android.media.Image
+import androidx.annotation.Keep
+import java.io.Closeable
+import java.nio.ByteBuffer
+
+/**
+ * A JPEG compressor kept for a burst of images,
+ * e.g. the frames of a camera preview or a batch of thumbnails.
+ *
+ * Unlike [JPEGUtil], the libjpeg-turbo compressor and its output buffer are created once
+ * and reused for every image. [compressBitmap] and [compressYuv] return a view of that buffer,
+ * so no memory is allocated per image once the buffer has grown to the largest JPEG.
+ * The JPEGs are the same as the ones of [JPEGUtil] with the same parameters.
+ *
+ * An encoder is not thread safe, use one per thread.
+ * Usage:
+ * ```
+ * JPEGEncoder().use { encoder ->
+ *     for (bitmap in bitmaps) {
+ *         val jpeg: ByteBuffer = encoder.compressBitmap(bitmap, 90, false) ?: continue
+ *         // Consume or copy the JPEG before the next call.
+ *     }
+ * }
+ * ```
+ */
+@Keep
+class JPEGEncoder : Closeable {
+    companion object {
+        init {
+            System.loadLibrary("leo-jpeg")
+        }
+    }
+
+    // The native JpegEncoder, set by create() and release().
+    private var ctx: Long = 0
+
+    init {
+        create()
+    }
+
+    private external fun create()
+    private external fun release()
+
+    /**
+     * See [JPEGUtil.compressBitmapInto].
+     */
+    external fun compressBitmapInto(
+        bitmap: Bitmap,
+        quality: Int,
+        buffer: ByteBuffer,
+        optimize: Boolean
+    ): Int
+
+    /**
+     * Compresses an [Bitmap.Config.ARGB_8888] bitmap into the buffer of the encoder.
+     *
+     * @return A direct buffer holding exactly the JPEG, or null on failure.
+     * It is only valid until the next call or [close], copy it to keep it.
+     */
+    external fun compressBitmap(
+        bitmap: Bitmap,
+        quality: Int,
+        optimize: Boolean
+    ): ByteBuffer?
+
+    /**
+     * See [JPEGUtil.compressYuvInto].
+     */
+    external fun compressYuvInto(
+        yBuffer: ByteBuffer,
+        yRowStride: Int,
+        uBuffer: ByteBuffer,
+        uRowStride: Int,
+        vBuffer: ByteBuffer,
+        vRowStride: Int,
+        uvPixelStride: Int,
+        width: Int,
+        height: Int,
+        quality: Int,
+        buffer: ByteBuffer,
+        optimize: Boolean
+    ): Int
+
+    /**
+     * Compresses the planes of an YUV 4:2:0 image into the buffer of the encoder,
+     * see [JPEGUtil.compressYuv].
+     *
+     * @return A direct buffer holding exactly the JPEG, or null on failure.
+     * It is only valid until the next call or [close], copy it to keep it.
+     */
+    external fun compressYuv(
+        yBuffer: ByteBuffer,
+        yRowStride: Int,
+        uBuffer: ByteBuffer,
+        uRowStride: Int,
+        vBuffer: ByteBuffer,
+        vRowStride: Int,
+        uvPixelStride: Int,
+        width: Int,
+        height: Int,
+        quality: Int,
+        optimize: Boolean
+    ): ByteBuffer?
+
+    /**
+     * Compresses an [ImageFormat.YUV_420_888] [image] into the buffer of the encoder without
+     * repacking its planes.
+     *
+     * @see compressYuv
+     */
+    fun compressImage(image: Image, quality: Int, optimize: Boolean): ByteBuffer? {
+        require(image.format == ImageFormat.YUV_420_888) { "Image format must be YUV_420_888." }
+        val planes = image.planes
+        return compressYuv(
+            planes[0].buffer, planes[0].rowStride,
+            planes[1].buffer, planes[1].rowStride,
+            planes[2].buffer, planes[2].rowStride,
+            planes[1].pixelStride,
+            image.width, image.height,
+            quality, optimize
+        )
+    }
+
+    /**
+     * Frees the native compressor and its buffer. The buffers returned before become invalid.
+     */
+    override fun close() {
+        if (ctx == 0L) return
+        release()
+    }
+}
@@ -1,7 +1,11 @@
 package com.leovp.jpeg
 
 import android.graphics.Bitmap
+import android.graphics.ImageFormat
+import android.graphics.Rect
+import android.media.Image
 import androidx.annotation.Keep
+import java.nio.ByteBuffer
 
 /**
  * Author: Michael Leo
@@ -14,8 +18,13 @@ object JPEGUtil {
     }
 
     /**
-     * This method is not only slower but also generated larger file
-     * than Android [Bitmap.compress] method.
+     * Compresses an [Bitmap.Config.ARGB_8888] bitmap into the JPEG file [outFilPath].
+     * The pixels are read in place, without an RGB copy, and stay locked while compressing.
+     * The alpha channel is ignored.
+     *
+     * @param optimize Compute optimal Huffman tables for the image.
+     * The file is a few percent smaller at the cost of a slower compression.
+     * @return 0 on success, -1 on failure, e.g. an unsupported bitmap config.
      */
     external fun compressBitmap(
         bitmap: Bitmap,
@@ -23,4 +32,243 @@ object JPEGUtil {
         outFilPath: String,
         optimize: Boolean
     ): Int
+
+    /**
+     * The largest JPEG [compressBitmapInto] can write for a [width] x [height] bitmap, whatever the
+     * quality. Allocate a buffer of this size once and reuse it for every bitmap up to this size.
+     *
+     * @return -1 if a size isn't positive or the result doesn't fit into an [Int].
+     */
+    external fun getJpegBufferSize(width: Int, height: Int): Int
+
+    /**
+     * Compresses an [Bitmap.Config.ARGB_8888] bitmap into the beginning of [buffer], without going
+     * through a file. The position and the limit of [buffer] are not changed.
+     *
+     * @param buffer A direct buffer. [getJpegBufferSize] bytes are always enough.
+     * @return The size of the JPEG, or -1 on failure, e.g. when it doesn't fit into [buffer].
+     */
+    external fun compressBitmapInto(
+        bitmap: Bitmap,
+        quality: Int,
+        buffer: ByteBuffer,
+        optimize: Boolean
+    ): Int
+
+    /**
+     * Compresses an [Bitmap.Config.ARGB_8888] bitmap in memory, without going through a file.
+     *
+     * @return A direct buffer holding exactly the JPEG, or null on failure.
+     */
+    external fun compressBitmapToBuffer(
+        bitmap: Bitmap,
+        quality: Int,
+        optimize: Boolean
+    ): ByteBuffer?
+
+    /**
+     * Compresses the planes of an YUV 4:2:0 image into the JPEG file [outFilPath].
+     *
+     * The planes become the YCbCr components of the JPEG as they are, without a conversion to RGB
+     * and back, so a camera frame doesn't need `YuvUtil.i420ToRgb24` first.
+     * The image must be full range BT.601 (JFIF), as camera frames are.
+     *
+     * The planes are read from the beginning of the direct buffers, their position is ignored.
+     * Padded rows (`rowStride > width`) and interleaved chroma (`pixelStride == 2`)
+     * are both supported:
+     * ```
+     * I420: uvPixelStride = 1
+     * NV21: uvPixelStride = 2, uBuffer starts one byte after vBuffer,
+     *       e.g. `vuPlane.position(1).slice()`
+     * NV12: uvPixelStride = 2, vBuffer starts one byte after uBuffer
+     * ```
+     *
+     * @return 0 on success, -1 on failure, e.g. a buffer too small for the size and the strides.
+     */
+    external fun compressYuv(
+        yBuffer: ByteBuffer,
+        yRowStride: Int,
+        uBuffer: ByteBuffer,
+        uRowStride: Int,
+        vBuffer: ByteBuffer,
+        vRowStride: Int,
+        uvPixelStride: Int,
+        width: Int,
+        height: Int,
+        quality: Int,
+        outFilPath: String,
+        optimize: Boolean
+    ): Int
+
+    /**
+     * Compresses the planes of an YUV 4:2:0 image into the beginning of [buffer],
+     * see [compressYuv].
+     *
+     * @param buffer A direct buffer. [getJpegBufferSize] bytes are always enough.
+     * @return The size of the JPEG, or -1 on failure.
+     */
+    external fun compressYuvInto(
+        yBuffer: ByteBuffer,
+        yRowStride: Int,
+        uBuffer: ByteBuffer,
+        uRowStride: Int,
+        vBuffer: ByteBuffer,
+        vRowStride: Int,
+        uvPixelStride: Int,
+        width: Int,
+        height: Int,
+        quality: Int,
+        buffer: ByteBuffer,
+        optimize: Boolean
+    ): Int
+
+    /**
+     * Compresses an [ImageFormat.YUV_420_888] [image] into the beginning of [buffer] without
+     * repacking its planes.
+     *
+     * @see compressYuvInto
+     */
+    fun compressImageInto(image: Image, quality: Int, buffer: ByteBuffer, optimize: Boolean): Int {
+        require(image.format == ImageFormat.YUV_420_888) { "Image format must be YUV_420_888." }
+        val planes = image.planes
+        return compressYuvInto(
+            planes[0].buffer, planes[0].rowStride,
+            planes[1].buffer, planes[1].rowStride,
+            planes[2].buffer, planes[2].rowStride,
+            planes[1].pixelStride,
+            image.width, image.height,
+            quality, buffer, optimize
+        )
+    }
+
+    /**
+     * Compresses a very large [Bitmap.Config.ARGB_8888] bitmap, e.g. a 48 MP photo, on up to
+     * [threadCount] threads into the JPEG file [outFilPath].
+     *
+     * The bitmap is split into horizontal strips of 16 pixel rows, which are compressed at the same
+     * time and joined into one baseline JPEG with a restart marker after every 16 rows.
+     * The file is the same whatever [threadCount], and a few bytes per 16 rows larger than
+     * [compressBitmap]. The standard Huffman tables are always used, as with `optimize = false`.
+     *
+     * @param threadCount Up to 16, e.g. [Runtime.availableProcessors].
+     * @return 0 on success, -1 on failure.
+     */
+    external fun compressBitmapParallel(
+        bitmap: Bitmap,
+        quality: Int,
+        outFilPath: String,
+        threadCount: Int
+    ): Int
+
+    /**
+     * [compressBitmapParallel] into the beginning of [buffer], see [compressBitmapInto].
+     *
+     * @return The size of the JPEG, or -1 on failure.
+     */
+    external fun compressBitmapIntoParallel(
+        bitmap: Bitmap,
+        quality: Int,
+        buffer: ByteBuffer,
+        threadCount: Int
+    ): Int
+
+    /**
+     * Compresses the planes of a very large YUV 4:2:0 image on up to [threadCount] threads
+     * into the beginning of [buffer], see [compressYuvInto] and [compressBitmapParallel].
+     *
+     * @return The size of the JPEG, or -1 on failure.
+     */
+    external fun compressYuvIntoParallel(
+        yBuffer: ByteBuffer,
+        yRowStride: Int,
+        uBuffer: ByteBuffer,
+        uRowStride: Int,
+        vBuffer: ByteBuffer,
+        vRowStride: Int,
+        uvPixelStride: Int,
+        width: Int,
+        height: Int,
+        quality: Int,
+        buffer: ByteBuffer,
+        threadCount: Int
+    ): Int
+
+    // ===== Decoding =====
+    //
+    // The JPEG is read from the beginning of a direct buffer, its position is ignored.
+    // A file mapped with `FileChannel.map` is a direct buffer,
+    // so it doesn't need to be read into memory first.
+    //
+    // `scaleDenom` is 1, 2, 4 or 8. The image is decoded at 1 / `scaleDenom` of its size in the DCT
+    // domain, which costs a small part of a full decode followed by a downscale.
+    // Regions are in the pixels of the scaled image.
+
+    /**
+     * @return The width and the height of the JPEG decoded at 1 / [scaleDenom] of its size,
+     * or null if it isn't a JPEG. Only the header is parsed.
+     */
+    external fun getScaledSize(jpeg: ByteBuffer, jpegSize: Int, scaleDenom: Int): IntArray?
+
+    /**
+     * Decodes the [width] x [height] region at ([left], [top]) of the scaled JPEG
+     * into the top left corner of the pixels of [bitmap], e.g. a bitmap reused for every thumbnail.
+     * Only the part of the JPEG covering the region is decoded.
+     *
+     * @param bitmap A mutable [Bitmap.Config.ARGB_8888] bitmap at least as large as the region.
+     * @return false on failure, e.g. a region outside of the scaled image.
+     */
+    external fun decodeInto(
+        jpeg: ByteBuffer,
+        jpegSize: Int,
+        scaleDenom: Int,
+        left: Int,
+        top: Int,
+        width: Int,
+        height: Int,
+        bitmap: Bitmap
+    ): Boolean
+
+    /**
+     * Decodes the [width] x [height] region at ([left], [top]) of the scaled JPEG into RGBA_8888
+     * pixels, see [decodeInto].
+     *
+     * @param buffer A direct buffer of [height] rows, [stride] bytes apart.
+     */
+    external fun decodeIntoBuffer(
+        jpeg: ByteBuffer,
+        jpegSize: Int,
+        scaleDenom: Int,
+        left: Int,
+        top: Int,
+        width: Int,
+        height: Int,
+        buffer: ByteBuffer,
+        stride: Int
+    ): Boolean
+
+    /**
+     * Decodes the JPEG, or the [region] of it, at 1 / [scaleDenom] of its size into a new bitmap.
+     *
+     * @param region In the pixels of the scaled image. The whole image if null.
+     * @return null on failure.
+     */
+    fun decodeBitmap(
+        jpeg: ByteBuffer,
+        jpegSize: Int,
+        scaleDenom: Int = 1,
+        region: Rect? = null
+    ): Bitmap? {
+        val rect = region
+            ?: getScaledSize(jpeg, jpegSize, scaleDenom)?.let { Rect(0, 0, it[0], it[1]) }
+            ?: return null
+        if (rect.isEmpty) return null
+        val bitmap = Bitmap.createBitmap(rect.width(), rect.height(), Bitmap.Config.ARGB_8888)
+        val width = rect.width()
+        val height = rect.height()
+        if (decodeInto(jpeg, jpegSize, scaleDenom, rect.left, rect.top, width, height, bitmap)) {
+            return bitmap
+        }
+        bitmap.recycle()
+        return null
+    }
 }
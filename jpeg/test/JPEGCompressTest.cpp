@@ -0,0 +1,409 @@
+// The RGBA path must write exactly the file of the RGB path, whatever the stride of the rows,
+// and the memory output exactly the bytes of the file.
+//
+// The YUV planes, I420 or NV21, must give exactly the JPEG libjpeg writes for the same YCbCr pixels
+// given one by one with the chroma repeated over 2x2 pixels, which it averages back to the same samples.
+//
+// An encoder kept between images must give the bytes of the one shot functions, whatever came before.
+//
+// The strips compressed on several threads must join into exactly the JPEG libjpeg writes on one thread
+// with a restart marker after every MCU row.
+//
+// The files are written into the gtest temporary directory and compared byte by byte.
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "JPEGCompress.h"
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+namespace {
+
+struct Size {
+    uint32_t width, height;
+};
+
+const Size kSizes[] = {{1, 1}, {17, 9}, {333, 250}, {640, 480}};
+
+// Extra bytes at the end of every row, as Android bitmaps may have.
+const uint32_t kRowPadding = 12;
+
+/** a gradient with some noise, [stride] bytes per row */
+std::vector<BYTE> makeRgba(uint32_t width, uint32_t height, uint32_t stride) {
+    std::vector<BYTE> rgba((size_t) stride * height);
+    srand(width * 31 + height);
+    for (uint32_t y = 0; y < height; y++) {
+        BYTE *p = rgba.data() + (size_t) y * stride;
+        for (uint32_t x = 0; x < width; x++) {
+            p[0] = (BYTE) (x * 255 / width + rand() % 16);
+            p[1] = (BYTE) (y * 255 / height + rand() % 16);
+            p[2] = (BYTE) rand();
+            p[3] = (BYTE) rand();
+            p += 4;
+        }
+    }
+    return rgba;
+}
+
+std::vector<BYTE> readFile(const std::string &path) {
+    std::vector<BYTE> data;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) return data;
+    BYTE buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) data.insert(data.end(), buffer, buffer + count);
+    fclose(file);
+    return data;
+}
+
+std::string tempPath(const char *name) {
+    return testing::TempDir() + name;
+}
+
+TEST(JPEGCompressTest, RgbaMatchesRgb) {
+    const std::string rgbPath = tempPath("rgb.jpg"), rgbaPath = tempPath("rgba.jpg");
+    for (const Size &size : kSizes) {
+        uint32_t stride = size.width * 4 + kRowPadding;
+        std::vector<BYTE> rgba = makeRgba(size.width, size.height, stride);
+        std::vector<BYTE> rgb((size_t) size.width * size.height * 3);
+        rgbaToRgb(rgba.data(), size.width, size.height, stride, rgb.data());
+        for (bool optimize : {false, true}) {
+            ASSERT_EQ(0, write_JPEG_file(rgb.data(), size.width, size.height, 85, rgbPath.c_str(), optimize));
+            ASSERT_EQ(0, compressRgbaToFile(rgba.data(), size.width, size.height, stride, 85, rgbaPath.c_str(),
+                                            optimize));
+            std::vector<BYTE> expected = readFile(rgbPath);
+            ASSERT_FALSE(expected.empty());
+            EXPECT_EQ(expected, readFile(rgbaPath)) << size.width << "x" << size.height << " optimize " << optimize;
+        }
+    }
+}
+
+TEST(JPEGCompressTest, OptimizeShrinksTheFile) {
+    const std::string path = tempPath("optimize.jpg");
+    std::vector<BYTE> rgba = makeRgba(640, 480, 640 * 4);
+    ASSERT_EQ(0, compressRgbaToFile(rgba.data(), 640, 480, 640 * 4, 80, path.c_str(), false));
+    size_t standardSize = readFile(path).size();
+    ASSERT_EQ(0, compressRgbaToFile(rgba.data(), 640, 480, 640 * 4, 80, path.c_str(), true));
+    EXPECT_LT(readFile(path).size(), standardSize);
+}
+
+TEST(JPEGCompressTest, UnwritablePathFails) {
+    std::vector<BYTE> rgba = makeRgba(16, 16, 64);
+    EXPECT_EQ(-1, compressRgbaToFile(rgba.data(), 16, 16, 64, 80, "/nonexistent/dir/out.jpg", false));
+}
+
+TEST(JPEGCompressTest, MemoryMatchesFile) {
+    const std::string path = tempPath("memory.jpg");
+    for (const Size &size : kSizes) {
+        uint32_t stride = size.width * 4 + kRowPadding;
+        std::vector<BYTE> rgba = makeRgba(size.width, size.height, stride);
+        ASSERT_EQ(0, compressRgbaToFile(rgba.data(), size.width, size.height, stride, 85, path.c_str(), false));
+        std::vector<BYTE> expected = readFile(path);
+
+        // a buffer allocated and grown by the compressor
+        BYTE *jpeg = nullptr;
+        size_t jpegSize = 0;
+        ASSERT_EQ(0, compressRgbaToMemory(rgba.data(), size.width, size.height, stride, 85, false, &jpeg, &jpegSize));
+        EXPECT_EQ(expected, std::vector<BYTE>(jpeg, jpeg + jpegSize)) << size.width << "x" << size.height;
+        free(jpeg);
+
+        // the caller's buffer
+        std::vector<BYTE> buffer(jpegBufferSize(size.width, size.height));
+        jpeg = buffer.data();
+        jpegSize = buffer.size();
+        ASSERT_EQ(0, compressRgbaToMemory(rgba.data(), size.width, size.height, stride, 85, false, &jpeg, &jpegSize));
+        EXPECT_EQ(buffer.data(), jpeg);
+        EXPECT_EQ(expected, std::vector<BYTE>(jpeg, jpeg + jpegSize)) << size.width << "x" << size.height;
+    }
+}
+
+TEST(JPEGCompressTest, NoiseFitsTheBufferSize) {
+    const uint32_t width = 101, height = 77;
+    std::vector<BYTE> rgba((size_t) width * height * 4);
+    srand(7);
+    for (auto &b : rgba) b = (BYTE) rand();
+    std::vector<BYTE> buffer(jpegBufferSize(width, height));
+    BYTE *jpeg = buffer.data();
+    size_t jpegSize = buffer.size();
+    ASSERT_EQ(0, compressRgbaToMemory(rgba.data(), width, height, width * 4, 100, false, &jpeg, &jpegSize));
+    EXPECT_LE(jpegSize, buffer.size());
+}
+
+TEST(JPEGCompressTest, SmallCallerBufferFails) {
+    std::vector<BYTE> rgba = makeRgba(333, 250, 333 * 4);
+    const size_t capacity = 1000, guard = 64;
+    std::vector<BYTE> buffer(capacity + guard, 0xA5);
+    BYTE *jpeg = buffer.data();
+    size_t jpegSize = capacity;
+    EXPECT_EQ(-1, compressRgbaToMemory(rgba.data(), 333, 250, 333 * 4, 85, false, &jpeg, &jpegSize));
+    EXPECT_EQ(buffer.data(), jpeg);
+    EXPECT_EQ(std::vector<BYTE>(guard, 0xA5), std::vector<BYTE>(buffer.begin() + capacity, buffer.end()));
+}
+
+struct YuvImage {
+    uint32_t width, height;
+    std::vector<BYTE> y, u, v;
+};
+
+// Extra bytes at the end of every plane row, as camera frames may have.
+const uint32_t kPlanePadding = 24;
+
+YuvImage makeYuv(uint32_t width, uint32_t height) {
+    uint32_t chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    YuvImage image = {width, height, std::vector<BYTE>((size_t) (width + kPlanePadding) * height),
+                      std::vector<BYTE>((size_t) (chromaWidth + kPlanePadding) * chromaHeight),
+                      std::vector<BYTE>((size_t) (chromaWidth + kPlanePadding) * chromaHeight)};
+    srand(width * 31 + height);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            image.y[(size_t) y * (width + kPlanePadding) + x] = (BYTE) (x * 255 / width + rand() % 32);
+        }
+    }
+    for (uint32_t y = 0; y < chromaHeight; y++) {
+        for (uint32_t x = 0; x < chromaWidth; x++) {
+            image.u[(size_t) y * (chromaWidth + kPlanePadding) + x] = (BYTE) (64 + rand() % 128);
+            image.v[(size_t) y * (chromaWidth + kPlanePadding) + x] = (BYTE) (y * 255 / chromaHeight);
+        }
+    }
+    return image;
+}
+
+/** libjpeg compressing the YCbCr pixels of [image] one by one */
+std::vector<BYTE> compressYuvReference(const YuvImage &image, int quality) {
+    uint32_t lumaStride = image.width + kPlanePadding, chromaStride = (image.width + 1) / 2 + kPlanePadding;
+    std::vector<BYTE> row((size_t) image.width * 3);
+    jpeg_compress_struct cinfo{};
+    jpeg_error_mgr jerr{};
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    unsigned char *jpeg = nullptr;
+    unsigned long jpegSize = 0;
+    jpeg_mem_dest(&cinfo, &jpeg, &jpegSize);
+    cinfo.image_width = image.width;
+    cinfo.image_height = image.height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        uint32_t y = cinfo.next_scanline;
+        for (uint32_t x = 0; x < image.width; x++) {
+            row[x * 3] = image.y[(size_t) y * lumaStride + x];
+            row[x * 3 + 1] = image.u[(size_t) (y / 2) * chromaStride + x / 2];
+            row[x * 3 + 2] = image.v[(size_t) (y / 2) * chromaStride + x / 2];
+        }
+        JSAMPROW rows[1] = {row.data()};
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    std::vector<BYTE> result(jpeg, jpeg + jpegSize);
+    free(jpeg);
+    return result;
+}
+
+const Size kYuvSizes[] = {{2, 2}, {1, 1}, {16, 16}, {64, 48}, {101, 77}, {200, 130}, {640, 480}};
+
+TEST(JPEGCompressTest, I420MatchesYCbCrPixels) {
+    for (const Size &size : kYuvSizes) {
+        YuvImage image = makeYuv(size.width, size.height);
+        uint32_t chromaStride = (size.width + 1) / 2 + kPlanePadding;
+        YuvPlanes planes = {image.y.data(), size.width + kPlanePadding, image.u.data(), chromaStride,
+                            image.v.data(), chromaStride, 1};
+        BYTE *jpeg = nullptr;
+        size_t jpegSize = 0;
+        ASSERT_EQ(0, compressYuvToMemory(planes, size.width, size.height, 85, false, &jpeg, &jpegSize));
+        EXPECT_EQ(compressYuvReference(image, 85), std::vector<BYTE>(jpeg, jpeg + jpegSize))
+                << size.width << "x" << size.height;
+        free(jpeg);
+    }
+}
+
+TEST(JPEGCompressTest, Nv21MatchesI420) {
+    const std::string i420Path = tempPath("i420.jpg"), nv21Path = tempPath("nv21.jpg");
+    for (const Size &size : kYuvSizes) {
+        YuvImage image = makeYuv(size.width, size.height);
+        uint32_t chromaWidth = (size.width + 1) / 2, chromaHeight = (size.height + 1) / 2;
+        uint32_t chromaStride = chromaWidth + kPlanePadding, vuStride = chromaWidth * 2 + kPlanePadding;
+        std::vector<BYTE> vu((size_t) vuStride * chromaHeight);
+        for (uint32_t y = 0; y < chromaHeight; y++) {
+            for (uint32_t x = 0; x < chromaWidth; x++) {
+                vu[(size_t) y * vuStride + x * 2] = image.v[(size_t) y * chromaStride + x];
+                vu[(size_t) y * vuStride + x * 2 + 1] = image.u[(size_t) y * chromaStride + x];
+            }
+        }
+        YuvPlanes i420 = {image.y.data(), size.width + kPlanePadding, image.u.data(), chromaStride,
+                          image.v.data(), chromaStride, 1};
+        YuvPlanes nv21 = {image.y.data(), size.width + kPlanePadding, vu.data() + 1, vuStride, vu.data(), vuStride, 2};
+        ASSERT_EQ(0, compressYuvToFile(i420, size.width, size.height, 85, i420Path.c_str(), true));
+        ASSERT_EQ(0, compressYuvToFile(nv21, size.width, size.height, 85, nv21Path.c_str(), true));
+        EXPECT_EQ(readFile(i420Path), readFile(nv21Path)) << size.width << "x" << size.height;
+    }
+}
+
+std::vector<BYTE> compressOnce(const std::vector<BYTE> &rgba, const Size &size, int quality, bool optimize) {
+    BYTE *jpeg = nullptr;
+    size_t jpegSize = 0;
+    EXPECT_EQ(0, compressRgbaToMemory(rgba.data(), size.width, size.height, size.width * 4, quality, optimize, &jpeg,
+                                      &jpegSize));
+    std::vector<BYTE> result(jpeg, jpeg + jpegSize);
+    free(jpeg);
+    return result;
+}
+
+TEST(JPEGCompressTest, EncoderMatchesOneShot) {
+    struct Step {
+        Size size;
+        int quality;
+        bool optimize;
+    };
+    // the same size repeated, other sizes, other qualities and the optimize flag switched
+    const Step steps[] = {{{640, 480}, 80, false}, {{640, 480}, 80, false}, {{333, 250}, 80, false},
+                          {{17, 9}, 80, false}, {{640, 480}, 95, false}, {{640, 480}, 95, true},
+                          {{333, 250}, 50, true}, {{640, 480}, 80, false}};
+    JpegEncoder encoder;
+    for (const Step &step : steps) {
+        std::vector<BYTE> rgba = makeRgba(step.size.width, step.size.height, step.size.width * 4);
+        BYTE *jpeg = nullptr;
+        size_t jpegSize = 0;
+        ASSERT_EQ(0, encoder.compressRgba(rgba.data(), step.size.width, step.size.height, step.size.width * 4,
+                                          step.quality, step.optimize, &jpeg, &jpegSize));
+        EXPECT_EQ(compressOnce(rgba, step.size, step.quality, step.optimize),
+                  std::vector<BYTE>(jpeg, jpeg + jpegSize))
+                << step.size.width << "x" << step.size.height << " q" << step.quality << " optimize "
+                << step.optimize;
+    }
+
+    // YUV after RGBA, then RGBA again
+    YuvImage image = makeYuv(101, 77);
+    uint32_t chromaStride = (101 + 1) / 2 + kPlanePadding;
+    YuvPlanes planes = {image.y.data(), 101 + kPlanePadding, image.u.data(), chromaStride, image.v.data(),
+                        chromaStride, 1};
+    BYTE *jpeg = nullptr;
+    size_t jpegSize = 0;
+    ASSERT_EQ(0, encoder.compressYuv(planes, 101, 77, 85, false, &jpeg, &jpegSize));
+    EXPECT_EQ(compressYuvReference(image, 85), std::vector<BYTE>(jpeg, jpeg + jpegSize));
+
+    std::vector<BYTE> rgba = makeRgba(640, 480, 640 * 4);
+    jpeg = nullptr;
+    ASSERT_EQ(0, encoder.compressRgba(rgba.data(), 640, 480, 640 * 4, 80, false, &jpeg, &jpegSize));
+    EXPECT_EQ(compressOnce(rgba, {640, 480}, 80, false), std::vector<BYTE>(jpeg, jpeg + jpegSize));
+}
+
+TEST(JPEGCompressTest, EncoderRecoversFromAFailure) {
+    std::vector<BYTE> rgba = makeRgba(333, 250, 333 * 4);
+    JpegEncoder encoder;
+    std::vector<BYTE> small(1000);
+    BYTE *jpeg = small.data();
+    size_t jpegSize = small.size();
+    EXPECT_EQ(-1, encoder.compressRgba(rgba.data(), 333, 250, 333 * 4, 80, false, &jpeg, &jpegSize));
+
+    // into the caller's buffer, then into the encoder's
+    std::vector<BYTE> buffer(jpegBufferSize(333, 250));
+    jpeg = buffer.data();
+    jpegSize = buffer.size();
+    ASSERT_EQ(0, encoder.compressRgba(rgba.data(), 333, 250, 333 * 4, 80, false, &jpeg, &jpegSize));
+    std::vector<BYTE> expected = compressOnce(rgba, {333, 250}, 80, false);
+    EXPECT_EQ(expected, std::vector<BYTE>(jpeg, jpeg + jpegSize));
+    jpeg = nullptr;
+    ASSERT_EQ(0, encoder.compressRgba(rgba.data(), 333, 250, 333 * 4, 80, false, &jpeg, &jpegSize));
+    EXPECT_EQ(expected, std::vector<BYTE>(jpeg, jpeg + jpegSize));
+}
+
+/** libjpeg compressing the RGBA pixels on one thread with a restart interval of one MCU row */
+std::vector<BYTE> compressRestartReference(const std::vector<BYTE> &rgba, const Size &size, uint32_t stride,
+                                           int quality) {
+    jpeg_compress_struct cinfo{};
+    jpeg_error_mgr jerr{};
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    unsigned char *jpeg = nullptr;
+    unsigned long jpegSize = 0;
+    jpeg_mem_dest(&cinfo, &jpeg, &jpegSize);
+    cinfo.image_width = size.width;
+    cinfo.image_height = size.height;
+    cinfo.input_components = 4;
+    cinfo.in_color_space = JCS_EXT_RGBA;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.restart_in_rows = 1;
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW rows[1] = {(JSAMPROW) (rgba.data() + (size_t) cinfo.next_scanline * stride)};
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    std::vector<BYTE> result(jpeg, jpeg + jpegSize);
+    free(jpeg);
+    return result;
+}
+
+// 1 to 40 MCU rows, so the restart markers wrap around RST7 and some strips are a single row
+const Size kParallelSizes[] = {{1, 1}, {17, 9}, {333, 250}, {64, 640}, {640, 480}};
+const uint32_t kThreadCounts[] = {1, 2, 3, 4, 8, 16};
+
+TEST(JPEGCompressTest, ParallelMatchesRestartIntervals) {
+    for (const Size &size : kParallelSizes) {
+        uint32_t stride = size.width * 4 + kRowPadding;
+        std::vector<BYTE> rgba = makeRgba(size.width, size.height, stride);
+        std::vector<BYTE> expected = compressRestartReference(rgba, size, stride, 85);
+        for (uint32_t threads : kThreadCounts) {
+            BYTE *jpeg = nullptr;
+            size_t jpegSize = 0;
+            ASSERT_EQ(0, compressRgbaToMemoryParallel(rgba.data(), size.width, size.height, stride, 85, threads,
+                                                      &jpeg, &jpegSize));
+            EXPECT_EQ(expected, std::vector<BYTE>(jpeg, jpeg + jpegSize))
+                    << size.width << "x" << size.height << " on " << threads << " threads";
+            free(jpeg);
+        }
+    }
+}
+
+TEST(JPEGCompressTest, ParallelYuvMatchesOneThread) {
+    for (const Size &size : kYuvSizes) {
+        YuvImage image = makeYuv(size.width, size.height);
+        uint32_t chromaStride = (size.width + 1) / 2 + kPlanePadding;
+        YuvPlanes planes = {image.y.data(), size.width + kPlanePadding, image.u.data(), chromaStride,
+                            image.v.data(), chromaStride, 1};
+        BYTE *expected = nullptr;
+        size_t expectedSize = 0;
+        ASSERT_EQ(0, compressYuvToMemoryParallel(planes, size.width, size.height, 85, 1, &expected, &expectedSize));
+        for (uint32_t threads : kThreadCounts) {
+            BYTE *jpeg = nullptr;
+            size_t jpegSize = 0;
+            ASSERT_EQ(0, compressYuvToMemoryParallel(planes, size.width, size.height, 85, threads, &jpeg, &jpegSize));
+            EXPECT_EQ(std::vector<BYTE>(expected, expected + expectedSize), std::vector<BYTE>(jpeg, jpeg + jpegSize))
+                    << size.width << "x" << size.height << " on " << threads << " threads";
+            free(jpeg);
+        }
+        free(expected);
+    }
+}
+
+TEST(JPEGCompressTest, ParallelIntoCallerBuffer) {
+    const Size size = {640, 480};
+    std::vector<BYTE> rgba = makeRgba(size.width, size.height, size.width * 4);
+    std::vector<BYTE> expected = compressRestartReference(rgba, size, size.width * 4, 85);
+    std::vector<BYTE> buffer(jpegBufferSize(size.width, size.height));
+    BYTE *jpeg = buffer.data();
+    size_t jpegSize = buffer.size();
+    ASSERT_EQ(0, compressRgbaToMemoryParallel(rgba.data(), size.width, size.height, size.width * 4, 85, 4, &jpeg,
+                                              &jpegSize));
+    EXPECT_EQ(buffer.data(), jpeg);
+    EXPECT_EQ(expected, std::vector<BYTE>(jpeg, jpeg + jpegSize));
+
+    jpegSize = expected.size() - 1;
+    EXPECT_EQ(-1, compressRgbaToMemoryParallel(rgba.data(), size.width, size.height, size.width * 4, 85, 4, &jpeg,
+                                               &jpegSize));
+}
+
+}  // namespace
@@ -0,0 +1,140 @@
+// Decoding a region of a scaled JPEG must give exactly the pixels of the same region cut out of
+// the whole image decoded at the same scale, and decoding the whole image exactly the pixels of libjpeg.
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "JPEGDecompress.h"
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+namespace {
+
+const uint32_t kScales[] = {1, 2, 4, 8};
+
+struct Region {
+    uint32_t left, top, width, height;
+};
+
+/** a 4:2:0 JPEG of a gradient with some noise */
+std::vector<BYTE> makeJpeg(uint32_t width, uint32_t height) {
+    std::vector<BYTE> rgba((size_t) width * height * 4);
+    srand(width * 31 + height);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            BYTE *p = rgba.data() + ((size_t) y * width + x) * 4;
+            p[0] = (BYTE) (x * 255 / width + rand() % 32);
+            p[1] = (BYTE) (y * 255 / height + rand() % 32);
+            p[2] = (BYTE) ((x ^ y) * 4);
+            p[3] = 0xFF;
+        }
+    }
+    BYTE *jpeg = nullptr;
+    size_t jpegSize = 0;
+    EXPECT_EQ(0, compressRgbaToMemory(rgba.data(), width, height, width * 4, 85, false, &jpeg, &jpegSize));
+    std::vector<BYTE> result(jpeg, jpeg + jpegSize);
+    free(jpeg);
+    return result;
+}
+
+/** libjpeg decoding the whole image at 1 / [scaleDenom], one row at a time */
+std::vector<BYTE> decodeReference(const std::vector<BYTE> &jpeg, uint32_t scaleDenom, uint32_t *width,
+                                  uint32_t *height) {
+    jpeg_decompress_struct cinfo{};
+    jpeg_error_mgr jerr{};
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg.data(), (unsigned long) jpeg.size());
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scaleDenom;
+    cinfo.out_color_space = JCS_EXT_RGBA;
+    jpeg_start_decompress(&cinfo);
+    *width = cinfo.output_width;
+    *height = cinfo.output_height;
+    std::vector<BYTE> rgba((size_t) *width * *height * 4);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = rgba.data() + (size_t) cinfo.output_scanline * *width * 4;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return rgba;
+}
+
+std::vector<BYTE> cut(const std::vector<BYTE> &rgba, uint32_t width, const Region &region) {
+    std::vector<BYTE> result;
+    for (uint32_t y = region.top; y < region.top + region.height; y++) {
+        const BYTE *row = rgba.data() + ((size_t) y * width + region.left) * 4;
+        result.insert(result.end(), row, row + (size_t) region.width * 4);
+    }
+    return result;
+}
+
+TEST(JPEGDecompressTest, WholeImageMatchesLibjpeg) {
+    for (uint32_t scale : kScales) {
+        std::vector<BYTE> jpeg = makeJpeg(333, 250);
+        uint32_t width, height;
+        std::vector<BYTE> expected = decodeReference(jpeg, scale, &width, &height);
+        uint32_t scaledWidth, scaledHeight;
+        ASSERT_EQ(0, getJpegScaledSize(jpeg.data(), jpeg.size(), scale, &scaledWidth, &scaledHeight));
+        EXPECT_EQ(width, scaledWidth);
+        EXPECT_EQ(height, scaledHeight);
+        EXPECT_EQ((333 + scale - 1) / scale, scaledWidth);
+
+        std::vector<BYTE> actual(expected.size());
+        ASSERT_EQ(0, decodeJpegToRgba(jpeg.data(), jpeg.size(), scale, 0, 0, width, height, actual.data(),
+                                      width * 4));
+        EXPECT_EQ(expected, actual) << "1/" << scale;
+    }
+}
+
+TEST(JPEGDecompressTest, RegionMatchesWholeImage) {
+    std::vector<BYTE> jpeg = makeJpeg(640, 480);
+    for (uint32_t scale : kScales) {
+        uint32_t width, height;
+        std::vector<BYTE> whole = decodeReference(jpeg, scale, &width, &height);
+        const Region regions[] = {{0, 0, width, 1}, {0, 0, 1, height}, {width / 3, height / 5, width / 2, height / 3},
+                                  {17 / scale, 9 / scale, width / 4 + 3, height / 4 + 5},
+                                  {width - 7, height - 5, 7, 5}, {width / 2 + 1, 0, width / 2 - 1, height},
+                                  {0, height / 2 + 3, width, height / 2 - 3}};
+        for (const Region &region : regions) {
+            // padded rows, the padding must be left alone
+            const uint32_t stride = region.width * 4 + 8;
+            std::vector<BYTE> actual((size_t) stride * region.height, 0xA5);
+            ASSERT_EQ(0, decodeJpegToRgba(jpeg.data(), jpeg.size(), scale, region.left, region.top, region.width,
+                                          region.height, actual.data(), stride));
+            std::vector<BYTE> rows, padding;
+            for (uint32_t y = 0; y < region.height; y++) {
+                const BYTE *row = actual.data() + (size_t) y * stride;
+                rows.insert(rows.end(), row, row + (size_t) region.width * 4);
+                padding.insert(padding.end(), row + (size_t) region.width * 4, row + stride);
+            }
+            EXPECT_EQ(cut(whole, width, region), rows)
+                    << "1/" << scale << " " << region.width << "x" << region.height << " at " << region.left << ","
+                    << region.top;
+            EXPECT_EQ(std::vector<BYTE>(padding.size(), 0xA5), padding);
+        }
+    }
+}
+
+TEST(JPEGDecompressTest, InvalidArgumentsFail) {
+    std::vector<BYTE> jpeg = makeJpeg(64, 48);
+    std::vector<BYTE> rgba(64 * 48 * 4);
+    uint32_t width, height;
+    EXPECT_EQ(-1, getJpegScaledSize(jpeg.data(), jpeg.size(), 3, &width, &height));
+    EXPECT_EQ(-1, decodeJpegToRgba(jpeg.data(), jpeg.size(), 3, 0, 0, 16, 16, rgba.data(), 64 * 4));
+    EXPECT_EQ(-1, decodeJpegToRgba(jpeg.data(), jpeg.size(), 1, 60, 0, 5, 1, rgba.data(), 64 * 4));
+    EXPECT_EQ(-1, decodeJpegToRgba(jpeg.data(), jpeg.size(), 2, 0, 0, 32, 25, rgba.data(), 64 * 4));
+    EXPECT_EQ(-1, decodeJpegToRgba(jpeg.data(), jpeg.size(), 1, 0, 0, 0, 1, rgba.data(), 64 * 4));
+    // not a JPEG
+    std::vector<BYTE> garbage(100, 0x42);
+    EXPECT_EQ(-1, getJpegScaledSize(garbage.data(), garbage.size(), 1, &width, &height));
+    EXPECT_EQ(-1, decodeJpegToRgba(garbage.data(), garbage.size(), 1, 0, 0, 1, 1, rgba.data(), 64 * 4));
+}
+
+}  // namespace
@@ -0,0 +1,51 @@
+// Thumbnails of a 12 MP (4000x3000) photo with every filter of BitmapScaler, plus a 3x upscale.
+//
+// Reports the source throughput (bytes_per_second) and the time per source pixel (time_per_pixel).
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "BitmapScaler.h"
+
+namespace {
+
+std::vector<uint32_t> makePixels(uint32_t width, uint32_t height) {
+    std::vector<uint32_t> pixels((size_t) width * height);
+    srand(1);
+    for (auto &p : pixels) p = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    return pixels;
+}
+
+void setThroughput(benchmark::State &state, uint32_t width, uint32_t height) {
+    int64_t pixels = (int64_t) width * height;
+    state.SetBytesProcessed((int64_t) state.iterations() * pixels * 4);
+    state.counters["time_per_pixel"] = benchmark::Counter((double) state.iterations() * pixels,
+                                                        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+// {source width, source height, destination width, destination height}
+void sizes(benchmark::internal::Benchmark *b) {
+    b->Args({4000, 3000, 400, 300})->Args({4000, 3000, 1000, 750})->Args({4000, 3000, 2000, 1500});
+    b->Args({640, 480, 1920, 1440});
+    b->ArgNames({"w", "h", "nw", "nh"})->Unit(benchmark::kMillisecond);
+}
+
+void BM_Scale(benchmark::State &state, ScaleFilter filter) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    uint32_t nw = (uint32_t) state.range(2), nh = (uint32_t) state.range(3);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst((size_t) nw * nh);
+    for (auto _ : state) {
+        scalePixels(src.data(), w, h, w, dst.data(), nw, nh, nw, filter);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+}  // namespace
+
+BENCHMARK_CAPTURE(BM_Scale, Bilinear, kScaleFilterBilinear)->Apply(sizes);
+BENCHMARK_CAPTURE(BM_Scale, Box, kScaleFilterBox)->Apply(sizes);
+BENCHMARK_CAPTURE(BM_Scale, Lanczos3, kScaleFilterLanczos3)->Apply(sizes);
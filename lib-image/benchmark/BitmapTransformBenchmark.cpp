@@ -0,0 +1,155 @@
+// Throughput of the bitmap pixel loops at 480p, 720p, 1080p and 4K.
+//
+// Reports the source throughput (bytes_per_second) and the time per source pixel (time_per_pixel, e.g. 15ns).
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "BitmapTransform.h"
+
+namespace {
+
+std::vector<uint32_t> makePixels(uint32_t width, uint32_t height) {
+    std::vector<uint32_t> pixels((size_t) width * height);
+    srand(1);
+    for (auto &p : pixels) p = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    return pixels;
+}
+
+void setThroughput(benchmark::State &state, uint32_t width, uint32_t height) {
+    int64_t pixels = (int64_t) width * height;
+    state.SetBytesProcessed((int64_t) state.iterations() * pixels * 4);
+    state.counters["time_per_pixel"] = benchmark::Counter((double) state.iterations() * pixels,
+                                                        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+void resolutions(benchmark::internal::Benchmark *b) {
+    b->Args({640, 480})->Args({1280, 720})->Args({1920, 1080})->Args({3840, 2160});
+    b->ArgNames({"w", "h"})->Unit(benchmark::kMicrosecond);
+}
+
+void BM_Crop(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst((size_t) w * h);
+    for (auto _ : state) {
+        cropPixels(src.data(), w, h, w / 8, h / 8, w - w / 8, h - h / 8, dst.data());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+void BM_RotateCw90(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst(src.size());
+    for (auto _ : state) {
+        rotatePixelsCw90(src.data(), w, h, dst.data());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+void BM_RotateCcw90(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst(src.size());
+    for (auto _ : state) {
+        rotatePixelsCcw90(src.data(), w, h, dst.data());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+void BM_Rotate180(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> pixels = makePixels(w, h);
+    for (auto _ : state) {
+        rotatePixels180(pixels.data(), w, h);
+        benchmark::DoNotOptimize(pixels.data());
+    }
+    setThroughput(state, w, h);
+}
+
+void BM_FlipHorizontal(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> pixels = makePixels(w, h);
+    for (auto _ : state) {
+        flipPixelsHorizontal(pixels.data(), w, h);
+        benchmark::DoNotOptimize(pixels.data());
+    }
+    setThroughput(state, w, h);
+}
+
+void BM_FlipVertical(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> pixels = makePixels(w, h);
+    for (auto _ : state) {
+        flipPixelsVertical(pixels.data(), w, h);
+        benchmark::DoNotOptimize(pixels.data());
+    }
+    setThroughput(state, w, h);
+}
+
+// Scale to half the size.
+void BM_ScaleNN(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst((size_t) (w / 2) * (h / 2));
+    for (auto _ : state) {
+        scalePixelsNN(src.data(), w, h, dst.data(), w / 2, h / 2);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+// Scale to 3/4 of the size, a ratio without a SIMD path.
+void BM_ScaleNNFractional(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst((size_t) (w * 3 / 4) * (h * 3 / 4));
+    for (auto _ : state) {
+        scalePixelsNN(src.data(), w, h, dst.data(), w * 3 / 4, h * 3 / 4);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+// Scale to twice the size, every other output row is a copy.
+void BM_ScaleNNUpscale(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst((size_t) (w * 2) * (h * 2));
+    for (auto _ : state) {
+        scalePixelsNN(src.data(), w, h, dst.data(), w * 2, h * 2);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+// Scale to half the size.
+void BM_ScaleBI(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst((size_t) (w / 2) * (h / 2));
+    for (auto _ : state) {
+        scalePixelsBI(src.data(), w, h, dst.data(), w / 2, h / 2);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+}  // namespace
+
+BENCHMARK(BM_Crop)->Apply(resolutions);
+BENCHMARK(BM_RotateCw90)->Apply(resolutions);
+BENCHMARK(BM_RotateCcw90)->Apply(resolutions);
+BENCHMARK(BM_Rotate180)->Apply(resolutions);
+BENCHMARK(BM_FlipHorizontal)->Apply(resolutions);
+BENCHMARK(BM_FlipVertical)->Apply(resolutions);
+BENCHMARK(BM_ScaleNN)->Apply(resolutions);
+BENCHMARK(BM_ScaleNNFractional)->Apply(resolutions);
+BENCHMARK(BM_ScaleNNUpscale)->Apply(resolutions);
+BENCHMARK(BM_ScaleBI)->Apply(resolutions);
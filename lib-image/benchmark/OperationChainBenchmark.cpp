@@ -0,0 +1,90 @@
+// crop -> rotate -> scale of a 12 MP (4000x3000) photo into a 1080x1080 square, as the photo editor does it.
+//
+// The sequential case does what three BitmapProcessor calls did: allocate a new buffer per operation,
+// run the operation and free the previous buffer. The chained case composes the operations and renders them
+// into a single buffer. Both report `allocations` per frame.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "BitmapScaler.h"
+#include "BitmapTransform.h"
+#include "OperationChain.h"
+
+namespace {
+
+const uint32_t kWidth = 4000;
+const uint32_t kHeight = 3000;
+const uint32_t kSize = 1080;
+
+std::vector<uint32_t> makePixels(uint32_t width, uint32_t height) {
+    std::vector<uint32_t> pixels((size_t) width * height);
+    srand(1);
+    for (auto &p : pixels) p = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    return pixels;
+}
+
+void setThroughput(benchmark::State &state, int allocations) {
+    state.SetBytesProcessed((int64_t) state.iterations() * kWidth * kHeight * 4);
+    state.counters["allocations"] = allocations;
+}
+
+void BM_Sequential(benchmark::State &state, bool filtered) {
+    std::vector<uint32_t> src = makePixels(kWidth, kHeight);
+    for (auto _ : state) {
+        // the stored copy of the bitmap
+        auto *pixels = new uint32_t[src.size()];
+        std::copy(src.begin(), src.end(), pixels);
+
+        auto *cropped = new uint32_t[kHeight * kHeight];
+        cropPixels(pixels, kWidth, kHeight, 500, 0, 3500, kHeight, cropped);
+        delete[] pixels;
+
+        auto *rotated = new uint32_t[kHeight * kHeight];
+        rotatePixelsCw90(cropped, kHeight, kHeight, rotated);
+        delete[] cropped;
+
+        auto *scaled = new uint32_t[kSize * kSize];
+        if (filtered)
+            scalePixelsBI(rotated, kHeight, kHeight, scaled, kSize, kSize);
+        else
+            scalePixelsNN(rotated, kHeight, kHeight, scaled, kSize, kSize);
+        delete[] rotated;
+
+        benchmark::DoNotOptimize(scaled);
+        delete[] scaled;
+    }
+    setThroughput(state, 4);
+}
+
+void BM_Chained(benchmark::State &state, bool filtered) {
+    std::vector<uint32_t> src = makePixels(kWidth, kHeight);
+    const int32_t operations[] = {
+            kOperationCrop, 500, 0, 3500, (int32_t) kHeight,
+            kOperationRotateCw90,
+            kOperationScale, kSize, kSize, filtered ? kChainScaleBilinear : kChainScaleNearestNeighbour,
+    };
+    for (auto _ : state) {
+        auto *pixels = new uint32_t[src.size()];
+        std::copy(src.begin(), src.end(), pixels);
+
+        OperationChain chain;
+        composeOperations(operations, sizeof(operations) / sizeof(operations[0]), kWidth, kHeight, &chain);
+        auto *result = new uint32_t[chain.width * chain.height];
+        executeOperations(chain, pixels, kWidth, result, chain.width);
+        delete[] pixels;
+
+        benchmark::DoNotOptimize(result);
+        delete[] result;
+    }
+    setThroughput(state, 2);
+}
+
+}  // namespace
+
+BENCHMARK_CAPTURE(BM_Sequential, NearestNeighbour, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Chained, NearestNeighbour, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Sequential, Bilinear, true)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Chained, Bilinear, true)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,96 @@
+// The same operations on the four pixel types of BitmapTransform.h, at 1080p:
+//   uint8_t A_8, uint16_t RGB_565, uint32_t RGBA_8888 and uint64_t RGBA_F16.
+//
+// Reports the source throughput (bytes_per_second) and the time per source pixel (time_per_pixel, e.g. 15ns).
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "BitmapScaler.h"
+#include "BitmapTransform.h"
+
+namespace {
+
+const uint32_t kWidth = 1920;
+const uint32_t kHeight = 1080;
+
+template <typename Pixel>
+std::vector<Pixel> makePixels(uint32_t width, uint32_t height) {
+    std::vector<Pixel> pixels((size_t) width * height);
+    srand(1);
+    for (auto &p : pixels) p = (Pixel) (((uint64_t) rand() << 32) ^ ((uint64_t) rand() << 16) ^ (uint64_t) rand());
+    return pixels;
+}
+
+// Random halves may be NaN or infinite, which would not be representative of a photo.
+template <>
+std::vector<uint64_t> makePixels<uint64_t>(uint32_t width, uint32_t height) {
+    std::vector<uint64_t> pixels((size_t) width * height);
+    srand(1);
+    for (auto &p : pixels) {
+        p = 0;
+        // [0, 1) with a random mantissa, alpha 1.0
+        for (int c = 0; c < 3; ++c) p |= (uint64_t) (0x3800 | (rand() & 0x3ff)) << (16 * c);
+        p |= (uint64_t) 0x3c00 << 48;
+    }
+    return pixels;
+}
+
+template <typename Pixel>
+void setThroughput(benchmark::State &state, uint32_t width, uint32_t height) {
+    int64_t pixels = (int64_t) width * height;
+    state.SetBytesProcessed((int64_t) state.iterations() * pixels * (int64_t) sizeof(Pixel));
+    state.counters["time_per_pixel"] = benchmark::Counter((double) state.iterations() * pixels,
+                                                        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+template <typename Pixel>
+void BM_RotateCw90(benchmark::State &state) {
+    std::vector<Pixel> src = makePixels<Pixel>(kWidth, kHeight);
+    std::vector<Pixel> dst(src.size());
+    for (auto _ : state) {
+        rotatePixelsCw90(src.data(), kWidth, kHeight, dst.data());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput<Pixel>(state, kWidth, kHeight);
+}
+
+template <typename Pixel>
+void BM_FlipHorizontal(benchmark::State &state) {
+    std::vector<Pixel> pixels = makePixels<Pixel>(kWidth, kHeight);
+    for (auto _ : state) {
+        flipPixelsHorizontal(pixels.data(), kWidth, kHeight);
+        benchmark::DoNotOptimize(pixels.data());
+    }
+    setThroughput<Pixel>(state, kWidth, kHeight);
+}
+
+// Scale to a 480x270 thumbnail.
+template <typename Pixel>
+void BM_ScaleBox(benchmark::State &state) {
+    std::vector<Pixel> src = makePixels<Pixel>(kWidth, kHeight);
+    std::vector<Pixel> dst((size_t) (kWidth / 4) * (kHeight / 4));
+    for (auto _ : state) {
+        scalePixels(src.data(), kWidth, kHeight, kWidth, dst.data(), kWidth / 4, kHeight / 4, kWidth / 4,
+                    kScaleFilterBox);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput<Pixel>(state, kWidth, kHeight);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_RotateCw90, uint8_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_RotateCw90, uint16_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_RotateCw90, uint32_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_RotateCw90, uint64_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FlipHorizontal, uint8_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FlipHorizontal, uint16_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FlipHorizontal, uint32_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FlipHorizontal, uint64_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ScaleBox, uint8_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ScaleBox, uint16_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ScaleBox, uint32_t)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_ScaleBox, uint64_t)->Unit(benchmark::kMicrosecond);
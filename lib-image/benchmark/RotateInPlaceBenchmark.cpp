@@ -0,0 +1,120 @@
+// Out of place vs in place 90 degree rotation of a stored JniBitmap.
+//
+// The out of place case does what RotateBitmapCw90 does: allocate the rotated pixels, rotate, free the original.
+// Besides the time, each case reports `peak_extra_MB`: how far the resident memory rose above the bitmap itself
+// during one rotation. It is measured once outside the timed loop by resetting the peak RSS (VmHWM)
+// through /proc/self/clear_refs, so it is only available on Linux (-1 elsewhere).
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "BitmapTransform.h"
+
+namespace {
+
+#if defined(__GLIBC__)
+// glibc raises its mmap threshold after a large block is freed and then serves the next bitmaps from a heap
+// which stays resident, hiding the second copy. Keep large blocks mapped and unmapped on every call,
+// as the Android allocators do.
+const int kFixedMmapThreshold = mallopt(M_MMAP_THRESHOLD, 1024 * 1024);
+#endif
+
+uint32_t *makePixels(uint32_t width, uint32_t height) {
+    size_t count = (size_t) width * height;
+    auto *pixels = new uint32_t[count];
+    srand(1);
+    for (size_t i = 0; i < count; ++i) pixels[i] = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    return pixels;
+}
+
+// Returns the value of a `/proc/self/status` field in kB, or -1.
+long readStatusKb(const char *field) {
+    FILE *file = fopen("/proc/self/status", "r");
+    if (file == nullptr) return -1;
+    char line[256];
+    long value = -1;
+    size_t length = strlen(field);
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (strncmp(line, field, length) == 0 && line[length] == ':') {
+            value = strtol(line + length + 1, nullptr, 10);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+bool resetPeakRss() {
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    if (file == nullptr) return false;
+    bool ok = fputs("5", file) >= 0;
+    return fclose(file) == 0 && ok;
+}
+
+// Runs [rotate] once and returns by how many MB the peak RSS exceeded the RSS before, or -1.
+template <typename Rotate>
+double measurePeakExtraMb(Rotate rotate) {
+    if (!resetPeakRss()) return -1;
+    long before = readStatusKb("VmRSS");
+    rotate();
+    long peak = readStatusKb("VmHWM");
+    if (before < 0 || peak < 0) return -1;
+    return (double) (peak - before) / 1024.0;
+}
+
+uint32_t *rotateOutOfPlaceCw90(uint32_t *pixels, uint32_t width, uint32_t height) {
+    auto *rotated = new uint32_t[(size_t) width * height];
+    rotatePixelsCw90(pixels, width, height, rotated);
+    delete[] pixels;
+    return rotated;
+}
+
+void setCounters(benchmark::State &state, uint32_t width, uint32_t height, double peakExtraMb) {
+    int64_t pixels = (int64_t) width * height;
+    state.SetBytesProcessed((int64_t) state.iterations() * pixels * 4);
+    state.counters["bitmap_MB"] = (double) pixels * 4 / (1024.0 * 1024.0);
+    state.counters["peak_extra_MB"] = peakExtraMb;
+}
+
+void resolutions(benchmark::internal::Benchmark *b) {
+    b->Args({1920, 1080})->Args({4000, 3000});
+    b->ArgNames({"w", "h"})->Unit(benchmark::kMillisecond);
+}
+
+void BM_RotateCw90OutOfPlace(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    uint32_t *pixels = makePixels(w, h);
+    for (auto _ : state) {
+        pixels = rotateOutOfPlaceCw90(pixels, w, h);
+        std::swap(w, h);
+        benchmark::DoNotOptimize(pixels);
+    }
+    double peak = measurePeakExtraMb([&] { pixels = rotateOutOfPlaceCw90(pixels, w, h); });
+    delete[] pixels;
+    setCounters(state, w, h, peak);
+}
+
+void BM_RotateCw90InPlace(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    uint32_t *pixels = makePixels(w, h);
+    for (auto _ : state) {
+        rotatePixelsCw90InPlace(pixels, w, h);
+        std::swap(w, h);
+        benchmark::DoNotOptimize(pixels);
+    }
+    double peak = measurePeakExtraMb([&] { rotatePixelsCw90InPlace(pixels, w, h); });
+    delete[] pixels;
+    setCounters(state, w, h, peak);
+}
+
+}  // namespace
+
+BENCHMARK(BM_RotateCw90OutOfPlace)->Apply(resolutions);
+BENCHMARK(BM_RotateCw90InPlace)->Apply(resolutions);
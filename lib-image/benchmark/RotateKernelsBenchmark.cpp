@@ -0,0 +1,96 @@
+// 90 degree rotation by kernel, compared with the per pixel loop rotatePixelsCw90 used before.
+//
+// The 4000x3000 (12 MP) case is 48MB in and 48MB out, far beyond any cache:
+// a tiled kernel should approach the memcpy throughput reported by BM_Memcpy.
+// Kernels not supported by the running CPU are skipped.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "RotateKernels.h"
+
+namespace {
+
+std::vector<uint32_t> makePixels(uint32_t width, uint32_t height) {
+    std::vector<uint32_t> pixels((size_t) width * height);
+    srand(1);
+    for (auto &p : pixels) p = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    return pixels;
+}
+
+void setThroughput(benchmark::State &state, uint32_t width, uint32_t height) {
+    int64_t pixels = (int64_t) width * height;
+    state.SetBytesProcessed((int64_t) state.iterations() * pixels * 4);
+    state.counters["time_per_pixel"] = benchmark::Counter((double) state.iterations() * pixels,
+                                                        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+void resolutions(benchmark::internal::Benchmark *b) {
+    b->Args({1920, 1080})->Args({3840, 2160})->Args({4000, 3000});
+    b->ArgNames({"w", "h"})->Unit(benchmark::kMicrosecond);
+}
+
+// The loop rotatePixelsCw90 used to run: sequential reads, one destination column per source row.
+void rotateNaiveCw90(const uint32_t *src, uint32_t width, uint32_t height, uint32_t *dst) {
+    int newWidth = height;
+    int newHeight = width;
+    int whereToGet = 0;
+    for (int x = newWidth - 1; x >= 0; --x) {
+        for (int y = 0; y < newHeight; ++y) {
+            dst[newWidth * y + x] = src[whereToGet++];
+        }
+    }
+}
+
+void BM_Memcpy(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst(src.size());
+    for (auto _ : state) {
+        memcpy(dst.data(), src.data(), src.size() * 4);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+void BM_RotateNaiveCw90(benchmark::State &state) {
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst(src.size());
+    for (auto _ : state) {
+        rotateNaiveCw90(src.data(), w, h, dst.data());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+void BM_Rotate90(benchmark::State &state, RotateKernel kernel, bool clockwise) {
+    if (!isRotateKernelSupported(kernel)) {
+        state.SkipWithError("kernel not supported by this CPU");
+        return;
+    }
+    uint32_t w = (uint32_t) state.range(0), h = (uint32_t) state.range(1);
+    std::vector<uint32_t> src = makePixels(w, h);
+    std::vector<uint32_t> dst(src.size());
+    for (auto _ : state) {
+        rotatePixels90(src.data(), w, h, w, dst.data(), h, clockwise, kernel);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state, w, h);
+}
+
+}  // namespace
+
+BENCHMARK(BM_Memcpy)->Apply(resolutions);
+BENCHMARK(BM_RotateNaiveCw90)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_Rotate90, Cw_scalar, kRotateKernelScalar, true)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_Rotate90, Cw_sse2, kRotateKernelSse2, true)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_Rotate90, Cw_avx2, kRotateKernelAvx2, true)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_Rotate90, Cw_neon, kRotateKernelNeon, true)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_Rotate90, Ccw_scalar, kRotateKernelScalar, false)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_Rotate90, Ccw_sse2, kRotateKernelSse2, false)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_Rotate90, Ccw_avx2, kRotateKernelAvx2, false)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_Rotate90, Ccw_neon, kRotateKernelNeon, false)->Apply(resolutions);
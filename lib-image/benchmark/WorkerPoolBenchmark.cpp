@@ -0,0 +1,111 @@
+// The operations of BitmapTransform.h, BitmapScaler.h and OperationChain.h split into bands on a WorkerPool,
+// on a 12 MP RGBA_8888 photo. The argument is the thread count, 1 runs without a pool.
+//
+// Reports the source throughput (bytes_per_second). The time is the wall time of the calling thread,
+// the speedup over 1 thread is bounded by the cores and the memory bandwidth of the machine.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "BitmapScaler.h"
+#include "BitmapTransform.h"
+#include "OperationChain.h"
+#include "WorkerPool.h"
+
+namespace {
+
+const uint32_t kWidth = 4000;
+const uint32_t kHeight = 3000;
+
+std::vector<uint32_t> makePixels(uint32_t width, uint32_t height) {
+    std::vector<uint32_t> pixels((size_t) width * height);
+    srand(1);
+    for (auto &p : pixels) p = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    return pixels;
+}
+
+std::unique_ptr<WorkerPool> makeWorkers(const benchmark::State &state) {
+    uint32_t threads = (uint32_t) state.range(0);
+    return std::unique_ptr<WorkerPool>(threads > 1 ? new WorkerPool(threads) : nullptr);
+}
+
+void setThroughput(benchmark::State &state) {
+    state.SetBytesProcessed((int64_t) state.iterations() * kWidth * kHeight * (int64_t) sizeof(uint32_t));
+}
+
+void BM_RotateCw90(benchmark::State &state) {
+    std::vector<uint32_t> src = makePixels(kWidth, kHeight);
+    std::vector<uint32_t> dst(src.size());
+    std::unique_ptr<WorkerPool> workers = makeWorkers(state);
+    for (auto _ : state) {
+        rotatePixelsCw90(src.data(), kWidth, kHeight, dst.data(), workers.get());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state);
+}
+
+void BM_RotateCw90InPlace(benchmark::State &state) {
+    std::vector<uint32_t> pixels = makePixels(kWidth, kHeight);
+    std::unique_ptr<WorkerPool> workers = makeWorkers(state);
+    uint32_t width = kWidth, height = kHeight;
+    for (auto _ : state) {
+        rotatePixelsCw90InPlace(pixels.data(), width, height, workers.get());
+        std::swap(width, height);
+        benchmark::DoNotOptimize(pixels.data());
+    }
+    setThroughput(state);
+}
+
+void BM_FlipHorizontal(benchmark::State &state) {
+    std::vector<uint32_t> pixels = makePixels(kWidth, kHeight);
+    std::unique_ptr<WorkerPool> workers = makeWorkers(state);
+    for (auto _ : state) {
+        flipPixelsHorizontal(pixels.data(), kWidth, kHeight, kWidth, workers.get());
+        benchmark::DoNotOptimize(pixels.data());
+    }
+    setThroughput(state);
+}
+
+// Downscale to a 1000x750 preview.
+void BM_ScaleLanczos3(benchmark::State &state) {
+    std::vector<uint32_t> src = makePixels(kWidth, kHeight);
+    std::vector<uint32_t> dst((size_t) (kWidth / 4) * (kHeight / 4));
+    std::unique_ptr<WorkerPool> workers = makeWorkers(state);
+    for (auto _ : state) {
+        scalePixels(src.data(), kWidth, kHeight, kWidth, dst.data(), kWidth / 4, kHeight / 4, kWidth / 4,
+                    kScaleFilterLanczos3, workers.get());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state);
+}
+
+// Crop, rotate and box scale in one chain, the usual thumbnail of a batch.
+void BM_OperationChain(benchmark::State &state) {
+    std::vector<uint32_t> src = makePixels(kWidth, kHeight);
+    const int32_t operations[] = {kOperationCrop, 500, 0, 3500, 3000,
+                                  kOperationRotateCw90,
+                                  kOperationScale, 600, 600, kChainScaleBox};
+    OperationChain chain;
+    if (!composeOperations(operations, sizeof(operations) / sizeof(operations[0]), kWidth, kHeight, &chain)) {
+        state.SkipWithError("invalid operations");
+        return;
+    }
+    std::vector<uint32_t> dst((size_t) chain.width * chain.height);
+    std::unique_ptr<WorkerPool> workers = makeWorkers(state);
+    for (auto _ : state) {
+        executeOperations(chain, src.data(), kWidth, dst.data(), chain.width, workers.get());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    setThroughput(state);
+}
+
+}  // namespace
+
+BENCHMARK(BM_RotateCw90)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_RotateCw90InPlace)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_FlipHorizontal)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScaleLanczos3)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_OperationChain)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
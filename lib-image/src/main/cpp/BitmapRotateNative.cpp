@@ -1,163 +1,424 @@
 #include "BitmapRotateNative.h"
 
+#include <map>
+#include <memory>
+#include <mutex>
+
 #define IMAGE_PACKAGE_BASE "com/leovp/image/"
 
-int32_t convertArgbToInt(ARGB argb)
+// more threads than cores only add overhead, no device has more than this
+static const jint kMaxThreadCount = 16;
+
+// cached by JNI_OnLoad, used to create the result bitmaps
+static jclass g_bitmapClass = NULL;
+static jmethodID g_createBitmapMethod = NULL;
+static jobject g_argb8888Config = NULL;
+static jobject g_rgb565Config = NULL;
+static jobject g_rgbaF16Config = NULL;
+static jobject g_alpha8Config = NULL;
+
+/** the size of a pixel of the supported formats, 0 for the others */
+static uint32_t bytesPerPixel(int32_t format)
+{
+    switch (format)
+    {
+    case ANDROID_BITMAP_FORMAT_RGBA_8888:
+        return 4;
+    case ANDROID_BITMAP_FORMAT_RGB_565:
+        return 2;
+    case ANDROID_BITMAP_FORMAT_RGBA_F16:
+        return 8;
+    case ANDROID_BITMAP_FORMAT_A_8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/** the Bitmap.Config creating bitmaps of [format] */
+static jobject bitmapConfigOf(int32_t format)
+{
+    switch (format)
+    {
+    case ANDROID_BITMAP_FORMAT_RGB_565:
+        return g_rgb565Config;
+    case ANDROID_BITMAP_FORMAT_RGBA_F16:
+        return g_rgbaF16Config;
+    case ANDROID_BITMAP_FORMAT_A_8:
+        return g_alpha8Config;
+    default:
+        return g_argb8888Config;
+    }
+}
+
+/** copies [height] rows of [rowSize] bytes between buffers of different strides */
+static void copyRows(const uint8_t *src, uint32_t srcStride, uint8_t *dst, uint32_t dstStride,
+                     uint32_t rowSize, uint32_t height)
+{
+    if (srcStride == rowSize && dstStride == rowSize)
+    {
+        memcpy(dst, src, (size_t)rowSize * height);
+        return;
+    }
+    for (uint32_t y = 0; y < height; ++y)
+        memcpy(dst + (size_t)y * dstStride, src + (size_t)y * srcStride, rowSize);
+}
+
+/** copies the pixels of the attached bitmap into native memory and releases it */
+static bool detachBitmap(JNIEnv *env, JniBitmap *jniBitmap)
+{
+    int ret;
+    void *bitmapPixels;
+    if ((ret = AndroidBitmap_lockPixels(env, jniBitmap->_attachedBitmap, &bitmapPixels)) < 0)
+    {
+        LOGE("AndroidBitmap_lockPixels() failed ! error=%d", ret);
+        return false;
+    }
+    uint32_t width = jniBitmap->_bitmapInfo.width, height = jniBitmap->_bitmapInfo.height;
+    uint32_t rowSize = width * bytesPerPixel(jniBitmap->_bitmapInfo.format);
+    uint8_t *storedBitmapPixels = new uint8_t[(size_t)rowSize * height];
+    copyRows((uint8_t *)bitmapPixels, jniBitmap->_bitmapInfo.stride, storedBitmapPixels, rowSize, rowSize, height);
+    AndroidBitmap_unlockPixels(env, jniBitmap->_attachedBitmap);
+    env->DeleteGlobalRef(jniBitmap->_attachedBitmap);
+    jniBitmap->_attachedBitmap = NULL;
+    jniBitmap->_storedBitmapPixels = storedBitmapPixels;
+    jniBitmap->_bitmapInfo.stride = rowSize;
+    return true;
+}
+
+/** returns the bitmap of the handle with its pixels in native memory, detaching it if needed. NULL if there is none */
+static JniBitmap *getStoredBitmap(JNIEnv *env, jobject handle)
+{
+    JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
+    if (jniBitmap == NULL)
+        return NULL;
+    if (jniBitmap->_attachedBitmap != NULL && !detachBitmap(env, jniBitmap))
+        return NULL;
+    return jniBitmap->_storedBitmapPixels == NULL ? NULL : jniBitmap;
+}
+
+/**
+ * returns the pixels the size preserving operations work on, whose rows are _bitmapInfo.stride bytes apart:
+ * the locked pixels of the attached bitmap, or the stored ones. to be released by unlockBitmapPixels().
+ */
+static void *lockBitmapPixels(JNIEnv *env, JniBitmap *jniBitmap)
 {
-    return (argb.alpha) | (argb.red << 24) | (argb.green << 16) | (argb.blue << 8);
+    if (jniBitmap->_attachedBitmap == NULL)
+        return jniBitmap->_storedBitmapPixels;
+    int ret;
+    void *bitmapPixels;
+    if ((ret = AndroidBitmap_lockPixels(env, jniBitmap->_attachedBitmap, &bitmapPixels)) < 0)
+    {
+        LOGE("AndroidBitmap_lockPixels() failed ! error=%d", ret);
+        return NULL;
+    }
+    return bitmapPixels;
 }
 
-void convertIntToArgb(uint32_t pixel, ARGB *argb)
+static void unlockBitmapPixels(JNIEnv *env, JniBitmap *jniBitmap)
 {
-    argb->red = ((pixel >> 24) & 0xff);
-    argb->green = ((pixel >> 16) & 0xff);
-    argb->blue = ((pixel >> 8) & 0xff);
-    argb->alpha = (pixel & 0xff);
+    if (jniBitmap->_attachedBitmap != NULL)
+        AndroidBitmap_unlockPixels(env, jniBitmap->_attachedBitmap);
 }
 
+// --------------------
+// Worker pools.
+//
+// A pool per thread count, created by the first bitmap asking for it.
+// The map owns the pools, they live until the library is unloaded.
+// Bitmaps processed concurrently on the same pool take turns, so a batch never runs more threads than requested.
+// --------------------
+
+static std::mutex g_workerPoolsMutex;
+static std::map<jint, std::unique_ptr<WorkerPool> > g_workerPools;
+
+/** the pool running bands on [threadCount] threads, NULL for a single thread */
+static WorkerPool *workerPoolFor(jint threadCount)
+{
+    if (threadCount <= 1)
+        return NULL;
+    if (threadCount > kMaxThreadCount)
+        threadCount = kMaxThreadCount;
+    std::lock_guard<std::mutex> lock(g_workerPoolsMutex);
+    std::unique_ptr<WorkerPool> &workers = g_workerPools[threadCount];
+    if (!workers)
+        workers.reset(new WorkerPool((uint32_t)threadCount));
+    return workers.get();
+}
+
+// --------------------
+// Operations over the pixel type of the bitmap, see BitmapTransform.h.
+//
+// The operations of BitmapTransform are templates, these functors carry their arguments
+// until the format of the bitmap has picked the pixel type.
+// --------------------
+
+template <typename Pixel, typename Operation>
+static void replacePixelsAs(JniBitmap *jniBitmap, uint32_t newWidth, uint32_t newHeight, const Operation &operation)
+{
+    Pixel *previousData = (Pixel *)jniBitmap->_storedBitmapPixels;
+    uint8_t *newBitmapPixels = new uint8_t[(size_t)newWidth * newHeight * sizeof(Pixel)];
+    operation(previousData, jniBitmap->_bitmapInfo.width, jniBitmap->_bitmapInfo.height, (Pixel *)newBitmapPixels);
+    // get rid of old data, and replace it with new one
+    delete[] jniBitmap->_storedBitmapPixels;
+    jniBitmap->_storedBitmapPixels = newBitmapPixels;
+    jniBitmap->_bitmapInfo.width = newWidth;
+    jniBitmap->_bitmapInfo.height = newHeight;
+    jniBitmap->_bitmapInfo.stride = newWidth * sizeof(Pixel);
+}
+
+/** replaces the stored pixels by the [newWidth] x [newHeight] ones operation(src, width, height, dst) renders */
+template <typename Operation>
+static void replacePixels(JniBitmap *jniBitmap, uint32_t newWidth, uint32_t newHeight, const Operation &operation)
+{
+    switch (jniBitmap->_bitmapInfo.format)
+    {
+    case ANDROID_BITMAP_FORMAT_RGB_565:
+        replacePixelsAs<uint16_t>(jniBitmap, newWidth, newHeight, operation);
+        break;
+    case ANDROID_BITMAP_FORMAT_RGBA_F16:
+        replacePixelsAs<uint64_t>(jniBitmap, newWidth, newHeight, operation);
+        break;
+    case ANDROID_BITMAP_FORMAT_A_8:
+        replacePixelsAs<uint8_t>(jniBitmap, newWidth, newHeight, operation);
+        break;
+    default:
+        replacePixelsAs<uint32_t>(jniBitmap, newWidth, newHeight, operation);
+        break;
+    }
+}
+
+/** calls operation(pixels) with the [pixels] of [format] as their pixel type */
+template <typename Operation>
+static void modifyPixels(int32_t format, void *pixels, const Operation &operation)
+{
+    switch (format)
+    {
+    case ANDROID_BITMAP_FORMAT_RGB_565:
+        operation((uint16_t *)pixels);
+        break;
+    case ANDROID_BITMAP_FORMAT_RGBA_F16:
+        operation((uint64_t *)pixels);
+        break;
+    case ANDROID_BITMAP_FORMAT_A_8:
+        operation((uint8_t *)pixels);
+        break;
+    default:
+        operation((uint32_t *)pixels);
+        break;
+    }
+}
+
+// every functor also carries the pool of the bitmap
+
+struct Crop
+{
+    uint32_t left, top, right, bottom;
+    WorkerPool *workers;
+
+    template <typename Pixel>
+    void operator()(const Pixel *src, uint32_t width, uint32_t height, Pixel *dst) const
+    {
+        cropPixels(src, width, height, left, top, right, bottom, dst, workers);
+    }
+};
+
+struct Rotate90
+{
+    bool clockwise;
+    WorkerPool *workers;
+
+    template <typename Pixel>
+    void operator()(const Pixel *src, uint32_t width, uint32_t height, Pixel *dst) const
+    {
+        if (clockwise)
+            rotatePixelsCw90(src, width, height, dst, workers);
+        else
+            rotatePixelsCcw90(src, width, height, dst, workers);
+    }
+};
+
+struct Rotate90InPlace
+{
+    uint32_t width, height;
+    bool clockwise;
+    WorkerPool *workers;
+
+    template <typename Pixel>
+    void operator()(Pixel *pixels) const
+    {
+        if (clockwise)
+            rotatePixelsCw90InPlace(pixels, width, height, workers);
+        else
+            rotatePixelsCcw90InPlace(pixels, width, height, workers);
+    }
+};
+
+/** the size preserving operations, on rows [stride] bytes apart */
+struct Rotate180
+{
+    uint32_t width, height, stride;
+    WorkerPool *workers;
+
+    template <typename Pixel>
+    void operator()(Pixel *pixels) const
+    {
+        rotatePixels180(pixels, width, height, stride / sizeof(Pixel), workers);
+    }
+};
+
+struct FlipHorizontal
+{
+    uint32_t width, height, stride;
+    WorkerPool *workers;
+
+    template <typename Pixel>
+    void operator()(Pixel *pixels) const
+    {
+        flipPixelsHorizontal(pixels, width, height, stride / sizeof(Pixel), workers);
+    }
+};
+
+struct FlipVertical
+{
+    uint32_t width, height, stride;
+    WorkerPool *workers;
+
+    template <typename Pixel>
+    void operator()(Pixel *pixels) const
+    {
+        flipPixelsVertical(pixels, width, height, stride / sizeof(Pixel), workers);
+    }
+};
+
+struct ScaleNN
+{
+    uint32_t newWidth, newHeight;
+    WorkerPool *workers;
+
+    template <typename Pixel>
+    void operator()(const Pixel *src, uint32_t width, uint32_t height, Pixel *dst) const
+    {
+        scalePixelsNN(src, width, height, dst, newWidth, newHeight, workers);
+    }
+};
+
+struct ScaleFiltered
+{
+    uint32_t newWidth, newHeight;
+    ScaleFilter filter;
+    WorkerPool *workers;
+
+    template <typename Pixel>
+    void operator()(const Pixel *src, uint32_t width, uint32_t height, Pixel *dst) const
+    {
+        scalePixels(src, width, height, width, dst, newWidth, newHeight, newWidth, filter, workers);
+    }
+};
+
+struct ExecuteOperations
+{
+    const OperationChain *chain;
+    WorkerPool *workers;
+
+    template <typename Pixel>
+    void operator()(const Pixel *src, uint32_t width, uint32_t /* height */, Pixel *dst) const
+    {
+        executeOperations(*chain, src, width, dst, chain->width, workers);
+    }
+};
+
+// =============================
+
 /** crops the bitmap within to be smaller. note that no validations are done */
 JNIEXPORT void JNICALL CropBitmap(JNIEnv *env, jobject obj,
                                   jobject handle,
                                   uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
 {
-    JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
-    if (jniBitmap == NULL || jniBitmap->_storedBitmapPixels == NULL)
+    JniBitmap *jniBitmap = getStoredBitmap(env, handle);
+    if (jniBitmap == NULL)
         return;
-    uint32_t *previousData = jniBitmap->_storedBitmapPixels;
-    uint32_t oldWidth = jniBitmap->_bitmapInfo.width;
-    uint32_t newWidth = right - left, newHeight = bottom - top;
-    uint32_t *newBitmapPixels = new uint32_t[newWidth * newHeight];
-    uint32_t *whereToGet = previousData + left + top * oldWidth;
-    uint32_t *whereToPut = newBitmapPixels;
-    for (int y = top; y < bottom; ++y)
-    {
-        memcpy(whereToPut, whereToGet, sizeof(uint32_t) * newWidth);
-        whereToGet += oldWidth;
-        whereToPut += newWidth;
-    }
-    // done copying , so replace old data with new one
-    delete[] previousData;
-    jniBitmap->_storedBitmapPixels = newBitmapPixels;
-    jniBitmap->_bitmapInfo.width = newWidth;
-    jniBitmap->_bitmapInfo.height = newHeight;
+    Crop crop = {left, top, right, bottom, jniBitmap->_workers};
+    replacePixels(jniBitmap, right - left, bottom - top, crop);
 }
 
 /**rotates the inner bitmap data by 90 degrees counter clock wise*/ //
-JNIEXPORT void JNICALL RotateBitmapCcw90(JNIEnv *env, jobject obj, jobject handle)
+JNIEXPORT void JNICALL RotateBitmapCcw90(JNIEnv *env, jobject obj, jobject handle, jboolean inPlace)
 {
-    JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
-    if (jniBitmap == NULL || jniBitmap->_storedBitmapPixels == NULL)
+    JniBitmap *jniBitmap = getStoredBitmap(env, handle);
+    if (jniBitmap == NULL)
         return;
-    uint32_t *previousData = jniBitmap->_storedBitmapPixels;
-    uint32_t newWidth = jniBitmap->_bitmapInfo.height;
-    uint32_t newHeight = jniBitmap->_bitmapInfo.width;
-    jniBitmap->_bitmapInfo.width = newWidth;
-    jniBitmap->_bitmapInfo.height = newHeight;
-    uint32_t *newBitmapPixels = new uint32_t[newWidth * newHeight];
-    int whereToGet = 0;
-    // XY. ... ... ..X
-    // ...>Y..>...>..Y
-    // ... X.. .YX ...
-    for (int x = 0; x < newWidth; ++x)
-    {
-        for (int y = newHeight - 1; y >= 0; --y)
-        {
-            // take from each row (up to bottom), from left to right
-            uint32_t pixel = previousData[whereToGet++];
-            newBitmapPixels[newWidth * y + x] = pixel;
-        }
-    }
-    delete[] previousData;
-    jniBitmap->_storedBitmapPixels = newBitmapPixels;
+    uint32_t oldWidth = jniBitmap->_bitmapInfo.width;
+    uint32_t oldHeight = jniBitmap->_bitmapInfo.height;
+    if (inPlace)
+    {
+        // slower, but without a second copy of the pixels
+        Rotate90InPlace rotate = {oldWidth, oldHeight, false, jniBitmap->_workers};
+        modifyPixels(jniBitmap->_bitmapInfo.format, jniBitmap->_storedBitmapPixels, rotate);
+        jniBitmap->_bitmapInfo.width = oldHeight;
+        jniBitmap->_bitmapInfo.height = oldWidth;
+        jniBitmap->_bitmapInfo.stride = oldHeight * bytesPerPixel(jniBitmap->_bitmapInfo.format);
+        return;
+    }
+    Rotate90 rotate = {false, jniBitmap->_workers};
+    replacePixels(jniBitmap, oldHeight, oldWidth, rotate);
 }
 
 /**rotates the inner bitmap data by 90 degrees clock wise*/ //
-JNIEXPORT void JNICALL RotateBitmapCw90(JNIEnv *env, jobject obj, jobject handle)
+JNIEXPORT void JNICALL RotateBitmapCw90(JNIEnv *env, jobject obj, jobject handle, jboolean inPlace)
 {
-    JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
-    if (jniBitmap == NULL || jniBitmap->_storedBitmapPixels == NULL)
+    JniBitmap *jniBitmap = getStoredBitmap(env, handle);
+    if (jniBitmap == NULL)
         return;
-    uint32_t *previousData = jniBitmap->_storedBitmapPixels;
-    uint32_t newWidth = jniBitmap->_bitmapInfo.height;
-    uint32_t newHeight = jniBitmap->_bitmapInfo.width;
-    jniBitmap->_bitmapInfo.width = newWidth;
-    jniBitmap->_bitmapInfo.height = newHeight;
-    uint32_t *newBitmapPixels = new uint32_t[newWidth * newHeight];
-    int whereToGet = 0;
-    // XY. ..X ... ...
-    // ...>..Y>...>Y..
-    // ... ... .YX X..
-    jniBitmap->_storedBitmapPixels = newBitmapPixels;
-    for (int x = newWidth - 1; x >= 0; --x)
+    uint32_t oldWidth = jniBitmap->_bitmapInfo.width;
+    uint32_t oldHeight = jniBitmap->_bitmapInfo.height;
+    if (inPlace)
     {
-        for (int y = 0; y < newHeight; ++y)
-        {
-            // take from each row (up to bottom), from left to right
-            uint32_t pixel = previousData[whereToGet++];
-            newBitmapPixels[newWidth * y + x] = pixel;
-        }
+        // slower, but without a second copy of the pixels
+        Rotate90InPlace rotate = {oldWidth, oldHeight, true, jniBitmap->_workers};
+        modifyPixels(jniBitmap->_bitmapInfo.format, jniBitmap->_storedBitmapPixels, rotate);
+        jniBitmap->_bitmapInfo.width = oldHeight;
+        jniBitmap->_bitmapInfo.height = oldWidth;
+        jniBitmap->_bitmapInfo.stride = oldHeight * bytesPerPixel(jniBitmap->_bitmapInfo.format);
+        return;
     }
-    delete[] previousData;
+    Rotate90 rotate = {true, jniBitmap->_workers};
+    replacePixels(jniBitmap, oldHeight, oldWidth, rotate);
 }
 
 /**rotates the inner bitmap data by 180 degrees (*/ //
 JNIEXPORT void JNICALL RotateBitmap180(JNIEnv *env, jobject obj, jobject handle)
 {
     JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
-    if (jniBitmap == NULL || jniBitmap->_storedBitmapPixels == NULL)
+    if (jniBitmap == NULL)
         return;
-    uint32_t *pixels = jniBitmap->_storedBitmapPixels;
-    uint32_t *pixels2 = jniBitmap->_storedBitmapPixels;
-    uint32_t width = jniBitmap->_bitmapInfo.width;
-    uint32_t height = jniBitmap->_bitmapInfo.height;
-    // no need to create a totally new bitmap - it's the exact same size as the original
-    //  1234 fedc
-    //  5678>ba09
-    //  90ab>8765
-    //  cdef 4321
-    int whereToGet = 0;
-    for (int y = height - 1; y >= height / 2; --y)
-    {
-        for (int x = width - 1; x >= 0; --x)
-        {
-            // take from each row (up to bottom), from left to right
-            uint32_t tempPixel = pixels2[width * y + x];
-            pixels2[width * y + x] = pixels[whereToGet];
-            pixels[whereToGet] = tempPixel;
-            ++whereToGet;
-        }
-    }
-    // if the height isn't even, flip the middle row :
-    if (height % 2 == 1)
-    {
-        int y = height / 2;
-        whereToGet = width * y;
-        int lastXToHandle = width % 2 == 0 ? (width / 2) : (width / 2) - 1;
-        for (int x = width - 1; x >= lastXToHandle; --x)
-        {
-            uint32_t tempPixel = pixels2[width * y + x];
-            pixels2[width * y + x] = pixels[whereToGet];
-            pixels[whereToGet] = tempPixel;
-            ++whereToGet;
-        }
-    }
+    void *pixels = lockBitmapPixels(env, jniBitmap);
+    if (pixels == NULL)
+        return;
+    Rotate180 rotate = {jniBitmap->_bitmapInfo.width, jniBitmap->_bitmapInfo.height, jniBitmap->_bitmapInfo.stride,
+                        jniBitmap->_workers};
+    modifyPixels(jniBitmap->_bitmapInfo.format, pixels, rotate);
+    unlockBitmapPixels(env, jniBitmap);
 }
 
 /**free bitmap*/ //
 JNIEXPORT void JNICALL FreeBitmapData(JNIEnv *env, jobject obj, jobject handle)
 {
     JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
-    if (jniBitmap == NULL || jniBitmap->_storedBitmapPixels == NULL)
+    if (jniBitmap == NULL)
         return;
+    if (jniBitmap->_attachedBitmap != NULL)
+        env->DeleteGlobalRef(jniBitmap->_attachedBitmap);
     delete[] jniBitmap->_storedBitmapPixels;
-    jniBitmap->_storedBitmapPixels = NULL;
     delete jniBitmap;
 }
 
-/**restore java bitmap (from JNI data)*/ //
+/**restore java bitmap (from JNI data) in the format it was stored. an attached bitmap is returned itself*/ //
 JNIEXPORT jobject GetBitmapFromSavedBitmapData(JNIEnv *env, jobject obj, jobject handle)
 {
     JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
+    if (jniBitmap != NULL && jniBitmap->_attachedBitmap != NULL)
+        return env->NewLocalRef(jniBitmap->_attachedBitmap);
     if (jniBitmap == NULL || jniBitmap->_storedBitmapPixels == NULL)
     {
         LOGD("no bitmap data was stored. returning null...");
@@ -166,42 +427,39 @@ JNIEXPORT jobject GetBitmapFromSavedBitmapData(JNIEnv *env, jobject obj, jobject
     //
     // creating a new bitmap to put the pixels into it - using Bitmap Bitmap.createBitmap (int width, int height, Bitmap.Config config) :
     //
-    jclass bitmapCls = env->FindClass("android/graphics/Bitmap");
-    jmethodID createBitmapFunction = env->GetStaticMethodID(bitmapCls,
-                                                            "createBitmap",
-                                                            "(IILandroid/graphics/Bitmap$Config;)Landroid/graphics/Bitmap;");
-    jstring configName = env->NewStringUTF("ARGB_8888");
-    jclass bitmapConfigClass = env->FindClass("android/graphics/Bitmap$Config");
-    jmethodID valueOfBitmapConfigFunction = env->GetStaticMethodID(
-        bitmapConfigClass, "valueOf",
-        "(Ljava/lang/String;)Landroid/graphics/Bitmap$Config;");
-    jobject bitmapConfig = env->CallStaticObjectMethod(bitmapConfigClass, valueOfBitmapConfigFunction, configName);
-    jobject newBitmap = env->CallStaticObjectMethod(bitmapCls,
-                                                    createBitmapFunction, jniBitmap->_bitmapInfo.width,
-                                                    jniBitmap->_bitmapInfo.height, bitmapConfig);
+    uint32_t width = jniBitmap->_bitmapInfo.width, height = jniBitmap->_bitmapInfo.height;
+    jobject bitmapConfig = bitmapConfigOf(jniBitmap->_bitmapInfo.format);
+    if (bitmapConfig == NULL)
+    {
+        LOGE("Bitmap format %d is not available!", jniBitmap->_bitmapInfo.format);
+        return NULL;
+    }
+    jobject newBitmap = env->CallStaticObjectMethod(g_bitmapClass, g_createBitmapMethod, width, height, bitmapConfig);
+    if (newBitmap == NULL)
+        return NULL;
     //
     // putting the pixels into the new bitmap:
     //
     int ret;
+    AndroidBitmapInfo bitmapInfo;
     void *bitmapPixels;
-    if ((ret = AndroidBitmap_lockPixels(env, newBitmap, &bitmapPixels)) < 0)
+    if ((ret = AndroidBitmap_getInfo(env, newBitmap, &bitmapInfo)) < 0 ||
+        (ret = AndroidBitmap_lockPixels(env, newBitmap, &bitmapPixels)) < 0)
     {
         LOGE("AndroidBitmap_lockPixels() failed ! error=%d", ret);
         return NULL;
     }
-    uint32_t *newBitmapPixels = (uint32_t *)bitmapPixels;
-    int pixelsCount = jniBitmap->_bitmapInfo.height * jniBitmap->_bitmapInfo.width;
-    memcpy(newBitmapPixels, jniBitmap->_storedBitmapPixels, sizeof(uint32_t) * pixelsCount);
+    copyRows(jniBitmap->_storedBitmapPixels, jniBitmap->_bitmapInfo.stride, (uint8_t *)bitmapPixels, bitmapInfo.stride,
+             width * bytesPerPixel(jniBitmap->_bitmapInfo.format), height);
     AndroidBitmap_unlockPixels(env, newBitmap);
     // LOGD("returning the new bitmap");
     return newBitmap;
 }
 
-/**store java bitmap as JNI data*/
+/**store java bitmap as JNI data. RGBA_8888, RGB_565, RGBA_F16 and A_8 are supported*/
 JNIEXPORT jobject JNICALL SetBitmapData(JNIEnv *env, jobject obj, jobject bitmap)
 {
     AndroidBitmapInfo bitmapInfo;
-    uint32_t *storedBitmapPixels = NULL;
     // LOGD("reading bitmap info...");
     int ret;
     if ((ret = AndroidBitmap_getInfo(env, bitmap, &bitmapInfo)) < 0)
@@ -210,13 +468,14 @@ JNIEXPORT jobject JNICALL SetBitmapData(JNIEnv *env, jobject obj, jobject bitmap
         return NULL;
     }
     // LOGD("width:%d height:%d stride:%d", bitmapInfo.width, bitmapInfo.height, bitmapInfo.stride);
-    if (bitmapInfo.format != ANDROID_BITMAP_FORMAT_RGBA_8888)
+    uint32_t bytes = bytesPerPixel(bitmapInfo.format);
+    if (bytes == 0)
     {
-        LOGE("Bitmap format is not RGBA_8888!");
+        LOGE("Bitmap format %d is not supported!", bitmapInfo.format);
         return NULL;
     }
     //
-    // read pixels of bitmap into native memory :
+    // read pixels of bitmap into native memory, without the padding of the rows :
     //
     // LOGD("reading bitmap pixels...");
     void *bitmapPixels;
@@ -225,54 +484,60 @@ JNIEXPORT jobject JNICALL SetBitmapData(JNIEnv *env, jobject obj, jobject bitmap
         LOGE("AndroidBitmap_lockPixels() failed ! error=%d", ret);
         return NULL;
     }
-    uint32_t *src = (uint32_t *)bitmapPixels;
-    storedBitmapPixels = new uint32_t[bitmapInfo.height * bitmapInfo.width];
-    int pixelsCount = bitmapInfo.height * bitmapInfo.width;
-    memcpy(storedBitmapPixels, src, sizeof(uint32_t) * pixelsCount);
+    uint32_t rowSize = bitmapInfo.width * bytes;
+    uint8_t *storedBitmapPixels = new uint8_t[(size_t)rowSize * bitmapInfo.height];
+    copyRows((uint8_t *)bitmapPixels, bitmapInfo.stride, storedBitmapPixels, rowSize, rowSize, bitmapInfo.height);
     AndroidBitmap_unlockPixels(env, bitmap);
     JniBitmap *jniBitmap = new JniBitmap();
     jniBitmap->_bitmapInfo = bitmapInfo;
+    jniBitmap->_bitmapInfo.stride = rowSize;
     jniBitmap->_storedBitmapPixels = storedBitmapPixels;
     return env->NewDirectByteBuffer(jniBitmap, 0);
 }
 
+/**
+ * keep a reference to a mutable java bitmap instead of copying its pixels, in any format SetBitmapData supports.
+ * flips and rotate 180 modify the bitmap itself, see JniBitmap.
+ */
+JNIEXPORT jobject JNICALL AttachBitmapData(JNIEnv *env, jobject obj, jobject bitmap)
+{
+    AndroidBitmapInfo bitmapInfo;
+    int ret;
+    if ((ret = AndroidBitmap_getInfo(env, bitmap, &bitmapInfo)) < 0)
+    {
+        LOGE("AndroidBitmap_getInfo() failed ! error=%d", ret);
+        return NULL;
+    }
+    if (bytesPerPixel(bitmapInfo.format) == 0)
+    {
+        LOGE("Bitmap format %d is not supported!", bitmapInfo.format);
+        return NULL;
+    }
+    JniBitmap *jniBitmap = new JniBitmap();
+    jniBitmap->_bitmapInfo = bitmapInfo;
+    jniBitmap->_attachedBitmap = env->NewGlobalRef(bitmap);
+    return env->NewDirectByteBuffer(jniBitmap, 0);
+}
+
+/** the scale sizes arrive as jint, a non-positive one would divide by zero or wrap to a huge allocation */
+static bool isValidScaleSize(uint32_t newWidth, uint32_t newHeight)
+{
+    if ((int32_t)newWidth > 0 && (int32_t)newHeight > 0)
+        return true;
+    LOGE("Invalid scale size: %dx%d", (int32_t)newWidth, (int32_t)newHeight);
+    return false;
+}
+
 /**scales the image using the fastest, simplest algorithm called "nearest neighbor" */ //
 JNIEXPORT void JNICALL ScaleNNBitmap(JNIEnv *env, jobject obj,
                                      jobject handle,
                                      uint32_t newWidth, uint32_t newHeight)
 {
-    JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
-    if (jniBitmap == NULL || jniBitmap->_storedBitmapPixels == NULL)
+    JniBitmap *jniBitmap = getStoredBitmap(env, handle);
+    if (jniBitmap == NULL || !isValidScaleSize(newWidth, newHeight))
         return;
-    uint32_t oldWidth = jniBitmap->_bitmapInfo.width;
-    uint32_t oldHeight = jniBitmap->_bitmapInfo.height;
-    uint32_t *previousData = jniBitmap->_storedBitmapPixels;
-    uint32_t *newBitmapPixels = new uint32_t[newWidth * newHeight];
-    int x2, y2;
-    int whereToPut = 0;
-    for (int y = 0; y < newHeight; ++y)
-    {
-        for (int x = 0; x < newWidth; ++x)
-        {
-            x2 = x * oldWidth / newWidth;
-            if (x2 < 0)
-                x2 = 0;
-            else if (x2 >= oldWidth)
-                x2 = oldWidth - 1;
-            y2 = y * oldHeight / newHeight;
-            if (y2 < 0)
-                y2 = 0;
-            else if (y2 >= oldHeight)
-                y2 = oldHeight - 1;
-            newBitmapPixels[whereToPut++] = previousData[(y2 * oldWidth) + x2];
-            // same as : newBitmapPixels[(y * newWidth) + x] = previousData[(y2 * oldWidth) + x2];
-        }
-    }
-
-    delete[] previousData;
-    jniBitmap->_storedBitmapPixels = newBitmapPixels;
-    jniBitmap->_bitmapInfo.width = newWidth;
-    jniBitmap->_bitmapInfo.height = newHeight;
+    ScaleNN scale = {newWidth, newHeight, jniBitmap->_workers};
+    replacePixels(jniBitmap, newWidth, newHeight, scale);
 }
 
 /**scales the image using a high-quality algorithm called "Bilinear Interpolation"
@@ -283,100 +548,53 @@ JNIEXPORT void JNICALL ScaleBIBitmap(JNIEnv *env, jobject obj,
                                      jobject handle,
                                      uint32_t newWidth, uint32_t newHeight)
 {
-    JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
-    if (jniBitmap == NULL || jniBitmap->_storedBitmapPixels == NULL)
+    JniBitmap *jniBitmap = getStoredBitmap(env, handle);
+    if (jniBitmap == NULL || !isValidScaleSize(newWidth, newHeight))
+        return;
+    ScaleFiltered scale = {newWidth, newHeight, kScaleFilterBilinear, jniBitmap->_workers};
+    replacePixels(jniBitmap, newWidth, newHeight, scale);
+}
+
+/** scales the image with a separable filter: 0 bilinear, 1 box (area average) or 2 lanczos3, see BitmapScaler.h */
+JNIEXPORT void JNICALL ScaleFilteredBitmap(JNIEnv *env, jobject obj,
+                                           jobject handle,
+                                           uint32_t newWidth, uint32_t newHeight, jint filter)
+{
+    JniBitmap *jniBitmap = getStoredBitmap(env, handle);
+    if (jniBitmap == NULL || !isValidScaleSize(newWidth, newHeight))
+        return;
+    if (filter < kScaleFilterBilinear || filter > kScaleFilterLanczos3)
+    {
+        LOGE("Unknown scale filter: %d", filter);
         return;
-    uint32_t oldWidth = jniBitmap->_bitmapInfo.width;
-    uint32_t oldHeight = jniBitmap->_bitmapInfo.height;
-    uint32_t *previousData = jniBitmap->_storedBitmapPixels;
-    uint32_t *newBitmapPixels = new uint32_t[newWidth * newHeight];
-    // position of the top left pixel of the 4 pixels to use interpolation on
-    int xTopLeft, yTopLeft;
-    int x, y, lastTopLefty;
-    float xRatio = (float)newWidth / (float)oldWidth;
-    float yratio = (float)newHeight / (float)oldHeight;
-    // Y color ratio to use on left and right pixels for interpolation
-    float ycRatio2 = 0, ycRatio1 = 0;
-    // pixel target in the src
-    float xt, yt;
-    // X color ratio to use on left and right pixels for interpolation
-    float xcRatio2 = 0, xcratio1 = 0;
-    ARGB rgbTopLeft, rgbTopRight, rgbBottomLeft, rgbBottomRight, rgbTopMiddle,
-        rgbBottomMiddle, result;
-    for (x = 0; x < newWidth; ++x)
-    {
-        xTopLeft = (int)(xt = x / xRatio);
-        // when meeting the most right edge, move left a little
-        if (xTopLeft >= oldWidth - 1)
-            xTopLeft--;
-        if (xt <= xTopLeft + 1)
-        {
-            // we are between the left and right pixel
-            xcratio1 = xt - xTopLeft;
-            // color ratio in favor of the right pixel color
-            xcRatio2 = 1 - xcratio1;
-        }
-        for (y = 0, lastTopLefty = -30000; y < newHeight; ++y)
-        {
-            yTopLeft = (int)(yt = y / yratio);
-            // when meeting the most bottom edge, move up a little
-            if (yTopLeft >= oldHeight - 1)
-                --yTopLeft;
-            if (lastTopLefty == yTopLeft - 1)
-            {
-                // we went down only one rectangle
-                rgbTopLeft = rgbBottomLeft;
-                rgbTopRight = rgbBottomRight;
-                rgbTopMiddle = rgbBottomMiddle;
-                // rgbBottomLeft=startingImageData[xTopLeft][yTopLeft+1];
-                convertIntToArgb(previousData[((yTopLeft + 1) * oldWidth) + xTopLeft], &rgbBottomLeft);
-                // rgbBottomRight=startingImageData[xTopLeft+1][yTopLeft+1];
-                convertIntToArgb(previousData[((yTopLeft + 1) * oldWidth) + (xTopLeft + 1)], &rgbBottomRight);
-                rgbBottomMiddle.alpha = rgbBottomLeft.alpha * xcRatio2 + rgbBottomRight.alpha * xcratio1;
-                rgbBottomMiddle.red = rgbBottomLeft.red * xcRatio2 + rgbBottomRight.red * xcratio1;
-                rgbBottomMiddle.green = rgbBottomLeft.green * xcRatio2 + rgbBottomRight.green * xcratio1;
-                rgbBottomMiddle.blue = rgbBottomLeft.blue * xcRatio2 + rgbBottomRight.blue * xcratio1;
-            }
-            else if (lastTopLefty != yTopLeft)
-            {
-                // we went to a totally different rectangle (happens in every loop start,and might happen more when making the picture smaller)
-                // rgbTopLeft=startingImageData[xTopLeft][yTopLeft];
-                convertIntToArgb(previousData[(yTopLeft * oldWidth) + xTopLeft], &rgbTopLeft);
-                // rgbTopRight=startingImageData[xTopLeft+1][yTopLeft];
-                convertIntToArgb(previousData[(yTopLeft * oldWidth) + xTopLeft + 1], &rgbTopRight);
-                rgbTopMiddle.alpha = rgbTopLeft.alpha * xcRatio2 + rgbTopRight.alpha * xcratio1;
-                rgbTopMiddle.red = rgbTopLeft.red * xcRatio2 + rgbTopRight.red * xcratio1;
-                rgbTopMiddle.green = rgbTopLeft.green * xcRatio2 + rgbTopRight.green * xcratio1;
-                rgbTopMiddle.blue = rgbTopLeft.blue * xcRatio2 + rgbTopRight.blue * xcratio1;
-                // rgbBottomLeft=startingImageData[xTopLeft][yTopLeft+1];
-                convertIntToArgb(previousData[((yTopLeft + 1) * oldWidth) + xTopLeft], &rgbBottomLeft);
-                // rgbBottomRight=startingImageData[xTopLeft+1][yTopLeft+1];
-                convertIntToArgb(previousData[((yTopLeft + 1) * oldWidth) + (xTopLeft + 1)], &rgbBottomRight);
-                rgbBottomMiddle.alpha = rgbBottomLeft.alpha * xcRatio2 + rgbBottomRight.alpha * xcratio1;
-                rgbBottomMiddle.red = rgbBottomLeft.red * xcRatio2 + rgbBottomRight.red * xcratio1;
-                rgbBottomMiddle.green = rgbBottomLeft.green * xcRatio2 + rgbBottomRight.green * xcratio1;
-                rgbBottomMiddle.blue = rgbBottomLeft.blue * xcRatio2 + rgbBottomRight.blue * xcratio1;
-            }
-            lastTopLefty = yTopLeft;
-            if (yt <= yTopLeft + 1)
-            {
-                // color ratio in favor of the bottom pixel color
-                ycRatio1 = yt - yTopLeft;
-                ycRatio2 = 1 - ycRatio1;
-            }
-            // prepared all pixels to look at, so finally set the new pixel data
-            result.alpha = rgbTopMiddle.alpha * ycRatio2 + rgbBottomMiddle.alpha * ycRatio1;
-            result.blue = rgbTopMiddle.blue * ycRatio2 + rgbBottomMiddle.blue * ycRatio1;
-            result.red = rgbTopMiddle.red * ycRatio2 + rgbBottomMiddle.red * ycRatio1;
-            result.green = rgbTopMiddle.green * ycRatio2 + rgbBottomMiddle.green * ycRatio1;
-            newBitmapPixels[(y * newWidth) + x] = convertArgbToInt(result);
-        }
     }
-    // get rid of old data, and replace it with new one
-    delete[] previousData;
-    jniBitmap->_storedBitmapPixels = newBitmapPixels;
-    jniBitmap->_bitmapInfo.width = newWidth;
-    jniBitmap->_bitmapInfo.height = newHeight;
+    ScaleFiltered scale = {newWidth, newHeight, (ScaleFilter)filter, jniBitmap->_workers};
+    replacePixels(jniBitmap, newWidth, newHeight, scale);
+}
+
+/**
+ * applies the operations encoded as described in OperationChain.h in one pass into one new pixel buffer.
+ * returns false and leaves the bitmap untouched if they are malformed or out of bounds.
+ */
+JNIEXPORT jboolean JNICALL ApplyOperations(JNIEnv *env, jobject obj, jobject handle, jintArray operations)
+{
+    JniBitmap *jniBitmap = getStoredBitmap(env, handle);
+    if (jniBitmap == NULL)
+        return JNI_FALSE;
+    jsize length = env->GetArrayLength(operations);
+    jint *codes = env->GetIntArrayElements(operations, NULL);
+    OperationChain chain;
+    bool composed = composeOperations(codes, length, jniBitmap->_bitmapInfo.width, jniBitmap->_bitmapInfo.height,
+                                      &chain);
+    env->ReleaseIntArrayElements(operations, codes, JNI_ABORT);
+    if (!composed)
+    {
+        LOGE("Invalid bitmap operations.");
+        return JNI_FALSE;
+    }
+    ExecuteOperations execute = {&chain, jniBitmap->_workers};
+    replacePixels(jniBitmap, chain.width, chain.height, execute);
+    return JNI_TRUE;
 }
 
 /** flips a bitmap horizontally, as such:
@@ -389,24 +607,15 @@ JNIEXPORT void JNICALL ScaleBIBitmap(JNIEnv *env, jobject obj,
 JNIEXPORT void JNICALL FlipBitmapHorizontal(JNIEnv *env, jobject obj, jobject handle)
 {
     JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
-    if (jniBitmap == NULL || jniBitmap->_storedBitmapPixels == NULL)
+    if (jniBitmap == NULL)
         return;
-    uint32_t *previousData = jniBitmap->_storedBitmapPixels;
-    int width = jniBitmap->_bitmapInfo.width, middle = width / 2, height = jniBitmap->_bitmapInfo.height;
-    for (int y = 0; y < height; ++y)
-    {
-        // for each row, switch between the first pixels and the last ones
-        uint32_t *idx1 = previousData + width * y;
-        uint32_t *idx2 = previousData + width * (y + 1) - 1;
-        for (int x = 0; x < middle; ++x)
-        {
-            uint32_t pixel = *idx1; // pixel= previousData[rowStart + x];
-            *idx1 = *idx2;          // previousData[rowStart + x] =previousData[rowStart + (width - x - 1)];
-            *idx2 = pixel;          // previousData[rowStart + (width - x - 1)] = pixel;
-            ++idx1;
-            --idx2;
-        }
-    }
+    void *pixels = lockBitmapPixels(env, jniBitmap);
+    if (pixels == NULL)
+        return;
+    FlipHorizontal flip = {jniBitmap->_bitmapInfo.width, jniBitmap->_bitmapInfo.height, jniBitmap->_bitmapInfo.stride,
+                           jniBitmap->_workers};
+    modifyPixels(jniBitmap->_bitmapInfo.format, pixels, flip);
+    unlockBitmapPixels(env, jniBitmap);
 }
 
 /** flips a bitmap vertically, as such:
@@ -418,42 +627,62 @@ JNIEXPORT void JNICALL FlipBitmapHorizontal(JNIEnv *env, jobject obj, jobject ha
 JNIEXPORT void JNICALL FlipBitmapVertical(JNIEnv *env, jobject obj, jobject handle)
 {
     JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
-    if (jniBitmap == NULL || jniBitmap->_storedBitmapPixels == NULL)
+    if (jniBitmap == NULL)
         return;
-    uint32_t *previousData = jniBitmap->_storedBitmapPixels;
-    int width = jniBitmap->_bitmapInfo.width, height = jniBitmap->_bitmapInfo.height, middle = height / 2;
-    for (int y = 0; y < middle; ++y)
-    {
-        // for each row till the middle row, switch its pixels with the one at the bottom
-        uint32_t *idx1 = previousData + width * y;
-        uint32_t *idx2 = previousData + width * (height - y - 1);
-        for (int x = 0; x < width; ++x)
-        {
-            uint32_t pixel = *idx1;
-            *idx1 = *idx2;
-            *idx2 = pixel;
-            ++idx2;
-            ++idx1;
-        }
-    }
+    void *pixels = lockBitmapPixels(env, jniBitmap);
+    if (pixels == NULL)
+        return;
+    FlipVertical flip = {jniBitmap->_bitmapInfo.width, jniBitmap->_bitmapInfo.height, jniBitmap->_bitmapInfo.stride,
+                         jniBitmap->_workers};
+    modifyPixels(jniBitmap->_bitmapInfo.format, pixels, flip);
+    unlockBitmapPixels(env, jniBitmap);
+}
+
+/**
+ * runs the following operations of the bitmap on [threadCount] threads, the calling one included.
+ * 0 or 1 runs them on the calling thread only, which is the default.
+ */
+JNIEXPORT void JNICALL SetThreadCount(JNIEnv *env, jobject obj, jobject handle, jint threadCount)
+{
+    JniBitmap *jniBitmap = (JniBitmap *)env->GetDirectBufferAddress(handle);
+    if (jniBitmap == NULL)
+        return;
+    jniBitmap->_workers = workerPoolFor(threadCount);
 }
 
 // =============================
 
 static JNINativeMethod methods[] = {
         {"setBitmapData",                 "(Landroid/graphics/Bitmap;)Ljava/nio/ByteBuffer;", (void *) SetBitmapData},
+        {"attachBitmapData",              "(Landroid/graphics/Bitmap;)Ljava/nio/ByteBuffer;", (void *) AttachBitmapData},
         {"getBitmapFromSavedBitmapData",  "(Ljava/nio/ByteBuffer;)Landroid/graphics/Bitmap;", (void *) GetBitmapFromSavedBitmapData},
         {"freeBitmapData",                "(Ljava/nio/ByteBuffer;)V",                         (void *) FreeBitmapData},
-        {"rotateBitmapCcw90",             "(Ljava/nio/ByteBuffer;)V",                         (void *) RotateBitmapCcw90},
-        {"rotateBitmapCw90",              "(Ljava/nio/ByteBuffer;)V",                         (void *) RotateBitmapCw90},
+        {"rotateBitmapCcw90",             "(Ljava/nio/ByteBuffer;Z)V",                        (void *) RotateBitmapCcw90},
+        {"rotateBitmapCw90",              "(Ljava/nio/ByteBuffer;Z)V",                        (void *) RotateBitmapCw90},
         {"rotateBitmap180",               "(Ljava/nio/ByteBuffer;)V",                         (void *) RotateBitmap180},
         {"cropBitmap",                    "(Ljava/nio/ByteBuffer;IIII)V",                     (void *) CropBitmap},
         {"scaleNNBitmap",                 "(Ljava/nio/ByteBuffer;II)V",                       (void *) ScaleNNBitmap},
         {"scaleBIBitmap",                 "(Ljava/nio/ByteBuffer;II)V",                       (void *) ScaleBIBitmap},
+        {"scaleFilteredBitmap",           "(Ljava/nio/ByteBuffer;III)V",                      (void *) ScaleFilteredBitmap},
+        {"applyOperations",               "(Ljava/nio/ByteBuffer;[I)Z",                       (void *) ApplyOperations},
         {"flipBitmapHorizontal",          "(Ljava/nio/ByteBuffer;)V",                         (void *) FlipBitmapHorizontal},
         {"flipBitmapVertical",            "(Ljava/nio/ByteBuffer;)V",                         (void *) FlipBitmapVertical},
+        {"setThreadCount",                "(Ljava/nio/ByteBuffer;I)V",                        (void *) SetThreadCount},
 };
 
+/** a global reference to the constant [name] of Bitmap.Config, NULL if this Android version doesn't have it */
+static jobject getBitmapConfig(JNIEnv *env, jclass bitmapConfigCls, const char *name)
+{
+    jfieldID field = env->GetStaticFieldID(bitmapConfigCls, name, "Landroid/graphics/Bitmap$Config;");
+    if (field == nullptr)
+    {
+        // RGBA_F16 was added in Android 8.0
+        env->ExceptionClear();
+        return NULL;
+    }
+    return env->NewGlobalRef(env->GetStaticObjectField(bitmapConfigCls, field));
+}
+
 JNIEXPORT jint JNI_OnLoad(JavaVM *vm, __attribute__((unused)) void *reserved)
 {
     JNIEnv *env;
@@ -474,5 +703,27 @@ JNIEXPORT jint JNI_OnLoad(JavaVM *vm, __attribute__((unused)) void *reserved)
         return JNI_ERR;
     }
 
+    jclass bitmapCls = env->FindClass("android/graphics/Bitmap");
+    jclass bitmapConfigCls = env->FindClass("android/graphics/Bitmap$Config");
+    if (bitmapCls == nullptr || bitmapConfigCls == nullptr)
+    {
+        return JNI_ERR;
+    }
+    g_createBitmapMethod = env->GetStaticMethodID(bitmapCls, "createBitmap",
+                                                  "(IILandroid/graphics/Bitmap$Config;)Landroid/graphics/Bitmap;");
+    if (g_createBitmapMethod == nullptr)
+    {
+        return JNI_ERR;
+    }
+    g_bitmapClass = (jclass)env->NewGlobalRef(bitmapCls);
+    g_argb8888Config = getBitmapConfig(env, bitmapConfigCls, "ARGB_8888");
+    g_rgb565Config = getBitmapConfig(env, bitmapConfigCls, "RGB_565");
+    g_rgbaF16Config = getBitmapConfig(env, bitmapConfigCls, "RGBA_F16");
+    g_alpha8Config = getBitmapConfig(env, bitmapConfigCls, "ALPHA_8");
+    if (g_argb8888Config == NULL)
+    {
+        return JNI_ERR;
+    }
+
     return JNI_VERSION_1_6;
 }
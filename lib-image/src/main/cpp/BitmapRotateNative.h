@@ -7,6 +7,10 @@
 #include <android/bitmap.h>
 #include <cstring>
 #include <unistd.h>
+#include "BitmapScaler.h"
+#include "OperationChain.h"
+#include "BitmapTransform.h"
+#include "WorkerPool.h"
 
 #define LOG_TAG "LEO-Native-Bitmap"
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
@@ -20,6 +24,9 @@ extern "C"
     // set
     JNIEXPORT jobject JNICALL SetBitmapData(JNIEnv *env, jobject obj, jobject bitmap);
 
+    // attach a mutable java bitmap without copying its pixels, see JniBitmap
+    JNIEXPORT jobject JNICALL AttachBitmapData(JNIEnv *env, jobject obj, jobject bitmap);
+
     // get
     JNIEXPORT jobject JNICALL GetBitmapFromSavedBitmapData(JNIEnv *env, jobject obj, jobject handle);
 
@@ -27,10 +34,10 @@ extern "C"
     JNIEXPORT void JNICALL FreeBitmapData(JNIEnv *env, jobject obj, jobject handle);
 
     // rotate 90 degrees CCW
-    JNIEXPORT void JNICALL RotateBitmapCcw90(JNIEnv *env, jobject obj, jobject handle);
+    JNIEXPORT void JNICALL RotateBitmapCcw90(JNIEnv *env, jobject obj, jobject handle, jboolean inPlace);
 
     // rotate 90 degrees CW
-    JNIEXPORT void JNICALL RotateBitmapCw90(JNIEnv *env, jobject obj, jobject handle);
+    JNIEXPORT void JNICALL RotateBitmapCw90(JNIEnv *env, jobject obj, jobject handle, jboolean inPlace);
 
     // rotate 180 degrees
     JNIEXPORT void JNICALL RotateBitmap180(JNIEnv *env, jobject obj, jobject handle);
@@ -50,29 +57,49 @@ extern "C"
                                          jobject handle,
                                          uint32_t newWidth, uint32_t newHeight);
 
+    // scale using one of the ScaleFilter of BitmapScaler.h
+    JNIEXPORT void JNICALL ScaleFilteredBitmap(JNIEnv *env, jobject obj,
+                                               jobject handle,
+                                               uint32_t newWidth, uint32_t newHeight, jint filter);
+
+    // apply a list of operations in one pass, see OperationChain.h
+    JNIEXPORT jboolean JNICALL ApplyOperations(JNIEnv *env, jobject obj, jobject handle, jintArray operations);
+
     JNIEXPORT void JNICALL FlipBitmapHorizontal(JNIEnv *env, jobject obj, jobject handle);
 
     JNIEXPORT void JNICALL FlipBitmapVertical(JNIEnv *env, jobject obj, jobject handle);
 
+    // the number of threads the operations of the bitmap run on, see WorkerPool.h
+    JNIEXPORT void JNICALL SetThreadCount(JNIEnv *env, jobject obj, jobject handle, jint threadCount);
+
 #ifdef __cplusplus
 }
 #endif
 
+/**
+ * the pixels are either a native copy of the bitmap, or, once attached, the locked pixels of the java bitmap itself.
+ * _bitmapInfo.format tells their pixel type and _bitmapInfo.stride the bytes between two rows,
+ * the native copy has no padding.
+ * the operations keeping the size (flips, rotate 180) work directly on the attached bitmap,
+ * the first one changing the size copies its pixels into native memory and detaches it.
+ * _workers runs the operations in bands of rows, it is shared by all the bitmaps with the same thread count.
+ */
 class JniBitmap
 {
 public:
-    uint32_t *_storedBitmapPixels;
+    uint8_t *_storedBitmapPixels;
     AndroidBitmapInfo _bitmapInfo;
+    // global reference, or NULL when not attached
+    jobject _attachedBitmap;
+    // NULL to run on the calling thread
+    WorkerPool *_workers;
 
     JniBitmap()
     {
         _storedBitmapPixels = NULL;
+        _attachedBitmap = NULL;
+        _workers = NULL;
     }
 };
 
-typedef struct
-{
-    uint8_t alpha, red, green, blue;
-} ARGB;
-
 #endif // LEOANDROIDBASEUTIL_BITMAPROTATE_H
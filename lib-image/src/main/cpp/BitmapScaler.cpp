@@ -0,0 +1,715 @@
+#include "BitmapScaler.h"
+#include "WorkerPool.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SCALER_HAS_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCALER_HAS_NEON 1
+#endif
+
+// weights are fixed point numbers with 14 fractional bits, so a pixel times a weight fits in 16 + 8 bits
+// and the sum of any realistic number of taps fits in 32 bits.
+static const int kPrecisionBits = 14;
+static const int32_t kRounding = 1 << (kPrecisionBits - 1);
+
+// --------------------
+// Filters.
+// --------------------
+
+static double bilinearFilter(double x)
+{
+    x = fabs(x);
+    return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+static double boxFilter(double x)
+{
+    return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+}
+
+static double sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+static double lanczos3Filter(double x)
+{
+    return x > -3.0 && x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+}
+
+// --------------------
+// Coefficients.
+// --------------------
+
+/**
+ * the source pixels and weights of every output pixel along one axis.
+ * output pixel i reads counts[i] pixels from starts[i] with the weights from i * taps.
+ */
+struct ScaleCoefficients
+{
+    uint32_t taps;
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> counts;
+    std::vector<int16_t> weights;
+};
+
+static void computeCoefficients(uint32_t srcSize, uint32_t dstSize, ScaleFilter filter, ScaleCoefficients *coefficients)
+{
+    double (*function)(double) = lanczos3Filter;
+    double support = 3.0;
+    if (filter == kScaleFilterBilinear)
+    {
+        function = bilinearFilter;
+        support = 1.0;
+    }
+    else if (filter == kScaleFilterBox)
+    {
+        function = boxFilter;
+        support = 0.5;
+    }
+
+    double scale = (double)srcSize / dstSize;
+    // stretch the filter over the source pixels covered by one output pixel when downscaling
+    double filterScale = scale > 1.0 ? scale : 1.0;
+    support *= filterScale;
+    uint32_t taps = (uint32_t)ceil(support) * 2 + 1;
+
+    coefficients->taps = taps;
+    coefficients->starts.assign(dstSize, 0);
+    coefficients->counts.assign(dstSize, 0);
+    coefficients->weights.assign((size_t)dstSize * taps, 0);
+    std::vector<double> weights(taps);
+    for (uint32_t i = 0; i < dstSize; ++i)
+    {
+        // pixel centers are at half integers
+        double center = (i + 0.5) * scale;
+        double first = floor(center - support + 0.5);
+        double last = floor(center + support + 0.5);
+        if (first < 0.0)
+            first = 0.0;
+        if (last > srcSize)
+            last = srcSize;
+        uint32_t start = (uint32_t)first;
+        uint32_t count = (uint32_t)(last - first);
+        if (count > taps)
+            count = taps;
+
+        double sum = 0.0;
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            weights[k] = function((start + k - center + 0.5) / filterScale);
+            sum += weights[k];
+        }
+        int16_t *fixed = &coefficients->weights[(size_t)i * taps];
+        int32_t fixedSum = 0;
+        uint32_t largest = 0;
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            double w = sum != 0.0 ? weights[k] / sum : 0.0;
+            fixed[k] = (int16_t)lround(w * (1 << kPrecisionBits));
+            fixedSum += fixed[k];
+            if (fixed[k] > fixed[largest])
+                largest = k;
+        }
+        // let the rounding error go to the largest weight, so flat areas keep their exact color
+        fixed[largest] = (int16_t)(fixed[largest] + (1 << kPrecisionBits) - fixedSum);
+        coefficients->starts[i] = start;
+        coefficients->counts[i] = count;
+    }
+}
+
+// --------------------
+// Kernels.
+//
+// The horizontal pass computes one output pixel from [count] consecutive source pixels,
+// the vertical pass one output row from [count] source rows.
+// --------------------
+
+static inline uint8_t clampChannel(int32_t value)
+{
+    value >>= kPrecisionBits;
+    return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+#if SCALER_HAS_SSE2
+/** two 16-bit weights as the (w0, w1) pairs multiplied by _mm_madd_epi16 */
+static inline __m128i weightPair(int16_t w0, int16_t w1)
+{
+    return _mm_set1_epi32((int32_t)((uint32_t)(uint16_t)w0 | ((uint32_t)(uint16_t)w1 << 16)));
+}
+
+/** 4 x 32-bit sums to 4 clamped channels */
+static inline uint32_t packPixel(__m128i sum)
+{
+    sum = _mm_srai_epi32(sum, kPrecisionBits);
+    sum = _mm_packs_epi32(sum, sum);
+    return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+}
+
+static inline uint32_t filterPixels(const uint32_t *src, uint32_t count, const int16_t *weights)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_set1_epi32(kRounding);
+    uint32_t k = 0;
+    for (; k + 3 < count; k += 4)
+    {
+        // p0c0 p1c0 p0c1 p1c1 ... and p2c0 p3c0 ... as 16-bit
+        __m128i p = _mm_loadu_si128((const __m128i *)(src + k));
+        __m128i p01 = _mm_unpacklo_epi8(p, zero);
+        __m128i p23 = _mm_unpackhi_epi8(p, zero);
+        p01 = _mm_unpacklo_epi16(p01, _mm_srli_si128(p01, 8));
+        p23 = _mm_unpacklo_epi16(p23, _mm_srli_si128(p23, 8));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(p01, weightPair(weights[k], weights[k + 1])));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(p23, weightPair(weights[k + 2], weights[k + 3])));
+    }
+    for (; k + 1 < count; k += 2)
+    {
+        __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(src + k)), zero);
+        p = _mm_unpacklo_epi16(p, _mm_srli_si128(p, 8));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(p, weightPair(weights[k], weights[k + 1])));
+    }
+    if (k < count)
+    {
+        __m128i p = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int32_t)src[k]), zero);
+        p = _mm_unpacklo_epi16(p, zero);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(p, weightPair(weights[k], 0)));
+    }
+    return packPixel(sum);
+}
+
+static void filterRows(const uint32_t *const *rows, uint32_t count, const int16_t *weights, uint32_t width, uint32_t *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(kRounding);
+    uint32_t x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i sum0 = rounding, sum1 = rounding, sum2 = rounding, sum3 = rounding;
+        for (uint32_t k = 0; k < count; k += 2)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + x));
+            __m128i b = zero;
+            __m128i w = weightPair(weights[k], 0);
+            if (k + 1 < count)
+            {
+                b = _mm_loadu_si128((const __m128i *)(rows[k + 1] + x));
+                w = weightPair(weights[k], weights[k + 1]);
+            }
+            // a0 b0 a1 b1 ... so every 16-bit pair is multiplied by (w0, w1)
+            __m128i lo = _mm_unpacklo_epi8(a, b);
+            __m128i hi = _mm_unpackhi_epi8(a, b);
+            sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+            sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+            sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+            sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+        }
+        __m128i p01 = _mm_packs_epi32(_mm_srai_epi32(sum0, kPrecisionBits), _mm_srai_epi32(sum1, kPrecisionBits));
+        __m128i p23 = _mm_packs_epi32(_mm_srai_epi32(sum2, kPrecisionBits), _mm_srai_epi32(sum3, kPrecisionBits));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(p01, p23));
+    }
+    for (; x < width; ++x)
+    {
+        __m128i sum = rounding;
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            __m128i p = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int32_t)rows[k][x]), zero);
+            p = _mm_unpacklo_epi16(p, zero);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(p, weightPair(weights[k], 0)));
+        }
+        dst[x] = packPixel(sum);
+    }
+}
+#elif SCALER_HAS_NEON
+static inline int16x4_t loadPixel(uint32_t pixel)
+{
+    uint8x8_t p = vreinterpret_u8_u32(vdup_n_u32(pixel));
+    return vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(p)));
+}
+
+/** 4 x 32-bit sums to 4 clamped channels */
+static inline uint32_t packPixel(int32x4_t sum)
+{
+    int16x4_t s = vqshrn_n_s32(sum, kPrecisionBits);
+    return vget_lane_u32(vreinterpret_u32_u8(vqmovun_s16(vcombine_s16(s, s))), 0);
+}
+
+static inline uint32_t filterPixels(const uint32_t *src, uint32_t count, const int16_t *weights)
+{
+    int32x4_t sum = vdupq_n_s32(kRounding);
+    for (uint32_t k = 0; k < count; ++k)
+        sum = vmlal_n_s16(sum, loadPixel(src[k]), weights[k]);
+    return packPixel(sum);
+}
+
+static void filterRows(const uint32_t *const *rows, uint32_t count, const int16_t *weights, uint32_t width, uint32_t *dst)
+{
+    const int32x4_t rounding = vdupq_n_s32(kRounding);
+    uint32_t x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        int32x4_t sum0 = rounding, sum1 = rounding, sum2 = rounding, sum3 = rounding;
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            uint8x16_t p = vld1q_u8((const uint8_t *)(rows[k] + x));
+            int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(p)));
+            int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(p)));
+            sum0 = vmlal_n_s16(sum0, vget_low_s16(lo), weights[k]);
+            sum1 = vmlal_n_s16(sum1, vget_high_s16(lo), weights[k]);
+            sum2 = vmlal_n_s16(sum2, vget_low_s16(hi), weights[k]);
+            sum3 = vmlal_n_s16(sum3, vget_high_s16(hi), weights[k]);
+        }
+        int16x8_t p01 = vcombine_s16(vqshrn_n_s32(sum0, kPrecisionBits), vqshrn_n_s32(sum1, kPrecisionBits));
+        int16x8_t p23 = vcombine_s16(vqshrn_n_s32(sum2, kPrecisionBits), vqshrn_n_s32(sum3, kPrecisionBits));
+        vst1q_u8((uint8_t *)(dst + x), vcombine_u8(vqmovun_s16(p01), vqmovun_s16(p23)));
+    }
+    for (; x < width; ++x)
+    {
+        int32x4_t sum = rounding;
+        for (uint32_t k = 0; k < count; ++k)
+            sum = vmlal_n_s16(sum, loadPixel(rows[k][x]), weights[k]);
+        dst[x] = packPixel(sum);
+    }
+}
+#else
+static inline uint32_t filterPixels(const uint32_t *src, uint32_t count, const int16_t *weights)
+{
+    int32_t sum[4] = {kRounding, kRounding, kRounding, kRounding};
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        const uint8_t *p = (const uint8_t *)(src + k);
+        for (int c = 0; c < 4; ++c)
+            sum[c] += p[c] * weights[k];
+    }
+    uint32_t pixel;
+    uint8_t *out = (uint8_t *)&pixel;
+    for (int c = 0; c < 4; ++c)
+        out[c] = clampChannel(sum[c]);
+    return pixel;
+}
+
+static void filterRows(const uint32_t *const *rows, uint32_t count, const int16_t *weights, uint32_t width, uint32_t *dst)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        int32_t sum[4] = {kRounding, kRounding, kRounding, kRounding};
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            const uint8_t *p = (const uint8_t *)(rows[k] + x);
+            for (int c = 0; c < 4; ++c)
+                sum[c] += p[c] * weights[k];
+        }
+        uint8_t *out = (uint8_t *)(dst + x);
+        for (int c = 0; c < 4; ++c)
+            out[c] = clampChannel(sum[c]);
+    }
+}
+#endif
+
+// A_8 by portable code, which the compiler vectorizes along the rows in the vertical pass.
+
+static inline uint8_t filterPixels(const uint8_t *src, uint32_t count, const int16_t *weights)
+{
+    int32_t sum = kRounding;
+    for (uint32_t k = 0; k < count; ++k)
+        sum += src[k] * weights[k];
+    return clampChannel(sum);
+}
+
+static void filterRows(const uint8_t *const *rows, uint32_t count, const int16_t *weights, uint32_t width, uint8_t *dst)
+{
+    const uint32_t chunk = 256;
+    int32_t sum[chunk];
+    for (uint32_t x0 = 0; x0 < width; x0 += chunk)
+    {
+        uint32_t n = width - x0 < chunk ? width - x0 : chunk;
+        for (uint32_t x = 0; x < n; ++x)
+            sum[x] = kRounding;
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            const uint8_t *row = rows[k] + x0;
+            int32_t w = weights[k];
+            for (uint32_t x = 0; x < n; ++x)
+                sum[x] += row[x] * w;
+        }
+        for (uint32_t x = 0; x < n; ++x)
+            dst[x0 + x] = clampChannel(sum[x]);
+    }
+}
+
+/** RGBA_F16 as 4 floats. values above 1 are kept, this is HDR content */
+struct FloatPixel
+{
+    float c[4];
+};
+
+static inline FloatPixel filterPixels(const FloatPixel *src, uint32_t count, const int16_t *weights)
+{
+    FloatPixel sum = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        float w = weights[k] * (1.0f / (1 << kPrecisionBits));
+        for (int c = 0; c < 4; ++c)
+            sum.c[c] += src[k].c[c] * w;
+    }
+    return sum;
+}
+
+static void filterRows(const FloatPixel *const *rows, uint32_t count, const int16_t *weights, uint32_t width,
+                       FloatPixel *dst)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        for (int c = 0; c < 4; ++c)
+            dst[x].c[c] = 0.0f;
+    }
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        const FloatPixel *row = rows[k];
+        float w = weights[k] * (1.0f / (1 << kPrecisionBits));
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            for (int c = 0; c < 4; ++c)
+                dst[x].c[c] += row[x].c[c] * w;
+        }
+    }
+}
+
+// --------------------
+// Working pixels.
+//
+// The kernels run on working pixels: RGBA_8888 and A_8 as they are, RGB_565 with a byte per channel,
+// so the RGBA_8888 kernels apply, and RGBA_F16 as floats.
+// The other pixels are converted once per row and pass, instead of at every tap.
+// --------------------
+
+template <typename Pixel>
+struct WorkingPixel
+{
+    typedef Pixel Type;
+    static const bool kConverted = false;
+};
+
+template <>
+struct WorkingPixel<uint16_t>
+{
+    typedef uint32_t Type;
+    static const bool kConverted = true;
+};
+
+template <>
+struct WorkingPixel<uint64_t>
+{
+    typedef FloatPixel Type;
+    static const bool kConverted = true;
+};
+
+/** the pixels which are their own working pixels are never converted */
+template <typename Pixel>
+static inline void expandRow(const Pixel *src, uint32_t width, Pixel *dst)
+{
+    memcpy(dst, src, width * sizeof(Pixel));
+}
+
+template <typename Pixel>
+static inline void packRow(const Pixel *src, uint32_t width, Pixel *dst)
+{
+    memcpy(dst, src, width * sizeof(Pixel));
+}
+
+static inline void expandRow(const uint16_t *src, uint32_t width, uint32_t *dst)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        uint32_t p = src[x];
+        dst[x] = (p >> 11) | ((p >> 5) & 0x3f) << 8 | (p & 0x1f) << 16;
+    }
+}
+
+/** the kernels clamp the channels to a byte, lanczos may still overshoot the 5 or 6 bits */
+static inline void packRow(const uint32_t *src, uint32_t width, uint16_t *dst)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        uint32_t p = src[x];
+        uint32_t red = p & 0xff, green = (p >> 8) & 0xff, blue = (p >> 16) & 0xff;
+        red = red > 31 ? 31 : red;
+        green = green > 63 ? 63 : green;
+        blue = blue > 31 ? 31 : blue;
+        dst[x] = (uint16_t)(red << 11 | green << 5 | blue);
+    }
+}
+
+/** IEEE 754 binary16 to float, exact */
+static inline float halfToFloat(uint16_t half)
+{
+    // move exponent and mantissa into place and let a multiplication by 2^112 fix the exponent bias,
+    // which turns the subnormal halves into normal floats as well
+    uint32_t bits = (uint32_t)(half & 0x7fff) << 13;
+    if ((half & 0x7c00) == 0x7c00)
+        bits |= 0x7f800000; // infinity or NaN
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    value *= 5.192296858534828e33f;
+    memcpy(&bits, &value, sizeof(bits));
+    bits |= (uint32_t)(half & 0x8000) << 16;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/** rounds to the nearest even half */
+static inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+    uint16_t half;
+    if (bits >= (127u + 16) << 23)
+    {
+        // too large for a half, or infinity or NaN
+        half = bits > 0x7f800000u ? 0x7e00 : 0x7c00;
+    }
+    else if (bits < 113u << 23)
+    {
+        // subnormal or zero: adding 0.5 aligns the 10 mantissa bits at the bottom, rounded by the FPU
+        const uint32_t magicBits = (127u - 15 + 23 - 10 + 1) << 23;
+        float magic, aligned;
+        memcpy(&magic, &magicBits, sizeof(magic));
+        memcpy(&aligned, &bits, sizeof(aligned));
+        aligned += magic;
+        memcpy(&bits, &aligned, sizeof(bits));
+        half = (uint16_t)(bits - magicBits);
+    }
+    else
+    {
+        uint32_t odd = (bits >> 13) & 1;
+        bits -= 112u << 23; // rebias the exponent
+        bits += 0xfff + odd;
+        half = (uint16_t)(bits >> 13);
+    }
+    return (uint16_t)(half | sign >> 16);
+}
+
+static inline void expandRow(const uint64_t *src, uint32_t width, FloatPixel *dst)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        for (int c = 0; c < 4; ++c)
+            dst[x].c[c] = halfToFloat((uint16_t)(src[x] >> (16 * c)));
+    }
+}
+
+static inline void packRow(const FloatPixel *src, uint32_t width, uint64_t *dst)
+{
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        uint64_t pixel = 0;
+        for (int c = 0; c < 4; ++c)
+            pixel |= (uint64_t)floatToHalf(src[x].c[c]) << (16 * c);
+        dst[x] = pixel;
+    }
+}
+
+/**
+ * the rows of a source as working pixels. converted rows are kept in a ring of [window] rows,
+ * enough for the rows of one output row of the vertical pass, whose starts only grow.
+ */
+template <typename Pixel>
+class RowReader
+{
+public:
+    typedef typename WorkingPixel<Pixel>::Type Work;
+
+    RowReader(const Pixel *pixels, uint32_t width, size_t stride, uint32_t window)
+        : _pixels(pixels), _width(width), _stride(stride), _window(window)
+    {
+        if (WorkingPixel<Pixel>::kConverted)
+        {
+            _rows.resize((size_t)width * window);
+            _cached.assign(window, -1);
+        }
+    }
+
+    const Work *row(uint32_t y)
+    {
+        if (!WorkingPixel<Pixel>::kConverted)
+            return (const Work *)(_pixels + y * _stride);
+        uint32_t slot = y % _window;
+        Work *cached = &_rows[(size_t)slot * _width];
+        if (_cached[slot] != y)
+        {
+            expandRow(_pixels + y * _stride, _width, cached);
+            _cached[slot] = y;
+        }
+        return cached;
+    }
+
+private:
+    const Pixel *_pixels;
+    uint32_t _width;
+    size_t _stride;
+    uint32_t _window;
+    std::vector<Work> _rows;
+    std::vector<int64_t> _cached;
+};
+
+/** the rows of a destination as working pixels, converted by commit() */
+template <typename Pixel>
+class RowWriter
+{
+public:
+    typedef typename WorkingPixel<Pixel>::Type Work;
+
+    RowWriter(Pixel *pixels, uint32_t width, size_t stride) : _pixels(pixels), _width(width), _stride(stride)
+    {
+        if (WorkingPixel<Pixel>::kConverted)
+            _row.resize(width);
+    }
+
+    Work *row(uint32_t y)
+    {
+        return WorkingPixel<Pixel>::kConverted ? _row.data() : (Work *)(_pixels + y * _stride);
+    }
+
+    void commit(uint32_t y)
+    {
+        if (WorkingPixel<Pixel>::kConverted)
+            packRow(_row.data(), _width, _pixels + y * _stride);
+    }
+
+private:
+    Pixel *_pixels;
+    uint32_t _width;
+    size_t _stride;
+    std::vector<Work> _row;
+};
+
+// --------------------
+// Passes.
+// --------------------
+
+/** scales the rows [firstRow, firstRow + height) of [src] into the rows of [dst], in bands of rows */
+template <typename Source, typename Destination>
+static void scaleHorizontally(const Source *src, uint32_t width, size_t srcStride, uint32_t firstRow, uint32_t height,
+                              Destination *dst, size_t dstStride, uint32_t newWidth,
+                              const ScaleCoefficients &coefficients, WorkerPool *workers)
+{
+    forEachBand(workers, height, 1, [&](uint32_t first, uint32_t end) {
+        RowReader<Source> reader(src, width, srcStride, 1);
+        RowWriter<Destination> writer(dst, newWidth, dstStride);
+        for (uint32_t y = first; y < end; ++y)
+        {
+            const typename RowReader<Source>::Work *srcRow = reader.row(firstRow + y);
+            typename RowWriter<Destination>::Work *dstRow = writer.row(y);
+            for (uint32_t x = 0; x < newWidth; ++x)
+            {
+                const int16_t *weights = &coefficients.weights[(size_t)x * coefficients.taps];
+                dstRow[x] = filterPixels(srcRow + coefficients.starts[x], coefficients.counts[x], weights);
+            }
+            writer.commit(y);
+        }
+    });
+}
+
+/**
+ * scales [src] into the [newHeight] rows of [dst], in bands of output rows.
+ * [firstRow] is subtracted from the source rows of the coefficients.
+ */
+template <typename Source, typename Destination>
+static void scaleVertically(const Source *src, uint32_t width, size_t srcStride, uint32_t firstRow,
+                            Destination *dst, size_t dstStride, uint32_t newHeight,
+                            const ScaleCoefficients &coefficients, WorkerPool *workers)
+{
+    forEachBand(workers, newHeight, 1, [&](uint32_t first, uint32_t end) {
+        // every band keeps its own window of converted rows
+        RowReader<Source> reader(src, width, srcStride, coefficients.taps);
+        RowWriter<Destination> writer(dst, width, dstStride);
+        std::vector<const typename RowReader<Source>::Work *> rows(coefficients.taps);
+        for (uint32_t y = first; y < end; ++y)
+        {
+            uint32_t start = coefficients.starts[y] - firstRow;
+            uint32_t count = coefficients.counts[y];
+            for (uint32_t k = 0; k < count; ++k)
+                rows[k] = reader.row(start + k);
+            const int16_t *weights = &coefficients.weights[(size_t)y * coefficients.taps];
+            filterRows(rows.data(), count, weights, width, writer.row(y));
+            writer.commit(y);
+        }
+    });
+}
+
+template <typename Pixel>
+void scalePixels(const Pixel *src, uint32_t width, uint32_t height, size_t srcStride,
+                 Pixel *dst, uint32_t newWidth, uint32_t newHeight, size_t dstStride, ScaleFilter filter,
+                 WorkerPool *workers)
+{
+    typedef typename WorkingPixel<Pixel>::Type Work;
+    if (width == 0 || height == 0 || newWidth == 0 || newHeight == 0)
+        return;
+    if (width == newWidth && height == newHeight)
+    {
+        forEachBand(workers, height, 1, [&](uint32_t first, uint32_t end) {
+            for (uint32_t y = first; y < end; ++y)
+                memcpy(dst + y * dstStride, src + y * srcStride, width * sizeof(Pixel));
+        });
+        return;
+    }
+
+    ScaleCoefficients horizontal;
+    ScaleCoefficients vertical;
+    if (width != newWidth)
+        computeCoefficients(width, newWidth, filter, &horizontal);
+    if (height != newHeight)
+        computeCoefficients(height, newHeight, filter, &vertical);
+
+    if (height == newHeight)
+    {
+        scaleHorizontally(src, width, srcStride, 0, height, dst, dstStride, newWidth, horizontal, workers);
+        return;
+    }
+    if (width == newWidth)
+    {
+        scaleVertically(src, width, srcStride, 0, dst, dstStride, newHeight, vertical, workers);
+        return;
+    }
+
+    // the horizontal pass computes every pixel on its own and costs about twice as much per tap as the vertical one,
+    // which computes 4 pixels at once. run the passes in the order which makes less work,
+    // e.g. vertical first when downscaling so the horizontal pass only sees the remaining rows.
+    // the intermediate rows are kept as working pixels.
+    double horizontalFirst = 2.0 * height * newWidth * horizontal.taps + (double)newHeight * newWidth * vertical.taps;
+    double verticalFirst = (double)newHeight * width * vertical.taps + 2.0 * newHeight * newWidth * horizontal.taps;
+    if (verticalFirst < horizontalFirst)
+    {
+        std::vector<Work> temp((size_t)width * newHeight);
+        scaleVertically(src, width, srcStride, 0, temp.data(), width, newHeight, vertical, workers);
+        scaleHorizontally(temp.data(), width, width, 0, newHeight, dst, dstStride, newWidth, horizontal, workers);
+        return;
+    }
+
+    // only the source rows read by the vertical pass are scaled horizontally
+    uint32_t firstRow = vertical.starts[0];
+    uint32_t lastRow = vertical.starts[newHeight - 1] + vertical.counts[newHeight - 1];
+    std::vector<Work> temp((size_t)newWidth * (lastRow - firstRow));
+    scaleHorizontally(src, width, srcStride, firstRow, lastRow - firstRow, temp.data(), newWidth, newWidth, horizontal,
+                      workers);
+    scaleVertically(temp.data(), newWidth, newWidth, firstRow, dst, dstStride, newHeight, vertical, workers);
+}
+
+template void scalePixels(const uint8_t *, uint32_t, uint32_t, size_t, uint8_t *, uint32_t, uint32_t, size_t,
+                          ScaleFilter, WorkerPool *);
+template void scalePixels(const uint16_t *, uint32_t, uint32_t, size_t, uint16_t *, uint32_t, uint32_t, size_t,
+                          ScaleFilter, WorkerPool *);
+template void scalePixels(const uint32_t *, uint32_t, uint32_t, size_t, uint32_t *, uint32_t, uint32_t, size_t,
+                          ScaleFilter, WorkerPool *);
+template void scalePixels(const uint64_t *, uint32_t, uint32_t, size_t, uint64_t *, uint32_t, uint32_t, size_t,
+                          ScaleFilter, WorkerPool *);
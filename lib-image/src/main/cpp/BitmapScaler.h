@@ -0,0 +1,41 @@
+#ifndef LEOANDROIDBASEUTIL_BITMAPSCALER_H
+#define LEOANDROIDBASEUTIL_BITMAPSCALER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class WorkerPool;
+
+// Separable resampling of the pixel types of BitmapTransform.h.
+// RGBA_8888 is treated as 4 independent 8-bit channels, RGB_565 as 3 channels of 5, 6 and 5 bits,
+// A_8 as a single channel and RGBA_F16 as 4 floats.
+//
+// Every output pixel is a weighted sum of the source pixels under the filter, first along the rows and then
+// along the columns. The weights are computed once per call as 14-bit fixed point numbers,
+// and when downscaling the filter is stretched by the scale factor so every source pixel contributes (antialiasing).
+// Both passes run row by row, with SSE2 or NEON when available for RGBA_8888,
+// and with workers every pass is split into bands of its output rows.
+
+enum ScaleFilter
+{
+    /** triangle filter, the 2x2 neighbourhood when upscaling */
+    kScaleFilterBilinear = 0,
+    /** box filter, the average of the covered source area when downscaling */
+    kScaleFilterBox = 1,
+    /** windowed sinc filter with 3 lobes, the sharpest and the slowest */
+    kScaleFilterLanczos3 = 2,
+};
+
+/**
+ * scales [src] into [dst] of [newWidth] x [newHeight] pixels.
+ *
+ * @param srcStride the distance between two source rows, in pixels
+ * @param dstStride the distance between two destination rows, in pixels
+ * @param workers the pool which runs the bands, or NULL to run on the calling thread
+ */
+template <typename Pixel>
+void scalePixels(const Pixel *src, uint32_t width, uint32_t height, size_t srcStride,
+                 Pixel *dst, uint32_t newWidth, uint32_t newHeight, size_t dstStride, ScaleFilter filter,
+                 WorkerPool *workers = NULL);
+
+#endif // LEOANDROIDBASEUTIL_BITMAPSCALER_H
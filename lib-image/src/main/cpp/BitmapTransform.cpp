@@ -0,0 +1,377 @@
+#include "BitmapTransform.h"
+#include "BitmapScaler.h"
+#include "RotateKernels.h"
+#include "WorkerPool.h"
+
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define TRANSFORM_HAS_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TRANSFORM_HAS_NEON 1
+#endif
+
+int32_t convertArgbToInt(ARGB argb)
+{
+    return (argb.alpha) | (argb.red << 24) | (argb.green << 16) | (argb.blue << 8);
+}
+
+void convertIntToArgb(uint32_t pixel, ARGB *argb)
+{
+    argb->red = ((pixel >> 24) & 0xff);
+    argb->green = ((pixel >> 16) & 0xff);
+    argb->blue = ((pixel >> 8) & 0xff);
+    argb->alpha = (pixel & 0xff);
+}
+
+template <typename Pixel>
+void cropPixels(const Pixel *src, uint32_t width, uint32_t /* height */,
+                uint32_t left, uint32_t top, uint32_t right, uint32_t bottom,
+                Pixel *dst, WorkerPool *workers)
+{
+    uint32_t newWidth = right - left;
+    forEachBand(workers, bottom - top, 1, [&](uint32_t first, uint32_t end) {
+        const Pixel *whereToGet = src + left + (size_t)(top + first) * width;
+        Pixel *whereToPut = dst + (size_t)first * newWidth;
+        for (uint32_t y = first; y < end; ++y)
+        {
+            memcpy(whereToPut, whereToGet, sizeof(Pixel) * newWidth);
+            whereToGet += width;
+            whereToPut += newWidth;
+        }
+    });
+}
+
+// The 90 degree rotations are split into bands of source columns, i.e. of destination rows.
+// Bands start on a tile boundary of RotateKernels.cpp so no block is cut in two.
+static const uint32_t kRotateBandAlignment = 16;
+
+template <typename Pixel>
+void rotatePixelsCcw90(const Pixel *src, uint32_t width, uint32_t height, Pixel *dst, WorkerPool *workers)
+{
+    // XY. ... ... ..X
+    // ...>Y..>...>..Y
+    // ... X.. .YX ...
+    RotateKernel kernel = bestRotateKernel();
+    forEachBand(workers, width, kRotateBandAlignment, [&](uint32_t first, uint32_t end) {
+        // the columns [first, end) become the rows [width - end, width - first)
+        rotatePixels90(src + first, end - first, height, width, dst + (size_t)(width - end) * height, height, false,
+                       kernel);
+    });
+}
+
+template <typename Pixel>
+void rotatePixelsCw90(const Pixel *src, uint32_t width, uint32_t height, Pixel *dst, WorkerPool *workers)
+{
+    // XY. ..X ... ...
+    // ...>..Y>...>Y..
+    // ... ... .YX X..
+    RotateKernel kernel = bestRotateKernel();
+    forEachBand(workers, width, kRotateBandAlignment, [&](uint32_t first, uint32_t end) {
+        // the columns [first, end) become the rows [first, end)
+        rotatePixels90(src + first, end - first, height, width, dst + (size_t)first * height, height, true, kernel);
+    });
+}
+
+template <typename Pixel>
+void rotatePixelsCcw90InPlace(Pixel *pixels, uint32_t width, uint32_t height, WorkerPool *workers)
+{
+    // the transposed pixels flipped upside down
+    transposePixelsInPlace(pixels, width, height, workers);
+    flipPixelsVertical(pixels, height, width, height, workers);
+}
+
+template <typename Pixel>
+void rotatePixelsCw90InPlace(Pixel *pixels, uint32_t width, uint32_t height, WorkerPool *workers)
+{
+    // the transposed pixels flipped left to right
+    transposePixelsInPlace(pixels, width, height, workers);
+    flipPixelsHorizontal(pixels, height, width, height, workers);
+}
+
+template <typename Pixel>
+void rotatePixels180(Pixel *pixels, uint32_t width, uint32_t height)
+{
+    // no need to create a totally new bitmap - it's the exact same size as the original
+    //  1234 fedc
+    //  5678>ba09
+    //  90ab>8765
+    //  cdef 4321
+    rotatePixels180(pixels, width, height, (size_t)width);
+}
+
+// --------------------
+// Nearest neighbour.
+//
+// The source column of every output column is looked up in a table built once per call,
+// and an output row mapping to the same source row as the previous one is a copy of it.
+// Integer ratios of 32-bit pixels pick or repeat the source pixels with SSE2 or NEON shuffles instead.
+// --------------------
+
+/** dst[x] = srcRow[columns[x]] for every x in [0, count) */
+template <typename Pixel>
+static void gatherRow(const Pixel *srcRow, const uint32_t *columns, uint32_t count, Pixel *dst)
+{
+    uint32_t x = 0;
+    for (; x + 4 <= count; x += 4)
+    {
+        dst[x] = srcRow[columns[x]];
+        dst[x + 1] = srcRow[columns[x + 1]];
+        dst[x + 2] = srcRow[columns[x + 2]];
+        dst[x + 3] = srcRow[columns[x + 3]];
+    }
+    for (; x < count; ++x)
+        dst[x] = srcRow[columns[x]];
+}
+
+/** dst[x] = srcRow[x * step] for every x in [0, count) */
+template <typename Pixel>
+static void pickRow(const Pixel *srcRow, uint32_t step, uint32_t count, Pixel *dst)
+{
+    for (uint32_t x = 0; x < count; ++x)
+        dst[x] = srcRow[(size_t)x * step];
+}
+
+/** dst[x] = srcRow[x / 2] for every x in [0, count) */
+template <typename Pixel>
+static void doubleRow(const Pixel *srcRow, uint32_t count, Pixel *dst)
+{
+    for (uint32_t x = 0; x < count; ++x)
+        dst[x] = srcRow[x / 2];
+}
+
+#if TRANSFORM_HAS_SSE2
+template <>
+void pickRow(const uint32_t *srcRow, uint32_t step, uint32_t count, uint32_t *dst)
+{
+    uint32_t x = 0;
+    if (step == 2)
+    {
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128 a = _mm_loadu_ps((const float *)(srcRow + x * 2));
+            __m128 b = _mm_loadu_ps((const float *)(srcRow + x * 2 + 4));
+            _mm_storeu_ps((float *)(dst + x), _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+    }
+    else if (step == 4)
+    {
+        for (; x + 4 <= count; x += 4)
+        {
+            const __m128i *p = (const __m128i *)(srcRow + x * 4);
+            __m128i ab = _mm_unpacklo_epi32(_mm_loadu_si128(p), _mm_loadu_si128(p + 1));
+            __m128i cd = _mm_unpacklo_epi32(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3));
+            _mm_storeu_si128((__m128i *)(dst + x), _mm_unpacklo_epi64(ab, cd));
+        }
+    }
+    for (; x < count; ++x)
+        dst[x] = srcRow[(size_t)x * step];
+}
+
+template <>
+void doubleRow(const uint32_t *srcRow, uint32_t count, uint32_t *dst)
+{
+    uint32_t x = 0;
+    for (; x + 8 <= count; x += 8)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i *)(srcRow + x / 2));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_unpacklo_epi32(p, p));
+        _mm_storeu_si128((__m128i *)(dst + x + 4), _mm_unpackhi_epi32(p, p));
+    }
+    for (; x < count; ++x)
+        dst[x] = srcRow[x / 2];
+}
+#elif TRANSFORM_HAS_NEON
+template <>
+void pickRow(const uint32_t *srcRow, uint32_t step, uint32_t count, uint32_t *dst)
+{
+    uint32_t x = 0;
+    if (step == 2)
+    {
+        for (; x + 4 <= count; x += 4)
+            vst1q_u32(dst + x, vld2q_u32(srcRow + x * 2).val[0]);
+    }
+    else if (step == 4)
+    {
+        for (; x + 4 <= count; x += 4)
+            vst1q_u32(dst + x, vld4q_u32(srcRow + x * 4).val[0]);
+    }
+    for (; x < count; ++x)
+        dst[x] = srcRow[(size_t)x * step];
+}
+
+template <>
+void doubleRow(const uint32_t *srcRow, uint32_t count, uint32_t *dst)
+{
+    uint32_t x = 0;
+    for (; x + 8 <= count; x += 8)
+    {
+        uint32x4_t p = vld1q_u32(srcRow + x / 2);
+        uint32x4x2_t pairs = {{p, p}};
+        vst2q_u32(dst + x, pairs);
+    }
+    for (; x < count; ++x)
+        dst[x] = srcRow[x / 2];
+}
+#endif
+
+template <typename Pixel>
+void scalePixelsNN(const Pixel *src, uint32_t width, uint32_t height,
+                   Pixel *dst, uint32_t newWidth, uint32_t newHeight, WorkerPool *workers)
+{
+    uint32_t oldWidth = width;
+    uint32_t oldHeight = height;
+    // x2 = x * oldWidth / newWidth, the products are computed in 64 bits so large bitmaps do not overflow
+    std::vector<uint32_t> columns(newWidth);
+    for (uint32_t x = 0; x < newWidth; ++x)
+        columns[x] = (uint32_t)((uint64_t)x * oldWidth / newWidth);
+    bool downscaleByInteger = oldWidth % newWidth == 0;
+    bool upscaleByTwo = newWidth == oldWidth * 2;
+
+    forEachBand(workers, newHeight, 1, [&](uint32_t first, uint32_t end) {
+        uint32_t previousY2 = oldHeight;
+        for (uint32_t y = first; y < end; ++y)
+        {
+            uint32_t y2 = (uint32_t)((uint64_t)y * oldHeight / newHeight);
+            Pixel *dstRow = dst + (size_t)y * newWidth;
+            if (y2 == previousY2)
+            {
+                // same source row as the previous output row
+                memcpy(dstRow, dstRow - newWidth, sizeof(Pixel) * newWidth);
+                continue;
+            }
+            previousY2 = y2;
+            const Pixel *srcRow = src + (size_t)y2 * oldWidth;
+            if (downscaleByInteger)
+                pickRow(srcRow, oldWidth / newWidth, newWidth, dstRow);
+            else if (upscaleByTwo)
+                doubleRow(srcRow, newWidth, dstRow);
+            else
+                gatherRow(srcRow, columns.data(), newWidth, dstRow);
+        }
+    });
+}
+
+template <typename Pixel>
+void scalePixelsBI(const Pixel *src, uint32_t width, uint32_t height,
+                   Pixel *dst, uint32_t newWidth, uint32_t newHeight, WorkerPool *workers)
+{
+    scalePixels(src, width, height, width, dst, newWidth, newHeight, newWidth, kScaleFilterBilinear, workers);
+}
+
+/**
+ * 123    321
+ * 456 => 654
+ * 789    987
+ * */
+template <typename Pixel>
+void flipPixelsHorizontal(Pixel *pixels, uint32_t width, uint32_t height)
+{
+    int middle = width / 2;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        // for each row, switch between the first pixels and the last ones
+        Pixel *idx1 = pixels + width * y;
+        Pixel *idx2 = pixels + width * (y + 1) - 1;
+        for (int x = 0; x < middle; ++x)
+        {
+            Pixel pixel = *idx1; // pixel= pixels[rowStart + x];
+            *idx1 = *idx2;          // pixels[rowStart + x] =pixels[rowStart + (width - x - 1)];
+            *idx2 = pixel;          // pixels[rowStart + (width - x - 1)] = pixel;
+            ++idx1;
+            --idx2;
+        }
+    }
+}
+
+/**
+ * 123    789
+ * 456 => 456
+ * 789    123
+ * */
+template <typename Pixel>
+void flipPixelsVertical(Pixel *pixels, uint32_t width, uint32_t height)
+{
+    uint32_t middle = height / 2;
+    for (uint32_t y = 0; y < middle; ++y)
+    {
+        // for each row till the middle row, switch its pixels with the one at the bottom
+        Pixel *idx1 = pixels + width * y;
+        Pixel *idx2 = pixels + width * (height - y - 1);
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            Pixel pixel = *idx1;
+            *idx1 = *idx2;
+            *idx2 = pixel;
+            ++idx2;
+            ++idx1;
+        }
+    }
+}
+
+template <typename Pixel>
+void rotatePixels180(Pixel *pixels, uint32_t width, uint32_t height, size_t stride, WorkerPool *workers)
+{
+    // the rows y and height - 1 - y swap their reversed pixels, so the bands are made of such pairs
+    forEachBand(workers, (height + 1) / 2, 1, [&](uint32_t first, uint32_t end) {
+        for (uint32_t y = first; y < end; ++y)
+        {
+            Pixel *top = pixels + y * stride;
+            Pixel *bottom = pixels + (height - 1 - y) * stride;
+            if (top == bottom)
+                std::reverse(top, top + width); // the middle row of an odd height
+            else
+                std::swap_ranges(top, top + width, std::reverse_iterator<Pixel *>(bottom + width));
+        }
+    });
+}
+
+template <typename Pixel>
+void flipPixelsHorizontal(Pixel *pixels, uint32_t width, uint32_t height, size_t stride, WorkerPool *workers)
+{
+    forEachBand(workers, height, 1, [&](uint32_t first, uint32_t end) {
+        for (uint32_t y = first; y < end; ++y)
+        {
+            Pixel *row = pixels + y * stride;
+            std::reverse(row, row + width);
+        }
+    });
+}
+
+template <typename Pixel>
+void flipPixelsVertical(Pixel *pixels, uint32_t width, uint32_t height, size_t stride, WorkerPool *workers)
+{
+    forEachBand(workers, height / 2, 1, [&](uint32_t first, uint32_t end) {
+        for (uint32_t y = first; y < end; ++y)
+        {
+            Pixel *top = pixels + y * stride;
+            std::swap_ranges(top, top + width, pixels + (height - 1 - y) * stride);
+        }
+    });
+}
+
+#define INSTANTIATE_TRANSFORMS(Pixel)                                                                              \
+    template void cropPixels(const Pixel *, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, Pixel *,    \
+                             WorkerPool *);                                                                        \
+    template void rotatePixelsCcw90(const Pixel *, uint32_t, uint32_t, Pixel *, WorkerPool *);                     \
+    template void rotatePixelsCw90(const Pixel *, uint32_t, uint32_t, Pixel *, WorkerPool *);                      \
+    template void rotatePixelsCcw90InPlace(Pixel *, uint32_t, uint32_t, WorkerPool *);                             \
+    template void rotatePixelsCw90InPlace(Pixel *, uint32_t, uint32_t, WorkerPool *);                              \
+    template void rotatePixels180(Pixel *, uint32_t, uint32_t);                                                    \
+    template void scalePixelsNN(const Pixel *, uint32_t, uint32_t, Pixel *, uint32_t, uint32_t, WorkerPool *);     \
+    template void scalePixelsBI(const Pixel *, uint32_t, uint32_t, Pixel *, uint32_t, uint32_t, WorkerPool *);     \
+    template void flipPixelsHorizontal(Pixel *, uint32_t, uint32_t);                                               \
+    template void flipPixelsVertical(Pixel *, uint32_t, uint32_t);                                                 \
+    template void rotatePixels180(Pixel *, uint32_t, uint32_t, size_t, WorkerPool *);                              \
+    template void flipPixelsHorizontal(Pixel *, uint32_t, uint32_t, size_t, WorkerPool *);                         \
+    template void flipPixelsVertical(Pixel *, uint32_t, uint32_t, size_t, WorkerPool *);
+
+INSTANTIATE_TRANSFORMS(uint8_t)
+INSTANTIATE_TRANSFORMS(uint16_t)
+INSTANTIATE_TRANSFORMS(uint32_t)
+INSTANTIATE_TRANSFORMS(uint64_t)
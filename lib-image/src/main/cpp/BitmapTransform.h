@@ -0,0 +1,87 @@
+#ifndef LEOANDROIDBASEUTIL_BITMAPTRANSFORM_H
+#define LEOANDROIDBASEUTIL_BITMAPTRANSFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class WorkerPool;
+
+// Pixel loops of the bitmap operations, free of any JNI or Android dependency.
+// All buffers hold tightly packed pixels, [width] * [height] of them.
+// Unless stated otherwise [dst] must not overlap [src].
+//
+// The operations are templates over the pixel type, which also tells the format of the pixel:
+//   uint32_t RGBA_8888, uint16_t RGB_565, uint64_t RGBA_F16 and uint8_t A_8.
+// They are instantiated for these four types only.
+//
+// The operations taking [workers] split their rows into bands which run on the pool, see WorkerPool.h.
+// Without workers they run on the calling thread.
+
+typedef struct
+{
+    uint8_t alpha, red, green, blue;
+} ARGB;
+
+int32_t convertArgbToInt(ARGB argb);
+
+void convertIntToArgb(uint32_t pixel, ARGB *argb);
+
+/** copies the region [left, right) x [top, bottom) of [src] into [dst]. note that no validations are done */
+template <typename Pixel>
+void cropPixels(const Pixel *src, uint32_t width, uint32_t height,
+                uint32_t left, uint32_t top, uint32_t right, uint32_t bottom,
+                Pixel *dst, WorkerPool *workers = NULL);
+
+/** rotates by 90 degrees counter clock wise. [dst] is [height] pixels wide */
+template <typename Pixel>
+void rotatePixelsCcw90(const Pixel *src, uint32_t width, uint32_t height, Pixel *dst, WorkerPool *workers = NULL);
+
+/** rotates by 90 degrees clock wise. [dst] is [height] pixels wide */
+template <typename Pixel>
+void rotatePixelsCw90(const Pixel *src, uint32_t width, uint32_t height, Pixel *dst, WorkerPool *workers = NULL);
+
+/** rotates by 90 degrees counter clock wise in place, the [pixels] become [height] pixels wide */
+template <typename Pixel>
+void rotatePixelsCcw90InPlace(Pixel *pixels, uint32_t width, uint32_t height, WorkerPool *workers = NULL);
+
+/** rotates by 90 degrees clock wise in place, the [pixels] become [height] pixels wide */
+template <typename Pixel>
+void rotatePixelsCw90InPlace(Pixel *pixels, uint32_t width, uint32_t height, WorkerPool *workers = NULL);
+
+/** rotates by 180 degrees in place */
+template <typename Pixel>
+void rotatePixels180(Pixel *pixels, uint32_t width, uint32_t height);
+
+/**
+ * scales using the fastest, simplest algorithm called "nearest neighbor":
+ * the output pixel (x, y) is the source pixel (x * width / newWidth, y * height / newHeight)
+ */
+template <typename Pixel>
+void scalePixelsNN(const Pixel *src, uint32_t width, uint32_t height,
+                   Pixel *dst, uint32_t newWidth, uint32_t newHeight, WorkerPool *workers = NULL);
+
+/** scales using a high-quality algorithm called "Bilinear Interpolation", antialiased when downscaling */
+template <typename Pixel>
+void scalePixelsBI(const Pixel *src, uint32_t width, uint32_t height,
+                   Pixel *dst, uint32_t newWidth, uint32_t newHeight, WorkerPool *workers = NULL);
+
+/** flips horizontally in place */
+template <typename Pixel>
+void flipPixelsHorizontal(Pixel *pixels, uint32_t width, uint32_t height);
+
+/** flips vertically in place */
+template <typename Pixel>
+void flipPixelsVertical(Pixel *pixels, uint32_t width, uint32_t height);
+
+// The same in place operations on rows which are [stride] pixels apart, e.g. the locked pixels of a Bitmap.
+
+template <typename Pixel>
+void rotatePixels180(Pixel *pixels, uint32_t width, uint32_t height, size_t stride, WorkerPool *workers = NULL);
+
+template <typename Pixel>
+void flipPixelsHorizontal(Pixel *pixels, uint32_t width, uint32_t height, size_t stride, WorkerPool *workers = NULL);
+
+template <typename Pixel>
+void flipPixelsVertical(Pixel *pixels, uint32_t width, uint32_t height, size_t stride, WorkerPool *workers = NULL);
+
+#endif // LEOANDROIDBASEUTIL_BITMAPTRANSFORM_H
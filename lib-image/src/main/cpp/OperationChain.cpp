@@ -0,0 +1,303 @@
+#include "OperationChain.h"
+#include "BitmapScaler.h"
+#include "WorkerPool.h"
+
+#include <math.h>
+#include <utility>
+#include <vector>
+
+// the gather pass walks the output in tiles, so rotated reads reuse the source lines they bring into the cache
+static const uint32_t kTileSize = 32;
+
+// --------------------
+// Composition.
+// --------------------
+
+/** (sourceX, sourceY) = (xx * X + xy * Y + x0, yx * X + yy * Y + y0) */
+typedef struct
+{
+    double xx, xy, x0;
+    double yx, yy, y0;
+} Affine;
+
+/** [outer] applied after [inner], i.e. outer(inner(p)) */
+static Affine compose(const Affine &outer, const Affine &inner)
+{
+    Affine result;
+    result.xx = outer.xx * inner.xx + outer.xy * inner.yx;
+    result.xy = outer.xx * inner.xy + outer.xy * inner.yy;
+    result.x0 = outer.xx * inner.x0 + outer.xy * inner.y0 + outer.x0;
+    result.yx = outer.yx * inner.xx + outer.yy * inner.yx;
+    result.yy = outer.yx * inner.xy + outer.yy * inner.yy;
+    result.y0 = outer.yx * inner.x0 + outer.yy * inner.y0 + outer.y0;
+    return result;
+}
+
+static Affine makeAffine(double xx, double xy, double x0, double yx, double yy, double y0)
+{
+    Affine affine = {xx, xy, x0, yx, yy, y0};
+    return affine;
+}
+
+bool composeOperations(const int32_t *operations, uint32_t length, uint32_t width, uint32_t height,
+                       OperationChain *chain)
+{
+    // maps the coordinates of the current image to the source, every operation maps its output to its input
+    Affine toSource = makeAffine(1, 0, 0, 0, 1, 0);
+    double w = width;
+    double h = height;
+    int32_t scaleMethod = kChainScaleNearestNeighbour;
+    int32_t xTieBreak = 1;
+    int32_t yTieBreak = 1;
+    uint32_t i = 0;
+    while (i < length)
+    {
+        int32_t operation = operations[i++];
+        Affine toInput;
+        switch (operation)
+        {
+        case kOperationCrop:
+        {
+            if (i + 4 > length)
+                return false;
+            int32_t left = operations[i], top = operations[i + 1], right = operations[i + 2], bottom = operations[i + 3];
+            i += 4;
+            if (left < 0 || top < 0 || right <= left || bottom <= top || right > w || bottom > h)
+                return false;
+            toInput = makeAffine(1, 0, left, 0, 1, top);
+            w = right - left;
+            h = bottom - top;
+            break;
+        }
+        case kOperationRotateCw90:
+            // (x, y) -> (h - y, x)
+            toInput = makeAffine(0, 1, 0, -1, 0, h);
+            std::swap(w, h);
+            break;
+        case kOperationRotateCcw90:
+            // (x, y) -> (y, w - x)
+            toInput = makeAffine(0, -1, w, 1, 0, 0);
+            std::swap(w, h);
+            break;
+        case kOperationRotate180:
+            toInput = makeAffine(-1, 0, w, 0, -1, h);
+            break;
+        case kOperationFlipHorizontal:
+            toInput = makeAffine(-1, 0, w, 0, 1, 0);
+            break;
+        case kOperationFlipVertical:
+            toInput = makeAffine(1, 0, 0, 0, -1, h);
+            break;
+        case kOperationScale:
+        {
+            if (i + 3 > length)
+                return false;
+            int32_t newWidth = operations[i], newHeight = operations[i + 1], method = operations[i + 2];
+            i += 3;
+            if (newWidth <= 0 || newHeight <= 0 || method < kChainScaleNearestNeighbour || method > kChainScaleLanczos3)
+                return false;
+            if (method == kChainScaleNearestNeighbour)
+            {
+                // like scalePixelsNN, the output pixel i takes the input pixel under the edge w / newWidth * i,
+                // which is half a pixel before its center
+                toInput = makeAffine(w / newWidth, 0, -0.5 * w / newWidth, 0, h / newHeight, -0.5 * h / newHeight);
+            }
+            else
+            {
+                toInput = makeAffine(w / newWidth, 0, 0, 0, h / newHeight, 0);
+            }
+            w = newWidth;
+            h = newHeight;
+            scaleMethod = method;
+            xTieBreak = toSource.xx + toSource.xy > 0 ? 1 : -1;
+            yTieBreak = toSource.yx + toSource.yy > 0 ? 1 : -1;
+            break;
+        }
+        default:
+            return false;
+        }
+        toSource = compose(toSource, toInput);
+    }
+
+    chain->srcWidth = width;
+    chain->srcHeight = height;
+    chain->width = (uint32_t)w;
+    chain->height = (uint32_t)h;
+    chain->xx = toSource.xx;
+    chain->xy = toSource.xy;
+    chain->x0 = toSource.x0;
+    chain->yx = toSource.yx;
+    chain->yy = toSource.yy;
+    chain->y0 = toSource.y0;
+    chain->xTieBreak = xTieBreak;
+    chain->yTieBreak = yTieBreak;
+    chain->scaleMethod = scaleMethod;
+    return true;
+}
+
+// --------------------
+// Execution.
+// --------------------
+
+/** the source pixel under scale * (i + 0.5) + offset clamped to [0, size), for every i in [0, count) */
+static void sampleAxis(double scale, double offset, int32_t tieBreak, uint32_t count, uint32_t size,
+                       std::vector<int64_t> *indices)
+{
+    indices->resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        // e.g. 2 * (0.5 + 0.5) is on a boundary, the epsilon absorbs the rounding errors
+        double position = scale * (i + 0.5) + offset;
+        position = tieBreak > 0 ? floor(position + 1e-7) : ceil(position - 1e-7) - 1;
+        if (position < 0)
+            position = 0;
+        if (position > size - 1)
+            position = size - 1;
+        (*indices)[i] = (int64_t)position;
+    }
+}
+
+/**
+ * dst(x, y) = src(column[x] + row[y]): every source coordinate depends on either x or y,
+ * so the offset of a source pixel splits into a part per output column and a part per output row.
+ * the output is split into bands of whole tile rows.
+ */
+template <typename Pixel>
+static void gather(const OperationChain &chain, const Pixel *src, size_t srcStride, uint32_t srcWidth,
+                   uint32_t srcHeight, Pixel *dst, size_t dstStride, WorkerPool *workers)
+{
+    std::vector<int64_t> column(chain.width, 0);
+    std::vector<int64_t> row(chain.height, 0);
+    std::vector<int64_t> indices;
+
+    if (chain.xx != 0)
+    {
+        sampleAxis(chain.xx, chain.x0, chain.xTieBreak, chain.width, srcWidth, &indices);
+        for (uint32_t x = 0; x < chain.width; ++x)
+            column[x] += indices[x];
+    }
+    else
+    {
+        sampleAxis(chain.xy, chain.x0, chain.xTieBreak, chain.height, srcWidth, &indices);
+        for (uint32_t y = 0; y < chain.height; ++y)
+            row[y] += indices[y];
+    }
+    if (chain.yy != 0)
+    {
+        sampleAxis(chain.yy, chain.y0, chain.yTieBreak, chain.height, srcHeight, &indices);
+        for (uint32_t y = 0; y < chain.height; ++y)
+            row[y] += indices[y] * (int64_t)srcStride;
+    }
+    else
+    {
+        sampleAxis(chain.yx, chain.y0, chain.yTieBreak, chain.width, srcHeight, &indices);
+        for (uint32_t x = 0; x < chain.width; ++x)
+            column[x] += indices[x] * (int64_t)srcStride;
+    }
+
+    forEachBand(workers, chain.height, kTileSize, [&](uint32_t first, uint32_t end) {
+        for (uint32_t ty = first; ty < end; ty += kTileSize)
+        {
+            uint32_t tyEnd = ty + kTileSize < end ? ty + kTileSize : end;
+            for (uint32_t tx = 0; tx < chain.width; tx += kTileSize)
+            {
+                uint32_t txEnd = tx + kTileSize < chain.width ? tx + kTileSize : chain.width;
+                for (uint32_t y = ty; y < tyEnd; ++y)
+                {
+                    const Pixel *srcRow = src + row[y];
+                    Pixel *dstRow = dst + y * dstStride;
+                    for (uint32_t x = tx; x < txEnd; ++x)
+                        dstRow[x] = srcRow[column[x]];
+                }
+            }
+        }
+    });
+}
+
+static ScaleFilter toScaleFilter(int32_t method)
+{
+    switch (method)
+    {
+    case kChainScaleBox:
+        return kScaleFilterBox;
+    case kChainScaleLanczos3:
+        return kScaleFilterLanczos3;
+    default:
+        return kScaleFilterBilinear;
+    }
+}
+
+template <typename Pixel>
+void executeOperations(const OperationChain &chain, const Pixel *src, size_t srcStride,
+                       Pixel *dst, size_t dstStride, WorkerPool *workers)
+{
+    bool swapped = chain.xx == 0;
+    // the output size in the orientation of the source
+    uint32_t scaledWidth = swapped ? chain.height : chain.width;
+    uint32_t scaledHeight = swapped ? chain.width : chain.height;
+    double scaleX = fabs(swapped ? chain.xy : chain.xx);
+    double scaleY = fabs(swapped ? chain.yx : chain.yy);
+    bool scaled = fabs(scaleX - 1.0) > 1e-9 || fabs(scaleY - 1.0) > 1e-9;
+    if (chain.scaleMethod == kChainScaleNearestNeighbour || !scaled)
+    {
+        gather(chain, src, srcStride, chain.srcWidth, chain.srcHeight, dst, dstStride, workers);
+        return;
+    }
+
+    // the source area covered by the output, rounded to whole pixels
+    double left = swapped ? (chain.xy > 0 ? chain.x0 : chain.x0 + chain.xy * chain.height)
+                          : (chain.xx > 0 ? chain.x0 : chain.x0 + chain.xx * chain.width);
+    double top = swapped ? (chain.yx > 0 ? chain.y0 : chain.y0 + chain.yx * chain.width)
+                         : (chain.yy > 0 ? chain.y0 : chain.y0 + chain.yy * chain.height);
+    int64_t cropLeft = (int64_t)floor(left + 0.5);
+    int64_t cropTop = (int64_t)floor(top + 0.5);
+    int64_t cropRight = (int64_t)floor(left + scaleX * scaledWidth + 0.5);
+    int64_t cropBottom = (int64_t)floor(top + scaleY * scaledHeight + 0.5);
+    if (cropLeft < 0)
+        cropLeft = 0;
+    if (cropTop < 0)
+        cropTop = 0;
+    if (cropRight > chain.srcWidth)
+        cropRight = chain.srcWidth;
+    if (cropBottom > chain.srcHeight)
+        cropBottom = chain.srcHeight;
+    if (cropRight <= cropLeft)
+        cropRight = cropLeft + 1;
+    if (cropBottom <= cropTop)
+        cropBottom = cropTop + 1;
+    const Pixel *cropped = src + cropTop * srcStride + cropLeft;
+    uint32_t croppedWidth = (uint32_t)(cropRight - cropLeft);
+    uint32_t croppedHeight = (uint32_t)(cropBottom - cropTop);
+    ScaleFilter filter = toScaleFilter(chain.scaleMethod);
+
+    bool identity = !swapped && chain.xx > 0 && chain.yy > 0;
+    if (identity)
+    {
+        scalePixels(cropped, croppedWidth, croppedHeight, srcStride, dst, chain.width, chain.height, dstStride, filter,
+                    workers);
+        return;
+    }
+
+    std::vector<Pixel> scaledPixels((size_t)scaledWidth * scaledHeight);
+    scalePixels(cropped, croppedWidth, croppedHeight, srcStride, scaledPixels.data(), scaledWidth, scaledHeight,
+                scaledWidth, filter, workers);
+
+    // only the rotation and the mirroring are left, with the signs of the chain
+    OperationChain orientation = chain;
+    orientation.srcWidth = scaledWidth;
+    orientation.srcHeight = scaledHeight;
+    orientation.xx = chain.xx > 0 ? 1 : chain.xx < 0 ? -1 : 0;
+    orientation.xy = chain.xy > 0 ? 1 : chain.xy < 0 ? -1 : 0;
+    orientation.yx = chain.yx > 0 ? 1 : chain.yx < 0 ? -1 : 0;
+    orientation.yy = chain.yy > 0 ? 1 : chain.yy < 0 ? -1 : 0;
+    orientation.x0 = orientation.xx + orientation.xy < 0 ? scaledWidth : 0;
+    orientation.y0 = orientation.yx + orientation.yy < 0 ? scaledHeight : 0;
+    orientation.xTieBreak = 1;
+    orientation.yTieBreak = 1;
+    gather(orientation, scaledPixels.data(), scaledWidth, scaledWidth, scaledHeight, dst, dstStride, workers);
+}
+
+template void executeOperations(const OperationChain &, const uint8_t *, size_t, uint8_t *, size_t, WorkerPool *);
+template void executeOperations(const OperationChain &, const uint16_t *, size_t, uint16_t *, size_t, WorkerPool *);
+template void executeOperations(const OperationChain &, const uint32_t *, size_t, uint32_t *, size_t, WorkerPool *);
+template void executeOperations(const OperationChain &, const uint64_t *, size_t, uint64_t *, size_t, WorkerPool *);
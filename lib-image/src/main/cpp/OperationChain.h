@@ -0,0 +1,87 @@
+#ifndef LEOANDROIDBASEUTIL_OPERATIONCHAIN_H
+#define LEOANDROIDBASEUTIL_OPERATIONCHAIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class WorkerPool;
+
+// A list of bitmap operations composed into a single mapping from the output pixels to the source pixels,
+// so crop -> rotate -> scale costs one pass and one destination buffer instead of three.
+//
+// The operations are given as a flat array, every operation code followed by its arguments:
+//   kOperationCrop left top right bottom
+//   kOperationRotateCw90, kOperationRotateCcw90, kOperationRotate180
+//   kOperationFlipHorizontal, kOperationFlipVertical
+//   kOperationScale newWidth newHeight method
+// Coordinates and sizes are those of the image produced by the previous operations.
+//
+// A nearest neighbour scale picks the pixels of scalePixelsNN, floor(x * width / newWidth),
+// so a chain with a single scale gives the same pixels as the operations applied one after another.
+// Several scales are composed into one and only approximate the successive ones.
+
+enum ChainOperation
+{
+    kOperationCrop = 0,
+    kOperationRotateCw90 = 1,
+    kOperationRotateCcw90 = 2,
+    kOperationRotate180 = 3,
+    kOperationFlipHorizontal = 4,
+    kOperationFlipVertical = 5,
+    kOperationScale = 6,
+};
+
+enum ChainScaleMethod
+{
+    kChainScaleNearestNeighbour = 0,
+    kChainScaleBilinear = 1,
+    kChainScaleBox = 2,
+    kChainScaleLanczos3 = 3,
+};
+
+/**
+ * maps the center of the output pixel (x, y) to the source:
+ *   sourceX = xx * (x + 0.5) + xy * (y + 0.5) + x0
+ *   sourceY = yx * (x + 0.5) + yy * (y + 0.5) + y0
+ * one of xx and xy is 0 and so is one of yx and yy, the operations only swap, mirror and stretch the axes.
+ */
+typedef struct
+{
+    uint32_t srcWidth, srcHeight;
+    uint32_t width, height;
+    double xx, xy, x0;
+    double yx, yy, y0;
+    /**
+     * 1 if a source coordinate on a pixel boundary takes the pixel after it, -1 the one before it.
+     * it is the direction of the source axis in the input of the last kOperationScale,
+     * so the nearest neighbours are the same as when every operation is applied one after another.
+     */
+    int32_t xTieBreak, yTieBreak;
+    /** the method of the last kOperationScale, nearest neighbour when there is none */
+    int32_t scaleMethod;
+} OperationChain;
+
+/**
+ * composes [length] ints of [operations] applied to a [width] x [height] image.
+ *
+ * @return false if the operations are malformed or a crop or scale is out of bounds, [chain] is undefined then
+ */
+bool composeOperations(const int32_t *operations, uint32_t length, uint32_t width, uint32_t height,
+                       OperationChain *chain);
+
+/**
+ * renders [chain] from [src] into [dst] of chain.width x chain.height pixels, of any pixel type of BitmapTransform.h.
+ *
+ * Without a filtered scale it is a single pass. With one, the cropped source is scaled in its own orientation first
+ * and then rotated or flipped into [dst] when needed, since all filters of BitmapScaler are separable.
+ * A crop following a filtered scale is rounded to whole source pixels.
+ *
+ * @param srcStride the distance between two source rows, in pixels
+ * @param dstStride the distance between two destination rows, in pixels
+ * @param workers the pool which runs the bands of output rows of every pass, or NULL to run on the calling thread
+ */
+template <typename Pixel>
+void executeOperations(const OperationChain &chain, const Pixel *src, size_t srcStride,
+                       Pixel *dst, size_t dstStride, WorkerPool *workers = NULL);
+
+#endif // LEOANDROIDBASEUTIL_OPERATIONCHAIN_H
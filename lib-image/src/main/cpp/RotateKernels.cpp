@@ -0,0 +1,591 @@
+#include "RotateKernels.h"
+#include "WorkerPool.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ROTATE_HAS_X86 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ROTATE_HAS_NEON 1
+#if defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+// A tile of 16x16 pixels touches 16 source and 16 destination rows, i.e. at most 32 pages.
+// Larger tiles still fit in L1 but measured slower on big frames, where every row is a TLB miss.
+static const uint32_t kTileSize = 16;
+
+// --------------------
+// Block transposes.
+//
+// dst[j][i] = src[i][j] for a square block. Strides are in pixels and may be negative,
+// which lets the same transpose rotate clockwise (source rows read bottom up)
+// or counter clockwise (destination rows written bottom up).
+// --------------------
+
+template <typename Pixel>
+static inline void transposeScalar8x8(const Pixel *src, ptrdiff_t srcStride, Pixel *dst, ptrdiff_t dstStride)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        for (int j = 0; j < 8; ++j)
+        {
+            dst[j * dstStride + i] = src[i * srcStride + j];
+        }
+    }
+}
+
+#if ROTATE_HAS_X86
+static inline void transposeSse2_4x4(const uint32_t *src, ptrdiff_t srcStride, uint32_t *dst, ptrdiff_t dstStride)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(src));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(src + srcStride));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(src + 2 * srcStride));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(src + 3 * srcStride));
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1); // a0 b0 a1 b1
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3); // c0 d0 c1 d1
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1); // a2 b2 a3 b3
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3); // c2 d2 c3 d3
+    _mm_storeu_si128((__m128i *)(dst), _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)(dst + dstStride), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i *)(dst + 2 * dstStride), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i *)(dst + 3 * dstStride), _mm_unpackhi_epi64(t2, t3));
+}
+
+static inline void transposeSse2_8x8(const uint32_t *src, ptrdiff_t srcStride, uint32_t *dst, ptrdiff_t dstStride)
+{
+    transposeSse2_4x4(src, srcStride, dst, dstStride);
+    transposeSse2_4x4(src + 4, srcStride, dst + 4 * dstStride, dstStride);
+    transposeSse2_4x4(src + 4 * srcStride, srcStride, dst + 4, dstStride);
+    transposeSse2_4x4(src + 4 * srcStride + 4, srcStride, dst + 4 * dstStride + 4, dstStride);
+}
+
+/** 16-bit pixels, a whole block row fits in one register */
+static inline void transposeSse2_8x8(const uint16_t *src, ptrdiff_t srcStride, uint16_t *dst, ptrdiff_t dstStride)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(src));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(src + srcStride));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(src + 2 * srcStride));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(src + 3 * srcStride));
+    __m128i r4 = _mm_loadu_si128((const __m128i *)(src + 4 * srcStride));
+    __m128i r5 = _mm_loadu_si128((const __m128i *)(src + 5 * srcStride));
+    __m128i r6 = _mm_loadu_si128((const __m128i *)(src + 6 * srcStride));
+    __m128i r7 = _mm_loadu_si128((const __m128i *)(src + 7 * srcStride));
+
+    __m128i t0 = _mm_unpacklo_epi16(r0, r1); // a0 b0 a1 b1 a2 b2 a3 b3
+    __m128i t1 = _mm_unpackhi_epi16(r0, r1); // a4 b4 ... a7 b7
+    __m128i t2 = _mm_unpacklo_epi16(r2, r3);
+    __m128i t3 = _mm_unpackhi_epi16(r2, r3);
+    __m128i t4 = _mm_unpacklo_epi16(r4, r5);
+    __m128i t5 = _mm_unpackhi_epi16(r4, r5);
+    __m128i t6 = _mm_unpacklo_epi16(r6, r7);
+    __m128i t7 = _mm_unpackhi_epi16(r6, r7);
+
+    __m128i u0 = _mm_unpacklo_epi32(t0, t2); // a0 b0 c0 d0 a1 b1 c1 d1
+    __m128i u1 = _mm_unpackhi_epi32(t0, t2); // a2 b2 c2 d2 a3 b3 c3 d3
+    __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+    __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+    __m128i u4 = _mm_unpacklo_epi32(t4, t6); // e0 f0 g0 h0 e1 f1 g1 h1
+    __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+    __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+    __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+    _mm_storeu_si128((__m128i *)(dst), _mm_unpacklo_epi64(u0, u4));
+    _mm_storeu_si128((__m128i *)(dst + dstStride), _mm_unpackhi_epi64(u0, u4));
+    _mm_storeu_si128((__m128i *)(dst + 2 * dstStride), _mm_unpacklo_epi64(u1, u5));
+    _mm_storeu_si128((__m128i *)(dst + 3 * dstStride), _mm_unpackhi_epi64(u1, u5));
+    _mm_storeu_si128((__m128i *)(dst + 4 * dstStride), _mm_unpacklo_epi64(u2, u6));
+    _mm_storeu_si128((__m128i *)(dst + 5 * dstStride), _mm_unpackhi_epi64(u2, u6));
+    _mm_storeu_si128((__m128i *)(dst + 6 * dstStride), _mm_unpacklo_epi64(u3, u7));
+    _mm_storeu_si128((__m128i *)(dst + 7 * dstStride), _mm_unpackhi_epi64(u3, u7));
+}
+
+__attribute__((target("avx2"))) static inline void transposeAvx2_8x8(const uint32_t *src, ptrdiff_t srcStride,
+                                                                      uint32_t *dst, ptrdiff_t dstStride)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)(src));
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)(src + srcStride));
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)(src + 2 * srcStride));
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)(src + 3 * srcStride));
+    __m256i r4 = _mm256_loadu_si256((const __m256i *)(src + 4 * srcStride));
+    __m256i r5 = _mm256_loadu_si256((const __m256i *)(src + 5 * srcStride));
+    __m256i r6 = _mm256_loadu_si256((const __m256i *)(src + 6 * srcStride));
+    __m256i r7 = _mm256_loadu_si256((const __m256i *)(src + 7 * srcStride));
+
+    // transpose the 2x2 blocks of pixels, then of pairs, then swap the 128-bit lanes
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    _mm256_storeu_si256((__m256i *)(dst), _mm256_permute2x128_si256(u0, u4, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + dstStride), _mm256_permute2x128_si256(u1, u5, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 2 * dstStride), _mm256_permute2x128_si256(u2, u6, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 3 * dstStride), _mm256_permute2x128_si256(u3, u7, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 4 * dstStride), _mm256_permute2x128_si256(u0, u4, 0x31));
+    _mm256_storeu_si256((__m256i *)(dst + 5 * dstStride), _mm256_permute2x128_si256(u1, u5, 0x31));
+    _mm256_storeu_si256((__m256i *)(dst + 6 * dstStride), _mm256_permute2x128_si256(u2, u6, 0x31));
+    _mm256_storeu_si256((__m256i *)(dst + 7 * dstStride), _mm256_permute2x128_si256(u3, u7, 0x31));
+}
+#endif
+
+#if ROTATE_HAS_NEON
+static inline void transposeNeon4x4(const uint32_t *src, ptrdiff_t srcStride, uint32_t *dst, ptrdiff_t dstStride)
+{
+    uint32x4_t r0 = vld1q_u32(src);
+    uint32x4_t r1 = vld1q_u32(src + srcStride);
+    uint32x4_t r2 = vld1q_u32(src + 2 * srcStride);
+    uint32x4_t r3 = vld1q_u32(src + 3 * srcStride);
+    uint32x4x2_t t01 = vtrnq_u32(r0, r1); // a0 b0 a2 b2 | a1 b1 a3 b3
+    uint32x4x2_t t23 = vtrnq_u32(r2, r3); // c0 d0 c2 d2 | c1 d1 c3 d3
+    vst1q_u32(dst, vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+    vst1q_u32(dst + dstStride, vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+    vst1q_u32(dst + 2 * dstStride, vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+    vst1q_u32(dst + 3 * dstStride, vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+}
+
+static inline void transposeNeon8x8(const uint32_t *src, ptrdiff_t srcStride, uint32_t *dst, ptrdiff_t dstStride)
+{
+    transposeNeon4x4(src, srcStride, dst, dstStride);
+    transposeNeon4x4(src + 4, srcStride, dst + 4 * dstStride, dstStride);
+    transposeNeon4x4(src + 4 * srcStride, srcStride, dst + 4, dstStride);
+    transposeNeon4x4(src + 4 * srcStride + 4, srcStride, dst + 4 * dstStride + 4, dstStride);
+}
+
+static inline uint16x8_t combineLow(uint32x4_t a, uint32x4_t b)
+{
+    return vreinterpretq_u16_u32(vcombine_u32(vget_low_u32(a), vget_low_u32(b)));
+}
+
+static inline uint16x8_t combineHigh(uint32x4_t a, uint32x4_t b)
+{
+    return vreinterpretq_u16_u32(vcombine_u32(vget_high_u32(a), vget_high_u32(b)));
+}
+
+/** 16-bit pixels, a whole block row fits in one register */
+static inline void transposeNeon8x8(const uint16_t *src, ptrdiff_t srcStride, uint16_t *dst, ptrdiff_t dstStride)
+{
+    uint16x8x2_t t01 = vtrnq_u16(vld1q_u16(src), vld1q_u16(src + srcStride)); // a0 b0 a2 b2 .. | a1 b1 a3 b3 ..
+    uint16x8x2_t t23 = vtrnq_u16(vld1q_u16(src + 2 * srcStride), vld1q_u16(src + 3 * srcStride));
+    uint16x8x2_t t45 = vtrnq_u16(vld1q_u16(src + 4 * srcStride), vld1q_u16(src + 5 * srcStride));
+    uint16x8x2_t t67 = vtrnq_u16(vld1q_u16(src + 6 * srcStride), vld1q_u16(src + 7 * srcStride));
+    // a0 b0 c0 d0 a4 b4 c4 d4 | a2 b2 c2 d2 a6 b6 c6 d6
+    uint32x4x2_t u02 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[0]), vreinterpretq_u32_u16(t23.val[0]));
+    // a1 b1 c1 d1 a5 b5 c5 d5 | a3 b3 c3 d3 a7 b7 c7 d7
+    uint32x4x2_t u13 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[1]), vreinterpretq_u32_u16(t23.val[1]));
+    uint32x4x2_t u46 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[0]), vreinterpretq_u32_u16(t67.val[0]));
+    uint32x4x2_t u57 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[1]), vreinterpretq_u32_u16(t67.val[1]));
+    vst1q_u16(dst, combineLow(u02.val[0], u46.val[0]));
+    vst1q_u16(dst + dstStride, combineLow(u13.val[0], u57.val[0]));
+    vst1q_u16(dst + 2 * dstStride, combineLow(u02.val[1], u46.val[1]));
+    vst1q_u16(dst + 3 * dstStride, combineLow(u13.val[1], u57.val[1]));
+    vst1q_u16(dst + 4 * dstStride, combineHigh(u02.val[0], u46.val[0]));
+    vst1q_u16(dst + 5 * dstStride, combineHigh(u13.val[0], u57.val[0]));
+    vst1q_u16(dst + 6 * dstStride, combineHigh(u02.val[1], u46.val[1]));
+    vst1q_u16(dst + 7 * dstStride, combineHigh(u13.val[1], u57.val[1]));
+}
+#endif
+
+// --------------------
+// Tiling.
+// --------------------
+
+template <typename Pixel>
+static inline void rotatePixelScalar(const Pixel *src, uint32_t width, uint32_t height, size_t srcStride,
+                                     Pixel *dst, size_t dstStride, bool clockwise, uint32_t x, uint32_t y)
+{
+    Pixel pixel = src[y * srcStride + x];
+    if (clockwise)
+        dst[x * dstStride + (height - 1 - y)] = pixel;
+    else
+        dst[(width - 1 - x) * dstStride + y] = pixel;
+}
+
+/**
+ * walks the frame in tiles and each tile in 8x8 blocks, the pixels of incomplete blocks at the right and
+ * bottom edges are rotated one by one.
+ *
+ * clockwise:         dst[x][height - 1 - y] = src[y][x], so the block is read from its last row upward.
+ * counter clockwise: dst[width - 1 - x][y] = src[y][x], so the block is written from its last row upward.
+ */
+template <typename Pixel, void (*Transpose8x8)(const Pixel *, ptrdiff_t, Pixel *, ptrdiff_t)>
+static void rotateTiled(const Pixel *src, uint32_t width, uint32_t height, size_t srcStride,
+                        Pixel *dst, size_t dstStride, bool clockwise)
+{
+    const uint32_t block = 8;
+    uint32_t blockWidth = width - width % block;
+    uint32_t blockHeight = height - height % block;
+    ptrdiff_t ss = (ptrdiff_t)srcStride;
+    ptrdiff_t ds = (ptrdiff_t)dstStride;
+
+    for (uint32_t ty = 0; ty < blockHeight; ty += kTileSize)
+    {
+        uint32_t tyEnd = ty + kTileSize < blockHeight ? ty + kTileSize : blockHeight;
+        for (uint32_t tx = 0; tx < blockWidth; tx += kTileSize)
+        {
+            uint32_t txEnd = tx + kTileSize < blockWidth ? tx + kTileSize : blockWidth;
+            for (uint32_t y = ty; y < tyEnd; y += block)
+            {
+                for (uint32_t x = tx; x < txEnd; x += block)
+                {
+                    if (clockwise)
+                    {
+                        // the last source row of the block becomes the first destination column
+                        Transpose8x8(src + (y + block - 1) * ss + x, -ss,
+                                     dst + x * ds + (height - y - block), ds);
+                    }
+                    else
+                    {
+                        // the first source column of the block becomes the last destination row
+                        Transpose8x8(src + y * ss + x, ss,
+                                     dst + (width - 1 - x) * ds + y, -ds);
+                    }
+                }
+            }
+        }
+    }
+
+    // right edge
+    for (uint32_t y = 0; y < blockHeight; ++y)
+        for (uint32_t x = blockWidth; x < width; ++x)
+            rotatePixelScalar(src, width, height, srcStride, dst, dstStride, clockwise, x, y);
+    // bottom edge
+    for (uint32_t y = blockHeight; y < height; ++y)
+        for (uint32_t x = 0; x < width; ++x)
+            rotatePixelScalar(src, width, height, srcStride, dst, dstStride, clockwise, x, y);
+}
+
+static void rotateWithKernel(const uint32_t *src, uint32_t width, uint32_t height, size_t srcStride,
+                             uint32_t *dst, size_t dstStride, bool clockwise, RotateKernel kernel)
+{
+    switch (kernel)
+    {
+#if ROTATE_HAS_X86
+    case kRotateKernelAvx2:
+        rotateTiled<uint32_t, transposeAvx2_8x8>(src, width, height, srcStride, dst, dstStride, clockwise);
+        break;
+    case kRotateKernelSse2:
+        rotateTiled<uint32_t, transposeSse2_8x8>(src, width, height, srcStride, dst, dstStride, clockwise);
+        break;
+#endif
+#if ROTATE_HAS_NEON
+    case kRotateKernelNeon:
+        rotateTiled<uint32_t, transposeNeon8x8>(src, width, height, srcStride, dst, dstStride, clockwise);
+        break;
+#endif
+    default:
+        rotateTiled<uint32_t, transposeScalar8x8<uint32_t> >(src, width, height, srcStride, dst, dstStride, clockwise);
+        break;
+    }
+}
+
+static void rotateWithKernel(const uint16_t *src, uint32_t width, uint32_t height, size_t srcStride,
+                             uint16_t *dst, size_t dstStride, bool clockwise, RotateKernel kernel)
+{
+    switch (kernel)
+    {
+#if ROTATE_HAS_X86
+    // a block of 16-bit pixels is one register wide, AVX2 has nothing to add
+    case kRotateKernelAvx2:
+    case kRotateKernelSse2:
+        rotateTiled<uint16_t, transposeSse2_8x8>(src, width, height, srcStride, dst, dstStride, clockwise);
+        break;
+#endif
+#if ROTATE_HAS_NEON
+    case kRotateKernelNeon:
+        rotateTiled<uint16_t, transposeNeon8x8>(src, width, height, srcStride, dst, dstStride, clockwise);
+        break;
+#endif
+    default:
+        rotateTiled<uint16_t, transposeScalar8x8<uint16_t> >(src, width, height, srcStride, dst, dstStride, clockwise);
+        break;
+    }
+}
+
+/** 8 and 64-bit pixels only have the scalar kernel */
+template <typename Pixel>
+static void rotateWithKernel(const Pixel *src, uint32_t width, uint32_t height, size_t srcStride,
+                             Pixel *dst, size_t dstStride, bool clockwise, RotateKernel)
+{
+    rotateTiled<Pixel, transposeScalar8x8<Pixel> >(src, width, height, srcStride, dst, dstStride, clockwise);
+}
+
+template <typename Pixel>
+void rotatePixels90(const Pixel *src, uint32_t width, uint32_t height, size_t srcStride,
+                    Pixel *dst, size_t dstStride, bool clockwise, RotateKernel kernel)
+{
+    if (!isRotateKernelSupported(kernel))
+        kernel = kRotateKernelScalar;
+    rotateWithKernel(src, width, height, srcStride, dst, dstStride, clockwise, kernel);
+}
+
+template void rotatePixels90(const uint8_t *, uint32_t, uint32_t, size_t, uint8_t *, size_t, bool, RotateKernel);
+template void rotatePixels90(const uint16_t *, uint32_t, uint32_t, size_t, uint16_t *, size_t, bool, RotateKernel);
+template void rotatePixels90(const uint32_t *, uint32_t, uint32_t, size_t, uint32_t *, size_t, bool, RotateKernel);
+template void rotatePixels90(const uint64_t *, uint32_t, uint32_t, size_t, uint64_t *, size_t, bool, RotateKernel);
+
+// --------------------
+// In-place transposition.
+//
+// The buffer is seen as the source grid of [height] rows by [width] columns.
+// The pixel of row i and column j has to end up at p = j * height + i, i.e. row p / width and column p % width.
+// With g = gcd(width, height) and b = width / g:
+//   1. rotate column j down by j / b                    (only when g > 1)
+//   2. in every row, move column j to (j * height + i) % width
+//   3. in every column, move the pixel of source (i, j) to row p / width
+// Step 1 makes step 2 a permutation of each row when width and height are not coprime.
+// --------------------
+
+// Columns are moved in groups of up to 64 (256 bytes of every row), fewer for narrow frames
+// so the scratch buffer stays below 1/16 of the frame, and fewer for tall frames
+// so the scratch buffer of a group stays below kMaxGroupScratchBytes unless a single column is larger.
+static const uint32_t kMaxColumnGroup = 64;
+static const size_t kMaxGroupScratchBytes = 256 * 1024;
+// With workers each band moves narrower groups, but not narrower than this.
+static const uint32_t kMinBandColumnGroup = 16;
+
+static uint32_t greatestCommonDivisor(uint32_t a, uint32_t b)
+{
+    while (b != 0)
+    {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/** step 1 on the columns [first, end), [scratch] holds the [height] x [groupWidth] pixels of the columns being moved */
+template <typename Pixel>
+static void rotateColumns(Pixel *pixels, uint32_t width, uint32_t height, uint32_t b, uint32_t group,
+                          uint32_t first, uint32_t end, Pixel *scratch)
+{
+    uint32_t shift[kMaxColumnGroup];
+    for (uint32_t j0 = first; j0 < end; j0 += group)
+    {
+        uint32_t groupWidth = end - j0 < group ? end - j0 : group;
+        for (uint32_t i = 0; i < height; ++i)
+            memcpy(scratch + i * groupWidth, pixels + (size_t)i * width + j0, groupWidth * sizeof(Pixel));
+        // (j0 + k) / b < g <= height
+        for (uint32_t k = 0; k < groupWidth; ++k)
+            shift[k] = height - (j0 + k) / b;
+        for (uint32_t i = 0; i < height; ++i)
+        {
+            Pixel *row = pixels + (size_t)i * width + j0;
+            for (uint32_t k = 0; k < groupWidth; ++k)
+            {
+                // the source row is (i - (j0 + k) / b) mod height
+                uint32_t from = i + shift[k];
+                if (from >= height)
+                    from -= height;
+                row[k] = scratch[from * groupWidth + k];
+            }
+        }
+    }
+}
+
+/** step 2 on the rows [first, end), [scratch] holds one row */
+template <typename Pixel>
+static void shuffleRows(Pixel *pixels, uint32_t width, uint32_t height, uint32_t b,
+                        uint32_t first, uint32_t end, Pixel *scratch)
+{
+    uint32_t heightModWidth = height % width;
+    for (uint32_t row = first; row < end; ++row)
+    {
+        Pixel *line = pixels + (size_t)row * width;
+        // j * height % width, the source row i of column j and i % width, updated incrementally
+        uint32_t product = 0;
+        uint32_t i = row;
+        uint32_t iModWidth = i % width;
+        uint32_t untilNextShift = b;
+        for (uint32_t j = 0; j < width; ++j)
+        {
+            uint32_t to = product + iModWidth;
+            if (to >= width)
+                to -= width;
+            scratch[to] = line[j];
+
+            product += heightModWidth;
+            if (product >= width)
+                product -= width;
+            if (--untilNextShift == 0)
+            {
+                // step 1 moved the next columns one more row down
+                untilNextShift = b;
+                i = i == 0 ? height - 1 : i - 1;
+                iModWidth = i % width;
+            }
+        }
+        memcpy(line, scratch, width * sizeof(Pixel));
+    }
+}
+
+/** step 3 on the columns [first, end), [scratch] holds the [height] x [groupWidth] pixels of the columns being moved */
+template <typename Pixel>
+static void shuffleColumns(Pixel *pixels, uint32_t width, uint32_t height, uint32_t b, uint32_t group,
+                           uint32_t first, uint32_t end, Pixel *scratch)
+{
+    for (uint32_t j0 = first; j0 < end; j0 += group)
+    {
+        uint32_t groupWidth = end - j0 < group ? end - j0 : group;
+        for (uint32_t r = 0; r < height; ++r)
+            memcpy(scratch + r * groupWidth, pixels + (size_t)r * width + j0, groupWidth * sizeof(Pixel));
+        for (uint32_t r = 0; r < height; ++r)
+        {
+            // the pixel of row r and column j0 + k comes from p = r * width + j0 + k,
+            // i.e. source (i, j) = (p % height, p / height), which steps 1 and 2 left at row (i + j / b) % height.
+            // p grows by one along the row, so only the first source is divided.
+            uint64_t p = (uint64_t)r * width + j0;
+            uint32_t i = (uint32_t)(p % height);
+            uint32_t j = (uint32_t)(p / height);
+            uint32_t from = i + j / b;
+            if (from >= height)
+                from -= height;
+            Pixel *row = pixels + (size_t)r * width + j0;
+            for (uint32_t k = 0; k < groupWidth; ++k)
+            {
+                row[k] = scratch[from * groupWidth + k];
+                if (++from == height)
+                    from = 0;
+                if (++i == height)
+                {
+                    // next j, which may have been rotated one more row down by step 1
+                    i = 0;
+                    ++j;
+                    from = j / b;
+                }
+            }
+        }
+    }
+}
+
+template <typename Pixel>
+void transposePixelsInPlace(Pixel *pixels, uint32_t width, uint32_t height, WorkerPool *workers)
+{
+    // a single row or column is its own transpose
+    if (width <= 1 || height <= 1)
+        return;
+    uint32_t g = greatestCommonDivisor(width, height);
+    uint32_t b = width / g;
+    uint32_t group = width / 16;
+    if (group > kMaxColumnGroup)
+        group = kMaxColumnGroup;
+    size_t budgetGroup = kMaxGroupScratchBytes / ((size_t)height * sizeof(Pixel));
+    if (group > budgetGroup)
+        group = (uint32_t)budgetGroup;
+    if (workers != NULL && workers->threadCount() > 1)
+    {
+        // every band moves its own group of columns, narrower ones so the scratch buffers together stay
+        // about as small, but at least a cache line of every row
+        uint32_t bandGroup = group / workers->threadCount();
+        group = bandGroup < kMinBandColumnGroup ? (group < kMinBandColumnGroup ? group : kMinBandColumnGroup)
+                                                : bandGroup;
+    }
+    if (group == 0)
+        group = 1;
+
+    if (g > 1)
+    {
+        forEachBand(workers, width, group, [&](uint32_t first, uint32_t end) {
+            Pixel *scratch = new Pixel[(size_t)height * group];
+            rotateColumns(pixels, width, height, b, group, first, end, scratch);
+            delete[] scratch;
+        });
+    }
+    forEachBand(workers, height, 1, [&](uint32_t first, uint32_t end) {
+        Pixel *scratch = new Pixel[width];
+        shuffleRows(pixels, width, height, b, first, end, scratch);
+        delete[] scratch;
+    });
+    forEachBand(workers, width, group, [&](uint32_t first, uint32_t end) {
+        Pixel *scratch = new Pixel[(size_t)height * group];
+        shuffleColumns(pixels, width, height, b, group, first, end, scratch);
+        delete[] scratch;
+    });
+}
+
+template void transposePixelsInPlace(uint8_t *, uint32_t, uint32_t, WorkerPool *);
+template void transposePixelsInPlace(uint16_t *, uint32_t, uint32_t, WorkerPool *);
+template void transposePixelsInPlace(uint32_t *, uint32_t, uint32_t, WorkerPool *);
+template void transposePixelsInPlace(uint64_t *, uint32_t, uint32_t, WorkerPool *);
+
+// --------------------
+// CPU feature detection.
+// --------------------
+
+bool isRotateKernelSupported(RotateKernel kernel)
+{
+    switch (kernel)
+    {
+    case kRotateKernelScalar:
+        return true;
+#if ROTATE_HAS_X86
+    case kRotateKernelSse2:
+        return __builtin_cpu_supports("sse2");
+    case kRotateKernelAvx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#if ROTATE_HAS_NEON
+    case kRotateKernelNeon:
+#if defined(__arm__)
+        // NEON is optional on ARMv7
+        return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+        return true;
+#endif
+#endif
+    default:
+        return false;
+    }
+}
+
+static RotateKernel detectRotateKernel()
+{
+    static const RotateKernel preference[] = {kRotateKernelAvx2, kRotateKernelNeon, kRotateKernelSse2};
+    for (RotateKernel kernel : preference)
+    {
+        if (isRotateKernelSupported(kernel))
+            return kernel;
+    }
+    return kRotateKernelScalar;
+}
+
+RotateKernel bestRotateKernel()
+{
+    static const RotateKernel kernel = detectRotateKernel();
+    return kernel;
+}
+
+const char *rotateKernelName(RotateKernel kernel)
+{
+    switch (kernel)
+    {
+    case kRotateKernelSse2:
+        return "sse2";
+    case kRotateKernelAvx2:
+        return "avx2";
+    case kRotateKernelNeon:
+        return "neon";
+    default:
+        return "scalar";
+    }
+}
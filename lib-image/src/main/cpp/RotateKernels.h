@@ -0,0 +1,58 @@
+#ifndef LEOANDROIDBASEUTIL_ROTATEKERNELS_H
+#define LEOANDROIDBASEUTIL_ROTATEKERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class WorkerPool;
+
+// Cache-blocked 90 degree rotation of 8, 16, 32 and 64-bit pixels.
+//
+// The frame is walked in small tiles so the source and destination lines of a tile stay in L1
+// and their pages in the TLB.
+// Inside a tile, square blocks are transposed in registers by the selected kernel,
+// so whole destination rows are written instead of single pixels of a column.
+// The SIMD kernels cover 32-bit pixels and, except AVX2 which falls back to SSE2, 16-bit ones.
+// Other pixels always use the scalar kernel.
+
+enum RotateKernel
+{
+    kRotateKernelScalar = 0,
+    kRotateKernelSse2 = 1,
+    kRotateKernelAvx2 = 2,
+    kRotateKernelNeon = 3,
+};
+
+/** the fastest kernel supported by the running CPU, detected once */
+RotateKernel bestRotateKernel();
+
+/** whether the running CPU and the current build support [kernel] */
+bool isRotateKernelSupported(RotateKernel kernel);
+
+const char *rotateKernelName(RotateKernel kernel);
+
+/**
+ * rotates [src] by 90 degrees into [dst], which is [height] pixels wide and [width] pixels high.
+ *
+ * @param srcStride the distance between two source rows, in pixels
+ * @param dstStride the distance between two destination rows, in pixels
+ */
+template <typename Pixel>
+void rotatePixels90(const Pixel *src, uint32_t width, uint32_t height, size_t srcStride,
+                    Pixel *dst, size_t dstStride, bool clockwise, RotateKernel kernel);
+
+/**
+ * transposes the [width] x [height] [pixels] in place, so they become [height] pixels wide and [width] pixels high.
+ *
+ * Follows "A Decomposition for In-place Matrix Transposition" (Catanzaro et al., PPoPP 2014):
+ * a column rotation, a shuffle within every row and a shuffle within every column.
+ * Columns are moved up to 64 at a time through a scratch buffer of at most 256 KB, or of one column
+ * when a single column is larger. The row shuffle uses a scratch buffer of one row.
+ * It is several times slower than [rotatePixels90] and meant for frames which cannot afford a second copy.
+ * With [workers] every step is split into bands of rows or columns, each with its own scratch buffer,
+ * so the peak is one such buffer per thread.
+ */
+template <typename Pixel>
+void transposePixelsInPlace(Pixel *pixels, uint32_t width, uint32_t height, WorkerPool *workers = NULL);
+
+#endif // LEOANDROIDBASEUTIL_ROTATEKERNELS_H
@@ -0,0 +1,117 @@
+#include "WorkerPool.h"
+
+// bands of fewer rows are not worth waking up a thread
+static const uint32_t kMinBandRows = 32;
+
+WorkerPool::WorkerPool(uint32_t threadCount)
+    : _threadCount(threadCount < 1 ? 1 : threadCount), _task(NULL), _taskCount(0), _nextTask(0), _activeWorkers(0),
+      _generation(0), _stop(false)
+{
+    for (uint32_t i = 1; i < _threadCount; ++i)
+        _threads.push_back(std::thread(&WorkerPool::workerLoop, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _workCondition.notify_all();
+    for (size_t i = 0; i < _threads.size(); ++i)
+        _threads[i].join();
+}
+
+void WorkerPool::parallelFor(uint32_t taskCount, const std::function<void(uint32_t)> &task)
+{
+    if (taskCount == 0)
+        return;
+    if (_threads.empty() || taskCount == 1)
+    {
+        for (uint32_t i = 0; i < taskCount; ++i)
+            task(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(_runMutex);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &task;
+        _taskCount = taskCount;
+        _nextTask = 0;
+        ++_generation;
+    }
+    _workCondition.notify_all();
+
+    runTasks(task, taskCount);
+
+    // all tasks have been taken once the caller returns from runTasks, wait for the workers still running one.
+    // a worker waking up late finds no task to take.
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_activeWorkers != 0)
+        _doneCondition.wait(lock);
+    _task = NULL;
+    _taskCount = 0;
+}
+
+void WorkerPool::workerLoop()
+{
+    uint64_t seenGeneration = 0;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        while (!_stop && _generation == seenGeneration)
+            _workCondition.wait(lock);
+        if (_stop)
+            return;
+        seenGeneration = _generation;
+        if (_task == NULL || _nextTask >= _taskCount)
+            continue;
+
+        const std::function<void(uint32_t)> *task = _task;
+        uint32_t taskCount = _taskCount;
+        ++_activeWorkers;
+        lock.unlock();
+        runTasks(*task, taskCount);
+        lock.lock();
+        if (--_activeWorkers == 0)
+            _doneCondition.notify_all();
+    }
+}
+
+void WorkerPool::runTasks(const std::function<void(uint32_t)> &task, uint32_t taskCount)
+{
+    while (true)
+    {
+        uint32_t index;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_nextTask >= taskCount)
+                return;
+            index = _nextTask++;
+        }
+        task(index);
+    }
+}
+
+void forEachBand(WorkerPool *workers, uint32_t count, uint32_t alignment,
+                 const std::function<void(uint32_t, uint32_t)> &fn)
+{
+    if (alignment == 0)
+        alignment = 1;
+    uint32_t units = count / alignment;
+    uint32_t bands = workers == NULL ? 1 : workers->threadCount();
+    uint32_t maxBands = count / (alignment > kMinBandRows ? alignment : kMinBandRows);
+    if (bands > maxBands)
+        bands = maxBands;
+    if (bands <= 1 || units < bands)
+    {
+        fn(0, count);
+        return;
+    }
+    workers->parallelFor(bands, [&](uint32_t band) {
+        uint32_t first = (uint32_t)((uint64_t)units * band / bands) * alignment;
+        uint32_t end = band == bands - 1 ? count : (uint32_t)((uint64_t)units * (band + 1) / bands) * alignment;
+        fn(first, end);
+    });
+}
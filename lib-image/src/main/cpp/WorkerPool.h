@@ -0,0 +1,68 @@
+#ifndef LEOANDROIDBASEUTIL_BITMAPWORKERPOOL_H
+#define LEOANDROIDBASEUTIL_BITMAPWORKERPOOL_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * a fixed set of threads which run the tasks of parallelFor() together with the calling thread.
+ * parallelFor() may be called from multiple threads, the calls are executed one after another.
+ *
+ * the pixel loops take an optional pool and split their rows into bands with forEachBand(),
+ * without one they run on the calling thread.
+ */
+class WorkerPool
+{
+public:
+    /** [threadCount] includes the calling thread, so threadCount - 1 threads are started */
+    explicit WorkerPool(uint32_t threadCount);
+
+    ~WorkerPool();
+
+    uint32_t threadCount() const
+    {
+        return _threadCount;
+    }
+
+    /** runs task(0) to task(taskCount - 1) across the threads and waits for all of them to finish */
+    void parallelFor(uint32_t taskCount, const std::function<void(uint32_t)> &task);
+
+private:
+    WorkerPool(const WorkerPool &);
+    WorkerPool &operator=(const WorkerPool &);
+
+    void workerLoop();
+
+    void runTasks(const std::function<void(uint32_t)> &task, uint32_t taskCount);
+
+    uint32_t _threadCount;
+    std::vector<std::thread> _threads;
+
+    // serializes the callers of parallelFor
+    std::mutex _runMutex;
+
+    // guards all the fields below
+    std::mutex _mutex;
+    std::condition_variable _workCondition;
+    std::condition_variable _doneCondition;
+    const std::function<void(uint32_t)> *_task;
+    uint32_t _taskCount;
+    uint32_t _nextTask;
+    uint32_t _activeWorkers;
+    uint64_t _generation;
+    bool _stop;
+};
+
+/**
+ * splits [count] rows (or columns) into one band per thread, whose boundaries are multiples of [alignment],
+ * and calls fn(first, end) for every band on [workers].
+ * without [workers], or when there are too few rows, fn(0, count) is called on the calling thread.
+ */
+void forEachBand(WorkerPool *workers, uint32_t count, uint32_t alignment,
+                 const std::function<void(uint32_t, uint32_t)> &fn);
+
+#endif // LEOANDROIDBASEUTIL_BITMAPWORKERPOOL_H
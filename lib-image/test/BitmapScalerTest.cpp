@@ -0,0 +1,171 @@
+// The fixed point scaler, with SSE2 or NEON for RGBA_8888, must stay within rounding of a floating point reference
+// which applies the same filters in double precision without any intermediate rounding.
+//
+// Flat areas must keep their exact color, whatever the filter and the size.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "BitmapScaler.h"
+
+namespace {
+
+struct ScaleCase {
+    uint32_t width, height, newWidth, newHeight;
+};
+
+const ScaleCase kScaleCases[] = {{64, 48, 32, 24}, {64, 48, 17, 13}, {40, 30, 97, 71}, {100, 10, 37, 29},
+                                 {7, 5, 7, 11}, {33, 33, 60, 33}, {1, 1, 5, 3}, {256, 192, 100, 75}};
+
+const ScaleFilter kFilters[] = {kScaleFilterBilinear, kScaleFilterBox, kScaleFilterLanczos3};
+
+double filterWeight(ScaleFilter filter, double x) {
+    switch (filter) {
+        case kScaleFilterBilinear:
+            return fabs(x) < 1.0 ? 1.0 - fabs(x) : 0.0;
+        case kScaleFilterBox:
+            return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+        default: {
+            if (x <= -3.0 || x >= 3.0) return 0.0;
+            if (x == 0.0) return 1.0;
+            double a = M_PI * x, b = a / 3.0;
+            return sin(a) / a * sin(b) / b;
+        }
+    }
+}
+
+double filterSupport(ScaleFilter filter) {
+    return filter == kScaleFilterBilinear ? 1.0 : filter == kScaleFilterBox ? 0.5 : 3.0;
+}
+
+/** the normalized weights of every source pixel for output pixel [i], along one axis */
+std::vector<double> referenceWeights(uint32_t srcSize, uint32_t dstSize, ScaleFilter filter, uint32_t i) {
+    double scale = (double) srcSize / dstSize;
+    double filterScale = scale > 1.0 ? scale : 1.0;
+    double support = filterSupport(filter) * filterScale;
+    double center = (i + 0.5) * scale;
+    std::vector<double> weights(srcSize, 0.0);
+    double sum = 0.0;
+    for (uint32_t k = 0; k < srcSize; ++k) {
+        // only the pixels whose center is within the support, as the filter is not continuous at its edges
+        if (k + 0.5 <= center - support || k + 0.5 > center + support) continue;
+        weights[k] = filterWeight(filter, (k - center + 0.5) / filterScale);
+        sum += weights[k];
+    }
+    if (sum == 0.0) {
+        // a box whose edge falls exactly on a pixel center keeps the pixel starting at the center
+        weights[std::min((uint32_t) center, srcSize - 1)] = 1.0;
+        return weights;
+    }
+    for (auto &w : weights) w /= sum;
+    return weights;
+}
+
+/** scales one 8-bit channel of [channels] interleaved ones */
+std::vector<double> scaleReference(const std::vector<uint8_t> &src, uint32_t channels, const ScaleCase &c,
+                                   ScaleFilter filter) {
+    std::vector<double> rows((size_t) c.newWidth * c.height * channels);
+    for (uint32_t x = 0; x < c.newWidth; ++x) {
+        std::vector<double> weights = c.width == c.newWidth ? std::vector<double>() :
+                                      referenceWeights(c.width, c.newWidth, filter, x);
+        for (uint32_t y = 0; y < c.height; ++y) {
+            for (uint32_t ch = 0; ch < channels; ++ch) {
+                double sum = 0.0;
+                if (weights.empty())
+                    sum = src[((size_t) y * c.width + x) * channels + ch];
+                else
+                    for (uint32_t k = 0; k < c.width; ++k)
+                        sum += weights[k] * src[((size_t) y * c.width + k) * channels + ch];
+                rows[((size_t) y * c.newWidth + x) * channels + ch] = sum;
+            }
+        }
+    }
+    std::vector<double> dst((size_t) c.newWidth * c.newHeight * channels);
+    for (uint32_t y = 0; y < c.newHeight; ++y) {
+        std::vector<double> weights = c.height == c.newHeight ? std::vector<double>() :
+                                      referenceWeights(c.height, c.newHeight, filter, y);
+        for (uint32_t x = 0; x < c.newWidth * channels; ++x) {
+            double sum = 0.0;
+            if (weights.empty())
+                sum = rows[(size_t) y * c.newWidth * channels + x];
+            else
+                for (uint32_t k = 0; k < c.height; ++k)
+                    sum += weights[k] * rows[(size_t) k * c.newWidth * channels + x];
+            dst[(size_t) y * c.newWidth * channels + x] = sum < 0.0 ? 0.0 : sum > 255.0 ? 255.0 : sum;
+        }
+    }
+    return dst;
+}
+
+/**
+ * a gradient with some noise, kept away from 0 and 255 so the ringing of Lanczos-3 is never clamped:
+ * the scaler clamps between its passes, in an order which depends on the sizes.
+ */
+std::vector<uint8_t> makeChannels(size_t pixels, uint32_t width, uint32_t channels) {
+    std::vector<uint8_t> data(pixels * channels);
+    srand((unsigned) pixels);
+    for (size_t i = 0; i < pixels; ++i) {
+        uint32_t x = (uint32_t) (i % width), y = (uint32_t) (i / width);
+        for (uint32_t ch = 0; ch < channels; ++ch)
+            data[i * channels + ch] = (uint8_t) (48 + (x * 5 + y * 3 + ch * 60) % 120 + rand() % 40);
+    }
+    return data;
+}
+
+double maxDifference(const std::vector<uint8_t> &actual, const std::vector<double> &expected) {
+    double largest = 0.0;
+    for (size_t i = 0; i < actual.size(); ++i) largest = std::max(largest, fabs(actual[i] - expected[i]));
+    return largest;
+}
+
+// the horizontal and the vertical pass both round to 8 bits, and the weights to 14 bits
+const double kTolerance = 1.5;
+
+TEST(BitmapScalerTest, Rgba8888MatchesReference) {
+    for (const ScaleCase &c : kScaleCases) {
+        std::vector<uint8_t> src = makeChannels((size_t) c.width * c.height, c.width, 4);
+        for (ScaleFilter filter : kFilters) {
+            std::vector<uint8_t> dst((size_t) c.newWidth * c.newHeight * 4);
+            scalePixels((const uint32_t *) src.data(), c.width, c.height, c.width, (uint32_t *) dst.data(),
+                        c.newWidth, c.newHeight, c.newWidth, filter);
+            EXPECT_LE(maxDifference(dst, scaleReference(src, 4, c, filter)), kTolerance)
+                    << "filter " << filter << " " << c.width << "x" << c.height << " -> " << c.newWidth << "x"
+                    << c.newHeight;
+        }
+    }
+}
+
+TEST(BitmapScalerTest, A8MatchesReference) {
+    for (const ScaleCase &c : kScaleCases) {
+        std::vector<uint8_t> src = makeChannels((size_t) c.width * c.height, c.width, 1);
+        for (ScaleFilter filter : kFilters) {
+            std::vector<uint8_t> dst((size_t) c.newWidth * c.newHeight);
+            scalePixels(src.data(), c.width, c.height, c.width, dst.data(), c.newWidth, c.newHeight, c.newWidth,
+                        filter);
+            EXPECT_LE(maxDifference(dst, scaleReference(src, 1, c, filter)), kTolerance)
+                    << "filter " << filter << " " << c.width << "x" << c.height << " -> " << c.newWidth << "x"
+                    << c.newHeight;
+        }
+    }
+}
+
+TEST(BitmapScalerTest, FlatColorIsExact) {
+    const uint32_t color = 0x80c0ff37;
+    for (const ScaleCase &c : kScaleCases) {
+        std::vector<uint32_t> src((size_t) c.width * c.height, color);
+        for (ScaleFilter filter : kFilters) {
+            std::vector<uint32_t> dst((size_t) c.newWidth * c.newHeight, 0);
+            scalePixels(src.data(), c.width, c.height, c.width, dst.data(), c.newWidth, c.newHeight, c.newWidth,
+                        filter);
+            EXPECT_EQ(std::vector<uint32_t>(dst.size(), color), dst)
+                    << "filter " << filter << " " << c.width << "x" << c.height << " -> " << c.newWidth << "x"
+                    << c.newHeight;
+        }
+    }
+}
+
+}  // namespace
@@ -0,0 +1,55 @@
+// The nearest neighbour scaler, with its index table, row copies and SIMD paths for integer ratios,
+// must pick exactly the pixels of the per pixel formula x * width / newWidth, y * height / newHeight.
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "BitmapTransform.h"
+
+namespace {
+
+struct ScaleCase {
+    uint32_t width, height, newWidth, newHeight;
+};
+
+// integer downscales by 2, 3 and 4, upscales by 2 and 3, fractional ratios and single pixels,
+// with widths which are not multiples of the SIMD width
+const ScaleCase kScaleCases[] = {{64, 48, 32, 24}, {70, 50, 35, 25}, {66, 9, 22, 3}, {84, 41, 21, 10},
+                                 {37, 23, 74, 46}, {37, 23, 111, 69}, {100, 75, 64, 48}, {64, 48, 100, 75},
+                                 {1, 1, 9, 5}, {9, 5, 1, 1}, {13, 200, 13, 7}, {200, 13, 7, 13}};
+
+template <typename Pixel>
+std::vector<Pixel> makePixels(size_t count) {
+    std::vector<Pixel> pixels(count);
+    srand((unsigned) count);
+    for (auto &p : pixels) p = (Pixel) (((uint64_t) rand() << 40) ^ ((uint64_t) rand() << 20) ^ (uint64_t) rand());
+    return pixels;
+}
+
+template <typename Pixel>
+void checkScaleNN() {
+    for (const ScaleCase &c : kScaleCases) {
+        std::vector<Pixel> src = makePixels<Pixel>((size_t) c.width * c.height);
+        std::vector<Pixel> expected((size_t) c.newWidth * c.newHeight);
+        for (uint32_t y = 0; y < c.newHeight; ++y)
+            for (uint32_t x = 0; x < c.newWidth; ++x)
+                expected[(size_t) y * c.newWidth + x] =
+                        src[(size_t) (y * c.height / c.newHeight) * c.width + x * c.width / c.newWidth];
+
+        std::vector<Pixel> actual(expected.size());
+        scalePixelsNN(src.data(), c.width, c.height, actual.data(), c.newWidth, c.newHeight);
+        EXPECT_EQ(expected, actual) << sizeof(Pixel) * 8 << "-bit " << c.width << "x" << c.height << " -> "
+                                    << c.newWidth << "x" << c.newHeight;
+    }
+}
+
+TEST(BitmapTransformTest, ScaleNNMatchesReference) {
+    checkScaleNN<uint8_t>();
+    checkScaleNN<uint16_t>();
+    checkScaleNN<uint32_t>();
+    checkScaleNN<uint64_t>();
+}
+
+}  // namespace
@@ -0,0 +1,131 @@
+// A chain of crops, rotations, flips and at most one nearest neighbour scale must give exactly the pixels
+// of the operations of BitmapTransform.h called one after another.
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "BitmapTransform.h"
+#include "OperationChain.h"
+
+namespace {
+
+struct Image {
+    uint32_t width, height;
+    std::vector<uint32_t> pixels;
+};
+
+Image makeImage(uint32_t width, uint32_t height) {
+    Image image = {width, height, std::vector<uint32_t>((size_t) width * height)};
+    srand(width * 31 + height);
+    for (auto &p : image.pixels) p = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    return image;
+}
+
+/** the operations applied one after another, as BitmapProcessor does without a chain */
+Image applySequentially(Image image, const std::vector<int32_t> &operations) {
+    size_t i = 0;
+    while (i < operations.size()) {
+        int32_t operation = operations[i++];
+        std::vector<uint32_t> dst;
+        switch (operation) {
+            case kOperationCrop: {
+                uint32_t left = operations[i], top = operations[i + 1], right = operations[i + 2],
+                        bottom = operations[i + 3];
+                i += 4;
+                dst.resize((size_t) (right - left) * (bottom - top));
+                cropPixels(image.pixels.data(), image.width, image.height, left, top, right, bottom, dst.data());
+                image = {right - left, bottom - top, dst};
+                break;
+            }
+            case kOperationRotateCw90:
+                dst.resize(image.pixels.size());
+                rotatePixelsCw90(image.pixels.data(), image.width, image.height, dst.data());
+                image = {image.height, image.width, dst};
+                break;
+            case kOperationRotateCcw90:
+                dst.resize(image.pixels.size());
+                rotatePixelsCcw90(image.pixels.data(), image.width, image.height, dst.data());
+                image = {image.height, image.width, dst};
+                break;
+            case kOperationRotate180:
+                rotatePixels180(image.pixels.data(), image.width, image.height);
+                break;
+            case kOperationFlipHorizontal:
+                flipPixelsHorizontal(image.pixels.data(), image.width, image.height);
+                break;
+            case kOperationFlipVertical:
+                flipPixelsVertical(image.pixels.data(), image.width, image.height);
+                break;
+            case kOperationScale: {
+                uint32_t newWidth = operations[i], newHeight = operations[i + 1];
+                i += 3;
+                dst.resize((size_t) newWidth * newHeight);
+                scalePixelsNN(image.pixels.data(), image.width, image.height, dst.data(), newWidth, newHeight);
+                image = {newWidth, newHeight, dst};
+                break;
+            }
+            default:
+                ADD_FAILURE() << "unknown operation " << operation;
+                return image;
+        }
+    }
+    return image;
+}
+
+const int32_t NN = kChainScaleNearestNeighbour;
+
+const std::vector<int32_t> kOperationLists[] = {
+        {kOperationScale, 40, 30, NN},
+        {kOperationScale, 37, 23, NN},
+        {kOperationScale, 200, 90, NN},
+        {kOperationScale, 64, 48, NN},
+        {kOperationCrop, 3, 5, 50, 41, kOperationScale, 20, 33, NN},
+        {kOperationRotateCw90, kOperationScale, 17, 29, NN},
+        {kOperationRotateCcw90, kOperationScale, 100, 7, NN},
+        {kOperationRotate180, kOperationScale, 31, 31, NN},
+        {kOperationFlipHorizontal, kOperationScale, 33, 25, NN},
+        {kOperationFlipVertical, kOperationScale, 90, 61, NN},
+        {kOperationScale, 30, 21, NN, kOperationRotateCw90},
+        {kOperationScale, 30, 21, NN, kOperationFlipHorizontal, kOperationCrop, 1, 2, 17, 20},
+        {kOperationCrop, 10, 0, 60, 48, kOperationRotateCcw90, kOperationFlipVertical, kOperationScale, 13, 77, NN,
+                kOperationRotate180},
+        {kOperationRotateCw90, kOperationFlipHorizontal, kOperationCrop, 4, 4, 40, 60, kOperationRotateCw90},
+        {kOperationRotate180, kOperationFlipVertical, kOperationRotateCcw90, kOperationCrop, 0, 1, 47, 63},
+};
+
+TEST(OperationChainTest, ChainMatchesSequentialCalls) {
+    Image src = makeImage(64, 48);
+    for (const std::vector<int32_t> &operations : kOperationLists) {
+        Image expected = applySequentially(src, operations);
+
+        OperationChain chain;
+        ASSERT_TRUE(composeOperations(operations.data(), (uint32_t) operations.size(), src.width, src.height, &chain));
+        ASSERT_EQ(expected.width, chain.width);
+        ASSERT_EQ(expected.height, chain.height);
+        std::vector<uint32_t> actual((size_t) chain.width * chain.height);
+        executeOperations(chain, src.pixels.data(), src.width, actual.data(), chain.width);
+
+        std::string description;
+        for (int32_t code : operations) description += std::to_string(code) + " ";
+        EXPECT_EQ(expected.pixels, actual) << description;
+    }
+}
+
+TEST(OperationChainTest, MalformedOperationsAreRejected) {
+    const std::vector<int32_t> kMalformed[] = {
+            {kOperationCrop, 0, 0, 65, 48},
+            {kOperationCrop, 10, 0, 10, 48},
+            {kOperationCrop, 0, 0, 64},
+            {kOperationScale, 0, 10, NN},
+            {kOperationScale, 10, 10, kChainScaleLanczos3 + 1},
+            {kOperationRotateCw90, kOperationCrop, 0, 0, 64, 48},
+            {42},
+    };
+    OperationChain chain;
+    for (const std::vector<int32_t> &operations : kMalformed)
+        EXPECT_FALSE(composeOperations(operations.data(), (uint32_t) operations.size(), 64, 48, &chain));
+}
+
+}  // namespace
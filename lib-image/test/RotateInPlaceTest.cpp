@@ -0,0 +1,65 @@
+// The in place rotations must produce exactly the pixels of the rotations into a second buffer.
+//
+// The sizes cover squares, thin strips, coprime sides and sides sharing a factor,
+// which take different paths through the decomposition of transposePixelsInPlace,
+// and a tall frame whose column groups are narrowed to keep the scratch buffer small.
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "BitmapTransform.h"
+#include "RotateKernels.h"
+
+namespace {
+
+struct Size {
+    uint32_t width, height;
+};
+
+const Size kSizes[] = {{1, 1}, {1, 7}, {7, 1}, {2, 3}, {12, 8}, {16, 16}, {31, 17}, {64, 48}, {100, 3},
+                       {3, 100}, {130, 257}, {640, 480}, {960, 2400}};
+
+template <typename Pixel>
+std::vector<Pixel> makePixels(size_t count) {
+    std::vector<Pixel> pixels(count);
+    srand((unsigned) count);
+    for (auto &p : pixels) p = (Pixel) (((uint64_t) rand() << 40) ^ ((uint64_t) rand() << 20) ^ (uint64_t) rand());
+    return pixels;
+}
+
+template <typename Pixel>
+void checkInPlace() {
+    for (const Size &size : kSizes) {
+        std::vector<Pixel> src = makePixels<Pixel>((size_t) size.width * size.height);
+        std::vector<Pixel> expected(src.size());
+
+        // the transpose is a clockwise rotation flipped left to right
+        std::vector<Pixel> pixels = src;
+        rotatePixelsCw90(src.data(), size.width, size.height, expected.data());
+        flipPixelsHorizontal(expected.data(), size.height, size.width);
+        transposePixelsInPlace(pixels.data(), size.width, size.height);
+        EXPECT_EQ(expected, pixels) << "transpose " << sizeof(Pixel) * 8 << "-bit " << size.width << "x"
+                                    << size.height;
+
+        pixels = src;
+        rotatePixelsCw90(src.data(), size.width, size.height, expected.data());
+        rotatePixelsCw90InPlace(pixels.data(), size.width, size.height);
+        EXPECT_EQ(expected, pixels) << "cw " << sizeof(Pixel) * 8 << "-bit " << size.width << "x" << size.height;
+
+        pixels = src;
+        rotatePixelsCcw90(src.data(), size.width, size.height, expected.data());
+        rotatePixelsCcw90InPlace(pixels.data(), size.width, size.height);
+        EXPECT_EQ(expected, pixels) << "ccw " << sizeof(Pixel) * 8 << "-bit " << size.width << "x" << size.height;
+    }
+}
+
+TEST(RotateInPlaceTest, InPlaceMatchesOutOfPlace) {
+    checkInPlace<uint8_t>();
+    checkInPlace<uint16_t>();
+    checkInPlace<uint32_t>();
+    checkInPlace<uint64_t>();
+}
+
+}  // namespace
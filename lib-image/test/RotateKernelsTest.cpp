@@ -0,0 +1,100 @@
+// Every rotation kernel must produce exactly the pixels of a per pixel reference loop.
+//
+// The sizes cover single pixels, sizes below, at and across the tile and block boundaries of RotateKernels.cpp,
+// and padded rows. Kernels not supported by the running CPU are skipped.
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "BitmapTransform.h"
+#include "RotateKernels.h"
+
+namespace {
+
+struct Size {
+    uint32_t width, height;
+};
+
+const Size kSizes[] = {{1, 1}, {1, 9}, {9, 1}, {3, 5}, {8, 8}, {15, 17}, {16, 16}, {33, 31}, {64, 48}, {100, 37},
+                       {257, 130}};
+
+const RotateKernel kKernels[] = {kRotateKernelScalar, kRotateKernelSse2, kRotateKernelAvx2, kRotateKernelNeon};
+
+template <typename Pixel>
+std::vector<Pixel> makePixels(size_t count) {
+    std::vector<Pixel> pixels(count);
+    srand((unsigned) count);
+    for (auto &p : pixels) p = (Pixel) (((uint64_t) rand() << 40) ^ ((uint64_t) rand() << 20) ^ (uint64_t) rand());
+    return pixels;
+}
+
+// the source pixel (x, y) lands on (height - 1 - y, x) clockwise and on (y, width - 1 - x) counter clockwise
+template <typename Pixel>
+void rotateReference(const Pixel *src, uint32_t width, uint32_t height, size_t srcStride,
+                     Pixel *dst, size_t dstStride, bool clockwise) {
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            if (clockwise)
+                dst[x * dstStride + (height - 1 - y)] = src[y * srcStride + x];
+            else
+                dst[(width - 1 - x) * dstStride + y] = src[y * srcStride + x];
+        }
+    }
+}
+
+template <typename Pixel>
+void checkKernels() {
+    for (const Size &size : kSizes) {
+        // 3 pixels of padding on both sides, the padding of the destination must stay untouched
+        size_t srcStride = size.width + 3;
+        size_t dstStride = size.height + 3;
+        std::vector<Pixel> src = makePixels<Pixel>(srcStride * size.height);
+        for (bool clockwise : {true, false}) {
+            std::vector<Pixel> expected(dstStride * size.width, 0);
+            rotateReference(src.data(), size.width, size.height, srcStride, expected.data(), dstStride, clockwise);
+            for (RotateKernel kernel : kKernels) {
+                if (!isRotateKernelSupported(kernel))
+                    continue;
+                std::vector<Pixel> actual(expected.size(), 0);
+                rotatePixels90(src.data(), size.width, size.height, srcStride, actual.data(), dstStride, clockwise,
+                               kernel);
+                EXPECT_EQ(expected, actual) << rotateKernelName(kernel) << " " << sizeof(Pixel) * 8 << "-bit "
+                                            << size.width << "x" << size.height << (clockwise ? " cw" : " ccw");
+            }
+        }
+    }
+}
+
+template <typename Pixel>
+void checkTransforms() {
+    for (const Size &size : kSizes) {
+        std::vector<Pixel> src = makePixels<Pixel>((size_t) size.width * size.height);
+        std::vector<Pixel> expected(src.size()), actual(src.size());
+
+        rotateReference(src.data(), size.width, size.height, size.width, expected.data(), size.height, true);
+        rotatePixelsCw90(src.data(), size.width, size.height, actual.data());
+        EXPECT_EQ(expected, actual) << "cw " << sizeof(Pixel) * 8 << "-bit " << size.width << "x" << size.height;
+
+        rotateReference(src.data(), size.width, size.height, size.width, expected.data(), size.height, false);
+        rotatePixelsCcw90(src.data(), size.width, size.height, actual.data());
+        EXPECT_EQ(expected, actual) << "ccw " << sizeof(Pixel) * 8 << "-bit " << size.width << "x" << size.height;
+    }
+}
+
+TEST(RotateKernelsTest, KernelsMatchReference) {
+    checkKernels<uint8_t>();
+    checkKernels<uint16_t>();
+    checkKernels<uint32_t>();
+    checkKernels<uint64_t>();
+}
+
+TEST(RotateKernelsTest, RotationsMatchReference) {
+    checkTransforms<uint8_t>();
+    checkTransforms<uint16_t>();
+    checkTransforms<uint32_t>();
+    checkTransforms<uint64_t>();
+}
+
+}  // namespace
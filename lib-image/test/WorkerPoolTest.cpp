@@ -0,0 +1,174 @@
+// The operations split into bands on a WorkerPool must produce exactly the pixels of the single threaded calls.
+//
+// Every case runs once without a pool and once on pools of several sizes. The frames are tall enough
+// to be split into several bands, with odd sizes so the last band is shorter than the others.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "BitmapScaler.h"
+#include "BitmapTransform.h"
+#include "OperationChain.h"
+#include "RotateKernels.h"
+#include "WorkerPool.h"
+
+namespace {
+
+const uint32_t kThreadCounts[] = {2, 3, 4, 8};
+
+const uint32_t kWidth = 301;
+const uint32_t kHeight = 263;
+
+template <typename Pixel>
+std::vector<Pixel> makePixels(size_t count) {
+    std::vector<Pixel> pixels(count);
+    srand((unsigned) count);
+    for (auto &p : pixels) p = (Pixel) (((uint64_t) rand() << 40) ^ ((uint64_t) rand() << 20) ^ (uint64_t) rand());
+    return pixels;
+}
+
+/**
+ * runs [operation] on a copy of [input] without a pool, then on every pool size, and compares the results.
+ * [operation] writes its result into the buffer it is given, which starts as a copy of [input].
+ */
+template <typename Pixel>
+void checkThreaded(const char *name, const std::vector<Pixel> &input, size_t outputSize,
+                   const std::function<void(std::vector<Pixel> &, WorkerPool *)> &operation) {
+    std::vector<Pixel> expected = input;
+    expected.resize(std::max(input.size(), outputSize));
+    operation(expected, NULL);
+    for (uint32_t threads : kThreadCounts) {
+        WorkerPool workers(threads);
+        std::vector<Pixel> actual = input;
+        actual.resize(expected.size());
+        operation(actual, &workers);
+        EXPECT_EQ(expected, actual) << name << " " << sizeof(Pixel) * 8 << "-bit on " << threads << " threads";
+    }
+}
+
+template <typename Pixel>
+void checkTransforms() {
+    const std::vector<Pixel> src = makePixels<Pixel>((size_t) kWidth * kHeight);
+    const size_t size = src.size();
+
+    checkThreaded<Pixel>("crop", src, size, [&](std::vector<Pixel> &dst, WorkerPool *workers) {
+        cropPixels(src.data(), kWidth, kHeight, 7, 3, 290, 250, dst.data(), workers);
+    });
+    checkThreaded<Pixel>("rotate cw", src, size, [&](std::vector<Pixel> &dst, WorkerPool *workers) {
+        rotatePixelsCw90(src.data(), kWidth, kHeight, dst.data(), workers);
+    });
+    checkThreaded<Pixel>("rotate ccw", src, size, [&](std::vector<Pixel> &dst, WorkerPool *workers) {
+        rotatePixelsCcw90(src.data(), kWidth, kHeight, dst.data(), workers);
+    });
+    checkThreaded<Pixel>("rotate cw in place", src, size, [&](std::vector<Pixel> &pixels, WorkerPool *workers) {
+        rotatePixelsCw90InPlace(pixels.data(), kWidth, kHeight, workers);
+    });
+    checkThreaded<Pixel>("rotate ccw in place", src, size, [&](std::vector<Pixel> &pixels, WorkerPool *workers) {
+        rotatePixelsCcw90InPlace(pixels.data(), kWidth, kHeight, workers);
+    });
+    checkThreaded<Pixel>("transpose in place", src, size, [&](std::vector<Pixel> &pixels, WorkerPool *workers) {
+        transposePixelsInPlace(pixels.data(), kWidth, kHeight, workers);
+    });
+    // the strided operations on 290 of the 301 pixels of every row
+    checkThreaded<Pixel>("rotate 180", src, size, [&](std::vector<Pixel> &pixels, WorkerPool *workers) {
+        rotatePixels180(pixels.data(), 290, kHeight, kWidth, workers);
+    });
+    checkThreaded<Pixel>("flip horizontal", src, size, [&](std::vector<Pixel> &pixels, WorkerPool *workers) {
+        flipPixelsHorizontal(pixels.data(), 290, kHeight, kWidth, workers);
+    });
+    checkThreaded<Pixel>("flip vertical", src, size, [&](std::vector<Pixel> &pixels, WorkerPool *workers) {
+        flipPixelsVertical(pixels.data(), 290, kHeight, kWidth, workers);
+    });
+    checkThreaded<Pixel>("scale nearest neighbour", src, 400 * 350, [&](std::vector<Pixel> &dst, WorkerPool *workers) {
+        scalePixelsNN(src.data(), kWidth, kHeight, dst.data(), 400, 350, workers);
+    });
+}
+
+template <typename Pixel>
+void checkScaler() {
+    const std::vector<Pixel> src = makePixels<Pixel>((size_t) kWidth * kHeight);
+    const uint32_t sizes[][2] = {{150, 131}, {97, 263}, {301, 400}, {450, 395}};
+    for (ScaleFilter filter : {kScaleFilterBilinear, kScaleFilterBox, kScaleFilterLanczos3}) {
+        for (const auto &size : sizes) {
+            checkThreaded<Pixel>("scale", src, (size_t) size[0] * size[1],
+                                 [&](std::vector<Pixel> &dst, WorkerPool *workers) {
+                                     scalePixels(src.data(), kWidth, kHeight, kWidth, dst.data(), size[0], size[1],
+                                                 size[0], filter, workers);
+                                 });
+        }
+    }
+}
+
+template <typename Pixel>
+void checkOperationChain() {
+    const std::vector<Pixel> src = makePixels<Pixel>((size_t) kWidth * kHeight);
+    const std::vector<int32_t> operationLists[] = {
+            {kOperationCrop, 10, 5, 300, 260, kOperationRotateCw90, kOperationFlipHorizontal},
+            {kOperationRotateCcw90, kOperationScale, 200, 170, kChainScaleNearestNeighbour},
+            {kOperationCrop, 1, 1, 280, 250, kOperationScale, 140, 300, kChainScaleBilinear, kOperationRotate180},
+            {kOperationRotateCw90, kOperationScale, 120, 100, kChainScaleBox},
+            {kOperationFlipVertical, kOperationScale, 350, 330, kChainScaleLanczos3},
+    };
+    for (const std::vector<int32_t> &operations : operationLists) {
+        OperationChain chain;
+        ASSERT_TRUE(composeOperations(operations.data(), (uint32_t) operations.size(), kWidth, kHeight, &chain));
+        checkThreaded<Pixel>("operation chain", src, (size_t) chain.width * chain.height,
+                             [&](std::vector<Pixel> &dst, WorkerPool *workers) {
+                                 executeOperations(chain, src.data(), kWidth, dst.data(), chain.width, workers);
+                             });
+    }
+}
+
+TEST(WorkerPoolTest, ParallelForRunsEveryTaskOnce) {
+    for (uint32_t threads : kThreadCounts) {
+        WorkerPool workers(threads);
+        for (uint32_t taskCount : {0u, 1u, 3u, 8u, 100u}) {
+            std::vector<std::atomic<int>> runs(taskCount);
+            for (auto &r : runs) r = 0;
+            workers.parallelFor(taskCount, [&](uint32_t task) { runs[task]++; });
+            for (uint32_t task = 0; task < taskCount; ++task)
+                EXPECT_EQ(1, runs[task].load()) << "task " << task << " of " << taskCount << " on " << threads;
+        }
+    }
+}
+
+TEST(WorkerPoolTest, ForEachBandCoversEveryRowOnce) {
+    WorkerPool workers(4);
+    for (uint32_t count : {0u, 1u, 31u, 64u, 263u, 1000u}) {
+        for (uint32_t alignment : {1u, 16u, 32u}) {
+            std::vector<std::atomic<int>> rows(count);
+            for (auto &r : rows) r = 0;
+            forEachBand(&workers, count, alignment, [&](uint32_t first, uint32_t end) {
+                EXPECT_EQ(0u, first % alignment);
+                for (uint32_t y = first; y < end; ++y) rows[y]++;
+            });
+            for (uint32_t y = 0; y < count; ++y)
+                EXPECT_EQ(1, rows[y].load()) << "row " << y << " of " << count << ", alignment " << alignment;
+        }
+    }
+}
+
+TEST(WorkerPoolTest, TransformsThreadedMatchSerial) {
+    checkTransforms<uint8_t>();
+    checkTransforms<uint16_t>();
+    checkTransforms<uint32_t>();
+    checkTransforms<uint64_t>();
+}
+
+TEST(WorkerPoolTest, ScalerThreadedMatchesSerial) {
+    checkScaler<uint8_t>();
+    checkScaler<uint16_t>();
+    checkScaler<uint32_t>();
+    checkScaler<uint64_t>();
+}
+
+TEST(WorkerPoolTest, OperationChainThreadedMatchesSerial) {
+    checkOperationChain<uint16_t>();
+    checkOperationChain<uint32_t>();
+}
+
+}  // namespace
@@ -3,8 +3,52 @@ package com.leovp.x264
 import androidx.annotation.Keep
 
 /**
+ * [data] holds all NAL units of the frame in Annex B format, each one with its start code.
+ *
+ * [nals] is the index table of these units, [NAL_FIELDS] ints per unit:
+ * `nal_unit_type, nal_ref_idc, offset, size`,
+ * where offset and size are the unit in [data] without its start code.
+ * So a packetizer can fragment each unit or drop the SEI ones
+ * without scanning [data] for start codes:
+ * ```
+ * for (i in 0 until result.nalCount) {
+ *     if (result.nalType(i) == X264EncodeResult.NAL_SEI) continue
+ *     send(result.data, result.nalOffset(i), result.nalSize(i))
+ * }
+ * ```
+ *
  * Author: Michael Leo
  * Date: 21-3-18 下午4:21
  */
 @Keep
-data class X264EncodeResult(val err: Int, val data: ByteArray, val pts: Long, val isKey: Boolean)
+data class X264EncodeResult(
+    val err: Int,
+    val data: ByteArray,
+    val pts: Long,
+    val isKey: Boolean,
+    val nals: IntArray
+) {
+    val nalCount: Int get() = nals.size / NAL_FIELDS
+
+    fun nalType(index: Int): Int = nals[index * NAL_FIELDS]
+
+    fun nalRefIdc(index: Int): Int = nals[index * NAL_FIELDS + 1]
+
+    fun nalOffset(index: Int): Int = nals[index * NAL_FIELDS + 2]
+
+    fun nalSize(index: Int): Int = nals[index * NAL_FIELDS + 3]
+
+    companion object {
+        // Keep in sync with X264A_NAL_FIELDS in libx264_jni.cpp
+        const val NAL_FIELDS = 4
+
+        // nal_unit_type, see nal_unit_type_e in x264.h
+        const val NAL_SLICE = 1
+        const val NAL_SLICE_IDR = 5
+        const val NAL_SEI = 6
+        const val NAL_SPS = 7
+        const val NAL_PPS = 8
+        const val NAL_AUD = 9
+        const val NAL_FILLER = 12
+    }
+}
@@ -1,17 +1,209 @@
 package com.leovp.x264
 
+import java.nio.ByteBuffer
+
 /**
  * Author: Michael Leo
  * Date: 21-3-18 下午4:21
  */
 class X264Encoder {
     external fun initEncoder(params: X264Params): X264InitResult
+
+    /**
+     * Frees the encoder, after stopping the encoding thread of [startAsync].
+     * It must not overlap any other call on this encoder, from any thread, and nothing can be
+     * called afterwards.
+     */
     external fun releaseEncoder()
     external fun encodeFrame(frame: ByteArray, colorFormat: Int, pts: Long): X264EncodeResult
+
+    /**
+     * Encodes one frame without copying it and without allocating anything, for high frame rates.
+     *
+     * The planes are read in place from direct buffers, from their beginning, [vBuffer] is unused
+     * for NV12 and NV21 whose [uBuffer] holds the interleaved chroma. The last row of every plane
+     * must be complete.
+     *
+     * The NAL units of the encoded frame are written into the direct buffer [out] from [outOffset],
+     * see [X264EncodeResult] for the format, and their index table into [nals], with the offsets
+     * in [out].
+     * [frameInfo] receives [INFO_PTS], [INFO_KEY] (1 for an IDR frame or the recovery point of an
+     * intra refresh), [INFO_SIZE], [INFO_NAL_COUNT] and [INFO_DTS], which differs from the pts when
+     * [X264Params.bframes] reorders the frames.
+     *
+     * [out] can be used as a ring buffer: write every frame after the previous one.
+     * When a frame doesn't fit, [ERR_OUTPUT_TOO_SMALL] is returned and the frame is kept with its
+     * size in [frameInfo]. Take it with [takePendingFrame] at the beginning of [out] once the
+     * reader released it, or into a larger buffer. Nothing can be encoded before,
+     * [ERR_OUTPUT_PENDING] is returned meanwhile.
+     *
+     * @param nals [NAL_FIELDS][X264EncodeResult.NAL_FIELDS] ints per unit, 16 units are plenty
+     * without slices, allow one more unit per slice with [X264Params.sliceMaxSize] or
+     * [X264Params.sliceMaxMbs].
+     * @param frameInfo [FRAME_INFO_SIZE] longs.
+     * @return The number of NAL units, 0 while the encoder buffers the first frames, or a negative
+     * error code.
+     */
+    external fun encodeFrameInto(
+        yBuffer: ByteBuffer,
+        yStride: Int,
+        uBuffer: ByteBuffer,
+        uStride: Int,
+        vBuffer: ByteBuffer?,
+        vStride: Int,
+        colorFormat: Int,
+        pts: Long,
+        out: ByteBuffer,
+        outOffset: Int,
+        nals: IntArray,
+        frameInfo: LongArray
+    ): Int
+
+    /**
+     * Writes the frame [encodeFrameInto] couldn't fit, see [encodeFrameInto].
+     *
+     * @return The number of NAL units, 0 if no frame is pending, or a negative error code.
+     */
+    external fun takePendingFrame(
+        out: ByteBuffer,
+        outOffset: Int,
+        nals: IntArray,
+        frameInfo: LongArray
+    ): Int
+
+    /**
+     * Writes the next frame delayed by the encoder, as [encodeFrameInto] does, once the last
+     * frame was encoded. With [X264Params.lookahead], [X264Params.bframes], frame
+     * [X264Params.threads] or a tune other than zerolatency, the encoder holds back the last
+     * frames, call this until it returns [ERR_END_OF_STREAM] before [releaseEncoder], which drops
+     * them.
+     *
+     * @return The number of NAL units, [ERR_END_OF_STREAM] after the last delayed frame, or a
+     * negative error code.
+     */
+    external fun flushFrameInto(
+        out: ByteBuffer,
+        outOffset: Int,
+        nals: IntArray,
+        frameInfo: LongArray
+    ): Int
+
+    /**
+     * Starts encoding on a native thread, so the capture thread only copies frames in with
+     * [submitFrame] while x264 encodes the previous ones, and the sender takes them out with
+     * [pollFrame].
+     * Lets [X264Params.threads], [X264Params.lookahead] and [X264Params.bframes] raise the
+     * throughput without blocking the caller for the frames delayed by the encoder.
+     *
+     * [encodeFrame] and [encodeFrameInto] return [ERR_ASYNC_STATE] until [stopAsync].
+     *
+     * @param colorFormat The [X264Params] CSP_* format of all the submitted frames.
+     * @param queueSize The number of frames copied into the queue at most, allocated once.
+     * @return [OK] or a negative error code.
+     */
+    external fun startAsync(colorFormat: Int, queueSize: Int): Int
+
+    /**
+     * Copies a frame into the queue, read as in [encodeFrameInto]. The buffers can be reused once
+     * this returns.
+     *
+     * @return [OK], [ERR_QUEUE_FULL] if the encoder lags behind and the frame was dropped,
+     * [ERR_ASYNC_STATE] after [finishAsync], or another negative error code.
+     */
+    external fun submitFrame(
+        yBuffer: ByteBuffer,
+        yStride: Int,
+        uBuffer: ByteBuffer,
+        uStride: Int,
+        vBuffer: ByteBuffer?,
+        vStride: Int,
+        pts: Long
+    ): Int
+
+    /**
+     * Writes the next encoded frame, in encoding order, as [encodeFrameInto] does.
+     * A frame which doesn't fit stays first in the queue.
+     *
+     * @param timeoutMs How long to wait for a frame, 0 not to wait.
+     * @return The number of NAL units, 0 if no frame is ready, [ERR_END_OF_STREAM] after the last
+     * frame once [finishAsync] was called, or a negative error code.
+     */
+    external fun pollFrame(
+        out: ByteBuffer,
+        outOffset: Int,
+        nals: IntArray,
+        frameInfo: LongArray,
+        timeoutMs: Int
+    ): Int
+
+    /**
+     * Ends the stream: the queued frames and the ones delayed by the encoder are encoded for
+     * [pollFrame].
+     */
+    external fun finishAsync(): Int
+
+    /**
+     * Stops the encoding thread, the frames not polled yet are dropped. Called by [releaseEncoder].
+     * Can be called while other threads are in [submitFrame], [pollFrame] or [finishAsync]:
+     * it waits for them to return, [pollFrame] without waiting for its timeout,
+     * and they return [ERR_ASYNC_STATE] from then on.
+     */
+    external fun stopAsync()
+
+    /**
+     * Changes the rate control from the next frame, e.g. to follow the available bandwidth,
+     * without reopening the encoder nor sending new SPS and PPS. Can be called from any thread
+     * before [releaseEncoder].
+     * Pass a negative value to keep a parameter. The rates are in bits per second as in
+     * [X264Params].
+     *
+     * [crf] only applies if the encoder was opened with [X264Params.crf], and the VBV only if
+     * [X264Params.vbvMaxBitrate] and [X264Params.vbvBufferSize] were set.
+     * The frame rate can't be changed, lower the bitrate when the camera slows down.
+     *
+     * @return [OK] or [ERR_RECONFIG].
+     */
+    external fun reconfigure(bitrate: Int, vbvMaxBitrate: Int, vbvBufferSize: Int, crf: Float): Int
+
+    /**
+     * Encodes the next frame as an IDR frame, e.g. when a receiver joins or lost a reference.
+     * Can be called from any thread before [releaseEncoder].
+     */
+    external fun forceIdr()
+
+    /**
+     * Starts a periodic intra refresh from the next P-frame if [X264Params] enables it,
+     * which recovers from a loss without the burst of an IDR frame. Forces an IDR frame otherwise.
+     * Can be called from any thread before [releaseEncoder].
+     */
+    external fun intraRefresh()
+
     external fun getVersion(): String
     private val ctx: Long = 0
 
     companion object {
+        // Keep in sync with X264A_ERR_* in libx264_jni.cpp
+        const val OK = 0
+        const val ERR_APPLY_PROFILE = -2
+        const val ERR_OPEN_ENCODER = -3
+        const val ERR_NOT_SUPPORT_CPS = -4
+        const val ERR_ENCODE_FRAME = -5
+        const val ERR_OUTPUT_TOO_SMALL = -6
+        const val ERR_OUTPUT_PENDING = -7
+        const val ERR_INVALID_BUFFER = -8
+        const val ERR_QUEUE_FULL = -9
+        const val ERR_ASYNC_STATE = -10
+        const val ERR_END_OF_STREAM = -11
+        const val ERR_RECONFIG = -12
+
+        // The fields of frameInfo, keep in sync with X264A_FRAME_INFO_FIELDS in libx264_jni.cpp
+        const val INFO_PTS = 0
+        const val INFO_KEY = 1
+        const val INFO_SIZE = 2
+        const val INFO_NAL_COUNT = 3
+        const val INFO_DTS = 4
+        const val FRAME_INFO_SIZE = 5
+
         init {
             System.loadLibrary("libx264-encoder")
             System.loadLibrary("libx264")
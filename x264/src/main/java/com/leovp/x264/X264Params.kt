@@ -16,7 +16,68 @@ class X264Params {
     var profile = "baseline"
     var preset = "ultrafast"
 
+    /**
+     * Constant quality (e.g. 23, lower is better) instead of the average [bitrate] when above 0.
+     */
+    var crf = 0f
+
+    /**
+     * The VBV caps the bitrate over a buffer of [vbvBufferSize] bits to [vbvMaxBitrate] bits per
+     * second, 0 for none. Must be enabled here for [X264Encoder.reconfigure] to change it.
+     */
+    var vbvMaxBitrate = 0
+    var vbvBufferSize = 0
+
+    /**
+     * Refreshes the picture with a column of intra blocks moving across [gop] frames instead of IDR
+     * frames, so the bitrate has no key frame spikes and a lost packet heals within a gop.
+     * Only the first frame is an IDR frame, see [X264Encoder.intraRefresh] to start a refresh on
+     * demand.
+     */
+    var intraRefresh = false
+
+    /**
+     * The maximum size in bytes of a slice, e.g. 1200 to fit each slice in one RTP packet of an
+     * usual MTU, and the maximum number of 16x16 macroblocks in a slice. 0 for no limit.
+     */
+    var sliceMaxSize = 0
+    var sliceMaxMbs = 0
+
+    /**
+     * The x264 tune, e.g. "zerolatency" for live streaming, which disables the lookahead and the
+     * B-frames and uses sliced threads so each frame comes out of the encoder as soon as it went
+     * in. Empty for none, e.g. to let [lookahead] and [bframes] trade latency for quality or
+     * throughput.
+     */
+    var tune = "zerolatency"
+
+    // Left to [PRESET_DEFAULT] to keep the values of the preset and the tune.
+
+    /** Encoding threads, 0 for automatic. */
+    var threads = PRESET_DEFAULT
+
+    /**
+     * 1 to split each frame into slices encoded in parallel, the lowest latency; 0 for frame
+     * threads.
+     */
+    var slicedThreads = PRESET_DEFAULT
+
+    /**
+     * Frames buffered to decide the frame types and the rate control, each one adds a frame of
+     * latency.
+     */
+    var lookahead = PRESET_DEFAULT
+
+    /**
+     * Consecutive B-frames, the output is reordered. The baseline [profile] doesn't allow them and
+     * sets it to 0.
+     */
+    var bframes = PRESET_DEFAULT
+
     companion object {
+        // Keep in sync with X264A_PARAM_KEEP in libx264_jni.cpp
+        const val PRESET_DEFAULT = -1
+
         const val CSP_I420 = 0x0001 // yuv 4:2:0 planar
         const val CSP_YV12 = 0x0002 // yvu 4:2:0 planar
         const val CSP_NV12 = 0x0003 // yuv 4:2:0, with one y plane and one packed u+v
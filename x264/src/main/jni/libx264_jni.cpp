@@ -1,5 +1,12 @@
 #include <jni.h>
 #include <string>
+#include <cstring>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <x264.h>
 #include <android/log.h>
 
@@ -10,56 +17,153 @@
 #define X264A_ERR_OPEN_ENCODER -3
 #define X264A_ERR_NOT_SUPPORT_CPS -4
 #define X264A_ERR_ENCODE_FRAME -5
+#define X264A_ERR_OUTPUT_TOO_SMALL -6
+#define X264A_ERR_OUTPUT_PENDING -7
+#define X264A_ERR_INVALID_BUFFER -8
+#define X264A_ERR_QUEUE_FULL -9
+#define X264A_ERR_ASYNC_STATE -10
+#define X264A_ERR_END_OF_STREAM -11
+#define X264A_ERR_RECONFIG -12
 #define X264A_PACKAGE "com/leovp/x264/"
 
+// Ints per NAL unit in the index table of X264EncodeResult: type, ref_idc, offset, size
+#define X264A_NAL_FIELDS 4
+// Longs in the frame info of encodeFrameInto and pollFrame: pts, is key frame, size, NAL unit count, dts
+#define X264A_FRAME_INFO_FIELDS 5
+// An X264Params field left as the preset and the tune set it
+#define X264A_PARAM_KEEP -1
+
+// Cached in JNI_OnLoad, so encoding a frame doesn't look up any class, method or field
+static jfieldID g_ctx_field = NULL;
+static jclass g_init_result_cls = NULL;
+static jmethodID g_init_result_init = NULL;
+static jclass g_encode_result_cls = NULL;
+static jmethodID g_encode_result_init = NULL;
+
+/**
+ * The NAL units of an encoded frame and their index table, with the offsets relative to [payload].
+ */
+typedef struct EncodedFrame {
+    // In [data], or in the buffers of x264 until the next call to x264_encoder_encode
+    const uint8_t *payload;
+    int size;
+    std::vector<uint8_t> data;
+    std::vector<jint> nals;
+    int64_t pts;
+    int64_t dts;
+    bool key;
+} EncodedFrame;
+
 extern "C"
 
 typedef struct EncoderContext {
     x264_param_t params;
     x264_t *encoder;
     x264_picture_t input_picture;
+    // Guards the encoder and force_idr, so reconfigure, forceIdr and intraRefresh can be called from any thread.
+    // Nothing guards the context itself: releaseEncoder must not overlap any other call.
+    std::mutex encoder_mutex;
+    // forceIdr was called: the next picture is encoded as an IDR frame
+    bool force_idr;
+    // The output of encodeFrameInto which didn't fit into the caller's buffers yet, kept in the buffers of x264
+    bool pending;
+    EncodedFrame pending_frame;
+
+    // Asynchronous encoding between startAsync and stopAsync, see encode_loop.
+    // The queues and the flags are guarded by queue_mutex, the encoder is only used by encode_thread meanwhile.
+    // stopAsync waits for the submitFrame, pollFrame and finishAsync calls in progress, counted by async_users.
+    bool async;
+    std::thread encode_thread;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cond;
+    std::vector<x264_picture_t> pictures;
+    std::deque<x264_picture_t *> free_pictures;
+    std::deque<x264_picture_t *> input_queue;
+    std::deque<EncodedFrame *> output_queue;
+    std::vector<EncodedFrame *> free_frames;
+    // finishAsync was called: encode the frames left in input_queue and the ones delayed by x264
+    bool flushing;
+    // every frame is in output_queue
+    bool finished;
+    bool stopping;
+    int async_users;
+    int async_error;
 } EncoderContext;
 
+static void stop_async(EncoderContext *ctx);
+
+static bool is_async(EncoderContext *ctx) {
+    std::lock_guard<std::mutex> lock(ctx->queue_mutex);
+    return ctx->async;
+}
+
 static void set_ctx(JNIEnv *env, jobject thiz, void *ctx) {
-    jclass cls = env->GetObjectClass(thiz);
-    jfieldID fid = env->GetFieldID(cls, "ctx", "J");
-    env->SetLongField(thiz, fid, (jlong) (uintptr_t) ctx);
+    env->SetLongField(thiz, g_ctx_field, (jlong) (uintptr_t) ctx);
 }
 
 static void *get_ctx(JNIEnv *env, jobject thiz) {
-    jclass cls = env->GetObjectClass(thiz);
-    jfieldID fid = env->GetFieldID(cls, "ctx", "J");
-    return (void *) (uintptr_t) env->GetLongField(thiz, fid);
+    return (void *) (uintptr_t) env->GetLongField(thiz, g_ctx_field);
 }
 
 /**
  * Create a new encoder.
  */
 JNIEXPORT jobject initEncoder(JNIEnv *env, jobject thiz, jobject params) {
-    EncoderContext *ctx = (EncoderContext *) calloc(1, sizeof(EncoderContext));
+    EncoderContext *ctx = new EncoderContext();
     set_ctx(env, thiz, ctx);
-    jclass rsCls = env->FindClass(X264A_PACKAGE"X264InitResult");
-    jmethodID rsInit = env->GetMethodID(rsCls, "<init>", "(I[B[B)V");
+    jclass rsCls = g_init_result_cls;
+    jmethodID rsInit = g_init_result_init;
 
     // init params
     jclass paramsCls = env->GetObjectClass(params);
 
     jstring preset = (jstring) env->GetObjectField
             (params, env->GetFieldID(paramsCls, "preset", "Ljava/lang/String;"));
+    jstring tune = (jstring) env->GetObjectField
+            (params, env->GetFieldID(paramsCls, "tune", "Ljava/lang/String;"));
     const char *c_preset = env->GetStringUTFChars(preset, NULL);
-    x264_param_default_preset(&ctx->params, c_preset, "zerolatency");
+    const char *c_tune = tune == NULL ? NULL : env->GetStringUTFChars(tune, NULL);
+    x264_param_default_preset(&ctx->params, c_preset, c_tune != NULL && c_tune[0] != '\0' ? c_tune : NULL);
     env->ReleaseStringUTFChars(preset, c_preset);
+    if (c_tune != NULL) env->ReleaseStringUTFChars(tune, c_tune);
 
     ctx->params.i_width = env->GetIntField(params, env->GetFieldID(paramsCls, "width", "I"));
     ctx->params.i_height = env->GetIntField(params, env->GetFieldID(paramsCls, "height", "I"));
     ctx->params.rc.i_bitrate =
             env->GetIntField(params, env->GetFieldID(paramsCls, "bitrate", "I")) / 1000;
     ctx->params.rc.i_rc_method = X264_RC_ABR;
+    // constant quality instead of the average bitrate when given, capped by the VBV
+    jfloat crf = env->GetFloatField(params, env->GetFieldID(paramsCls, "crf", "F"));
+    if (crf > 0) {
+        ctx->params.rc.i_rc_method = X264_RC_CRF;
+        ctx->params.rc.f_rf_constant = crf;
+    }
+    // the VBV can only be reconfigured if it is enabled now
+    ctx->params.rc.i_vbv_max_bitrate =
+            env->GetIntField(params, env->GetFieldID(paramsCls, "vbvMaxBitrate", "I")) / 1000;
+    ctx->params.rc.i_vbv_buffer_size =
+            env->GetIntField(params, env->GetFieldID(paramsCls, "vbvBufferSize", "I")) / 1000;
     ctx->params.i_fps_num = env->GetIntField(params, env->GetFieldID(paramsCls, "fps", "I"));
     ctx->params.i_fps_den = 1;
     ctx->params.i_keyint_max = env->GetIntField(params, env->GetFieldID(paramsCls, "gop", "I"));
     ctx->params.b_repeat_headers = 0;
 
+    // a column of intra blocks sweeping the frames over the gop instead of IDR frames, and slices capped in size
+    // to be packetized one by one
+    ctx->params.b_intra_refresh = env->GetBooleanField(params, env->GetFieldID(paramsCls, "intraRefresh", "Z"));
+    ctx->params.i_slice_max_size = env->GetIntField(params, env->GetFieldID(paramsCls, "sliceMaxSize", "I"));
+    ctx->params.i_slice_max_mbs = env->GetIntField(params, env->GetFieldID(paramsCls, "sliceMaxMbs", "I"));
+
+    // threading, lookahead and B-frames, as the preset and the tune set them unless given
+    jint threads = env->GetIntField(params, env->GetFieldID(paramsCls, "threads", "I"));
+    jint sliced_threads = env->GetIntField(params, env->GetFieldID(paramsCls, "slicedThreads", "I"));
+    jint lookahead = env->GetIntField(params, env->GetFieldID(paramsCls, "lookahead", "I"));
+    jint bframes = env->GetIntField(params, env->GetFieldID(paramsCls, "bframes", "I"));
+    if (threads != X264A_PARAM_KEEP) ctx->params.i_threads = threads;
+    if (sliced_threads != X264A_PARAM_KEEP) ctx->params.b_sliced_threads = sliced_threads;
+    if (lookahead != X264A_PARAM_KEEP) ctx->params.rc.i_lookahead = lookahead;
+    if (bframes != X264A_PARAM_KEEP) ctx->params.i_bframe = bframes;
+
     jstring profile = (jstring) env->GetObjectField
             (params, env->GetFieldID(paramsCls, "profile", "Ljava/lang/String;"));
     const char *c_profile = env->GetStringUTFChars(profile, NULL);
@@ -87,9 +191,12 @@ JNIEXPORT jobject initEncoder(JNIEnv *env, jobject thiz, jobject params) {
 /**
  * Free up resources used by the encoder instance.
  * Make sure to call this even if initEncoder fail.
+ * The frames still delayed by x264 are dropped, take them with flushFrameInto or finishAsync first.
+ * The context is deleted, so no other call may be in progress or follow, on any thread.
  */
 JNIEXPORT void releaseEncoder(JNIEnv *env, jobject thiz) {
     EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    stop_async(ctx);
 
     int nnal;
     x264_nal_t *nal;
@@ -102,7 +209,49 @@ JNIEXPORT void releaseEncoder(JNIEnv *env, jobject thiz) {
         x264_encoder_close(ctx->encoder);
         ctx->encoder = NULL;
     }
-    free(ctx);
+    delete ctx;
+}
+
+/**
+ * Describe the [nnal] NAL units of a frame in [table], X264A_NAL_FIELDS ints per unit:
+ * nal_unit_type, nal_ref_idc, then the offset and the size of the unit without its Annex B start code.
+ * The offsets are relative to [base] plus the payload of the first unit, which is where the output of a frame starts.
+ */
+static void fill_nal_table(const x264_nal_t *nal, int nnal, jint base, jint *table) {
+    for (int i = 0; i < nnal; i++) {
+        int start_code = nal[i].b_long_startcode ? 4 : 3;
+        table[0] = nal[i].i_type;
+        table[1] = nal[i].i_ref_idc;
+        table[2] = base + (jint) (nal[i].p_payload - nal[0].p_payload) + start_code;
+        table[3] = nal[i].i_payload - start_code;
+        table += X264A_NAL_FIELDS;
+    }
+}
+
+/**
+ * Encode [in], or a delayed frame if NULL, as an IDR frame if forceIdr was called.
+ */
+static int encode_picture(EncoderContext *ctx, x264_nal_t **nal, int *nnal, x264_picture_t *in,
+                          x264_picture_t *out) {
+    std::lock_guard<std::mutex> lock(ctx->encoder_mutex);
+    if (in != NULL && ctx->force_idr) {
+        in->i_type = X264_TYPE_IDR;
+        ctx->force_idr = false;
+    }
+    return x264_encoder_encode(ctx->encoder, nal, nnal, in, out);
+}
+
+static int delayed_frames(EncoderContext *ctx) {
+    std::lock_guard<std::mutex> lock(ctx->encoder_mutex);
+    return x264_encoder_delayed_frames(ctx->encoder);
+}
+
+/**
+ * An X264EncodeResult of [err] with an empty frame and index table, as none of its fields is nullable.
+ */
+static jobject encode_error(JNIEnv *env, int err) {
+    return env->NewObject(g_encode_result_cls, g_encode_result_init,
+                          err, env->NewByteArray(0), (jlong) 0, JNI_FALSE, env->NewIntArray(0));
 }
 
 /**
@@ -110,8 +259,10 @@ JNIEXPORT void releaseEncoder(JNIEnv *env, jobject thiz) {
  **/
 JNIEXPORT jobject encodeFrame(JNIEnv *env, jobject thiz, jbyteArray frame, jint csp, jlong pts) {
     EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
-    jclass rsCls = env->FindClass(X264A_PACKAGE"X264EncodeResult");
-    jmethodID rsInit = env->GetMethodID(rsCls, "<init>", "(I[BJZ)V");
+    jclass rsCls = g_encode_result_cls;
+    jmethodID rsInit = g_encode_result_init;
+    if (ctx->pending) return encode_error(env, X264A_ERR_OUTPUT_PENDING);
+    if (is_async(ctx)) return encode_error(env, X264A_ERR_ASYNC_STATE);
 
     jbyte *input_frame = env->GetByteArrayElements(frame, NULL);
 
@@ -142,19 +293,509 @@ JNIEXPORT jobject encodeFrame(JNIEnv *env, jobject thiz, jbyteArray frame, jint
             ctx->input_picture.img.i_stride[2] = ctx->params.i_width / 2;
             break;
         default:
-            return env->NewObject(rsCls, rsInit, X264A_ERR_NOT_SUPPORT_CPS, NULL, 0, false);
+            env->ReleaseByteArrayElements(frame, input_frame, JNI_ABORT);
+            return encode_error(env, X264A_ERR_NOT_SUPPORT_CPS);
     }
 
-    int len = x264_encoder_encode(ctx->encoder, &nal, &nnal, &ctx->input_picture, &out_pic);
-    if (len < 0) return env->NewObject(rsCls, rsInit, X264A_ERR_ENCODE_FRAME, NULL, 0, false);
+    int len = encode_picture(ctx, &nal, &nnal, &ctx->input_picture, &out_pic);
+    env->ReleaseByteArrayElements(frame, input_frame, JNI_ABORT);
+    if (len < 0) return encode_error(env, X264A_ERR_ENCODE_FRAME);
 
     // return encoded data
+    // x264 writes the payloads of all NAL units of a frame one after another, so they are copied at once
     jbyteArray output_frame = env->NewByteArray(len);
-    env->SetByteArrayRegion(output_frame, 0, len, (jbyte *) nal[0].p_payload);
+    if (len > 0) env->SetByteArrayRegion(output_frame, 0, len, (jbyte *) nal[0].p_payload);
+    jintArray nals = env->NewIntArray(nnal * X264A_NAL_FIELDS);
+    if (nnal > 0) {
+        jint *table = env->GetIntArrayElements(nals, NULL);
+        fill_nal_table(nal, nnal, 0, table);
+        env->ReleaseIntArrayElements(nals, table, 0);
+    }
 
-    env->ReleaseByteArrayElements(frame, input_frame, JNI_ABORT);
     return env->NewObject(rsCls, rsInit,
-                          X264A_OK, output_frame, out_pic.i_pts, out_pic.i_type == X264_TYPE_IDR);
+                          X264A_OK, output_frame, out_pic.i_pts, (jboolean) (out_pic.b_keyframe != 0), nals);
+}
+
+/**
+ * Keep the output of x264_encoder_encode in [frame], in the buffers of x264 or copied into the frame.
+ */
+static void set_encoded_frame(EncodedFrame *frame, const x264_nal_t *nal, int nnal, int len,
+                              const x264_picture_t &out_pic, bool copy) {
+    frame->payload = nnal > 0 ? nal[0].p_payload : NULL;
+    if (copy) {
+        frame->data.assign(frame->payload, frame->payload + len);
+        frame->payload = frame->data.data();
+    }
+    frame->size = len;
+    frame->nals.resize((size_t) nnal * X264A_NAL_FIELDS);
+    if (nnal > 0) fill_nal_table(nal, nnal, 0, frame->nals.data());
+    frame->pts = out_pic.i_pts;
+    frame->dts = out_pic.i_dts;
+    // also set on the recovery point of an intra refresh, from where a decoder can start as from an IDR frame
+    frame->key = out_pic.b_keyframe != 0;
+}
+
+/**
+ * Copy [frame] into [out] from [out_offset] and its index table into [nals], with the offsets of the units in [out].
+ * Nothing is written but [frame_info] when the frame doesn't fit.
+ *
+ * @return the number of NAL units, or an X264A_ERR_* code.
+ */
+static jint write_frame(JNIEnv *env, const EncodedFrame &frame, jobject out, jint out_offset, jintArray nals,
+                        jlongArray frame_info) {
+    if (frame_info == NULL || env->GetArrayLength(frame_info) < X264A_FRAME_INFO_FIELDS) {
+        LOGE("frameInfo must hold %d longs.", X264A_FRAME_INFO_FIELDS);
+        return X264A_ERR_INVALID_BUFFER;
+    }
+    jint nnal = (jint) (frame.nals.size() / X264A_NAL_FIELDS);
+    jlong info[X264A_FRAME_INFO_FIELDS] = {frame.pts, frame.key, frame.size, nnal, frame.dts};
+    env->SetLongArrayRegion(frame_info, 0, X264A_FRAME_INFO_FIELDS, info);
+
+    uint8_t *address = out == NULL ? NULL : (uint8_t *) env->GetDirectBufferAddress(out);
+    if (address == NULL || nals == NULL || out_offset < 0) {
+        LOGE("The output must be a direct buffer and an index table.");
+        return X264A_ERR_INVALID_BUFFER;
+    }
+    if (env->GetDirectBufferCapacity(out) - out_offset < frame.size ||
+        env->GetArrayLength(nals) < nnal * X264A_NAL_FIELDS) {
+        return X264A_ERR_OUTPUT_TOO_SMALL;
+    }
+    if (frame.size > 0) memcpy(address + out_offset, frame.payload, frame.size);
+    if (nnal > 0) {
+        // doesn't copy the array, unlike GetIntArrayElements on some VMs
+        jint *table = (jint *) env->GetPrimitiveArrayCritical(nals, NULL);
+        for (jint i = 0; i < nnal * X264A_NAL_FIELDS; i += X264A_NAL_FIELDS) {
+            table[i] = frame.nals[i];
+            table[i + 1] = frame.nals[i + 1];
+            table[i + 2] = frame.nals[i + 2] + out_offset;
+            table[i + 3] = frame.nals[i + 3];
+        }
+        env->ReleasePrimitiveArrayCritical(nals, table, 0);
+    }
+    return nnal;
+}
+
+/**
+ * Point [img] at the planes of a [csp] frame in direct buffers, [u] holds the interleaved chroma of NV12/NV21.
+ * The last row of each plane must be complete, x264 reads whole rows.
+ *
+ * @return X264A_OK, or an X264A_ERR_* code.
+ */
+static int get_input_planes(JNIEnv *env, const EncoderContext *ctx, jint csp,
+                            jobject y, jint y_stride, jobject u, jint u_stride, jobject v, jint v_stride,
+                            x264_image_t *img) {
+    int planes;
+    switch (csp) {
+        case X264_CSP_NV21:
+        case X264_CSP_NV12:
+            planes = 2;
+            break;
+        case X264_CSP_I420:
+        case X264_CSP_YV12:
+            planes = 3;
+            break;
+        default:
+            return X264A_ERR_NOT_SUPPORT_CPS;
+    }
+    jobject buffers[3] = {y, u, v};
+    jint strides[3] = {y_stride, u_stride, v_stride};
+    jlong width = ctx->params.i_width, height = ctx->params.i_height;
+    for (int i = 0; i < planes; i++) {
+        // the interleaved chroma rows are as wide as the luma ones
+        jlong row = i == 0 || planes == 2 ? width : width / 2;
+        jlong rows = i == 0 ? height : height / 2;
+        uint8_t *address = buffers[i] == NULL ? NULL : (uint8_t *) env->GetDirectBufferAddress(buffers[i]);
+        if (address == NULL || strides[i] < row ||
+            env->GetDirectBufferCapacity(buffers[i]) < strides[i] * (rows - 1) + row) {
+            LOGE("Plane %d must be a direct buffer of %lld rows of %lld bytes.", i, (long long) rows,
+                 (long long) row);
+            return X264A_ERR_INVALID_BUFFER;
+        }
+        img->plane[i] = address;
+        img->i_stride[i] = strides[i];
+    }
+    img->i_csp = csp;
+    img->i_plane = planes;
+    return X264A_OK;
+}
+
+/**
+ * Encode one frame read in place from direct buffers, and write its NAL units into a direct buffer of the caller,
+ * without allocating anything. See get_input_planes and write_frame.
+ **/
+JNIEXPORT jint encodeFrameInto(JNIEnv *env, jobject thiz,
+                               jobject y, jint y_stride,
+                               jobject u, jint u_stride,
+                               jobject v, jint v_stride,
+                               jint csp, jlong pts,
+                               jobject out, jint out_offset,
+                               jintArray nals, jlongArray frame_info) {
+    EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    if (ctx->pending) return X264A_ERR_OUTPUT_PENDING;
+    if (is_async(ctx)) return X264A_ERR_ASYNC_STATE;
+
+    int result = get_input_planes(env, ctx, csp, y, y_stride, u, u_stride, v, v_stride, &ctx->input_picture.img);
+    if (result != X264A_OK) return result;
+    ctx->input_picture.i_pts = pts;
+    ctx->input_picture.i_type = X264_TYPE_AUTO;
+
+    int nnal;
+    x264_nal_t *nal;
+    x264_picture_t out_pic;
+    int len = encode_picture(ctx, &nal, &nnal, &ctx->input_picture, &out_pic);
+    if (len < 0) return X264A_ERR_ENCODE_FRAME;
+
+    // x264 keeps the payloads until the next x264_encoder_encode, which isn't called while the frame is pending
+    set_encoded_frame(&ctx->pending_frame, nal, nnal, len, out_pic, false);
+    result = write_frame(env, ctx->pending_frame, out, out_offset, nals, frame_info);
+    ctx->pending = result < 0;
+    return result;
+}
+
+/**
+ * Copy the frame of the last encodeFrameInto which didn't fit.
+ *
+ * @return the number of NAL units, 0 if no frame is pending, or an X264A_ERR_* code.
+ */
+JNIEXPORT jint takePendingFrame(JNIEnv *env, jobject thiz, jobject out, jint out_offset, jintArray nals,
+                                jlongArray frame_info) {
+    EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    if (!ctx->pending) return 0;
+    jint result = write_frame(env, ctx->pending_frame, out, out_offset, nals, frame_info);
+    ctx->pending = result < 0;
+    return result;
+}
+
+/**
+ * Encode the next frame delayed by x264 (lookahead, B-frames, frame threads) once no more frames will be encoded,
+ * and write it as encodeFrameInto does.
+ *
+ * @return the number of NAL units, X264A_ERR_END_OF_STREAM after the last delayed frame, or an X264A_ERR_* code.
+ */
+JNIEXPORT jint flushFrameInto(JNIEnv *env, jobject thiz, jobject out, jint out_offset, jintArray nals,
+                              jlongArray frame_info) {
+    EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    if (ctx->pending) return X264A_ERR_OUTPUT_PENDING;
+    if (is_async(ctx)) return X264A_ERR_ASYNC_STATE;
+
+    int nnal;
+    x264_nal_t *nal;
+    x264_picture_t out_pic;
+    int len = 0;
+    // a call may return no frame while the frame threads are still busy
+    while (len == 0) {
+        if (delayed_frames(ctx) == 0) return X264A_ERR_END_OF_STREAM;
+        len = encode_picture(ctx, &nal, &nnal, NULL, &out_pic);
+    }
+    if (len < 0) return X264A_ERR_ENCODE_FRAME;
+
+    set_encoded_frame(&ctx->pending_frame, nal, nnal, len, out_pic, false);
+    jint result = write_frame(env, ctx->pending_frame, out, out_offset, nals, frame_info);
+    ctx->pending = result < 0;
+    return result;
+}
+
+// ===== Asynchronous encoding =====
+
+/**
+ * The encode thread: encodes the frames of input_queue one after another into output_queue,
+ * then after finishAsync the frames delayed by x264 (lookahead, B-frames, frame threads).
+ * x264 spreads each call over its own i_threads, so the caller only copies frames in and out.
+ */
+static void encode_loop(EncoderContext *ctx) {
+    std::unique_lock<std::mutex> lock(ctx->queue_mutex);
+    for (;;) {
+        ctx->queue_cond.wait(lock, [ctx] {
+            return ctx->stopping || !ctx->input_queue.empty() || (ctx->flushing && !ctx->finished);
+        });
+        if (ctx->stopping) break;
+        x264_picture_t *picture = NULL;
+        if (!ctx->input_queue.empty()) {
+            picture = ctx->input_queue.front();
+            ctx->input_queue.pop_front();
+        }
+        EncodedFrame *frame;
+        if (ctx->free_frames.empty()) {
+            frame = new EncodedFrame();
+        } else {
+            frame = ctx->free_frames.back();
+            ctx->free_frames.pop_back();
+        }
+        lock.unlock();
+
+        int len = 0;
+        if (picture != NULL || delayed_frames(ctx) > 0) {
+            int nnal;
+            x264_nal_t *nal;
+            x264_picture_t out_pic;
+            len = encode_picture(ctx, &nal, &nnal, picture, &out_pic);
+            if (len > 0) set_encoded_frame(frame, nal, nnal, len, out_pic, true);
+        }
+        bool drained = picture == NULL && (len < 0 || delayed_frames(ctx) == 0);
+
+        lock.lock();
+        if (picture != NULL) ctx->free_pictures.push_back(picture);
+        if (len > 0) {
+            ctx->output_queue.push_back(frame);
+        } else {
+            ctx->free_frames.push_back(frame);
+        }
+        if (len < 0) {
+            LOGE("x264_encoder_encode error: %d", len);
+            ctx->async_error = X264A_ERR_ENCODE_FRAME;
+        }
+        if (drained) ctx->finished = true;
+        ctx->queue_cond.notify_all();
+    }
+}
+
+/**
+ * Enter a call using the queues, unless the encode thread isn't running or is being stopped.
+ * Every successful call must be paired with leave_async.
+ */
+static bool enter_async(EncoderContext *ctx) {
+    std::lock_guard<std::mutex> lock(ctx->queue_mutex);
+    if (!ctx->async || ctx->stopping) return false;
+    ctx->async_users++;
+    return true;
+}
+
+static void leave_async(EncoderContext *ctx) {
+    {
+        std::lock_guard<std::mutex> lock(ctx->queue_mutex);
+        ctx->async_users--;
+    }
+    ctx->queue_cond.notify_all();
+}
+
+/**
+ * Stop the encode thread and free the queues, once the submitFrame, pollFrame and finishAsync calls in progress
+ * returned. The frames not polled yet are dropped.
+ */
+static void stop_async(EncoderContext *ctx) {
+    if (ctx == NULL) return;
+    {
+        std::unique_lock<std::mutex> lock(ctx->queue_mutex);
+        if (!ctx->async || ctx->stopping) return;
+        ctx->stopping = true;
+        ctx->queue_cond.notify_all();
+        ctx->queue_cond.wait(lock, [ctx] { return ctx->async_users == 0; });
+    }
+    ctx->encode_thread.join();
+    std::lock_guard<std::mutex> lock(ctx->queue_mutex);
+    for (x264_picture_t &picture : ctx->pictures) x264_picture_clean(&picture);
+    for (EncodedFrame *frame : ctx->output_queue) delete frame;
+    for (EncodedFrame *frame : ctx->free_frames) delete frame;
+    ctx->pictures.clear();
+    ctx->free_pictures.clear();
+    ctx->input_queue.clear();
+    ctx->output_queue.clear();
+    ctx->free_frames.clear();
+    ctx->async = false;
+}
+
+/**
+ * Start the encode thread, with [queue_size] input frames of [csp] allocated once.
+ */
+JNIEXPORT jint startAsync(JNIEnv *env, jobject thiz, jint csp, jint queue_size) {
+    EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    if (ctx->encoder == NULL || is_async(ctx) || ctx->pending) return X264A_ERR_ASYNC_STATE;
+    if (csp != X264_CSP_I420 && csp != X264_CSP_YV12 && csp != X264_CSP_NV12 && csp != X264_CSP_NV21)
+        return X264A_ERR_NOT_SUPPORT_CPS;
+
+    ctx->pictures.resize(queue_size < 1 ? 1 : (size_t) queue_size);
+    for (size_t i = 0; i < ctx->pictures.size(); i++) {
+        if (x264_picture_alloc(&ctx->pictures[i], csp, ctx->params.i_width, ctx->params.i_height) < 0) {
+            for (size_t j = 0; j < i; j++) x264_picture_clean(&ctx->pictures[j]);
+            ctx->pictures.clear();
+            return X264A_ERR_INVALID_BUFFER;
+        }
+        ctx->free_pictures.push_back(&ctx->pictures[i]);
+    }
+    std::lock_guard<std::mutex> lock(ctx->queue_mutex);
+    ctx->flushing = false;
+    ctx->finished = false;
+    ctx->stopping = false;
+    ctx->async_users = 0;
+    ctx->async_error = X264A_OK;
+    ctx->async = true;
+    ctx->encode_thread = std::thread(encode_loop, ctx);
+    return X264A_OK;
+}
+
+/**
+ * Copy a frame into the queue of the encode thread, never waiting for the encoder.
+ * The planes are read from direct buffers as in encodeFrameInto, and can be reused as soon as this returns.
+ *
+ * @return X264A_OK, X264A_ERR_QUEUE_FULL when the encoder lags behind and the frame is dropped, or an error.
+ */
+JNIEXPORT jint submitFrame(JNIEnv *env, jobject thiz,
+                           jobject y, jint y_stride,
+                           jobject u, jint u_stride,
+                           jobject v, jint v_stride,
+                           jlong pts) {
+    EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    if (!enter_async(ctx)) return X264A_ERR_ASYNC_STATE;
+    x264_picture_t *picture = NULL;
+    int result = X264A_OK;
+    {
+        std::lock_guard<std::mutex> lock(ctx->queue_mutex);
+        if (ctx->async_error != X264A_OK) {
+            result = ctx->async_error;
+        } else if (ctx->flushing) {
+            result = X264A_ERR_ASYNC_STATE;
+        } else if (ctx->free_pictures.empty()) {
+            result = X264A_ERR_QUEUE_FULL;
+        } else {
+            picture = ctx->free_pictures.front();
+            ctx->free_pictures.pop_front();
+        }
+    }
+    if (picture == NULL) {
+        leave_async(ctx);
+        return result;
+    }
+
+    x264_image_t src;
+    result = get_input_planes(env, ctx, picture->img.i_csp, y, y_stride, u, u_stride, v, v_stride, &src);
+    if (result == X264A_OK) {
+        for (int i = 0; i < src.i_plane; i++) {
+            size_t row = i == 0 || src.i_plane == 2 ? ctx->params.i_width : ctx->params.i_width / 2;
+            int rows = i == 0 ? ctx->params.i_height : ctx->params.i_height / 2;
+            for (int r = 0; r < rows; r++) {
+                memcpy(picture->img.plane[i] + (size_t) r * picture->img.i_stride[i],
+                       src.plane[i] + (size_t) r * src.i_stride[i], row);
+            }
+        }
+        picture->i_pts = pts;
+        picture->i_type = X264_TYPE_AUTO;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ctx->queue_mutex);
+        if (result == X264A_OK) {
+            ctx->input_queue.push_back(picture);
+        } else {
+            ctx->free_pictures.push_back(picture);
+        }
+    }
+    leave_async(ctx);
+    return result;
+}
+
+/**
+ * Copy the next encoded frame, waiting up to [timeout_ms] for it. See write_frame.
+ * The frame stays first in the queue when it doesn't fit.
+ *
+ * @return the number of NAL units, 0 if no frame is ready, X264A_ERR_END_OF_STREAM after the last frame
+ * following finishAsync, or an X264A_ERR_* code.
+ */
+JNIEXPORT jint pollFrame(JNIEnv *env, jobject thiz, jobject out, jint out_offset, jintArray nals,
+                         jlongArray frame_info, jint timeout_ms) {
+    EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    if (!enter_async(ctx)) return X264A_ERR_ASYNC_STATE;
+    jint result;
+    {
+        std::unique_lock<std::mutex> lock(ctx->queue_mutex);
+        if (timeout_ms > 0) {
+            // stopAsync doesn't wait for the timeout
+            ctx->queue_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [ctx] {
+                return !ctx->output_queue.empty() || ctx->finished || ctx->async_error != X264A_OK ||
+                       ctx->stopping;
+            });
+        }
+        if (ctx->output_queue.empty()) {
+            if (ctx->async_error != X264A_OK) {
+                result = ctx->async_error;
+            } else if (ctx->stopping) {
+                result = X264A_ERR_ASYNC_STATE;
+            } else {
+                result = ctx->finished ? X264A_ERR_END_OF_STREAM : 0;
+            }
+        } else {
+            // the encode thread only appends to the queue, the lock is held for the copy anyway as it is short
+            EncodedFrame *frame = ctx->output_queue.front();
+            result = write_frame(env, *frame, out, out_offset, nals, frame_info);
+            if (result >= 0) {
+                ctx->output_queue.pop_front();
+                ctx->free_frames.push_back(frame);
+            }
+        }
+    }
+    leave_async(ctx);
+    return result;
+}
+
+/**
+ * No more frames will be submitted: encode the queued and the delayed frames, pollFrame returns
+ * X264A_ERR_END_OF_STREAM after the last one.
+ */
+JNIEXPORT jint finishAsync(JNIEnv *env, jobject thiz) {
+    EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    {
+        std::lock_guard<std::mutex> lock(ctx->queue_mutex);
+        if (!ctx->async || ctx->stopping) return X264A_ERR_ASYNC_STATE;
+        ctx->flushing = true;
+    }
+    ctx->queue_cond.notify_all();
+    return X264A_OK;
+}
+
+JNIEXPORT void stopAsync(JNIEnv *env, jobject thiz) {
+    stop_async((EncoderContext *) get_ctx(env, thiz));
+}
+
+// ===== Runtime reconfiguration =====
+
+/**
+ * Change the rate control of the open encoder from the next frame, without new SPS and PPS.
+ * Each value below 0 is left unchanged. The rates are in bits per second as in X264Params.
+ * [crf] only applies in the constant quality mode and the VBV only if it was enabled by initEncoder,
+ * x264 can't switch the rate control method of an open encoder.
+ *
+ * @return X264A_OK, or X264A_ERR_RECONFIG if x264 refused the parameters.
+ */
+JNIEXPORT jint reconfigure(JNIEnv *env, jobject thiz, jint bitrate, jint vbv_max_bitrate, jint vbv_buffer_size,
+                           jfloat crf) {
+    EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    if (ctx == NULL || ctx->encoder == NULL) return X264A_ERR_RECONFIG;
+    std::lock_guard<std::mutex> lock(ctx->encoder_mutex);
+    x264_param_t params;
+    x264_encoder_parameters(ctx->encoder, &params);
+    if (bitrate >= 0) params.rc.i_bitrate = bitrate / 1000;
+    if (vbv_max_bitrate >= 0) params.rc.i_vbv_max_bitrate = vbv_max_bitrate / 1000;
+    if (vbv_buffer_size >= 0) params.rc.i_vbv_buffer_size = vbv_buffer_size / 1000;
+    if (crf >= 0) params.rc.f_rf_constant = crf;
+    if (x264_encoder_reconfig(ctx->encoder, &params) < 0) {
+        LOGE("x264_encoder_reconfig failed.");
+        return X264A_ERR_RECONFIG;
+    }
+    return X264A_OK;
+}
+
+/**
+ * Encode the next submitted frame as an IDR frame, e.g. when the receiver lost a reference.
+ */
+JNIEXPORT void forceIdr(JNIEnv *env, jobject thiz) {
+    EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    if (ctx == NULL) return;
+    std::lock_guard<std::mutex> lock(ctx->encoder_mutex);
+    ctx->force_idr = true;
+}
+
+/**
+ * Start an intra refresh from the next P-frame when the encoder uses periodic intra refresh, which spreads
+ * the intra blocks over several frames instead of a large IDR frame. Force an IDR frame otherwise.
+ */
+JNIEXPORT void intraRefresh(JNIEnv *env, jobject thiz) {
+    EncoderContext *ctx = (EncoderContext *) get_ctx(env, thiz);
+    if (ctx == NULL || ctx->encoder == NULL) return;
+    std::lock_guard<std::mutex> lock(ctx->encoder_mutex);
+    if (ctx->params.b_intra_refresh) {
+        x264_encoder_intra_refresh(ctx->encoder);
+    } else {
+        ctx->force_idr = true;
+    }
 }
 
 JNIEXPORT jstring getVersion(JNIEnv *env, jobject thiz) {
@@ -165,6 +806,21 @@ static JNINativeMethod methods[] = {
         {"initEncoder",    "(L" X264A_PACKAGE "X264Params;)L" X264A_PACKAGE "X264InitResult;", (void *) initEncoder},
         {"releaseEncoder", "()V",                                                              (void *) releaseEncoder},
         {"encodeFrame",    "([BIJ)L" X264A_PACKAGE "X264EncodeResult;",                        (void *) encodeFrame},
+        {"encodeFrameInto",
+         "(Ljava/nio/ByteBuffer;ILjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;IIJLjava/nio/ByteBuffer;I[I[J)I",
+                                                                                               (void *) encodeFrameInto},
+        {"takePendingFrame",
+         "(Ljava/nio/ByteBuffer;I[I[J)I",                                                      (void *) takePendingFrame},
+        {"flushFrameInto", "(Ljava/nio/ByteBuffer;I[I[J)I",                                    (void *) flushFrameInto},
+        {"startAsync",     "(II)I",                                                            (void *) startAsync},
+        {"submitFrame",
+         "(Ljava/nio/ByteBuffer;ILjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;IJ)I",             (void *) submitFrame},
+        {"pollFrame",      "(Ljava/nio/ByteBuffer;I[I[JI)I",                                   (void *) pollFrame},
+        {"finishAsync",    "()I",                                                              (void *) finishAsync},
+        {"stopAsync",      "()V",                                                              (void *) stopAsync},
+        {"reconfigure",    "(IIIF)I",                                                          (void *) reconfigure},
+        {"forceIdr",       "()V",                                                              (void *) forceIdr},
+        {"intraRefresh",   "()V",                                                              (void *) intraRefresh},
         {"getVersion",     "()Ljava/lang/String;",                                             (void *) getVersion},
 };
 
@@ -181,6 +837,24 @@ JNIEXPORT jint JNI_OnLoad(JavaVM *vm, void *reserved) {
         LOGE("JNI_OnLoad FindClass error.");
         return JNI_ERR;
     }
+    g_ctx_field = env->GetFieldID(clz, "ctx", "J");
+
+    jclass initResultCls = env->FindClass(X264A_PACKAGE"X264InitResult");
+    jclass encodeResultCls = env->FindClass(X264A_PACKAGE"X264EncodeResult");
+    if (g_ctx_field == NULL || initResultCls == NULL || encodeResultCls == NULL) {
+        LOGE("JNI_OnLoad FindClass error.");
+        return JNI_ERR;
+    }
+    g_init_result_cls = (jclass) env->NewGlobalRef(initResultCls);
+    g_init_result_init = env->GetMethodID(initResultCls, "<init>", "(I[B[B)V");
+    g_encode_result_cls = (jclass) env->NewGlobalRef(encodeResultCls);
+    g_encode_result_init = env->GetMethodID(encodeResultCls, "<init>", "(I[BJZ[I)V");
+    env->DeleteLocalRef(initResultCls);
+    env->DeleteLocalRef(encodeResultCls);
+    if (g_init_result_init == NULL || g_encode_result_init == NULL) {
+        LOGE("JNI_OnLoad GetMethodID error.");
+        return JNI_ERR;
+    }
 
     if (env->RegisterNatives(clz, methods, sizeof(methods) / sizeof(methods[0]))) {
         LOGE("JNI_OnLoad RegisterNatives error.");
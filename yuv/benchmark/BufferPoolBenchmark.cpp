@@ -0,0 +1,54 @@
+// Compares the per call new[]/delete[] the byte array JNI functions used to do
+// with borrowing the same buffers from a BufferPool.
+//
+// Each iteration emulates one call: a source buffer the size of the input frame is filled,
+// a destination buffer is written by a routine, and both are given back.
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+
+#include "BufferPool.h"
+#include "YuvConvert.h"
+
+namespace {
+
+void BM_NewDelete(benchmark::State &state) {
+    int32_t width = (int32_t) state.range(0);
+    int32_t height = (int32_t) state.range(1);
+    size_t size = (size_t) width * height * 3 / 2;
+    for (auto _ : state) {
+        auto *src = new uint8_t[size];
+        memset(src, 0x80, size);
+        auto *dst = new uint8_t[size];
+        mirrorI420(src, width, height, dst);
+        benchmark::DoNotOptimize(dst);
+        delete[] src;
+        delete[] dst;
+    }
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) size);
+}
+
+void BM_BufferPool(benchmark::State &state) {
+    int32_t width = (int32_t) state.range(0);
+    int32_t height = (int32_t) state.range(1);
+    size_t size = (size_t) width * height * 3 / 2;
+    BufferPool pool;
+    for (auto _ : state) {
+        PooledBuffer src(pool, size);
+        memset(src.data(), 0x80, size);
+        PooledBuffer dst(pool, size);
+        mirrorI420(src.data(), width, height, dst.data());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    BufferPoolStats stats = pool.stats();
+    state.counters["hits"] = (double) stats.hits;
+    state.counters["misses"] = (double) stats.misses;
+    state.counters["held_MB"] = (double) stats.bytes_held / 1e6;
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) size);
+}
+
+}  // namespace
+
+BENCHMARK(BM_NewDelete)->Args({1280, 720})->Args({1920, 1080})->Args({3840, 2160})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_BufferPool)->Args({1280, 720})->Args({1920, 1080})->Args({3840, 2160})->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,74 @@
+// Scaling of the band-parallel routines with the number of threads on 4K frames.
+//
+// The argument is the thread count, 1 runs on the calling thread without a pool.
+// The range goes up to the number of cores of the host.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "YuvConvert.h"
+
+namespace {
+
+const int32_t kWidth = 3840;
+const int32_t kHeight = 2160;
+
+std::vector<uint8_t> makeFrame(int32_t width, int32_t height) {
+    std::vector<uint8_t> data((size_t) width * height * 3 / 2);
+    srand(1);
+    for (auto &b : data) b = (uint8_t) rand();
+    return data;
+}
+
+std::unique_ptr<WorkerPool> makeWorkers(const benchmark::State &state) {
+    int32_t thread_count = (int32_t) state.range(0);
+    return std::unique_ptr<WorkerPool>(thread_count > 1 ? new WorkerPool(thread_count) : nullptr);
+}
+
+void threadCounts(benchmark::internal::Benchmark *b) {
+    int32_t cores = (int32_t) std::max(1u, std::thread::hardware_concurrency());
+    for (int32_t i = 1; i <= cores; i++) b->Arg(i);
+}
+
+void BM_ConvertNV21Rotate90(benchmark::State &state) {
+    std::unique_ptr<WorkerPool> workers = makeWorkers(state);
+    std::vector<uint8_t> src = makeFrame(kWidth, kHeight);
+    std::vector<uint8_t> dst(src.size());
+    for (auto _ : state) {
+        convertToI420(src.data(), (int32_t) src.size(), 2, kWidth, kHeight, dst.data(), false, 90, workers.get());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) src.size());
+}
+
+void BM_RotateI420_90(benchmark::State &state) {
+    std::unique_ptr<WorkerPool> workers = makeWorkers(state);
+    std::vector<uint8_t> src = makeFrame(kWidth, kHeight);
+    std::vector<uint8_t> dst(src.size());
+    for (auto _ : state) {
+        rotateI420(src.data(), kWidth, kHeight, dst.data(), 90, workers.get());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) src.size());
+}
+
+void BM_ScaleI420BoxTo1080p(benchmark::State &state) {
+    std::unique_ptr<WorkerPool> workers = makeWorkers(state);
+    std::vector<uint8_t> src = makeFrame(kWidth, kHeight);
+    std::vector<uint8_t> dst((size_t) 1920 * 1080 * 3 / 2);
+    for (auto _ : state) {
+        scaleI420(src.data(), kWidth, kHeight, dst.data(), 1920, 1080, libyuv::kFilterBox, workers.get());
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) src.size());
+}
+
+}  // namespace
+
+BENCHMARK(BM_ConvertNV21Rotate90)->Apply(threadCounts)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RotateI420_90)->Apply(threadCounts)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ScaleI420BoxTo1080p)->Apply(threadCounts)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,126 @@
+// Throughput of every YuvConvert routine behind YuvUtil at 480p, 720p, 1080p and 4K,
+// on the calling thread and without the JNI copies.
+//
+// Reports the source throughput (bytes_per_second) and the time per source pixel (time_per_pixel, e.g. 15ns).
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "YuvConvert.h"
+
+namespace {
+
+enum Op {
+    kAndroid420ToI420,
+    kConvertNV21ToI420Rotate90,
+    kMirrorI420,
+    kFlipVerticallyI420,
+    kRotateI420_90,
+    kScaleI420HalfBox,
+    kCropI420,
+    kI420ToNv21,
+    kI420ToNv12,
+    kNv21ToI420,
+    kNv12ToI420,
+    kMirrorNV12,
+    kScaleNV12HalfBox,
+    kNv21ToNV12,
+    kI420ToRgb24,
+};
+
+size_t frameSize(int32_t width, int32_t height) {
+    return (size_t) width * height * 3 / 2;
+}
+
+void BM_YuvConvert(benchmark::State &state, Op op) {
+    int32_t w = (int32_t) state.range(0), h = (int32_t) state.range(1);
+    size_t src_size = frameSize(w, h);
+    std::vector<uint8_t> src(src_size);
+    srand(1);
+    for (auto &b : src) b = (uint8_t) rand();
+    // Large enough for every destination including RGB24.
+    std::vector<uint8_t> dst((size_t) w * h * 3);
+    uint8_t *s = src.data();
+    uint8_t *d = dst.data();
+
+    for (auto _ : state) {
+        switch (op) {
+            case kAndroid420ToI420:
+                android420ToI420(s, 2, w, h, d, false, 0);
+                break;
+            case kConvertNV21ToI420Rotate90:
+                convertToI420(s, (int32_t) src_size, 2, w, h, d, false, 90);
+                break;
+            case kMirrorI420:
+                mirrorI420(s, w, h, d);
+                break;
+            case kFlipVerticallyI420:
+                flipVerticallyI420(s, w, h, d);
+                break;
+            case kRotateI420_90:
+                rotateI420(s, w, h, d, 90);
+                break;
+            case kScaleI420HalfBox:
+                scaleI420(s, w, h, d, w / 2, h / 2, libyuv::kFilterBox);
+                break;
+            case kCropI420:
+                cropI420(s, (int32_t) src_size, w, h, d, w / 2, h / 2, w / 4 / 2 * 2, h / 4 / 2 * 2);
+                break;
+            case kI420ToNv21:
+                i420ToNv21(s, w, h, d);
+                break;
+            case kI420ToNv12:
+                i420ToNv12(s, w, h, d);
+                break;
+            case kNv21ToI420:
+                nv21ToI420(s, w, h, d);
+                break;
+            case kNv12ToI420:
+                nv12ToI420(s, w, h, d, 0);
+                break;
+            case kMirrorNV12:
+                mirrorNV12(s, w, h, d);
+                break;
+            case kScaleNV12HalfBox:
+                scaleNV12(s, w, h, d, w / 2, h / 2, libyuv::kFilterBox);
+                break;
+            case kNv21ToNV12:
+                nv21ToNV12(s, w, h, d);
+                break;
+            case kI420ToRgb24:
+                i420ToRgb24(s, w, h, d, w * 3);
+                break;
+        }
+        benchmark::DoNotOptimize(d);
+    }
+
+    int64_t pixels = (int64_t) w * h;
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) src_size);
+    state.counters["time_per_pixel"] = benchmark::Counter((double) state.iterations() * pixels,
+                                                          benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+void resolutions(benchmark::internal::Benchmark *b) {
+    b->Args({640, 480})->Args({1280, 720})->Args({1920, 1080})->Args({3840, 2160});
+    b->ArgNames({"w", "h"})->Unit(benchmark::kMicrosecond);
+}
+
+}  // namespace
+
+BENCHMARK_CAPTURE(BM_YuvConvert, android420ToI420_NV21, kAndroid420ToI420)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, convertToI420_NV21_Rotate90, kConvertNV21ToI420Rotate90)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, mirrorI420, kMirrorI420)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, flipVerticallyI420, kFlipVerticallyI420)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, rotateI420_90, kRotateI420_90)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, scaleI420_HalfBox, kScaleI420HalfBox)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, cropI420_Center, kCropI420)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, i420ToNv21, kI420ToNv21)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, i420ToNv12, kI420ToNv12)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, nv21ToI420, kNv21ToI420)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, nv12ToI420, kNv12ToI420)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, mirrorNV12, kMirrorNV12)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, scaleNV12_HalfBox, kScaleNV12HalfBox)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, nv21ToNV12, kNv21ToNV12)->Apply(resolutions);
+BENCHMARK_CAPTURE(BM_YuvConvert, i420ToRgb24, kI420ToRgb24)->Apply(resolutions);
@@ -0,0 +1,160 @@
+// Compares the fused YuvPipeline with the chained calls the capture path used to make through YuvUtilNative:
+// convertToI420 -> cropI420 -> scaleI420 -> i420ToNv12
+//
+// The chained case emulates the JNI glue of every call: copy the Java array in, allocate the result,
+// run the routine and copy the result out into a new Java array.
+// The pipeline case works on direct buffers, so nothing is copied across JNI.
+//
+// Besides the time, each case reports `traffic_MB`, the bytes read and written per frame by every pass
+// including the JNI copies. It is derived from the frame sizes, not measured.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "YuvConvert.h"
+
+namespace {
+
+const int32_t kNV21 = 2;
+
+size_t frameSize(int32_t width, int32_t height) {
+    return (size_t) width * height * 3 / 2;
+}
+
+std::vector<uint8_t> makeSource(int32_t width, int32_t height) {
+    std::vector<uint8_t> data(frameSize(width, height));
+    srand(1);
+    for (auto &b : data) b = (uint8_t) rand();
+    return data;
+}
+
+// Emulates `GetByteArrayRegion` into a new buffer.
+uint8_t *copyIn(const uint8_t *java_array, size_t size) {
+    auto *data = new uint8_t[size];
+    memcpy(data, java_array, size);
+    return data;
+}
+
+// Emulates `NewByteArray` + `SetByteArrayRegion`.
+void copyOut(const uint8_t *data, size_t size, std::vector<uint8_t> &java_array) {
+    java_array.assign(data, data + size);
+}
+
+struct Scenario {
+    int32_t src_width;
+    int32_t src_height;
+    int32_t crop_left;
+    int32_t crop_top;
+    int32_t crop_width;
+    int32_t crop_height;
+    int32_t degree;
+    int32_t dst_width;
+    int32_t dst_height;
+};
+
+// 1080p camera frame -> 4:3 portrait preview.
+const Scenario kPortrait = {1920, 1080, 240, 0, 1440, 1080, 90, 720, 960};
+// 4K camera frame -> 1080p.
+const Scenario kDownscale = {3840, 2160, 0, 0, 3840, 2160, 0, 1920, 1080};
+
+void BM_Chained(benchmark::State &state, const Scenario &s) {
+    std::vector<uint8_t> java_src = makeSource(s.src_width, s.src_height);
+    std::vector<uint8_t> java_i420, java_crop, java_scale, java_nv12;
+
+    bool swap = s.degree == 90 || s.degree == 270;
+    int32_t rotated_width = swap ? s.src_height : s.src_width;
+    int32_t rotated_height = swap ? s.src_width : s.src_height;
+    // The crop rectangle is given in source coordinates, map it into the rotated frame.
+    int32_t crop_left = swap ? s.crop_top : s.crop_left;
+    int32_t crop_top = swap ? s.crop_left : s.crop_top;
+    int32_t crop_width = swap ? s.crop_height : s.crop_width;
+    int32_t crop_height = swap ? s.crop_width : s.crop_height;
+
+    size_t src_size = frameSize(s.src_width, s.src_height);
+    size_t crop_size = frameSize(crop_width, crop_height);
+    size_t dst_size = frameSize(s.dst_width, s.dst_height);
+
+    for (auto _ : state) {
+        uint8_t *in = copyIn(java_src.data(), java_src.size());
+        auto *out = new uint8_t[src_size];
+        convertToI420(in, (int32_t) src_size, kNV21, s.src_width, s.src_height, out, false, s.degree);
+        copyOut(out, src_size, java_i420);
+        delete[] in;
+        delete[] out;
+
+        in = copyIn(java_i420.data(), java_i420.size());
+        out = new uint8_t[crop_size];
+        cropI420(in, (int32_t) src_size, rotated_width, rotated_height, out, crop_width, crop_height, crop_left, crop_top);
+        copyOut(out, crop_size, java_crop);
+        delete[] in;
+        delete[] out;
+
+        in = copyIn(java_crop.data(), java_crop.size());
+        out = new uint8_t[dst_size];
+        scaleI420(in, crop_width, crop_height, out, s.dst_width, s.dst_height, libyuv::kFilterBox);
+        copyOut(out, dst_size, java_scale);
+        delete[] in;
+        delete[] out;
+
+        in = copyIn(java_scale.data(), java_scale.size());
+        out = new uint8_t[dst_size];
+        i420ToNv12(in, s.dst_width, s.dst_height, out);
+        copyOut(out, dst_size, java_nv12);
+        delete[] in;
+        delete[] out;
+
+        benchmark::DoNotOptimize(java_nv12.data());
+    }
+
+    // Every call: copy in (read + write), the routine itself, copy out (read + write).
+    double traffic = 0;
+    traffic += 2.0 * src_size + 2.0 * src_size + 2.0 * src_size;    // convertToI420
+    traffic += 2.0 * src_size + 2.0 * crop_size + 2.0 * crop_size;  // cropI420
+    traffic += 2.0 * crop_size + (crop_size + dst_size) + 2.0 * dst_size; // scaleI420
+    traffic += 2.0 * dst_size + 2.0 * dst_size + 2.0 * dst_size;    // i420ToNv12
+    state.counters["traffic_MB"] = traffic / 1e6;
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) src_size);
+}
+
+void BM_Pipeline(benchmark::State &state, const Scenario &s) {
+    std::vector<uint8_t> src_data = makeSource(s.src_width, s.src_height);
+    std::vector<uint8_t> dst_data(frameSize(s.dst_width, s.dst_height));
+    YuvFrame src = makeNv21Frame(src_data.data(), s.src_width, s.src_height);
+    YuvFrame dst = makeNv12Frame(dst_data.data(), s.dst_width, s.dst_height);
+
+    YuvPipelineConfig config{};
+    config.crop_left = s.crop_left;
+    config.crop_top = s.crop_top;
+    config.crop_width = s.crop_width;
+    config.crop_height = s.crop_height;
+    config.degree = s.degree;
+    config.filter_mode = libyuv::kFilterBox;
+
+    YuvPipeline pipeline;
+    for (auto _ : state) {
+        pipeline.process(src, config, dst);
+        benchmark::DoNotOptimize(dst_data.data());
+    }
+
+    size_t crop_size = frameSize(s.crop_width, s.crop_height);
+    size_t dst_size = frameSize(s.dst_width, s.dst_height);
+    size_t dst_chroma_size = dst_size - (size_t) s.dst_width * s.dst_height;
+    // A semi-planar source is converted (and rotated) into the scratch frame first,
+    // then scaled into the destination Y plane and the scratch chroma planes, which are interleaved at last.
+    double traffic = 0;
+    traffic += 2.0 * crop_size;                // convert + rotate
+    traffic += crop_size + dst_size;           // scale
+    traffic += 2.0 * dst_chroma_size;          // interleave chroma
+    state.counters["traffic_MB"] = traffic / 1e6;
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) frameSize(s.src_width, s.src_height));
+}
+
+}  // namespace
+
+BENCHMARK_CAPTURE(BM_Chained, Portrait_1080p, kPortrait)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Pipeline, Portrait_1080p, kPortrait)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Chained, Downscale_4K, kDownscale)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Pipeline, Downscale_4K, kDownscale)->Unit(benchmark::kMillisecond);
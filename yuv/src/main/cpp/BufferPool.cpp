@@ -0,0 +1,91 @@
+#include "BufferPool.h"
+
+#include <cstdlib>
+
+const size_t BufferPool::kAlignment;
+const size_t BufferPool::kDefaultMaxBytesHeld;
+
+BufferPool::BufferPool(size_t max_bytes_held) : max_bytes_held_(max_bytes_held), stats_() {}
+
+BufferPool::~BufferPool() {
+    trimLocked(0);
+}
+
+size_t BufferPool::sizeClassOf(size_t size) {
+    return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+uint8_t *BufferPool::acquire(size_t size) {
+    size_t size_class = sizeClassOf(size);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = idle_buffers_.find(size_class);
+        if (it != idle_buffers_.end() && !it->second.empty()) {
+            uint8_t *buffer = it->second.back();
+            it->second.pop_back();
+            stats_.hits++;
+            stats_.bytes_held -= size_class;
+            stats_.bytes_in_use += size_class;
+            return buffer;
+        }
+        stats_.misses++;
+        stats_.bytes_in_use += size_class;
+    }
+
+    // Allocate outside the lock.
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, kAlignment, size_class > 0 ? size_class : kAlignment) != 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes_in_use -= size_class;
+        return nullptr;
+    }
+    return static_cast<uint8_t *>(buffer);
+}
+
+void BufferPool::release(uint8_t *buffer, size_t size) {
+    if (buffer == nullptr) return;
+    size_t size_class = sizeClassOf(size);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes_in_use -= size_class;
+        if (stats_.bytes_held + size_class <= max_bytes_held_) {
+            // The vector of a size class only grows until it holds the peak number of buffers in flight.
+            idle_buffers_[size_class].push_back(buffer);
+            stats_.bytes_held += size_class;
+            return;
+        }
+    }
+    free(buffer);
+}
+
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trimLocked(0);
+}
+
+void BufferPool::setMaxBytesHeld(size_t max_bytes_held) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_held_ = max_bytes_held;
+    trimLocked(max_bytes_held);
+}
+
+size_t BufferPool::maxBytesHeld() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_bytes_held_;
+}
+
+BufferPoolStats BufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void BufferPool::trimLocked(size_t max_bytes_held) {
+    for (auto &entry : idle_buffers_) {
+        std::vector<uint8_t *> &buffers = entry.second;
+        while (!buffers.empty() && stats_.bytes_held > max_bytes_held) {
+            free(buffers.back());
+            buffers.pop_back();
+            stats_.bytes_held -= entry.first;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef LEOANDROIDBASEUTIL_BUFFERPOOL_H
+#define LEOANDROIDBASEUTIL_BUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+typedef struct BufferPoolStats {
+    /** The number of acquisitions served by an idle buffer. */
+    uint64_t hits;
+    /** The number of acquisitions which had to allocate. */
+    uint64_t misses;
+    /** The bytes of idle buffers kept by the pool. */
+    size_t bytes_held;
+    /** The bytes of buffers acquired but not yet released. */
+    size_t bytes_in_use;
+} BufferPoolStats;
+
+/**
+ * A thread safe pool of 64-byte aligned buffers.
+ *
+ * Buffers are grouped into size classes by their byte size rounded up to [kAlignment],
+ * so repeated calls with the same resolution get the same buffers back
+ * and the steady state performs no heap allocation.
+ *
+ * Released buffers are kept as long as the idle bytes do not exceed max_bytes_held, otherwise they are freed.
+ */
+class BufferPool {
+public:
+    static const size_t kAlignment = 64;
+    static const size_t kDefaultMaxBytesHeld = 64 * 1024 * 1024;
+
+    explicit BufferPool(size_t max_bytes_held = kDefaultMaxBytesHeld);
+
+    ~BufferPool();
+
+    BufferPool(const BufferPool &) = delete;
+
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    /** @return A buffer of at least [size] bytes or nullptr if out of memory. */
+    uint8_t *acquire(size_t size);
+
+    /** Give back a buffer acquired with the same [size]. */
+    void release(uint8_t *buffer, size_t size);
+
+    /** Free all idle buffers. */
+    void trim();
+
+    void setMaxBytesHeld(size_t max_bytes_held);
+
+    size_t maxBytesHeld() const;
+
+    BufferPoolStats stats() const;
+
+private:
+    static size_t sizeClassOf(size_t size);
+
+    void trimLocked(size_t max_bytes_held);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<size_t, std::vector<uint8_t *>> idle_buffers_;
+    size_t max_bytes_held_;
+    BufferPoolStats stats_;
+};
+
+/**
+ * A buffer borrowed from a [BufferPool] for the current scope.
+ */
+class PooledBuffer {
+public:
+    PooledBuffer(BufferPool &pool, size_t size) : pool_(pool), size_(size), data_(pool.acquire(size)) {}
+
+    ~PooledBuffer() {
+        if (data_ != nullptr) pool_.release(data_, size_);
+    }
+
+    PooledBuffer(const PooledBuffer &) = delete;
+
+    PooledBuffer &operator=(const PooledBuffer &) = delete;
+
+    uint8_t *data() const { return data_; }
+
+private:
+    BufferPool &pool_;
+    size_t size_;
+    uint8_t *data_;
+};
+
+#endif //LEOANDROIDBASEUTIL_BUFFERPOOL_H
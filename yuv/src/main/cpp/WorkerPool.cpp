@@ -0,0 +1,76 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int32_t thread_count) : thread_count_(thread_count < 1 ? 1 : thread_count) {
+    for (int32_t i = 1; i < thread_count_; i++) {
+        threads_.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::parallelFor(int32_t task_count, const std::function<void(int32_t)> &task) {
+    if (task_count <= 0) return;
+    if (threads_.empty() || task_count == 1) {
+        for (int32_t i = 0; i < task_count; i++) task(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        task_count_ = task_count;
+        next_task_ = 0;
+        generation_++;
+    }
+    work_cv_.notify_all();
+
+    runTasks(task, task_count);
+
+    // All tasks have been taken once the caller returns from runTasks,
+    // wait for the workers still running one. A worker waking up late finds no task to take.
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return active_workers_ == 0; });
+    task_ = nullptr;
+    task_count_ = 0;
+}
+
+void WorkerPool::workerLoop() {
+    uint64_t seen_generation = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_cv_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+        if (stop_) return;
+        seen_generation = generation_;
+        if (task_ == nullptr || next_task_ >= task_count_) continue;
+
+        const std::function<void(int32_t)> *task = task_;
+        int32_t task_count = task_count_;
+        active_workers_++;
+        lock.unlock();
+        runTasks(*task, task_count);
+        lock.lock();
+        if (--active_workers_ == 0) done_cv_.notify_all();
+    }
+}
+
+void WorkerPool::runTasks(const std::function<void(int32_t)> &task, int32_t task_count) {
+    while (true) {
+        int32_t index;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (next_task_ >= task_count) return;
+            index = next_task_++;
+        }
+        task(index);
+    }
+}
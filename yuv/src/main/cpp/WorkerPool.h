@@ -0,0 +1,58 @@
+#ifndef LEOANDROIDBASEUTIL_WORKERPOOL_H
+#define LEOANDROIDBASEUTIL_WORKERPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of threads which run the tasks of [parallelFor] together with the calling thread.
+ *
+ * [parallelFor] may be called from multiple threads, the calls are executed one after another.
+ */
+class WorkerPool {
+public:
+    /**
+     * @param thread_count The number of threads running the tasks, including the calling thread.
+     * So `thread_count - 1` threads are started.
+     */
+    explicit WorkerPool(int32_t thread_count);
+
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    int32_t threadCount() const { return thread_count_; }
+
+    /** Run `task(0)` to `task(task_count - 1)` across the threads and wait for all of them to finish. */
+    void parallelFor(int32_t task_count, const std::function<void(int32_t)> &task);
+
+private:
+    void workerLoop();
+
+    void runTasks(const std::function<void(int32_t)> &task, int32_t task_count);
+
+    int32_t thread_count_;
+    std::vector<std::thread> threads_;
+
+    // Serializes the callers of parallelFor.
+    std::mutex run_mutex_;
+
+    // Guards all the fields below.
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(int32_t)> *task_ = nullptr;
+    int32_t task_count_ = 0;
+    int32_t next_task_ = 0;
+    int32_t active_workers_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
+
+#endif //LEOANDROIDBASEUTIL_WORKERPOOL_H
@@ -1,35 +1,444 @@
 #include "YuvConvert.h"
 
-void android420ToI420(const uint8_t *src_android420_data, jint src_pixel_stride_uv, jint width, jint height, uint8_t *dst_i420_data, jboolean vertically_flip, jint degree) {
-    jint src_i420_y_size = width * height;
-    jint src_i420_u_size = src_i420_y_size >> 2;
+#include <algorithm>
+
+YuvFrame makeI420Frame(const uint8_t *i420_data, int32_t width, int32_t height) {
+    auto *data = const_cast<uint8_t *>(i420_data);
+    YuvFrame frame{};
+    frame.y = data;
+    frame.u = data + width * height;
+    frame.v = frame.u + (width >> 1) * (height >> 1);
+    frame.stride_y = width;
+    frame.stride_u = width >> 1;
+    frame.stride_v = width >> 1;
+    frame.pixel_stride_uv = 1;
+    frame.width = width;
+    frame.height = height;
+    return frame;
+}
 
-    const uint8_t *src_i420_y_data = src_android420_data;
-    const uint8_t *src_i420_u_data = src_android420_data + src_i420_y_size;
-    const uint8_t *src_i420_v_data = src_android420_data + src_i420_y_size + src_i420_u_size;
+YuvFrame makeNv12Frame(const uint8_t *nv12_data, int32_t width, int32_t height) {
+    auto *data = const_cast<uint8_t *>(nv12_data);
+    YuvFrame frame{};
+    frame.y = data;
+    frame.u = data + width * height;
+    frame.v = frame.u + 1;
+    frame.stride_y = width;
+    frame.stride_u = width;
+    frame.stride_v = width;
+    frame.pixel_stride_uv = 2;
+    frame.width = width;
+    frame.height = height;
+    return frame;
+}
 
-    uint8_t *dst_i420_y_data = dst_i420_data;
-    uint8_t *dst_i420_u_data = dst_i420_data + src_i420_y_size;
-    uint8_t *dst_i420_v_data = dst_i420_data + src_i420_y_size + src_i420_u_size;
+YuvFrame makeNv21Frame(const uint8_t *nv21_data, int32_t width, int32_t height) {
+    auto *data = const_cast<uint8_t *>(nv21_data);
+    YuvFrame frame{};
+    frame.y = data;
+    frame.v = data + width * height;
+    frame.u = frame.v + 1;
+    frame.stride_y = width;
+    frame.stride_u = width;
+    frame.stride_v = width;
+    frame.pixel_stride_uv = 2;
+    frame.width = width;
+    frame.height = height;
+    return frame;
+}
 
-    int verticalFlip = 1;
-    if (JNI_TRUE == vertically_flip) verticalFlip = -1;
-    int base_dst_stride_dimension = width;
-    if (90 == degree || 270 == degree) base_dst_stride_dimension = height;
-    libyuv::Android420ToI420Rotate(src_i420_y_data, width,
-                                   src_i420_u_data, width >> 1,
-                                   src_i420_v_data, width >> 1,
-                                   src_pixel_stride_uv,
-                                   dst_i420_y_data, base_dst_stride_dimension,
-                                   dst_i420_u_data, base_dst_stride_dimension >> 1,
-                                   dst_i420_v_data, base_dst_stride_dimension >> 1,
-                                   width, verticalFlip * height,
+YuvFrame cropYuvFrame(const YuvFrame &frame, int32_t left, int32_t top, int32_t width, int32_t height) {
+    YuvFrame region = frame;
+    region.y = frame.y + top * frame.stride_y + left;
+    region.u = frame.u + (top >> 1) * frame.stride_u + (left >> 1) * frame.pixel_stride_uv;
+    region.v = frame.v + (top >> 1) * frame.stride_v + (left >> 1) * frame.pixel_stride_uv;
+    region.width = width;
+    region.height = height;
+    return region;
+}
+
+// ==================================================
+// Band splitting
+// ==================================================
+
+// Bands smaller than this are not worth a thread switch.
+static const int32_t kMinBandRows = 64;
+
+/**
+ * Split [rows] into bands whose boundaries are multiples of [alignment]
+ * and call `fn(first_row, end_row)` for each band on [workers].
+ * Without [workers] or when the frame is too small, `fn(0, rows)` is called on the calling thread.
+ */
+static void forEachBand(WorkerPool *workers, int32_t rows, int32_t alignment,
+                        const std::function<void(int32_t, int32_t)> &fn) {
+    int32_t units = rows / alignment;
+    int32_t bands = workers == nullptr ? 1 : std::min(workers->threadCount(), rows / std::max(alignment, kMinBandRows));
+    if (bands <= 1 || units < bands) {
+        fn(0, rows);
+        return;
+    }
+    workers->parallelFor(bands, [&](int32_t band) {
+        int32_t first_row = (int32_t) ((int64_t) units * band / bands) * alignment;
+        int32_t end_row = band == bands - 1 ? rows : (int32_t) ((int64_t) units * (band + 1) / bands) * alignment;
+        fn(first_row, end_row);
+    });
+}
+
+static int32_t greatestCommonDivisor(int32_t a, int32_t b) {
+    while (b != 0) {
+        int32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// ==================================================
+// Frame descriptor API
+// ==================================================
+
+static void android420ToI420Band(const YuvFrame &src, const YuvFrame &dst, bool vertically_flip, int32_t degree) {
+    int verticalFlip = vertically_flip ? -1 : 1;
+    libyuv::Android420ToI420Rotate(src.y, src.stride_y,
+                                   src.u, src.stride_u,
+                                   src.v, src.stride_v,
+                                   src.pixel_stride_uv,
+                                   dst.y, dst.stride_y,
+                                   dst.u, dst.stride_u,
+                                   dst.v, dst.stride_v,
+                                   src.width, verticalFlip * src.height,
                                    (libyuv::RotationMode) degree);
 }
 
-void convertToI420(const uint8_t *src_yuv_data, jint src_length, jint format, jint width, jint height, uint8_t *dst_i420_data, jboolean vertically_flip, jint degree) {
-    jint src_i420_y_size = width * height;
-    jint src_i420_u_size = src_i420_y_size >> 2;
+void android420ToI420(const YuvFrame &src, const YuvFrame &dst, bool vertically_flip, int32_t degree, WorkerPool *workers) {
+    // Odd sizes would put chroma rows across band boundaries.
+    if (workers == nullptr || src.width % 2 != 0 || src.height % 2 != 0) {
+        android420ToI420Band(src, dst, vertically_flip, degree);
+        return;
+    }
+    // Each band of source rows is flipped and rotated on its own
+    // and lands as a band of rows (0, 180) or columns (90, 270) in [dst].
+    forEachBand(workers, src.height, 2, [&](int32_t first_row, int32_t end_row) {
+        int32_t rows = end_row - first_row;
+        int32_t top = vertically_flip ? src.height - end_row : first_row;
+        YuvFrame band_dst;
+        switch (degree) {
+            case libyuv::kRotate90:
+                band_dst = cropYuvFrame(dst, src.height - top - rows, 0, rows, src.width);
+                break;
+            case libyuv::kRotate180:
+                band_dst = cropYuvFrame(dst, 0, src.height - top - rows, src.width, rows);
+                break;
+            case libyuv::kRotate270:
+                band_dst = cropYuvFrame(dst, top, 0, rows, src.width);
+                break;
+            default:
+                band_dst = cropYuvFrame(dst, 0, top, src.width, rows);
+        }
+        android420ToI420Band(cropYuvFrame(src, 0, first_row, src.width, rows), band_dst, vertically_flip, degree);
+    });
+}
+
+void mirrorI420(const YuvFrame &src, const YuvFrame &dst) {
+    libyuv::I420Mirror(src.y, src.stride_y,
+                       src.u, src.stride_u,
+                       src.v, src.stride_v,
+                       dst.y, dst.stride_y,
+                       dst.u, dst.stride_u,
+                       dst.v, dst.stride_v,
+                       src.width, src.height);
+}
+
+void flipVerticallyI420(const YuvFrame &src, const YuvFrame &dst) {
+    libyuv::I420Copy(src.y, src.stride_y,
+                     src.u, src.stride_u,
+                     src.v, src.stride_v,
+                     dst.y, dst.stride_y,
+                     dst.u, dst.stride_u,
+                     dst.v, dst.stride_v,
+                     src.width, -src.height);
+}
+
+void rotateI420(const YuvFrame &src, const YuvFrame &dst, int32_t degree, WorkerPool *workers) {
+    // 要注意 dst 的 width 和 height 在旋转 90 或 270 度之后是相反的
+    if (workers != nullptr) {
+        android420ToI420(src, dst, false, degree, workers);
+        return;
+    }
+    libyuv::I420Rotate(src.y, src.stride_y,
+                       src.u, src.stride_u,
+                       src.v, src.stride_v,
+                       dst.y, dst.stride_y,
+                       dst.u, dst.stride_u,
+                       dst.v, dst.stride_v,
+                       src.width, src.height,
+                       (libyuv::RotationMode) degree);
+}
+
+static void scaleI420Band(const YuvFrame &src, const YuvFrame &dst, int32_t mode) {
+    libyuv::I420Scale(src.y, src.stride_y,
+                      src.u, src.stride_u,
+                      src.v, src.stride_v,
+                      src.width, src.height,
+                      dst.y, dst.stride_y,
+                      dst.u, dst.stride_u,
+                      dst.v, dst.stride_v,
+                      dst.width, dst.height,
+                      (libyuv::FilterMode) mode);
+}
+
+/**
+ * Whether the rows of scaling [src_height] to [dst_height] can be split into bands with the same result.
+ *
+ * libyuv steps through the source rows with a 16.16 fixed point increment `dy = (src_height << 16) / dst_height`,
+ * so destination row i samples `y0 + dy * i`. A band starts again from its own first row,
+ * which only equals the accumulated position of the whole frame when dy has no rounding error.
+ * Any filter but kFilterNone aligns the first and last rows of both frames when upscaling, which no band can reproduce.
+ */
+static bool canScaleInBands(int32_t src_height, int32_t dst_height, int32_t mode) {
+    if (src_height % 2 != 0 || dst_height % 2 != 0) return false;
+    if (dst_height > src_height && mode != libyuv::kFilterNone) return false;
+    return ((int64_t) src_height << 16) % dst_height == 0;
+}
+
+void scaleI420(const YuvFrame &src, const YuvFrame &dst, int32_t mode, WorkerPool *workers) {
+    if (workers == nullptr || !canScaleInBands(src.height, dst.height, mode)) {
+        scaleI420Band(src, dst, mode);
+        return;
+    }
+    // Destination rows which are a multiple of dst_step start at an even source row exactly,
+    // so every band keeps the scale ratio and the sampling phase of the whole frame.
+    int32_t gcd = greatestCommonDivisor(src.height, dst.height);
+    int32_t dst_step = dst.height / gcd;
+    int32_t src_step = src.height / gcd;
+    while (dst_step % 2 != 0 || src_step % 2 != 0) {
+        dst_step *= 2;
+        src_step *= 2;
+    }
+    forEachBand(workers, dst.height, dst_step, [&](int32_t first_row, int32_t end_row) {
+        int32_t src_first_row = first_row / dst_step * src_step;
+        int32_t src_end_row = end_row == dst.height ? src.height : end_row / dst_step * src_step;
+        scaleI420Band(cropYuvFrame(src, 0, src_first_row, src.width, src_end_row - src_first_row),
+                      cropYuvFrame(dst, 0, first_row, dst.width, end_row - first_row), mode);
+    });
+}
+
+void cropI420(const YuvFrame &src, const YuvFrame &dst, int32_t left, int32_t top) {
+    // Cropping is only a pointer offset. The copy handles both planar and semi-planar sources.
+    android420ToI420(cropYuvFrame(src, left, top, dst.width, dst.height), dst, false, libyuv::kRotate0);
+}
+
+void i420ToNv21(const YuvFrame &src, const YuvFrame &dst) {
+    libyuv::I420ToNV21(src.y, src.stride_y,
+                       src.u, src.stride_u,
+                       src.v, src.stride_v,
+                       dst.y, dst.stride_y,
+                       dst.v, dst.stride_v,
+                       src.width, src.height);
+}
+
+void i420ToNv12(const YuvFrame &src, const YuvFrame &dst) {
+    libyuv::I420ToNV12(src.y, src.stride_y,
+                       src.u, src.stride_u,
+                       src.v, src.stride_v,
+                       dst.y, dst.stride_y,
+                       dst.u, dst.stride_u,
+                       src.width, src.height);
+}
+
+void nv21ToI420(const YuvFrame &src, const YuvFrame &dst) {
+    libyuv::NV21ToI420(src.y, src.stride_y,
+                       src.v, src.stride_v,
+                       dst.y, dst.stride_y,
+                       dst.u, dst.stride_u,
+                       dst.v, dst.stride_v,
+                       src.width, src.height);
+}
+
+void nv12ToI420(const YuvFrame &src, const YuvFrame &dst, int32_t degree) {
+    libyuv::NV12ToI420Rotate(src.y, src.stride_y,
+                             src.u, src.stride_u,
+                             dst.y, dst.stride_y,
+                             dst.u, dst.stride_u,
+                             dst.v, dst.stride_v,
+                             src.width, src.height,
+                             (libyuv::RotationMode) degree);
+}
+
+void mirrorNV12(const YuvFrame &src, const YuvFrame &dst) {
+    libyuv::NV12Mirror(src.y, src.stride_y,
+                       src.u, src.stride_u,
+                       dst.y, dst.stride_y,
+                       dst.u, dst.stride_u,
+                       src.width, src.height);
+}
+
+void scaleNV12(const YuvFrame &src, const YuvFrame &dst, int32_t mode) {
+    libyuv::NV12Scale(src.y, src.stride_y,
+                      src.u, src.stride_u,
+                      src.width, src.height,
+                      dst.y, dst.stride_y,
+                      dst.u, dst.stride_u,
+                      dst.width, dst.height,
+                      (libyuv::FilterMode) mode);
+}
+
+void nv21ToNV12(const YuvFrame &src, const YuvFrame &dst) {
+    libyuv::NV21ToNV12(src.y, src.stride_y,
+                       src.v, src.stride_v,
+                       dst.y, dst.stride_y,
+                       dst.u, dst.stride_u,
+                       src.width, src.height);
+}
+
+void i420ToRgb24(const YuvFrame &src, uint8_t *dst_rgb24_data, int32_t dst_stride_rgb24) {
+    libyuv::I420ToRGB24(src.y, src.stride_y,
+                        src.u, src.stride_u,
+                        src.v, src.stride_v,
+                        dst_rgb24_data, dst_stride_rgb24,
+                        src.width, src.height);
+}
+
+// ==================================================
+// Fused pipeline
+// ==================================================
+
+YuvPipeline::~YuvPipeline() {
+    delete[] scratch_;
+}
+
+uint8_t *YuvPipeline::acquireScratch(size_t size) {
+    if (size > scratch_size_) {
+        delete[] scratch_;
+        scratch_ = new uint8_t[size];
+        scratch_size_ = size;
+    }
+    return scratch_;
+}
+
+bool YuvPipeline::process(const YuvFrame &src, const YuvPipelineConfig &config, const YuvFrame &dst, WorkerPool *workers) {
+    int32_t crop_width = config.crop_width > 0 ? config.crop_width : src.width - config.crop_left;
+    int32_t crop_height = config.crop_height > 0 ? config.crop_height : src.height - config.crop_top;
+    if (config.crop_left < 0 || config.crop_top < 0 || config.crop_left % 2 != 0 || config.crop_top % 2 != 0 ||
+        crop_width <= 0 || crop_height <= 0 ||
+        config.crop_left + crop_width > src.width || config.crop_top + crop_height > src.height) {
+        return false;
+    }
+    YuvFrame region = cropYuvFrame(src, config.crop_left, config.crop_top, crop_width, crop_height);
+
+    // Mirroring after rotating equals flipping vertically before rotating by:
+    // 0 -> 180, 90 -> 90, 180 -> 0, 270 -> 270.
+    int32_t degree = config.degree;
+    bool vertically_flip = config.mirror;
+    if (config.mirror && (degree == libyuv::kRotate0 || degree == libyuv::kRotate180)) {
+        degree = libyuv::kRotate180 - degree;
+    }
+    bool swap_size = degree == libyuv::kRotate90 || degree == libyuv::kRotate270;
+    bool reorient = degree != libyuv::kRotate0 || vertically_flip;
+    int32_t rotated_width = swap_size ? crop_height : crop_width;
+    int32_t rotated_height = swap_size ? crop_width : crop_height;
+
+    bool scale = dst.width != rotated_width || dst.height != rotated_height;
+    bool planar_src = region.pixel_stride_uv == 1;
+    bool planar_dst = dst.pixel_stride_uv == 1;
+    // Rotating the smaller frame is cheaper. Only planar sources can be scaled before converting.
+    bool scale_first = scale && planar_src && (int64_t) dst.width * dst.height < (int64_t) crop_width * crop_height;
+
+    // The intermediate I420 frame, if any, has the size before scaling or before rotating.
+    int32_t tmp_width = 0;
+    int32_t tmp_height = 0;
+    if (scale && scale_first && reorient) {
+        tmp_width = swap_size ? dst.height : dst.width;
+        tmp_height = swap_size ? dst.width : dst.height;
+    } else if (scale && !scale_first && (reorient || !planar_src)) {
+        tmp_width = rotated_width;
+        tmp_height = rotated_height;
+    }
+    size_t tmp_size = (size_t) tmp_width * tmp_height + 2 * (size_t) ((tmp_width + 1) >> 1) * ((tmp_height + 1) >> 1);
+    int32_t dst_chroma_width = (dst.width + 1) >> 1;
+    int32_t dst_chroma_height = (dst.height + 1) >> 1;
+    size_t chroma_size = planar_dst ? 0 : 2 * (size_t) dst_chroma_width * dst_chroma_height;
+    uint8_t *scratch = tmp_size + chroma_size > 0 ? acquireScratch(tmp_size + chroma_size) : nullptr;
+
+    // The last stage always writes I420. A semi-planar destination receives the Y plane directly
+    // and the chroma planes are interleaved into it afterward.
+    YuvFrame out = dst;
+    if (!planar_dst) {
+        out.u = scratch + tmp_size;
+        out.v = out.u + (size_t) dst_chroma_width * dst_chroma_height;
+        out.stride_u = dst_chroma_width;
+        out.stride_v = dst_chroma_width;
+        out.pixel_stride_uv = 1;
+    }
+
+    YuvFrame tmp{};
+    if (tmp_size > 0) {
+        tmp.y = scratch;
+        tmp.u = scratch + (size_t) tmp_width * tmp_height;
+        tmp.v = tmp.u + (size_t) ((tmp_width + 1) >> 1) * ((tmp_height + 1) >> 1);
+        tmp.stride_y = tmp_width;
+        tmp.stride_u = (tmp_width + 1) >> 1;
+        tmp.stride_v = (tmp_width + 1) >> 1;
+        tmp.pixel_stride_uv = 1;
+        tmp.width = tmp_width;
+        tmp.height = tmp_height;
+    }
+
+    if (!scale) {
+        android420ToI420(region, out, vertically_flip, degree, workers);
+    } else if (tmp_size == 0) {
+        scaleI420(region, out, config.filter_mode, workers);
+    } else if (scale_first) {
+        scaleI420(region, tmp, config.filter_mode, workers);
+        android420ToI420(tmp, out, vertically_flip, degree, workers);
+    } else {
+        android420ToI420(region, tmp, vertically_flip, degree, workers);
+        scaleI420(tmp, out, config.filter_mode, workers);
+    }
+
+    if (!planar_dst) {
+        if (dst.v == dst.u + 1) {
+            // NV12
+            libyuv::MergeUVPlane(out.u, out.stride_u, out.v, out.stride_v, dst.u, dst.stride_u,
+                                 dst_chroma_width, dst_chroma_height);
+        } else {
+            // NV21
+            libyuv::MergeUVPlane(out.v, out.stride_v, out.u, out.stride_u, dst.v, dst.stride_v,
+                                 dst_chroma_width, dst_chroma_height);
+        }
+    }
+    return true;
+}
+
+// ==================================================
+// Tightly packed buffer API
+// ==================================================
+
+void android420ToI420(const uint8_t *src_android420_data, int32_t src_pixel_stride_uv, int32_t width, int32_t height, uint8_t *dst_i420_data, bool vertically_flip, int32_t degree, WorkerPool *workers) {
+    YuvFrame src = makeI420Frame(src_android420_data, width, height);
+    src.pixel_stride_uv = src_pixel_stride_uv;
+
+    if (90 == degree || 270 == degree) {
+        android420ToI420(src, makeI420Frame(dst_i420_data, height, width), vertically_flip, degree, workers);
+    } else {
+        android420ToI420(src, makeI420Frame(dst_i420_data, width, height), vertically_flip, degree, workers);
+    }
+}
+
+void convertToI420(const uint8_t *src_yuv_data, int32_t src_length, int32_t format, int32_t width, int32_t height, uint8_t *dst_i420_data, bool vertically_flip, int32_t degree, WorkerPool *workers) {
+    // The 4:2:0 formats can be split into bands. YUY2 always runs on the calling thread.
+    if (workers != nullptr && format >= 1 && format <= 3) {
+        YuvFrame src = format == 2 ? makeNv21Frame(src_yuv_data, width, height)
+                                   : format == 3 ? makeNv12Frame(src_yuv_data, width, height)
+                                                 : makeI420Frame(src_yuv_data, width, height);
+        android420ToI420(src, (90 == degree || 270 == degree) ? makeI420Frame(dst_i420_data, height, width)
+                                                                : makeI420Frame(dst_i420_data, width, height),
+                         vertically_flip, degree, workers);
+        return;
+    }
+
+    int32_t src_i420_y_size = width * height;
+    int32_t src_i420_u_size = src_i420_y_size >> 2;
 
     uint8_t *dst_i420_y_data = dst_i420_data;
     uint8_t *dst_i420_u_data = dst_i420_data + src_i420_y_size;
@@ -50,8 +459,7 @@ void convertToI420(const uint8_t *src_yuv_data, jint src_length, jint format, ji
             fourcc = libyuv::FOURCC_I420;
     }
 
-    int verticalFlip = 1;
-    if (JNI_TRUE == vertically_flip) verticalFlip = -1;
+    int verticalFlip = vertically_flip ? -1 : 1;
     int base_dst_stride_dimension = width;
     if (90 == degree || 270 == degree) base_dst_stride_dimension = height;
     libyuv::ConvertToI420(src_yuv_data, src_length,
@@ -64,283 +472,70 @@ void convertToI420(const uint8_t *src_yuv_data, jint src_length, jint format, ji
                           (libyuv::RotationMode) degree, fourcc);
 }
 
-void mirrorI420(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_i420_data) {
-    jint src_i420_y_size = width * height;
-    jint src_i420_u_size = src_i420_y_size >> 2;
-
-    const uint8_t *src_i420_y_data = src_i420_data;
-    const uint8_t *src_i420_u_data = src_i420_data + src_i420_y_size;
-    const uint8_t *src_i420_v_data = src_i420_data + src_i420_y_size + src_i420_u_size;
-
-    uint8_t *dst_i420_y_data = dst_i420_data;
-    uint8_t *dst_i420_u_data = dst_i420_data + src_i420_y_size;
-    uint8_t *dst_i420_v_data = dst_i420_data + src_i420_y_size + src_i420_u_size;
-
-    libyuv::I420Mirror(src_i420_y_data, width,
-                       src_i420_u_data, width >> 1,
-                       src_i420_v_data, width >> 1,
-                       dst_i420_y_data, width,
-                       dst_i420_u_data, width >> 1,
-                       dst_i420_v_data, width >> 1,
-                       width, height);
+void mirrorI420(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_i420_data) {
+    mirrorI420(makeI420Frame(src_i420_data, width, height), makeI420Frame(dst_i420_data, width, height));
 }
 
-void flipVerticallyI420(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_i420_data) {
-    jint src_i420_y_size = width * height;
-    jint src_i420_u_size = src_i420_y_size >> 2;
-
-    const uint8_t *src_i420_y_data = src_i420_data;
-    const uint8_t *src_i420_u_data = src_i420_data + src_i420_y_size;
-    const uint8_t *src_i420_v_data = src_i420_data + src_i420_y_size + src_i420_u_size;
-
-    uint8_t *dst_i420_y_data = dst_i420_data;
-    uint8_t *dst_i420_u_data = dst_i420_data + src_i420_y_size;
-    uint8_t *dst_i420_v_data = dst_i420_data + src_i420_y_size + src_i420_u_size;
-
-    libyuv::I420Copy(src_i420_y_data, width,
-                     src_i420_u_data, width >> 1,
-                     src_i420_v_data, width >> 1,
-                     dst_i420_y_data, width,
-                     dst_i420_u_data, width >> 1,
-                     dst_i420_v_data, width >> 1,
-                     width, -height);
+void flipVerticallyI420(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_i420_data) {
+    flipVerticallyI420(makeI420Frame(src_i420_data, width, height), makeI420Frame(dst_i420_data, width, height));
 }
 
-void rotateI420(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_i420_data, jint degree) {
-    jint src_i420_y_size = width * height;
-    jint src_i420_u_size = (width >> 1) * (height >> 1);
-
-    const uint8_t *src_i420_y_data = src_i420_data;
-    const uint8_t *src_i420_u_data = src_i420_data + src_i420_y_size;
-    const uint8_t *src_i420_v_data = src_i420_data + src_i420_y_size + src_i420_u_size;
-
-    uint8_t *dst_i420_y_data = dst_i420_data;
-    uint8_t *dst_i420_u_data = dst_i420_data + src_i420_y_size;
-    uint8_t *dst_i420_v_data = dst_i420_data + src_i420_y_size + src_i420_u_size;
-
+void rotateI420(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_i420_data, int32_t degree, WorkerPool *workers) {
     // 要注意这里的 width 和 height 在旋转之后是相反的
     if (degree == libyuv::kRotate90 || degree == libyuv::kRotate270) {
-        libyuv::I420Rotate(src_i420_y_data, width,
-                           src_i420_u_data, width >> 1,
-                           src_i420_v_data, width >> 1,
-                           dst_i420_y_data, height,
-                           dst_i420_u_data, height >> 1,
-                           dst_i420_v_data, height >> 1,
-                           width, height,
-                           (libyuv::RotationMode) degree);
+        rotateI420(makeI420Frame(src_i420_data, width, height), makeI420Frame(dst_i420_data, height, width), degree, workers);
     } else {
-        libyuv::I420Rotate(src_i420_y_data, width,
-                           src_i420_u_data, width >> 1,
-                           src_i420_v_data, width >> 1,
-                           dst_i420_y_data, width,
-                           dst_i420_u_data, width >> 1,
-                           dst_i420_v_data, width >> 1,
-                           width, height,
-                           (libyuv::RotationMode) degree);
+        rotateI420(makeI420Frame(src_i420_data, width, height), makeI420Frame(dst_i420_data, width, height), degree, workers);
     }
 }
 
-void scaleI420(const uint8_t *src_i420_data, jint width, jint height,
-               uint8_t *dst_i420_data, jint dst_width, jint dst_height, jint mode) {
-    jint src_i420_y_size = width * height;
-    jint src_i420_u_size = (width >> 1) * (height >> 1);
-    const uint8_t *src_i420_y_data = src_i420_data;
-    const uint8_t *src_i420_u_data = src_i420_data + src_i420_y_size;
-    const uint8_t *src_i420_v_data = src_i420_data + src_i420_y_size + src_i420_u_size;
-
-    jint dst_i420_y_size = dst_width * dst_height;
-    jint dst_i420_u_size = (dst_width >> 1) * (dst_height >> 1);
-    uint8_t *dst_i420_y_data = dst_i420_data;
-    uint8_t *dst_i420_u_data = dst_i420_data + dst_i420_y_size;
-    uint8_t *dst_i420_v_data = dst_i420_data + dst_i420_y_size + dst_i420_u_size;
-
-    libyuv::I420Scale(src_i420_y_data, width,
-                      src_i420_u_data, width >> 1,
-                      src_i420_v_data, width >> 1,
-                      width, height,
-                      dst_i420_y_data, dst_width,
-                      dst_i420_u_data, dst_width >> 1,
-                      dst_i420_v_data, dst_width >> 1,
-                      dst_width, dst_height,
-                      (libyuv::FilterMode) mode);
+void scaleI420(const uint8_t *src_i420_data, int32_t width, int32_t height,
+               uint8_t *dst_i420_data, int32_t dst_width, int32_t dst_height, int32_t mode, WorkerPool *workers) {
+    scaleI420(makeI420Frame(src_i420_data, width, height), makeI420Frame(dst_i420_data, dst_width, dst_height), mode, workers);
 }
 
-void cropI420(const uint8_t *src_i420_data, jint src_length, jint width, jint height,
-              uint8_t *dst_i420_data, jint dst_width, jint dst_height, jint left, jint top) {
-    jint dst_i420_y_size = dst_width * dst_height;
-    jint dst_i420_u_size = (dst_width >> 1) * (dst_height >> 1);
-
-    uint8_t *dst_i420_y_data = dst_i420_data;
-    uint8_t *dst_i420_u_data = dst_i420_data + dst_i420_y_size;
-    uint8_t *dst_i420_v_data = dst_i420_data + dst_i420_y_size + dst_i420_u_size;
-
-    libyuv::ConvertToI420(src_i420_data, src_length,
-                          dst_i420_y_data, dst_width,
-                          dst_i420_u_data, dst_width >> 1,
-                          dst_i420_v_data, dst_width >> 1,
-                          left, top,
-                          width, height,
-                          dst_width, dst_height,
-                          libyuv::kRotate0, libyuv::FOURCC_I420);
+void cropI420(const uint8_t *src_i420_data, __attribute__((unused)) int32_t src_length, int32_t width, int32_t height,
+              uint8_t *dst_i420_data, int32_t dst_width, int32_t dst_height, int32_t left, int32_t top) {
+    cropI420(makeI420Frame(src_i420_data, width, height), makeI420Frame(dst_i420_data, dst_width, dst_height), left, top);
 }
 
-void i420ToNv21(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_nv21_data) {
-    jint src_y_size = width * height;
-    jint src_u_size = (width >> 1) * (height >> 1);
-
-    uint8_t *dst_nv21_y_data = dst_nv21_data;
-    uint8_t *dst_nv21_uv_data = dst_nv21_data + src_y_size;
-
-    const uint8_t *src_i420_y_data = src_i420_data;
-    const uint8_t *src_i420_u_data = src_i420_data + src_y_size;
-    const uint8_t *src_i420_v_data = src_i420_data + src_y_size + src_u_size;
-
-    libyuv::I420ToNV21(src_i420_y_data, width,
-                       src_i420_u_data, width >> 1,
-                       src_i420_v_data, width >> 1,
-                       dst_nv21_y_data, width,
-                       dst_nv21_uv_data, width,
-                       width, height);
+void i420ToNv21(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_nv21_data) {
+    i420ToNv21(makeI420Frame(src_i420_data, width, height), makeNv21Frame(dst_nv21_data, width, height));
 }
 
-void i420ToNv12(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_nv12_data) {
-    jint src_y_size = width * height;
-    jint src_u_size = (width >> 1) * (height >> 1);
-
-    uint8_t *dst_nv12_y_data = dst_nv12_data;
-    uint8_t *dst_nv12_uv_data = dst_nv12_data + src_y_size;
-
-    const uint8_t *src_i420_y_data = src_i420_data;
-    const uint8_t *src_i420_u_data = src_i420_data + src_y_size;
-    const uint8_t *src_i420_v_data = src_i420_data + src_y_size + src_u_size;
-
-    libyuv::I420ToNV12(src_i420_y_data, width,
-                       src_i420_u_data, width >> 1,
-                       src_i420_v_data, width >> 1,
-                       dst_nv12_y_data, width,
-                       dst_nv12_uv_data, width,
-                       width, height);
+void i420ToNv12(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_nv12_data) {
+    i420ToNv12(makeI420Frame(src_i420_data, width, height), makeNv12Frame(dst_nv12_data, width, height));
 }
 
-void nv21ToI420(const uint8_t *src_nv21_data, jint width, jint height, uint8_t *dst_i420_data) {
-    jint src_y_size = width * height;
-    jint src_u_size = (width >> 1) * (height >> 1);
-
-    const uint8_t *src_nv21_y_data = src_nv21_data;
-    const uint8_t *src_nv21_vu_data = src_nv21_data + src_y_size;
-
-    uint8_t *dst_i420_y_data = dst_i420_data;
-    uint8_t *dst_i420_u_data = dst_i420_data + src_y_size;
-    uint8_t *dst_i420_v_data = dst_i420_data + src_y_size + src_u_size;
-
-    libyuv::NV21ToI420(src_nv21_y_data, width,
-                       src_nv21_vu_data, width,
-                       dst_i420_y_data, width,
-                       dst_i420_u_data, width >> 1,
-                       dst_i420_v_data, width >> 1,
-                       width, height);
-}
-
-void nv12ToI420(const uint8_t *src_nv12_data, jint width, jint height, uint8_t *dst_i420_data, jint degree) {
-    // NV12 video size
-    jint nv12_y_size = width * height;
-
-    // YUV420 video size
-    jint i420_y_size = width * height;
-    jint i420_u_size = (width >> 1) * (height >> 1);
-
-    // src: buffer address of Y channel and UV channel
-    const uint8_t *src_y_data = src_nv12_data;
-    const uint8_t *src_uv_data = src_nv12_data + nv12_y_size;
-    jint src_stride_y = width;
-    jint src_stride_uv = width;
-
-    //dst: buffer address of Y channel、U channel and V channel
-    uint8_t *dst_y_data = dst_i420_data;
-    uint8_t *dst_u_data = dst_i420_data + i420_y_size;
-    uint8_t *dst_v_data = dst_i420_data + i420_y_size + i420_u_size;
-    jint dst_y_stride = width;
-    jint dst_u_stride = width >> 1;
-    jint dst_v_stride = dst_u_stride;
-
-    libyuv::NV12ToI420Rotate(src_y_data, src_stride_y,
-                             src_uv_data, src_stride_uv,
-                             dst_y_data, dst_y_stride,
-                             dst_u_data, dst_u_stride,
-                             dst_v_data, dst_v_stride,
-                             width, height,
-                             (libyuv::RotationMode) degree);
+void nv21ToI420(const uint8_t *src_nv21_data, int32_t width, int32_t height, uint8_t *dst_i420_data) {
+    nv21ToI420(makeNv21Frame(src_nv21_data, width, height), makeI420Frame(dst_i420_data, width, height));
 }
 
-void mirrorNV12(const uint8_t *src_nv12_data, jint width, jint height, uint8_t *dst_nv12_data) {
-    // NV12 video size
-    jint src_nv12_y_size = width * height;
-
-    const uint8_t *src_y_data = src_nv12_data;
-    const uint8_t *src_uv_data = src_nv12_data + src_nv12_y_size;
-
-    uint8_t *dst_nv12_y_data = dst_nv12_data;
-    uint8_t *dst_nv12_uv_data = dst_nv12_data + src_nv12_y_size;
-
-    libyuv::NV12Mirror(src_y_data, width,
-                       src_uv_data, width,
-                       dst_nv12_y_data, width,
-                       dst_nv12_uv_data, width,
-                       width, height);
+void nv12ToI420(const uint8_t *src_nv12_data, int32_t width, int32_t height, uint8_t *dst_i420_data, int32_t degree) {
+    // The destination size is swapped after rotating 90 or 270 degrees.
+    if (degree == libyuv::kRotate90 || degree == libyuv::kRotate270) {
+        nv12ToI420(makeNv12Frame(src_nv12_data, width, height), makeI420Frame(dst_i420_data, height, width), degree);
+    } else {
+        nv12ToI420(makeNv12Frame(src_nv12_data, width, height), makeI420Frame(dst_i420_data, width, height), degree);
+    }
 }
 
-void scaleNV12(const uint8_t *src_nv12_data, jint width, jint height,
-               uint8_t *dst_nv12_data, jint dst_width, jint dst_height, jint mode) {
-    // NV12 video size
-    jint src_nv12_y_size = width * height;
-
-    const uint8_t *src_y_data = src_nv12_data;
-    const uint8_t *src_uv_data = src_nv12_data + src_nv12_y_size;
-
-    jint dst_nv12_y_size = dst_width * dst_height;
-    uint8_t *dst_nv12_y_data = dst_nv12_data;
-    uint8_t *dst_nv12_uv_data = dst_nv12_data + dst_nv12_y_size;
-
-    libyuv::NV12Scale(src_y_data, width,
-                      src_uv_data, width,
-                      width, height,
-                      dst_nv12_y_data, dst_width,
-                      dst_nv12_uv_data, dst_width,
-                      dst_width, dst_height,
-                      (libyuv::FilterMode) mode);
+void mirrorNV12(const uint8_t *src_nv12_data, int32_t width, int32_t height, uint8_t *dst_nv12_data) {
+    mirrorNV12(makeNv12Frame(src_nv12_data, width, height), makeNv12Frame(dst_nv12_data, width, height));
 }
 
-void nv21ToNV12(const uint8_t *src_nv21_data, jint width, jint height, uint8_t *dst_nv12_data) {
-    jint src_y_size = width * height;
-
-    const uint8_t *src_nv21_y_data = src_nv21_data;
-    const uint8_t *src_nv21_vu_data = src_nv21_data + src_y_size;
-
-    uint8_t *dst_nv12_y_data = dst_nv12_data;
-    uint8_t *dst_nv12_uv_data = dst_nv12_data + src_y_size;
+void scaleNV12(const uint8_t *src_nv12_data, int32_t width, int32_t height,
+               uint8_t *dst_nv12_data, int32_t dst_width, int32_t dst_height, int32_t mode) {
+    scaleNV12(makeNv12Frame(src_nv12_data, width, height), makeNv12Frame(dst_nv12_data, dst_width, dst_height), mode);
+}
 
-    libyuv::NV21ToNV12(src_nv21_y_data, width,
-                       src_nv21_vu_data, width,
-                       dst_nv12_y_data, width,
-                       dst_nv12_uv_data, width,
-                       width, height);
+void nv21ToNV12(const uint8_t *src_nv21_data, int32_t width, int32_t height, uint8_t *dst_nv12_data) {
+    nv21ToNV12(makeNv21Frame(src_nv21_data, width, height), makeNv12Frame(dst_nv12_data, width, height));
 }
 
 // --------------------
 
-void i420ToRgb24(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_rgb24_data, jint dst_rgb24_data_len) {
-    jint src_y_size = width * height;
-    jint src_u_size = (width >> 1) * (height >> 1);
-
-    const uint8_t *src_i420_y_data = src_i420_data;
-    const uint8_t *src_i420_u_data = src_i420_data + src_y_size;
-    const uint8_t *src_i420_v_data = src_i420_data + src_y_size + src_u_size;
-
-//    printf("i420ToRgb24 width=%d height=%d dst_rgb24_data_len=%d", width, height, dst_rgb24_data_len);
-
-    libyuv::I420ToRGB24(src_i420_y_data, width,
-                        src_i420_u_data, width >> 1,
-                        src_i420_v_data, width >> 1,
-                        dst_rgb24_data, dst_rgb24_data_len,
-                        width, height);
-}
\ No newline at end of file
+void i420ToRgb24(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_rgb24_data, int32_t dst_stride_rgb24) {
+//    printf("i420ToRgb24 width=%d height=%d dst_stride_rgb24=%d", width, height, dst_stride_rgb24);
+    i420ToRgb24(makeI420Frame(src_i420_data, width, height), dst_rgb24_data, dst_stride_rgb24);
+}
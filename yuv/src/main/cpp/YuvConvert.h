@@ -1,8 +1,10 @@
 #ifndef LEOANDROIDBASEUTIL_YUVCONVERT_H
 #define LEOANDROIDBASEUTIL_YUVCONVERT_H
 
-#include <jni.h>
-#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "WorkerPool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,36 +16,191 @@ extern "C" {
 }
 #endif
 
-void android420ToI420(const uint8_t *src_android420_data, jint src_pixel_stride_uv, jint width, jint height, uint8_t *dst_i420_data, jboolean vertically_flip, jint degree);
+/**
+ * Describes a YUV 4:2:0 frame whose planes may be padded or interleaved,
+ * such as the planes of an ImageReader Image or a MediaCodec buffer.
+ *
+ * - stride_y, stride_u, stride_v: The row stride of each plane in bytes.
+ * - pixel_stride_uv: The distance in bytes between two adjacent chroma samples.
+ *   1 for planar formats (I420). 2 for semi-planar formats (NV12/NV21), in this case [u] and [v]
+ *   point to the first U and V sample of the interleaved chroma plane,
+ *   so for NV12 `v == u + 1` and for NV21 `u == v + 1`.
+ * - width, height: The frame size in pixels.
+ */
+typedef struct YuvFrame {
+    uint8_t *y;
+    uint8_t *u;
+    uint8_t *v;
+    int32_t stride_y;
+    int32_t stride_u;
+    int32_t stride_v;
+    int32_t pixel_stride_uv;
+    int32_t width;
+    int32_t height;
+} YuvFrame;
+
+/** Describe a tightly packed I420 buffer. */
+YuvFrame makeI420Frame(const uint8_t *i420_data, int32_t width, int32_t height);
+
+/** Describe a tightly packed NV12 buffer. */
+YuvFrame makeNv12Frame(const uint8_t *nv12_data, int32_t width, int32_t height);
+
+/** Describe a tightly packed NV21 buffer. */
+YuvFrame makeNv21Frame(const uint8_t *nv21_data, int32_t width, int32_t height);
+
+/**
+ * Describe the [width]x[height] region at ([left], [top]) of [frame] without copying any data.
+ * Both [left] and [top] must be even numbers.
+ */
+YuvFrame cropYuvFrame(const YuvFrame &frame, int32_t left, int32_t top, int32_t width, int32_t height);
+
+// --------------------
+// Frame descriptor API.
+//
+// The source geometry is always taken from [src].
+// The destination frame must be large enough to hold the result.
+// Unless stated otherwise the I420 routines require a planar source (pixel_stride_uv == 1).
+//
+// The routines taking [workers] split the frame into horizontal bands and run them on the pool.
+// Pass nullptr to run on the calling thread.
+// --------------------
+
+/** Convert any YUV 4:2:0 layout (I420, NV12, NV21 with arbitrary strides) into I420. */
+void android420ToI420(const YuvFrame &src, const YuvFrame &dst, bool vertically_flip, int32_t degree, WorkerPool *workers = nullptr);
+
+void mirrorI420(const YuvFrame &src, const YuvFrame &dst);
+
+void flipVerticallyI420(const YuvFrame &src, const YuvFrame &dst);
+
+void rotateI420(const YuvFrame &src, const YuvFrame &dst, int32_t degree, WorkerPool *workers = nullptr);
+
+/**
+ * Scale [src] to the size of [dst].
+ *
+ * With [workers], band boundaries are placed where source and destination rows line up exactly,
+ * so the result is the same as the single threaded call.
+ * This is only possible when the source height times 65536 is a multiple of the destination height,
+ * e.g. 2160 -> 1080 or 1080 -> 720, and never for a filtered vertical upscale.
+ * Other sizes always run on the calling thread.
+ */
+void scaleI420(const YuvFrame &src, const YuvFrame &dst, int32_t mode, WorkerPool *workers = nullptr);
+
+/** Crop the region of [dst] size at ([left], [top]). [src] may be any YUV 4:2:0 layout. */
+void cropI420(const YuvFrame &src, const YuvFrame &dst, int32_t left, int32_t top);
+
+void i420ToNv21(const YuvFrame &src, const YuvFrame &dst);
+
+void i420ToNv12(const YuvFrame &src, const YuvFrame &dst);
+
+void nv21ToI420(const YuvFrame &src, const YuvFrame &dst);
+
+void nv12ToI420(const YuvFrame &src, const YuvFrame &dst, int32_t degree);
+
+void mirrorNV12(const YuvFrame &src, const YuvFrame &dst);
+
+/** Scale [src] to the size of [dst]. */
+void scaleNV12(const YuvFrame &src, const YuvFrame &dst, int32_t mode);
+
+void nv21ToNV12(const YuvFrame &src, const YuvFrame &dst);
+
+void i420ToRgb24(const YuvFrame &src, uint8_t *dst_rgb24_data, int32_t dst_stride_rgb24);
+
+// --------------------
+// Fused pipeline.
+// --------------------
+
+/**
+ * The chain of operations executed by [YuvPipeline], applied in this order:
+ * crop -> rotate -> mirror -> scale -> convert to the destination format.
+ *
+ * - crop_left, crop_top, crop_width, crop_height: The crop rectangle in the source frame.
+ *   crop_left and crop_top must be even numbers. If crop_width or crop_height is 0,
+ *   the crop rectangle extends to the right or bottom edge of the source frame.
+ * - degree: 0, 90, 180 or 270 degrees clockwise.
+ * - mirror: Mirror horizontally after rotating.
+ * - filter_mode: The libyuv::FilterMode used when the destination size differs from the rotated crop size.
+ */
+typedef struct YuvPipelineConfig {
+    int32_t crop_left;
+    int32_t crop_top;
+    int32_t crop_width;
+    int32_t crop_height;
+    int32_t degree;
+    bool mirror;
+    int32_t filter_mode;
+} YuvPipelineConfig;
+
+/**
+ * Executes a [YuvPipelineConfig] from any YUV 4:2:0 source into an I420, NV12 or NV21 destination
+ * with as few full frame passes as possible.
+ *
+ * - Cropping is a pointer offset and costs no pass.
+ * - Mirroring is folded into the rotation together with a vertical flip, which libyuv does for free.
+ * - Format conversion and rotation share one pass.
+ * - When shrinking a planar source, the frame is scaled before it is rotated.
+ * - A semi-planar destination gets its Y plane written directly, only the chroma planes are interleaved at last.
+ *
+ * At most one intermediate buffer is used. It is owned by the pipeline and reused across calls,
+ * so the steady state performs no allocation. A pipeline must not be used by multiple threads at the same time.
+ */
+class YuvPipeline {
+public:
+    YuvPipeline() = default;
+
+    ~YuvPipeline();
+
+    YuvPipeline(const YuvPipeline &) = delete;
+
+    YuvPipeline &operator=(const YuvPipeline &) = delete;
+
+    /**
+     * The destination size is taken from [dst] and the destination format is implied by its layout.
+     *
+     * @return false if the crop rectangle is invalid.
+     */
+    bool process(const YuvFrame &src, const YuvPipelineConfig &config, const YuvFrame &dst, WorkerPool *workers = nullptr);
+
+private:
+    uint8_t *acquireScratch(size_t size);
+
+    uint8_t *scratch_ = nullptr;
+    size_t scratch_size_ = 0;
+};
+
+// --------------------
+// Tightly packed buffer API.
+// --------------------
+
+void android420ToI420(const uint8_t *src_android420_data, int32_t src_pixel_stride_uv, int32_t width, int32_t height, uint8_t *dst_i420_data, bool vertically_flip, int32_t degree, WorkerPool *workers = nullptr);
 
-void convertToI420(const uint8_t *src_yuv_data, jint src_length, jint format, jint width, jint height, uint8_t *dst_i420_data, jboolean vertically_flip, jint degree);
+void convertToI420(const uint8_t *src_yuv_data, int32_t src_length, int32_t format, int32_t width, int32_t height, uint8_t *dst_i420_data, bool vertically_flip, int32_t degree, WorkerPool *workers = nullptr);
 
-void mirrorI420(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_i420_data);
+void mirrorI420(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_i420_data);
 
-void flipVerticallyI420(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_i420_data);
+void flipVerticallyI420(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_i420_data);
 
-void rotateI420(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_i420_data, jint degree);
+void rotateI420(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_i420_data, int32_t degree, WorkerPool *workers = nullptr);
 
-void scaleI420(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_i420_data, jint dst_width, jint dst_height, jint mode);
+void scaleI420(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_i420_data, int32_t dst_width, int32_t dst_height, int32_t mode, WorkerPool *workers = nullptr);
 
-void cropI420(const uint8_t *src_i420_data, jint src_length, jint width, jint height, uint8_t *dst_i420_data, jint dst_width, jint dst_height, jint left, jint top);
+void cropI420(const uint8_t *src_i420_data, int32_t src_length, int32_t width, int32_t height, uint8_t *dst_i420_data, int32_t dst_width, int32_t dst_height, int32_t left, int32_t top);
 
-void i420ToNv21(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_nv21_data);
+void i420ToNv21(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_nv21_data);
 
-void i420ToNv12(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_nv12_data);
+void i420ToNv12(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_nv12_data);
 
-void nv21ToI420(const uint8_t *src_nv21_data, jint width, jint height, uint8_t *dst_i420_data);
+void nv21ToI420(const uint8_t *src_nv21_data, int32_t width, int32_t height, uint8_t *dst_i420_data);
 
-void nv12ToI420(const uint8_t *src_nv12_data, jint width, jint height, uint8_t *dst_i420_data, jint degree);
+void nv12ToI420(const uint8_t *src_nv12_data, int32_t width, int32_t height, uint8_t *dst_i420_data, int32_t degree);
 
-void mirrorNV12(const uint8_t *src_nv12_data, jint width, jint height, uint8_t *dst_nv12_data);
+void mirrorNV12(const uint8_t *src_nv12_data, int32_t width, int32_t height, uint8_t *dst_nv12_data);
 
-void scaleNV12(const uint8_t *src_nv12_data, jint width, jint height, uint8_t *dst_nv12_data, jint dst_width, jint dst_height, jint mode);
+void scaleNV12(const uint8_t *src_nv12_data, int32_t width, int32_t height, uint8_t *dst_nv12_data, int32_t dst_width, int32_t dst_height, int32_t mode);
 
-void nv21ToNV12(const uint8_t *src_nv21_data, jint width, jint height, uint8_t *dst_nv12_data);
+void nv21ToNV12(const uint8_t *src_nv21_data, int32_t width, int32_t height, uint8_t *dst_nv12_data);
 
 // --------------------
 
-void i420ToRgb24(const uint8_t *src_i420_data, jint width, jint height, uint8_t *dst_rgb24_data, jint dst_rgb24_data_len);
+void i420ToRgb24(const uint8_t *src_i420_data, int32_t width, int32_t height, uint8_t *dst_rgb24_data, int32_t dst_stride_rgb24);
 
 #endif //LEOANDROIDBASEUTIL_YUVCONVERT_H
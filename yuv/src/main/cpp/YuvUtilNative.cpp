@@ -1,25 +1,180 @@
 #include <jni.h>
 #include <cstring>
 #include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include "BufferPool.h"
+#include "WorkerPool.h"
 #include "YuvConvert.h"
 
 #define YUV_PACKAGE_BASE "com/leovp/yuv/"
+#define BYTE_BUFFER "Ljava/nio/ByteBuffer;"
+
+static void throwIllegalArgumentException(JNIEnv *env, const char *msg) {
+    jclass jcls = env->FindClass("java/lang/IllegalArgumentException");
+    env->ThrowNew(jcls, msg);
+}
+
+/** Throw an OutOfMemoryError for a native buffer of [size] bytes that could not be allocated. */
+static void throwOutOfMemoryError(JNIEnv *env, size_t size) {
+    char msg[64];
+    snprintf(msg, sizeof(msg), "Failed to allocate %zu bytes.", size);
+    jclass jcls = env->FindClass("java/lang/OutOfMemoryError");
+    env->ThrowNew(jcls, msg);
+}
+
+/**
+ * Get the native address of a direct ByteBuffer.
+ *
+ * The data is always addressed from the beginning of the buffer, the buffer position is ignored.
+ * If [buffer] is not a direct buffer or its capacity is less than [min_capacity],
+ * an IllegalArgumentException will be thrown and nullptr will be returned.
+ */
+static uint8_t *getDirectBufferAddress(JNIEnv *env, jobject buffer, jlong min_capacity, const char *name) {
+    char msg[128];
+    auto *address = buffer == nullptr ? nullptr : static_cast<uint8_t *>(env->GetDirectBufferAddress(buffer));
+    if (address == nullptr) {
+        snprintf(msg, sizeof(msg), "%s must be a direct ByteBuffer.", name);
+        throwIllegalArgumentException(env, msg);
+        return nullptr;
+    }
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (capacity < min_capacity) {
+        snprintf(msg, sizeof(msg), "%s is too small. Required: %lld bytes, capacity: %lld bytes.",
+                 name, (long long) min_capacity, (long long) capacity);
+        throwIllegalArgumentException(env, msg);
+        return nullptr;
+    }
+    return address;
+}
+
+/**
+ * Check the size of a frame passed to a Direct function.
+ *
+ * Both [width] and [height] must be positive and the frame must fit in a jint even as RGB24,
+ * otherwise an IllegalArgumentException will be thrown and false will be returned.
+ */
+static bool checkFrameSize(JNIEnv *env, jint width, jint height, const char *name) {
+    if (width > 0 && height > 0 && (jlong) width * height * 3 <= INT32_MAX) return true;
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Invalid %s size: %dx%d.", name, width, height);
+    throwIllegalArgumentException(env, msg);
+    return false;
+}
+
+// =============================
+// Buffer pool.
+//
+// The byte array functions borrow their native src and dst buffers from the current pool.
+// A pool handle on the Kotlin side is a heap allocated std::shared_ptr<BufferPool>,
+// so a pool closed from Kotlin stays alive until the calls still using it return.
+// =============================
+
+static std::shared_ptr<BufferPool> g_default_buffer_pool = std::make_shared<BufferPool>();
+static std::shared_ptr<BufferPool> g_current_buffer_pool = g_default_buffer_pool;
+
+static std::shared_ptr<BufferPool> currentBufferPool() {
+    return std::atomic_load(&g_current_buffer_pool);
+}
+
+static BufferPool &getBufferPool(jlong handle) {
+    return **(std::shared_ptr<BufferPool> *) (uintptr_t) handle;
+}
+
+JNIEXPORT jlong CreateBufferPool(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jclass clazz, jlong max_bytes_held) {
+    return (jlong) (uintptr_t) new std::shared_ptr<BufferPool>(std::make_shared<BufferPool>((size_t) max_bytes_held));
+}
+
+JNIEXPORT jlong GetDefaultBufferPool(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jclass clazz) {
+    return (jlong) (uintptr_t) new std::shared_ptr<BufferPool>(g_default_buffer_pool);
+}
+
+JNIEXPORT void ReleaseBufferPool(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jclass clazz, jlong handle) {
+    delete (std::shared_ptr<BufferPool> *) (uintptr_t) handle;
+}
+
+JNIEXPORT void SetCurrentBufferPool(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jclass clazz, jlong handle) {
+    std::atomic_store(&g_current_buffer_pool, *(std::shared_ptr<BufferPool> *) (uintptr_t) handle);
+}
+
+/**
+ * @return [hits, misses, bytesHeld, bytesInUse, maxBytesHeld]
+ */
+JNIEXPORT jlongArray GetBufferPoolStats(JNIEnv *env, __attribute__((unused)) jclass clazz, jlong handle) {
+    BufferPool &pool = getBufferPool(handle);
+    BufferPoolStats stats = pool.stats();
+    jlong values[] = {(jlong) stats.hits, (jlong) stats.misses, (jlong) stats.bytes_held, (jlong) stats.bytes_in_use,
+                      (jlong) pool.maxBytesHeld()};
+    jsize len = sizeof(values) / sizeof(values[0]);
+    jlongArray array = env->NewLongArray(len);
+    env->SetLongArrayRegion(array, 0, len, values);
+    return array;
+}
+
+JNIEXPORT void SetBufferPoolMaxBytesHeld(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jclass clazz, jlong handle, jlong max_bytes_held) {
+    getBufferPool(handle).setMaxBytesHeld((size_t) max_bytes_held);
+}
+
+JNIEXPORT void TrimBufferPool(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jclass clazz, jlong handle) {
+    getBufferPool(handle).trim();
+}
+
+// =============================
+// Worker pool.
+//
+// scaleI420, rotateI420, convertToI420, android420ToI420 and YuvPipeline split the frames into bands
+// and run them on the current worker pool. Without a pool they run on the calling thread.
+// =============================
+
+static std::shared_ptr<WorkerPool> g_worker_pool;
+
+static std::shared_ptr<WorkerPool> currentWorkerPool() {
+    return std::atomic_load(&g_worker_pool);
+}
+
+/**
+ * @param thread_count The number of threads used by each call, including the calling thread.
+ *                     0 or 1 disables the worker pool.
+ */
+JNIEXPORT void SetThreadCount(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jobject thiz, jint thread_count) {
+    std::shared_ptr<WorkerPool> pool;
+    if (thread_count > 1) pool = std::make_shared<WorkerPool>(thread_count);
+    // The previous pool is destroyed when the last call using it returns.
+    std::atomic_store(&g_worker_pool, pool);
+}
+
+JNIEXPORT jint GetThreadCount(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jobject thiz) {
+    std::shared_ptr<WorkerPool> pool = currentWorkerPool();
+    return pool == nullptr ? 1 : pool->threadCount();
+}
+
+// =============================
 
 JNIEXPORT jbyteArray Android420_To_I420(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                         jbyteArray src_android420, jint src_pixel_stride_uv, jint width, jint height, jboolean vertically_flip, jint degree) {
     int src_android420_len = env->GetArrayLength(src_android420);
-    auto *src_android420_data = new uint8_t[src_android420_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_android420_data_buffer(*pool, src_android420_len);
+    auto *src_android420_data = src_android420_data_buffer.data();
+    if (src_android420_data == nullptr) {
+        throwOutOfMemoryError(env, src_android420_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(src_android420, 0, src_android420_len, reinterpret_cast<jbyte *>(src_android420_data));
 
     int dst_i420_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_i420_data = new uint8_t[dst_i420_len];
+    PooledBuffer dst_i420_data_buffer(*pool, dst_i420_len);
+    auto *dst_i420_data = dst_i420_data_buffer.data();
+    if (dst_i420_data == nullptr) {
+        throwOutOfMemoryError(env, dst_i420_len);
+        return nullptr;
+    }
 
-    android420ToI420(src_android420_data, src_pixel_stride_uv, width, height, dst_i420_data, vertically_flip, degree);
-    delete[] src_android420_data;
+    std::shared_ptr<WorkerPool> workers = currentWorkerPool();
+    android420ToI420(src_android420_data, src_pixel_stride_uv, width, height, dst_i420_data, vertically_flip, degree, workers.get());
 
     jbyteArray dst_i420_array = env->NewByteArray(dst_i420_len);
     env->SetByteArrayRegion(dst_i420_array, 0, dst_i420_len, reinterpret_cast<const jbyte *>(dst_i420_data));
-    delete[]  dst_i420_data;
     return dst_i420_array;
 }
 
@@ -41,54 +196,82 @@ JNIEXPORT jbyteArray Android420_To_I420(JNIEnv *env, __attribute__((unused)) job
 JNIEXPORT jbyteArray Convert_To_I420(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                      jbyteArray yuvSrc, jint format, jint width, jint height, jboolean vertically_flip, jint degree) {
     int src_yuv_len = env->GetArrayLength(yuvSrc);
-    auto *src_i420_data = new uint8_t[src_yuv_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_i420_data_buffer(*pool, src_yuv_len);
+    auto *src_i420_data = src_i420_data_buffer.data();
+    if (src_i420_data == nullptr) {
+        throwOutOfMemoryError(env, src_yuv_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(yuvSrc, 0, src_yuv_len, reinterpret_cast<jbyte *>(src_i420_data));
 
     int dst_i420_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_i420_data = new uint8_t[dst_i420_len];
+    PooledBuffer dst_i420_data_buffer(*pool, dst_i420_len);
+    auto *dst_i420_data = dst_i420_data_buffer.data();
+    if (dst_i420_data == nullptr) {
+        throwOutOfMemoryError(env, dst_i420_len);
+        return nullptr;
+    }
 
-    convertToI420(src_i420_data, src_yuv_len, format, width, height, dst_i420_data, vertically_flip, degree);
-    delete[] src_i420_data;
+    std::shared_ptr<WorkerPool> workers = currentWorkerPool();
+    convertToI420(src_i420_data, src_yuv_len, format, width, height, dst_i420_data, vertically_flip, degree, workers.get());
 
     jbyteArray dst_i420_array = env->NewByteArray(dst_i420_len);
     env->SetByteArrayRegion(dst_i420_array, 0, dst_i420_len, reinterpret_cast<const jbyte *>(dst_i420_data));
-    delete[]  dst_i420_data;
     return dst_i420_array;
 }
 
 JNIEXPORT jbyteArray MirrorI420(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                 jbyteArray i420Src, jint width, jint height) {
     int src_i420_len = env->GetArrayLength(i420Src);
-    auto *src_i420_data = new uint8_t[src_i420_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_i420_data_buffer(*pool, src_i420_len);
+    auto *src_i420_data = src_i420_data_buffer.data();
+    if (src_i420_data == nullptr) {
+        throwOutOfMemoryError(env, src_i420_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(i420Src, 0, src_i420_len, reinterpret_cast<jbyte *>(src_i420_data));
 
     int dst_i420_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_i420_data = new uint8_t[dst_i420_len];
+    PooledBuffer dst_i420_data_buffer(*pool, dst_i420_len);
+    auto *dst_i420_data = dst_i420_data_buffer.data();
+    if (dst_i420_data == nullptr) {
+        throwOutOfMemoryError(env, dst_i420_len);
+        return nullptr;
+    }
 
     mirrorI420(src_i420_data, width, height, dst_i420_data);
-    delete[] src_i420_data;
 
     jbyteArray mirror_i420_array = env->NewByteArray(dst_i420_len);
     env->SetByteArrayRegion(mirror_i420_array, 0, dst_i420_len, reinterpret_cast<const jbyte *>(dst_i420_data));
-    delete[]  dst_i420_data;
     return mirror_i420_array;
 }
 
 JNIEXPORT jbyteArray FlipVerticallyI420(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                         jbyteArray i420Src, jint width, jint height) {
     int src_i420_len = env->GetArrayLength(i420Src);
-    auto *src_i420_data = new uint8_t[src_i420_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_i420_data_buffer(*pool, src_i420_len);
+    auto *src_i420_data = src_i420_data_buffer.data();
+    if (src_i420_data == nullptr) {
+        throwOutOfMemoryError(env, src_i420_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(i420Src, 0, src_i420_len, reinterpret_cast<jbyte *>(src_i420_data));
 
     int dst_i420_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_i420_data = new uint8_t[dst_i420_len];
+    PooledBuffer dst_i420_data_buffer(*pool, dst_i420_len);
+    auto *dst_i420_data = dst_i420_data_buffer.data();
+    if (dst_i420_data == nullptr) {
+        throwOutOfMemoryError(env, dst_i420_len);
+        return nullptr;
+    }
 
     flipVerticallyI420(src_i420_data, width, height, dst_i420_data);
-    delete[] src_i420_data;
 
     jbyteArray vertically_flip_i420_array = env->NewByteArray(dst_i420_len);
     env->SetByteArrayRegion(vertically_flip_i420_array, 0, dst_i420_len, reinterpret_cast<const jbyte *>(dst_i420_data));
-    delete[]  dst_i420_data;
     return vertically_flip_i420_array;
 }
 
@@ -101,18 +284,28 @@ JNIEXPORT jbyteArray FlipVerticallyI420(JNIEnv *env, __attribute__((unused)) job
 JNIEXPORT jbyteArray RotateI420(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                 jbyteArray i420Src, jint width, jint height, jint degree) {
     int src_i420_len = env->GetArrayLength(i420Src);
-    auto *src_i420_data = new uint8_t[src_i420_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_i420_data_buffer(*pool, src_i420_len);
+    auto *src_i420_data = src_i420_data_buffer.data();
+    if (src_i420_data == nullptr) {
+        throwOutOfMemoryError(env, src_i420_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(i420Src, 0, src_i420_len, reinterpret_cast<jbyte *>(src_i420_data));
 
     int dst_i420_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_i420_data = new uint8_t[dst_i420_len];
+    PooledBuffer dst_i420_data_buffer(*pool, dst_i420_len);
+    auto *dst_i420_data = dst_i420_data_buffer.data();
+    if (dst_i420_data == nullptr) {
+        throwOutOfMemoryError(env, dst_i420_len);
+        return nullptr;
+    }
 
-    rotateI420(src_i420_data, width, height, dst_i420_data, degree);
-    delete[] src_i420_data;
+    std::shared_ptr<WorkerPool> workers = currentWorkerPool();
+    rotateI420(src_i420_data, width, height, dst_i420_data, degree, workers.get());
 
     jbyteArray rotate_i420_array = env->NewByteArray(dst_i420_len);
     env->SetByteArrayRegion(rotate_i420_array, 0, dst_i420_len, reinterpret_cast<const jbyte *>(dst_i420_data));
-    delete[]  dst_i420_data;
     return rotate_i420_array;
 }
 
@@ -127,18 +320,28 @@ JNIEXPORT jbyteArray ScaleI420(JNIEnv *env, __attribute__((unused)) jobject thiz
                                jbyteArray i420Src, jint width, jint height,
                                jint dst_width, jint dst_height, jint mode) {
     int src_i420_len = env->GetArrayLength(i420Src);
-    auto *src_i420_data = new uint8_t[src_i420_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_i420_data_buffer(*pool, src_i420_len);
+    auto *src_i420_data = src_i420_data_buffer.data();
+    if (src_i420_data == nullptr) {
+        throwOutOfMemoryError(env, src_i420_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(i420Src, 0, src_i420_len, reinterpret_cast<jbyte *>(src_i420_data));
 
     int dst_i420_len = (int) sizeof(uint8_t) * dst_width * dst_height * 3 / 2;
-    auto *dst_i420_data = new uint8_t[dst_i420_len];
+    PooledBuffer dst_i420_data_buffer(*pool, dst_i420_len);
+    auto *dst_i420_data = dst_i420_data_buffer.data();
+    if (dst_i420_data == nullptr) {
+        throwOutOfMemoryError(env, dst_i420_len);
+        return nullptr;
+    }
 
-    scaleI420(src_i420_data, width, height, dst_i420_data, dst_width, dst_height, mode);
-    delete[] src_i420_data;
+    std::shared_ptr<WorkerPool> workers = currentWorkerPool();
+    scaleI420(src_i420_data, width, height, dst_i420_data, dst_width, dst_height, mode, workers.get());
 
     jbyteArray scale_i420_array = env->NewByteArray(dst_i420_len);
     env->SetByteArrayRegion(scale_i420_array, 0, dst_i420_len, reinterpret_cast<const jbyte *>(dst_i420_data));
-    delete[] dst_i420_data;
     return scale_i420_array;
 }
 
@@ -153,108 +356,162 @@ JNIEXPORT jbyteArray CropI420(JNIEnv *env, __attribute__((unused)) jobject thiz,
     }
 
     int src_i420_len = env->GetArrayLength(i420Src);
-    auto *src_i420_data = new uint8_t[src_i420_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_i420_data_buffer(*pool, src_i420_len);
+    auto *src_i420_data = src_i420_data_buffer.data();
+    if (src_i420_data == nullptr) {
+        throwOutOfMemoryError(env, src_i420_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(i420Src, 0, src_i420_len, reinterpret_cast<jbyte *>(src_i420_data));
 
     int dst_i420_len = (int) sizeof(uint8_t) * dst_width * dst_height * 3 / 2;
-    auto *dst_i420_data = new uint8_t[dst_i420_len];
+    PooledBuffer dst_i420_data_buffer(*pool, dst_i420_len);
+    auto *dst_i420_data = dst_i420_data_buffer.data();
+    if (dst_i420_data == nullptr) {
+        throwOutOfMemoryError(env, dst_i420_len);
+        return nullptr;
+    }
 
     cropI420(src_i420_data, src_i420_len, width, height, dst_i420_data, dst_width, dst_height, left, top);
-    delete[] src_i420_data;
 
     jbyteArray crop_i420_array = env->NewByteArray(dst_i420_len);
     env->SetByteArrayRegion(crop_i420_array, 0, dst_i420_len, reinterpret_cast<const jbyte *>(dst_i420_data));
-    delete[]  dst_i420_data;
     return crop_i420_array;
 }
 
 JNIEXPORT jbyteArray I420ToNV21(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                 jbyteArray i420Src, jint width, jint height) {
     int src_i420_len = env->GetArrayLength(i420Src);
-    auto *src_i420_data = new uint8_t[src_i420_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_i420_data_buffer(*pool, src_i420_len);
+    auto *src_i420_data = src_i420_data_buffer.data();
+    if (src_i420_data == nullptr) {
+        throwOutOfMemoryError(env, src_i420_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(i420Src, 0, src_i420_len, reinterpret_cast<jbyte *>(src_i420_data));
 
     int dst_nv21_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_nv21_data = new uint8_t[dst_nv21_len];
+    PooledBuffer dst_nv21_data_buffer(*pool, dst_nv21_len);
+    auto *dst_nv21_data = dst_nv21_data_buffer.data();
+    if (dst_nv21_data == nullptr) {
+        throwOutOfMemoryError(env, dst_nv21_len);
+        return nullptr;
+    }
 
     i420ToNv21(src_i420_data, width, height, dst_nv21_data);
-    delete[] src_i420_data;
 
     jbyteArray nv21_array = env->NewByteArray(dst_nv21_len);
     env->SetByteArrayRegion(nv21_array, 0, dst_nv21_len, reinterpret_cast<const jbyte *>(dst_nv21_data));
-    delete[]  dst_nv21_data;
     return nv21_array;
 }
 
 JNIEXPORT jbyteArray I420ToNV12(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                 jbyteArray i420Src, jint width, jint height) {
     int src_i420_len = env->GetArrayLength(i420Src);
-    auto *src_i420_data = new uint8_t[src_i420_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_i420_data_buffer(*pool, src_i420_len);
+    auto *src_i420_data = src_i420_data_buffer.data();
+    if (src_i420_data == nullptr) {
+        throwOutOfMemoryError(env, src_i420_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(i420Src, 0, src_i420_len, reinterpret_cast<jbyte *>(src_i420_data));
 
     int dst_nv12_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_nv12_data = new uint8_t[dst_nv12_len];
+    PooledBuffer dst_nv12_data_buffer(*pool, dst_nv12_len);
+    auto *dst_nv12_data = dst_nv12_data_buffer.data();
+    if (dst_nv12_data == nullptr) {
+        throwOutOfMemoryError(env, dst_nv12_len);
+        return nullptr;
+    }
 
     i420ToNv12(src_i420_data, width, height, dst_nv12_data);
-    delete[] src_i420_data;
 
     jbyteArray nv12_array = env->NewByteArray(dst_nv12_len);
     env->SetByteArrayRegion(nv12_array, 0, dst_nv12_len, reinterpret_cast<const jbyte *>(dst_nv12_data));
-    delete[]  dst_nv12_data;
     return nv12_array;
 }
 
 JNIEXPORT jbyteArray NV21ToI420(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                 jbyteArray nv21Src, jint width, jint height) {
     int src_nv21_len = env->GetArrayLength(nv21Src);
-    auto *src_nv21_data = new uint8_t[src_nv21_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_nv21_data_buffer(*pool, src_nv21_len);
+    auto *src_nv21_data = src_nv21_data_buffer.data();
+    if (src_nv21_data == nullptr) {
+        throwOutOfMemoryError(env, src_nv21_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(nv21Src, 0, src_nv21_len, reinterpret_cast<jbyte *>(src_nv21_data));
 
     int dst_i420_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_i420_data = new uint8_t[dst_i420_len];
+    PooledBuffer dst_i420_data_buffer(*pool, dst_i420_len);
+    auto *dst_i420_data = dst_i420_data_buffer.data();
+    if (dst_i420_data == nullptr) {
+        throwOutOfMemoryError(env, dst_i420_len);
+        return nullptr;
+    }
 
     nv21ToI420(src_nv21_data, width, height, dst_i420_data);
-    delete[] src_nv21_data;
 
     jbyteArray i420_array = env->NewByteArray(dst_i420_len);
     env->SetByteArrayRegion(i420_array, 0, dst_i420_len, reinterpret_cast<const jbyte *>(dst_i420_data));
-    delete[]  dst_i420_data;
     return i420_array;
 }
 
 JNIEXPORT jbyteArray NV12ToI420(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                 jbyteArray nv12Src, jint width, jint height, jint degree) {
     int src_nv12_len = env->GetArrayLength(nv12Src);
-    auto *src_nv12_data = new uint8_t[src_nv12_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_nv12_data_buffer(*pool, src_nv12_len);
+    auto *src_nv12_data = src_nv12_data_buffer.data();
+    if (src_nv12_data == nullptr) {
+        throwOutOfMemoryError(env, src_nv12_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(nv12Src, 0, src_nv12_len, reinterpret_cast<jbyte *>(src_nv12_data));
 
     int dst_i420_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_i420_data = new uint8_t[dst_i420_len];
+    PooledBuffer dst_i420_data_buffer(*pool, dst_i420_len);
+    auto *dst_i420_data = dst_i420_data_buffer.data();
+    if (dst_i420_data == nullptr) {
+        throwOutOfMemoryError(env, dst_i420_len);
+        return nullptr;
+    }
 
     nv12ToI420(src_nv12_data, width, height, dst_i420_data, degree);
-    delete[] src_nv12_data;
 
     jbyteArray i420_array = env->NewByteArray(dst_i420_len);
     env->SetByteArrayRegion(i420_array, 0, dst_i420_len, reinterpret_cast<const jbyte *>(dst_i420_data));
-    delete[]  dst_i420_data;
     return i420_array;
 }
 
 JNIEXPORT jbyteArray MirrorNV12(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                 jbyteArray nv12Src, jint width, jint height) {
     int src_nv12_len = env->GetArrayLength(nv12Src);
-    auto *src_nv12_data = new uint8_t[src_nv12_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_nv12_data_buffer(*pool, src_nv12_len);
+    auto *src_nv12_data = src_nv12_data_buffer.data();
+    if (src_nv12_data == nullptr) {
+        throwOutOfMemoryError(env, src_nv12_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(nv12Src, 0, src_nv12_len, reinterpret_cast<jbyte *>(src_nv12_data));
 
     int dst_nv12_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_nv12_data = new uint8_t[dst_nv12_len];
+    PooledBuffer dst_nv12_data_buffer(*pool, dst_nv12_len);
+    auto *dst_nv12_data = dst_nv12_data_buffer.data();
+    if (dst_nv12_data == nullptr) {
+        throwOutOfMemoryError(env, dst_nv12_len);
+        return nullptr;
+    }
 
     mirrorNV12(src_nv12_data, width, height, dst_nv12_data);
-    delete[] src_nv12_data;
 
     jbyteArray mirror_nv12_array = env->NewByteArray(dst_nv12_len);
     env->SetByteArrayRegion(mirror_nv12_array, 0, dst_nv12_len, reinterpret_cast<const jbyte *>(dst_nv12_data));
-    delete[] dst_nv12_data;
     return mirror_nv12_array;
 }
 
@@ -274,36 +531,54 @@ JNIEXPORT jbyteArray ScaleNV12(JNIEnv *env, __attribute__((unused)) jobject thiz
     }
 
     int src_nv12_len = env->GetArrayLength(nv12Src);
-    auto *src_nv12_data = new uint8_t[src_nv12_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_nv12_data_buffer(*pool, src_nv12_len);
+    auto *src_nv12_data = src_nv12_data_buffer.data();
+    if (src_nv12_data == nullptr) {
+        throwOutOfMemoryError(env, src_nv12_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(nv12Src, 0, src_nv12_len, reinterpret_cast<jbyte *>(src_nv12_data));
 
     int dst_nv12_len = (int) sizeof(uint8_t) * dst_width * dst_height * 3 / 2;
-    auto *dst_nv12_data = new uint8_t[dst_nv12_len];
+    PooledBuffer dst_nv12_data_buffer(*pool, dst_nv12_len);
+    auto *dst_nv12_data = dst_nv12_data_buffer.data();
+    if (dst_nv12_data == nullptr) {
+        throwOutOfMemoryError(env, dst_nv12_len);
+        return nullptr;
+    }
 
     scaleNV12(src_nv12_data, width, height, dst_nv12_data, dst_width, dst_height, mode);
-    delete[] src_nv12_data;
 
     jbyteArray scale_nv12_array = env->NewByteArray(dst_nv12_len);
     env->SetByteArrayRegion(scale_nv12_array, 0, dst_nv12_len, reinterpret_cast<const jbyte *>(dst_nv12_data));
-    delete[] dst_nv12_data;
     return scale_nv12_array;
 }
 
 JNIEXPORT jbyteArray NV21ToNV12(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                 jbyteArray nv21Src, jint width, jint height) {
     int src_nv21_len = env->GetArrayLength(nv21Src);
-    auto *src_nv21_data = new uint8_t[src_nv21_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_nv21_data_buffer(*pool, src_nv21_len);
+    auto *src_nv21_data = src_nv21_data_buffer.data();
+    if (src_nv21_data == nullptr) {
+        throwOutOfMemoryError(env, src_nv21_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(nv21Src, 0, src_nv21_len, reinterpret_cast<jbyte *>(src_nv21_data));
 
     int dst_nv12_len = (int) sizeof(uint8_t) * width * height * 3 / 2;
-    auto *dst_nv12_data = new uint8_t[dst_nv12_len];
+    PooledBuffer dst_nv12_data_buffer(*pool, dst_nv12_len);
+    auto *dst_nv12_data = dst_nv12_data_buffer.data();
+    if (dst_nv12_data == nullptr) {
+        throwOutOfMemoryError(env, dst_nv12_len);
+        return nullptr;
+    }
 
     nv21ToNV12(src_nv21_data, width, height, dst_nv12_data);
-    delete[] src_nv21_data;
 
     jbyteArray dst_nv12_array = env->NewByteArray(dst_nv12_len);
     env->SetByteArrayRegion(dst_nv12_array, 0, dst_nv12_len, reinterpret_cast<const jbyte *>(dst_nv12_data));
-    delete[]  dst_nv12_data;
     return dst_nv12_array;
 }
 
@@ -312,24 +587,487 @@ JNIEXPORT jbyteArray NV21ToNV12(JNIEnv *env, __attribute__((unused)) jobject thi
 JNIEXPORT jbyteArray I420ToRGB24(JNIEnv *env, __attribute__((unused)) jobject thiz,
                                 jbyteArray i420Src, jint width, jint height) {
     int src_i420_len = env->GetArrayLength(i420Src);
-    auto *src_i420_data = new uint8_t[src_i420_len];
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_i420_data_buffer(*pool, src_i420_len);
+    auto *src_i420_data = src_i420_data_buffer.data();
+    if (src_i420_data == nullptr) {
+        throwOutOfMemoryError(env, src_i420_len);
+        return nullptr;
+    }
     env->GetByteArrayRegion(i420Src, 0, src_i420_len, reinterpret_cast<jbyte *>(src_i420_data));
 
     int dst_rgb24_len = (int) sizeof(uint8_t) * width * height * 3;
-    auto *dst_rgb24_data = new uint8_t[dst_rgb24_len];
+    PooledBuffer dst_rgb24_data_buffer(*pool, dst_rgb24_len);
+    auto *dst_rgb24_data = dst_rgb24_data_buffer.data();
+    if (dst_rgb24_data == nullptr) {
+        throwOutOfMemoryError(env, dst_rgb24_len);
+        return nullptr;
+    }
 
-    i420ToRgb24(src_i420_data, width, height, dst_rgb24_data, dst_rgb24_len);
-    delete[] src_i420_data;
+    i420ToRgb24(src_i420_data, width, height, dst_rgb24_data, width * 3);
 
     jbyteArray dst_rgb24_array = env->NewByteArray(dst_rgb24_len);
     env->SetByteArrayRegion(dst_rgb24_array, 0, dst_rgb24_len, reinterpret_cast<const jbyte *>(dst_rgb24_data));
-    delete[]  dst_rgb24_data;
     return dst_rgb24_array;
 }
 
+// =============================
+// Direct ByteBuffer variants.
+//
+// Both source and destination must be direct ByteBuffers owned by the caller.
+// The result is written into the destination buffer in place, so no intermediate copy and
+// no allocation happen in native code. The source and destination buffers must not overlap.
+//
+// Return the number of bytes written into the destination buffer, or -1 if the arguments are invalid.
+// =============================
+
+JNIEXPORT jint Android420_To_I420_Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                         jobject src_android420, jobject dst_i420, jint src_pixel_stride_uv,
+                                         jint width, jint height, jboolean vertically_flip, jint degree) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    jlong yuv_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_android420_data = getDirectBufferAddress(env, src_android420, yuv_len, "srcBuffer");
+    if (src_android420_data == nullptr) return -1;
+    uint8_t *dst_i420_data = getDirectBufferAddress(env, dst_i420, yuv_len, "dstBuffer");
+    if (dst_i420_data == nullptr) return -1;
+
+    std::shared_ptr<WorkerPool> workers = currentWorkerPool();
+    android420ToI420(src_android420_data, src_pixel_stride_uv, width, height, dst_i420_data, vertically_flip, degree, workers.get());
+    return (jint) yuv_len;
+}
+
+/**
+ * Convert the separate Y, U and V planes of an YUV 4:2:0 image, such as the planes of `android.media.Image`,
+ * into a tightly packed I420 buffer. The planes may be padded (row stride > width) and
+ * the chroma planes may be interleaved (pixel stride 2), so no repacking is needed before calling this method.
+ */
+JNIEXPORT jint Android420_Planes_To_I420_Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                                jobject y_plane, jint y_row_stride,
+                                                jobject u_plane, jint u_row_stride,
+                                                jobject v_plane, jint v_row_stride,
+                                                jint pixel_stride_uv, jint width, jint height,
+                                                jobject dst_i420, jboolean vertically_flip, jint degree) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    // The last row of a plane may be shorter than the row stride.
+    jint chroma_width = (width + 1) >> 1;
+    jint chroma_height = (height + 1) >> 1;
+    jlong y_len = (jlong) (height - 1) * y_row_stride + width;
+    jlong u_len = (jlong) (chroma_height - 1) * u_row_stride + (chroma_width - 1) * pixel_stride_uv + 1;
+    jlong v_len = (jlong) (chroma_height - 1) * v_row_stride + (chroma_width - 1) * pixel_stride_uv + 1;
+
+    YuvFrame src{};
+    src.y = getDirectBufferAddress(env, y_plane, y_len, "yBuffer");
+    if (src.y == nullptr) return -1;
+    src.u = getDirectBufferAddress(env, u_plane, u_len, "uBuffer");
+    if (src.u == nullptr) return -1;
+    src.v = getDirectBufferAddress(env, v_plane, v_len, "vBuffer");
+    if (src.v == nullptr) return -1;
+    src.stride_y = y_row_stride;
+    src.stride_u = u_row_stride;
+    src.stride_v = v_row_stride;
+    src.pixel_stride_uv = pixel_stride_uv;
+    src.width = width;
+    src.height = height;
+
+    jlong dst_i420_len = (jlong) width * height * 3 / 2;
+    uint8_t *dst_i420_data = getDirectBufferAddress(env, dst_i420, dst_i420_len, "dstBuffer");
+    if (dst_i420_data == nullptr) return -1;
+
+    std::shared_ptr<WorkerPool> workers = currentWorkerPool();
+    if (90 == degree || 270 == degree) {
+        android420ToI420(src, makeI420Frame(dst_i420_data, height, width), vertically_flip, degree, workers.get());
+    } else {
+        android420ToI420(src, makeI420Frame(dst_i420_data, width, height), vertically_flip, degree, workers.get());
+    }
+    return (jint) dst_i420_len;
+}
+
+JNIEXPORT jint Convert_To_I420_Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                      jobject yuvSrc, jobject i420Dst, jint format, jint width, jint height,
+                                      jboolean vertically_flip, jint degree) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    // YUY2 is a packed format with 2 bytes per pixel. The others are 4:2:0 formats.
+    jlong src_yuv_len = format == 4 ? (jlong) width * height * 2 : (jlong) width * height * 3 / 2;
+    const uint8_t *src_yuv_data = getDirectBufferAddress(env, yuvSrc, src_yuv_len, "srcBuffer");
+    if (src_yuv_data == nullptr) return -1;
+    jlong dst_i420_len = (jlong) width * height * 3 / 2;
+    uint8_t *dst_i420_data = getDirectBufferAddress(env, i420Dst, dst_i420_len, "dstBuffer");
+    if (dst_i420_data == nullptr) return -1;
+
+    std::shared_ptr<WorkerPool> workers = currentWorkerPool();
+    convertToI420(src_yuv_data, src_yuv_len, format, width, height, dst_i420_data, vertically_flip, degree, workers.get());
+    return (jint) dst_i420_len;
+}
+
+JNIEXPORT jint MirrorI420Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                jobject i420Src, jobject i420Dst, jint width, jint height) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    jlong i420_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_i420_data = getDirectBufferAddress(env, i420Src, i420_len, "srcBuffer");
+    if (src_i420_data == nullptr) return -1;
+    uint8_t *dst_i420_data = getDirectBufferAddress(env, i420Dst, i420_len, "dstBuffer");
+    if (dst_i420_data == nullptr) return -1;
+
+    mirrorI420(src_i420_data, width, height, dst_i420_data);
+    return (jint) i420_len;
+}
+
+JNIEXPORT jint FlipVerticallyI420Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                        jobject i420Src, jobject i420Dst, jint width, jint height) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    jlong i420_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_i420_data = getDirectBufferAddress(env, i420Src, i420_len, "srcBuffer");
+    if (src_i420_data == nullptr) return -1;
+    uint8_t *dst_i420_data = getDirectBufferAddress(env, i420Dst, i420_len, "dstBuffer");
+    if (dst_i420_data == nullptr) return -1;
+
+    flipVerticallyI420(src_i420_data, width, height, dst_i420_data);
+    return (jint) i420_len;
+}
+
+JNIEXPORT jint RotateI420Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                jobject i420Src, jobject i420Dst, jint width, jint height, jint degree) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    jlong i420_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_i420_data = getDirectBufferAddress(env, i420Src, i420_len, "srcBuffer");
+    if (src_i420_data == nullptr) return -1;
+    uint8_t *dst_i420_data = getDirectBufferAddress(env, i420Dst, i420_len, "dstBuffer");
+    if (dst_i420_data == nullptr) return -1;
+
+    std::shared_ptr<WorkerPool> workers = currentWorkerPool();
+    rotateI420(src_i420_data, width, height, dst_i420_data, degree, workers.get());
+    return (jint) i420_len;
+}
+
+JNIEXPORT jint ScaleI420Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                               jobject i420Src, jobject i420Dst, jint width, jint height,
+                               jint dst_width, jint dst_height, jint mode) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    if (!checkFrameSize(env, dst_width, dst_height, "dst")) return -1;
+    const uint8_t *src_i420_data = getDirectBufferAddress(env, i420Src, (jlong) width * height * 3 / 2, "srcBuffer");
+    if (src_i420_data == nullptr) return -1;
+    jlong dst_i420_len = (jlong) dst_width * dst_height * 3 / 2;
+    uint8_t *dst_i420_data = getDirectBufferAddress(env, i420Dst, dst_i420_len, "dstBuffer");
+    if (dst_i420_data == nullptr) return -1;
+
+    std::shared_ptr<WorkerPool> workers = currentWorkerPool();
+    scaleI420(src_i420_data, width, height, dst_i420_data, dst_width, dst_height, mode, workers.get());
+    return (jint) dst_i420_len;
+}
+
+JNIEXPORT jint CropI420Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                              jobject i420Src, jobject i420Dst, jint width, jint height,
+                              jint dst_width, jint dst_height, jint left, jint top) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    if (!checkFrameSize(env, dst_width, dst_height, "dst")) return -1;
+    if (left < 0 || top < 0 || left > width - dst_width || top > height - dst_height) {
+        throwIllegalArgumentException(env, "The crop rectangle must be inside the source frame.");
+        return -1;
+    }
+    if (left % 2 != 0 || top % 2 != 0) {
+        throwIllegalArgumentException(env, "Both left and top must be even numbers.");
+        return -1;
+    }
+
+    jlong src_i420_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_i420_data = getDirectBufferAddress(env, i420Src, src_i420_len, "srcBuffer");
+    if (src_i420_data == nullptr) return -1;
+    jlong dst_i420_len = (jlong) dst_width * dst_height * 3 / 2;
+    uint8_t *dst_i420_data = getDirectBufferAddress(env, i420Dst, dst_i420_len, "dstBuffer");
+    if (dst_i420_data == nullptr) return -1;
+
+    cropI420(src_i420_data, src_i420_len, width, height, dst_i420_data, dst_width, dst_height, left, top);
+    return (jint) dst_i420_len;
+}
+
+JNIEXPORT jint I420ToNV21Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                jobject i420Src, jobject nv21Dst, jint width, jint height) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    jlong yuv_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_i420_data = getDirectBufferAddress(env, i420Src, yuv_len, "srcBuffer");
+    if (src_i420_data == nullptr) return -1;
+    uint8_t *dst_nv21_data = getDirectBufferAddress(env, nv21Dst, yuv_len, "dstBuffer");
+    if (dst_nv21_data == nullptr) return -1;
+
+    i420ToNv21(src_i420_data, width, height, dst_nv21_data);
+    return (jint) yuv_len;
+}
+
+JNIEXPORT jint I420ToNV12Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                jobject i420Src, jobject nv12Dst, jint width, jint height) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    jlong yuv_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_i420_data = getDirectBufferAddress(env, i420Src, yuv_len, "srcBuffer");
+    if (src_i420_data == nullptr) return -1;
+    uint8_t *dst_nv12_data = getDirectBufferAddress(env, nv12Dst, yuv_len, "dstBuffer");
+    if (dst_nv12_data == nullptr) return -1;
+
+    i420ToNv12(src_i420_data, width, height, dst_nv12_data);
+    return (jint) yuv_len;
+}
+
+JNIEXPORT jint NV21ToI420Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                jobject nv21Src, jobject i420Dst, jint width, jint height) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    jlong yuv_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_nv21_data = getDirectBufferAddress(env, nv21Src, yuv_len, "srcBuffer");
+    if (src_nv21_data == nullptr) return -1;
+    uint8_t *dst_i420_data = getDirectBufferAddress(env, i420Dst, yuv_len, "dstBuffer");
+    if (dst_i420_data == nullptr) return -1;
+
+    nv21ToI420(src_nv21_data, width, height, dst_i420_data);
+    return (jint) yuv_len;
+}
+
+JNIEXPORT jint NV12ToI420Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                jobject nv12Src, jobject i420Dst, jint width, jint height, jint degree) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    jlong yuv_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_nv12_data = getDirectBufferAddress(env, nv12Src, yuv_len, "srcBuffer");
+    if (src_nv12_data == nullptr) return -1;
+    uint8_t *dst_i420_data = getDirectBufferAddress(env, i420Dst, yuv_len, "dstBuffer");
+    if (dst_i420_data == nullptr) return -1;
+
+    nv12ToI420(src_nv12_data, width, height, dst_i420_data, degree);
+    return (jint) yuv_len;
+}
+
+JNIEXPORT jint MirrorNV12Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                jobject nv12Src, jobject nv12Dst, jint width, jint height) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    jlong yuv_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_nv12_data = getDirectBufferAddress(env, nv12Src, yuv_len, "srcBuffer");
+    if (src_nv12_data == nullptr) return -1;
+    uint8_t *dst_nv12_data = getDirectBufferAddress(env, nv12Dst, yuv_len, "dstBuffer");
+    if (dst_nv12_data == nullptr) return -1;
+
+    mirrorNV12(src_nv12_data, width, height, dst_nv12_data);
+    return (jint) yuv_len;
+}
+
+JNIEXPORT jint ScaleNV12Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                               jobject nv12Src, jobject nv12Dst, jint width, jint height,
+                               jint dst_width, jint dst_height, jint mode) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    if (!checkFrameSize(env, dst_width, dst_height, "dst")) return -1;
+    if (dst_width % 8 != 0 || dst_height % 8 != 0) {
+        throwIllegalArgumentException(env, "Both dst_width and dst_height must be multiple of 8.");
+        return -1;
+    }
+
+    const uint8_t *src_nv12_data = getDirectBufferAddress(env, nv12Src, (jlong) width * height * 3 / 2, "srcBuffer");
+    if (src_nv12_data == nullptr) return -1;
+    jlong dst_nv12_len = (jlong) dst_width * dst_height * 3 / 2;
+    uint8_t *dst_nv12_data = getDirectBufferAddress(env, nv12Dst, dst_nv12_len, "dstBuffer");
+    if (dst_nv12_data == nullptr) return -1;
+
+    scaleNV12(src_nv12_data, width, height, dst_nv12_data, dst_width, dst_height, mode);
+    return (jint) dst_nv12_len;
+}
+
+JNIEXPORT jint NV21ToNV12Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                jobject nv21Src, jobject nv12Dst, jint width, jint height) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    jlong yuv_len = (jlong) width * height * 3 / 2;
+    const uint8_t *src_nv21_data = getDirectBufferAddress(env, nv21Src, yuv_len, "srcBuffer");
+    if (src_nv21_data == nullptr) return -1;
+    uint8_t *dst_nv12_data = getDirectBufferAddress(env, nv12Dst, yuv_len, "dstBuffer");
+    if (dst_nv12_data == nullptr) return -1;
+
+    nv21ToNV12(src_nv21_data, width, height, dst_nv12_data);
+    return (jint) yuv_len;
+}
+
+JNIEXPORT jint I420ToRGB24Direct(JNIEnv *env, __attribute__((unused)) jobject thiz,
+                                 jobject i420Src, jobject rgb24Dst, jint width, jint height) {
+    if (!checkFrameSize(env, width, height, "src")) return -1;
+    const uint8_t *src_i420_data = getDirectBufferAddress(env, i420Src, (jlong) width * height * 3 / 2, "srcBuffer");
+    if (src_i420_data == nullptr) return -1;
+    jlong dst_rgb24_len = (jlong) width * height * 3;
+    uint8_t *dst_rgb24_data = getDirectBufferAddress(env, rgb24Dst, dst_rgb24_len, "dstBuffer");
+    if (dst_rgb24_data == nullptr) return -1;
+
+    i420ToRgb24(src_i420_data, width, height, dst_rgb24_data, width * 3);
+    return (jint) dst_rgb24_len;
+}
+
+// =============================
+
+// Fused pipeline.
+// =============================
+
+struct PipelineContext {
+    YuvPipeline pipeline;
+    YuvPipelineConfig config;
+};
+
+/**
+ * @param format 1: I420, 2: NV21, 3: NV12
+ */
+static YuvFrame makeYuvFrame(const uint8_t *data, jint format, jint width, jint height) {
+    switch (format) {
+        case 2:
+            return makeNv21Frame(data, width, height);
+        case 3:
+            return makeNv12Frame(data, width, height);
+        default:
+            return makeI420Frame(data, width, height);
+    }
+}
+
+/**
+ * Check the size of a frame passed to the pipeline.
+ *
+ * Besides the checks of [checkFrameSize], both [width] and [height] must be even,
+ * because the packed frames are described with chroma planes of exactly half the size.
+ */
+static bool checkPipelineFrameSize(JNIEnv *env, jint width, jint height, const char *name) {
+    if (!checkFrameSize(env, width, height, name)) return false;
+    if (width % 2 == 0 && height % 2 == 0) return true;
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Invalid %s size: %dx%d. Both width and height must be even.", name, width, height);
+    throwIllegalArgumentException(env, msg);
+    return false;
+}
+
+/**
+ * Run the pipeline of [ctx] on the current worker pool.
+ * If the crop rectangle does not fit in [src], an IllegalArgumentException will be thrown and false will be returned.
+ */
+static bool runPipeline(JNIEnv *env, PipelineContext *ctx, const YuvFrame &src, const YuvFrame &dst) {
+    std::shared_ptr<WorkerPool> workers = currentWorkerPool();
+    if (ctx->pipeline.process(src, ctx->config, dst, workers.get())) return true;
+    const YuvPipelineConfig &config = ctx->config;
+    char msg[160];
+    snprintf(msg, sizeof(msg), "Invalid crop rectangle: (%d, %d) %dx%d in a %dx%d source.",
+             config.crop_left, config.crop_top, config.crop_width, config.crop_height, src.width, src.height);
+    throwIllegalArgumentException(env, msg);
+    return false;
+}
+
+JNIEXPORT jlong CreatePipeline(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jobject thiz,
+                               jint crop_left, jint crop_top, jint crop_width, jint crop_height,
+                               jint degree, jboolean mirror, jint filter_mode) {
+    auto *ctx = new PipelineContext();
+    ctx->config.crop_left = crop_left;
+    ctx->config.crop_top = crop_top;
+    ctx->config.crop_width = crop_width;
+    ctx->config.crop_height = crop_height;
+    ctx->config.degree = degree;
+    ctx->config.mirror = mirror;
+    ctx->config.filter_mode = filter_mode;
+    return (jlong) (uintptr_t) ctx;
+}
+
+JNIEXPORT void ReleasePipeline(__attribute__((unused)) JNIEnv *env, __attribute__((unused)) jobject thiz, jlong handle) {
+    delete (PipelineContext *) (uintptr_t) handle;
+}
+
+JNIEXPORT jint ProcessPipelineDirect(JNIEnv *env, __attribute__((unused)) jobject thiz, jlong handle,
+                                     jobject src, jint src_format, jint src_width, jint src_height,
+                                     jobject dst, jint dst_format, jint dst_width, jint dst_height) {
+    auto *ctx = (PipelineContext *) (uintptr_t) handle;
+    if (!checkPipelineFrameSize(env, src_width, src_height, "src")) return -1;
+    if (!checkPipelineFrameSize(env, dst_width, dst_height, "dst")) return -1;
+    const uint8_t *src_data = getDirectBufferAddress(env, src, (jlong) src_width * src_height * 3 / 2, "srcBuffer");
+    if (src_data == nullptr) return -1;
+    jlong dst_len = (jlong) dst_width * dst_height * 3 / 2;
+    uint8_t *dst_data = getDirectBufferAddress(env, dst, dst_len, "dstBuffer");
+    if (dst_data == nullptr) return -1;
+
+    if (!runPipeline(env, ctx, makeYuvFrame(src_data, src_format, src_width, src_height),
+                     makeYuvFrame(dst_data, dst_format, dst_width, dst_height))) {
+        return -1;
+    }
+    return (jint) dst_len;
+}
+
+JNIEXPORT jint ProcessPipelinePlanesDirect(JNIEnv *env, __attribute__((unused)) jobject thiz, jlong handle,
+                                           jobject y_plane, jint y_row_stride,
+                                           jobject u_plane, jint u_row_stride,
+                                           jobject v_plane, jint v_row_stride,
+                                           jint pixel_stride_uv, jint src_width, jint src_height,
+                                           jobject dst, jint dst_format, jint dst_width, jint dst_height) {
+    auto *ctx = (PipelineContext *) (uintptr_t) handle;
+    if (!checkPipelineFrameSize(env, src_width, src_height, "src")) return -1;
+    if (!checkPipelineFrameSize(env, dst_width, dst_height, "dst")) return -1;
+    jint chroma_width = (src_width + 1) >> 1;
+    jint chroma_height = (src_height + 1) >> 1;
+    jlong y_len = (jlong) (src_height - 1) * y_row_stride + src_width;
+    jlong u_len = (jlong) (chroma_height - 1) * u_row_stride + (chroma_width - 1) * pixel_stride_uv + 1;
+    jlong v_len = (jlong) (chroma_height - 1) * v_row_stride + (chroma_width - 1) * pixel_stride_uv + 1;
+
+    YuvFrame src{};
+    src.y = getDirectBufferAddress(env, y_plane, y_len, "yBuffer");
+    if (src.y == nullptr) return -1;
+    src.u = getDirectBufferAddress(env, u_plane, u_len, "uBuffer");
+    if (src.u == nullptr) return -1;
+    src.v = getDirectBufferAddress(env, v_plane, v_len, "vBuffer");
+    if (src.v == nullptr) return -1;
+    src.stride_y = y_row_stride;
+    src.stride_u = u_row_stride;
+    src.stride_v = v_row_stride;
+    src.pixel_stride_uv = pixel_stride_uv;
+    src.width = src_width;
+    src.height = src_height;
+
+    jlong dst_len = (jlong) dst_width * dst_height * 3 / 2;
+    uint8_t *dst_data = getDirectBufferAddress(env, dst, dst_len, "dstBuffer");
+    if (dst_data == nullptr) return -1;
+
+    if (!runPipeline(env, ctx, src, makeYuvFrame(dst_data, dst_format, dst_width, dst_height))) {
+        return -1;
+    }
+    return (jint) dst_len;
+}
+
+JNIEXPORT jbyteArray ProcessPipeline(JNIEnv *env, __attribute__((unused)) jobject thiz, jlong handle,
+                                     jbyteArray src, jint src_format, jint src_width, jint src_height,
+                                     jint dst_format, jint dst_width, jint dst_height) {
+    auto *ctx = (PipelineContext *) (uintptr_t) handle;
+    if (!checkPipelineFrameSize(env, src_width, src_height, "src")) return nullptr;
+    if (!checkPipelineFrameSize(env, dst_width, dst_height, "dst")) return nullptr;
+    jint src_len = (jint) ((jlong) src_width * src_height * 3 / 2);
+    jint src_array_len = env->GetArrayLength(src);
+    if (src_array_len < src_len) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "srcYuvByteArray is too small. Required: %d bytes, length: %d bytes.",
+                 src_len, src_array_len);
+        throwIllegalArgumentException(env, msg);
+        return nullptr;
+    }
+    std::shared_ptr<BufferPool> pool = currentBufferPool();
+    PooledBuffer src_data_buffer(*pool, src_len);
+    auto *src_data = src_data_buffer.data();
+    if (src_data == nullptr) {
+        throwOutOfMemoryError(env, src_len);
+        return nullptr;
+    }
+    env->GetByteArrayRegion(src, 0, src_len, reinterpret_cast<jbyte *>(src_data));
+
+    jint dst_len = (jint) ((jlong) dst_width * dst_height * 3 / 2);
+    PooledBuffer dst_data_buffer(*pool, dst_len);
+    auto *dst_data = dst_data_buffer.data();
+    if (dst_data == nullptr) {
+        throwOutOfMemoryError(env, dst_len);
+        return nullptr;
+    }
+
+    if (!runPipeline(env, ctx, makeYuvFrame(src_data, src_format, src_width, src_height),
+                     makeYuvFrame(dst_data, dst_format, dst_width, dst_height))) {
+        return nullptr;
+    }
+
+    jbyteArray dst_array = env->NewByteArray(dst_len);
+    env->SetByteArrayRegion(dst_array, 0, dst_len, reinterpret_cast<const jbyte *>(dst_data));
+    return dst_array;
+}
+
 // =============================
 
 static JNINativeMethod methods[] = {
+        {"setThreadCount",     "(I)V",         (void *) SetThreadCount},
+        {"getThreadCount",     "()I",          (void *) GetThreadCount},
         {"android420ToI420",   "([BIIIZI)[B",  (void *) Android420_To_I420},
         {"convertToI420",      "([BIIIZI)[B",  (void *) Convert_To_I420},
         {"mirrorI420",         "([BII)[B",     (void *) MirrorI420},
@@ -345,6 +1083,43 @@ static JNINativeMethod methods[] = {
         {"scaleNv12",          "([BIIIII)[B",  (void *) ScaleNV12},
         {"nv21ToNv12",         "([BII)[B",     (void *) NV21ToNV12},
         {"i420ToRgb24",        "([BII)[B",     (void *) I420ToRGB24},
+
+        {"android420ToI420",   "(" BYTE_BUFFER BYTE_BUFFER "IIIZI)I",  (void *) Android420_To_I420_Direct},
+        {"android420ToI420",   "(" BYTE_BUFFER "I" BYTE_BUFFER "I" BYTE_BUFFER "IIII" BYTE_BUFFER "ZI)I",
+                                                               (void *) Android420_Planes_To_I420_Direct},
+        {"convertToI420",      "(" BYTE_BUFFER BYTE_BUFFER "IIIZI)I",  (void *) Convert_To_I420_Direct},
+        {"mirrorI420",         "(" BYTE_BUFFER BYTE_BUFFER "II)I",     (void *) MirrorI420Direct},
+        {"flipVerticallyI420", "(" BYTE_BUFFER BYTE_BUFFER "II)I",     (void *) FlipVerticallyI420Direct},
+        {"rotateI420",         "(" BYTE_BUFFER BYTE_BUFFER "III)I",    (void *) RotateI420Direct},
+        {"scaleI420",          "(" BYTE_BUFFER BYTE_BUFFER "IIIII)I",  (void *) ScaleI420Direct},
+        {"cropI420",           "(" BYTE_BUFFER BYTE_BUFFER "IIIIII)I", (void *) CropI420Direct},
+        {"i420ToNv21",         "(" BYTE_BUFFER BYTE_BUFFER "II)I",     (void *) I420ToNV21Direct},
+        {"i420ToNv12",         "(" BYTE_BUFFER BYTE_BUFFER "II)I",     (void *) I420ToNV12Direct},
+        {"nv21ToI420",         "(" BYTE_BUFFER BYTE_BUFFER "II)I",     (void *) NV21ToI420Direct},
+        {"nv12ToI420",         "(" BYTE_BUFFER BYTE_BUFFER "III)I",    (void *) NV12ToI420Direct},
+        {"mirrorNv12",         "(" BYTE_BUFFER BYTE_BUFFER "II)I",     (void *) MirrorNV12Direct},
+        {"scaleNv12",          "(" BYTE_BUFFER BYTE_BUFFER "IIIII)I",  (void *) ScaleNV12Direct},
+        {"nv21ToNv12",         "(" BYTE_BUFFER BYTE_BUFFER "II)I",     (void *) NV21ToNV12Direct},
+        {"i420ToRgb24",        "(" BYTE_BUFFER BYTE_BUFFER "II)I",     (void *) I420ToRGB24Direct},
+};
+
+static JNINativeMethod pipelineMethods[] = {
+        {"createPipeline",       "(IIIIIZI)J",                                            (void *) CreatePipeline},
+        {"releasePipeline",      "(J)V",                                                  (void *) ReleasePipeline},
+        {"processPipeline",      "(J" BYTE_BUFFER "III" BYTE_BUFFER "III)I",              (void *) ProcessPipelineDirect},
+        {"processPipeline",      "(J" BYTE_BUFFER "I" BYTE_BUFFER "I" BYTE_BUFFER "IIII" BYTE_BUFFER "III)I",
+                                                                                          (void *) ProcessPipelinePlanesDirect},
+        {"processPipeline",      "(J[BIIIIII)[B",                                         (void *) ProcessPipeline},
+};
+
+static JNINativeMethod bufferPoolMethods[] = {
+        {"createBufferPool",          "(J)J",  (void *) CreateBufferPool},
+        {"getDefaultBufferPool",      "()J",   (void *) GetDefaultBufferPool},
+        {"releaseBufferPool",         "(J)V",  (void *) ReleaseBufferPool},
+        {"setCurrentBufferPool",      "(J)V",  (void *) SetCurrentBufferPool},
+        {"getBufferPoolStats",        "(J)[J", (void *) GetBufferPoolStats},
+        {"setBufferPoolMaxBytesHeld", "(JJ)V", (void *) SetBufferPoolMaxBytesHeld},
+        {"trimBufferPool",            "(J)V",  (void *) TrimBufferPool},
 };
 
 JNIEXPORT jint JNI_OnLoad(JavaVM *vm, __attribute__((unused)) void *reserved) {
@@ -363,5 +1138,23 @@ JNIEXPORT jint JNI_OnLoad(JavaVM *vm, __attribute__((unused)) void *reserved) {
         return JNI_ERR;
     }
 
+    jclass pipelineClz = env->FindClass(YUV_PACKAGE_BASE"YuvPipeline");
+    if (pipelineClz == nullptr) {
+        return JNI_ERR;
+    }
+
+    if (env->RegisterNatives(pipelineClz, pipelineMethods, sizeof(pipelineMethods) / sizeof(pipelineMethods[0]))) {
+        return JNI_ERR;
+    }
+
+    jclass bufferPoolClz = env->FindClass(YUV_PACKAGE_BASE"YuvBufferPool");
+    if (bufferPoolClz == nullptr) {
+        return JNI_ERR;
+    }
+
+    if (env->RegisterNatives(bufferPoolClz, bufferPoolMethods, sizeof(bufferPoolMethods) / sizeof(bufferPoolMethods[0]))) {
+        return JNI_ERR;
+    }
+
     return JNI_VERSION_1_6;
 }
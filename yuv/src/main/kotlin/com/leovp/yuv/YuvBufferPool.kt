@@ -0,0 +1,122 @@
+package com.leovp.yuv
+
+import androidx.annotation.Keep
+import java.io.Closeable
+
+/**
+ * A thread safe pool of native buffers used by the [YuvUtil] and [YuvPipeline] functions
+ * which take and return byte arrays.
+ *
+ * Those functions copy the input array into a native buffer and build the result in another one.
+ * The buffers are borrowed from the [current] pool, grouped by their byte size,
+ * so repeated calls with the same resolution reuse the same aligned memory
+ * and the steady state performs no heap allocation.
+ *
+ * The native library owns a [default] pool which is current from the start.
+ * Create a separate pool to limit or observe the memory used by a specific scenario:
+ * ```kotlin
+ * val pool = YuvBufferPool.create(maxBytesHeld = 32L * 1024 * 1024)
+ * YuvBufferPool.current = pool
+ * // ...
+ * Log.d(TAG, "${pool.stats()}")
+ * YuvBufferPool.current = YuvBufferPool.default
+ * pool.close()
+ * ```
+ *
+ * Closing a pool which is still current or still in use by a running call is safe,
+ * its memory is released when the last user returns.
+ */
+@Keep
+class YuvBufferPool private constructor(handle: Long) : Closeable {
+    companion object {
+        const val DEFAULT_MAX_BYTES_HELD = 64L * 1024 * 1024
+
+        init {
+            System.loadLibrary("leo-yuv")
+        }
+
+        /** The pool owned by the native library. Closing it has no effect. */
+        val default: YuvBufferPool = YuvBufferPool(getDefaultBufferPool())
+
+        /** The pool used by the byte array functions. */
+        @Volatile
+        var current: YuvBufferPool = default
+            set(value) {
+                setCurrentBufferPool(value.requireHandle())
+                field = value
+            }
+
+        /**
+         * @param maxBytesHeld Idle buffers exceeding this limit are freed instead of being kept.
+         */
+        fun create(maxBytesHeld: Long = DEFAULT_MAX_BYTES_HELD): YuvBufferPool =
+            YuvBufferPool(createBufferPool(maxBytesHeld))
+
+        @JvmStatic
+        private external fun createBufferPool(maxBytesHeld: Long): Long
+
+        @JvmStatic
+        private external fun getDefaultBufferPool(): Long
+
+        @JvmStatic
+        private external fun releaseBufferPool(handle: Long)
+
+        @JvmStatic
+        private external fun setCurrentBufferPool(handle: Long)
+
+        @JvmStatic
+        private external fun getBufferPoolStats(handle: Long): LongArray
+
+        @JvmStatic
+        private external fun setBufferPoolMaxBytesHeld(handle: Long, maxBytesHeld: Long)
+
+        @JvmStatic
+        private external fun trimBufferPool(handle: Long)
+    }
+
+    /**
+     * @param hits The number of buffers served from the pool.
+     * @param misses The number of buffers which had to be allocated.
+     * @param bytesHeld The bytes of idle buffers kept by the pool.
+     * @param bytesInUse The bytes of buffers currently borrowed.
+     * @param maxBytesHeld The limit of [bytesHeld].
+     */
+    data class Stats(
+        val hits: Long,
+        val misses: Long,
+        val bytesHeld: Long,
+        val bytesInUse: Long,
+        val maxBytesHeld: Long
+    )
+
+    private var handle: Long = handle
+
+    fun stats(): Stats {
+        val values = getBufferPoolStats(requireHandle())
+        return Stats(values[0], values[1], values[2], values[3], values[4])
+    }
+
+    /** Idle buffers exceeding this limit are freed instead of being kept. */
+    var maxBytesHeld: Long
+        get() = stats().maxBytesHeld
+        set(value) = setBufferPoolMaxBytesHeld(requireHandle(), value)
+
+    /** Free all idle buffers, e.g. when the resolution has changed or the memory is low. */
+    fun trim() = trimBufferPool(requireHandle())
+
+    override fun close() {
+        if (this === default) return
+        synchronized(this) {
+            if (handle != 0L) {
+                releaseBufferPool(handle)
+                handle = 0L
+            }
+        }
+    }
+
+    private fun requireHandle(): Long {
+        val h = handle
+        check(h != 0L) { "YuvBufferPool has been closed." }
+        return h
+    }
+}
@@ -0,0 +1,241 @@
+package com.leovp.yuv
+
+import android.graphics.ImageFormat
+import android.media.Image
+import androidx.annotation.Keep
+import java.io.Closeable
+import java.nio.ByteBuffer
+
+/**
+ * Executes a chain of operations on a YUV 4:2:0 frame in as few passes as possible:
+ * ```
+ * crop -> rotate -> mirror -> scale -> convert to [Config.dstFormat]
+ * ```
+ *
+ * Compared with calling [YuvUtil.convertToI420], [YuvUtil.cropI420], [YuvUtil.scaleI420] and
+ * [YuvUtil.i420ToNv12] one after another, the frame is copied across JNI at most once in each
+ * direction and at most one intermediate buffer is used, which is reused across calls.
+ *
+ * The source and destination widths and heights must be even numbers.
+ * If a buffer is too small or the crop rectangle is outside the source,
+ * the process methods throw an [IllegalArgumentException].
+ *
+ * A pipeline is not thread safe. Call [close] to release the native resources.
+ *
+ * Example:
+ * ```kotlin
+ * val pipeline = YuvPipeline(
+ *     YuvPipeline.Config(
+ *         srcFormat = YuvUtil.NV21, srcWidth = 1920, srcHeight = 1080,
+ *         cropLeft = 240, cropWidth = 1440, cropHeight = 1080,
+ *         degree = YuvUtil.ROTATE_90,
+ *         dstWidth = 720, dstHeight = 960, filterMode = YuvUtil.SCALE_FILTER_BOX,
+ *         dstFormat = YuvUtil.NV12
+ *     )
+ * )
+ * val dst = ByteBuffer.allocateDirect(pipeline.dstSize)
+ * pipeline.process(srcBuffer, dst)
+ * ```
+ */
+@Keep
+class YuvPipeline(val config: Config) : Closeable {
+    companion object {
+        init {
+            System.loadLibrary("leo-yuv")
+        }
+    }
+
+    /**
+     * @param srcFormat The source format. [YuvUtil.I420], [YuvUtil.NV21] or [YuvUtil.NV12].
+     * It is ignored when processing [Image] planes.
+     * @param cropLeft Must be an even number.
+     * @param cropTop Must be an even number.
+     * @param cropWidth 0 means from [cropLeft] to the right edge of the source.
+     * @param cropHeight 0 means from [cropTop] to the bottom edge of the source.
+     * @param degree The clockwise rotation. [YuvUtil.ROTATE_0], [YuvUtil.ROTATE_90],
+     * [YuvUtil.ROTATE_180] or [YuvUtil.ROTATE_270].
+     * @param mirror Mirror horizontally after rotating.
+     * @param dstWidth 0 means the width of the rotated crop rectangle.
+     * @param dstHeight 0 means the height of the rotated crop rectangle.
+     * @param filterMode Used when the destination size differs from the rotated crop rectangle.
+     * @param dstFormat The destination format. [YuvUtil.I420], [YuvUtil.NV21] or [YuvUtil.NV12].
+     */
+    data class Config(
+        val srcFormat: Int = YuvUtil.I420,
+        val srcWidth: Int,
+        val srcHeight: Int,
+        val cropLeft: Int = 0,
+        val cropTop: Int = 0,
+        val cropWidth: Int = 0,
+        val cropHeight: Int = 0,
+        val degree: Int = YuvUtil.ROTATE_0,
+        val mirror: Boolean = false,
+        val dstWidth: Int = 0,
+        val dstHeight: Int = 0,
+        val filterMode: Int = YuvUtil.SCALE_FILTER_NONE,
+        val dstFormat: Int = YuvUtil.I420
+    )
+
+    /** The destination frame width. */
+    val dstWidth: Int
+
+    /** The destination frame height. */
+    val dstHeight: Int
+
+    /** The destination frame size in bytes. */
+    val dstSize: Int
+
+    private var handle: Long
+
+    init {
+        require(config.srcFormat in YuvUtil.I420..YuvUtil.NV12) {
+            "Unsupported source format: ${config.srcFormat}"
+        }
+        require(config.dstFormat in YuvUtil.I420..YuvUtil.NV12) {
+            "Unsupported destination format: ${config.dstFormat}"
+        }
+        require(config.srcWidth % 2 == 0 && config.srcHeight % 2 == 0) {
+            "Source width and height must be even numbers: ${config.srcWidth}x${config.srcHeight}"
+        }
+        require(config.cropLeft % 2 == 0 && config.cropTop % 2 == 0) {
+            "Crop left and top must be even numbers."
+        }
+        val cropWidth =
+            if (config.cropWidth > 0) config.cropWidth else config.srcWidth - config.cropLeft
+        val cropHeight =
+            if (config.cropHeight > 0) config.cropHeight else config.srcHeight - config.cropTop
+        val rotated = config.degree == YuvUtil.ROTATE_90 || config.degree == YuvUtil.ROTATE_270
+        dstWidth = when {
+            config.dstWidth > 0 -> config.dstWidth
+            rotated -> cropHeight
+            else -> cropWidth
+        }
+        dstHeight = when {
+            config.dstHeight > 0 -> config.dstHeight
+            rotated -> cropWidth
+            else -> cropHeight
+        }
+        require(dstWidth % 2 == 0 && dstHeight % 2 == 0) {
+            "Destination width and height must be even numbers: ${dstWidth}x$dstHeight"
+        }
+        dstSize = dstWidth * dstHeight * 3 / 2
+        handle = createPipeline(
+            config.cropLeft,
+            config.cropTop,
+            cropWidth,
+            cropHeight,
+            config.degree,
+            config.mirror,
+            config.filterMode
+        )
+    }
+
+    /**
+     * @param srcBuffer A direct buffer holding a tightly packed frame of [Config.srcFormat].
+     * @param dstBuffer A direct buffer with at least [dstSize] bytes.
+     * @return The number of bytes written into [dstBuffer], or -1 if an exception has been thrown.
+     */
+    fun process(srcBuffer: ByteBuffer, dstBuffer: ByteBuffer): Int {
+        check(handle != 0L) { "YuvPipeline has been closed." }
+        return processPipeline(
+            handle,
+            srcBuffer, config.srcFormat, config.srcWidth, config.srcHeight,
+            dstBuffer, config.dstFormat, dstWidth, dstHeight
+        )
+    }
+
+    /**
+     * Process the planes of a [ImageFormat.YUV_420_888] image without copying them into a packed
+     * buffer first.
+     *
+     * @param dstBuffer A direct buffer with at least [dstSize] bytes.
+     * @return The number of bytes written into [dstBuffer], or -1 if an exception has been thrown.
+     */
+    fun process(image: Image, dstBuffer: ByteBuffer): Int {
+        check(handle != 0L) { "YuvPipeline has been closed." }
+        require(image.format == ImageFormat.YUV_420_888) { "Only YUV_420_888 image is supported." }
+        val planes = image.planes
+        return processPipeline(
+            handle,
+            planes[0].buffer, planes[0].rowStride,
+            planes[1].buffer, planes[1].rowStride,
+            planes[2].buffer, planes[2].rowStride,
+            planes[1].pixelStride,
+            config.srcWidth, config.srcHeight,
+            dstBuffer, config.dstFormat, dstWidth, dstHeight
+        )
+    }
+
+    /**
+     * @param srcYuvByteArray A tightly packed frame of [Config.srcFormat].
+     * @return The destination frame, or null if an exception has been thrown.
+     */
+    fun process(srcYuvByteArray: ByteArray): ByteArray? {
+        check(handle != 0L) { "YuvPipeline has been closed." }
+        return processPipeline(
+            handle,
+            srcYuvByteArray, config.srcFormat, config.srcWidth, config.srcHeight,
+            config.dstFormat, dstWidth, dstHeight
+        )
+    }
+
+    override fun close() {
+        if (handle != 0L) {
+            releasePipeline(handle)
+            handle = 0L
+        }
+    }
+
+    private external fun createPipeline(
+        cropLeft: Int,
+        cropTop: Int,
+        cropWidth: Int,
+        cropHeight: Int,
+        degree: Int,
+        mirror: Boolean,
+        filterMode: Int
+    ): Long
+
+    private external fun releasePipeline(handle: Long)
+
+    private external fun processPipeline(
+        handle: Long,
+        srcBuffer: ByteBuffer,
+        srcFormat: Int,
+        srcWidth: Int,
+        srcHeight: Int,
+        dstBuffer: ByteBuffer,
+        dstFormat: Int,
+        dstWidth: Int,
+        dstHeight: Int
+    ): Int
+
+    @Suppress("LongParameterList")
+    private external fun processPipeline(
+        handle: Long,
+        yBuffer: ByteBuffer,
+        yRowStride: Int,
+        uBuffer: ByteBuffer,
+        uRowStride: Int,
+        vBuffer: ByteBuffer,
+        vRowStride: Int,
+        uvPixelStride: Int,
+        srcWidth: Int,
+        srcHeight: Int,
+        dstBuffer: ByteBuffer,
+        dstFormat: Int,
+        dstWidth: Int,
+        dstHeight: Int
+    ): Int
+
+    private external fun processPipeline(
+        handle: Long,
+        srcYuvByteArray: ByteArray,
+        srcFormat: Int,
+        srcWidth: Int,
+        srcHeight: Int,
+        dstFormat: Int,
+        dstWidth: Int,
+        dstHeight: Int
+    ): ByteArray?
+}
@@ -1,6 +1,9 @@
 package com.leovp.yuv
 
+import android.graphics.ImageFormat
+import android.media.Image
 import androidx.annotation.Keep
+import java.nio.ByteBuffer
 
 /**
  * Author: Michael Leo
@@ -27,6 +30,25 @@ object YuvUtil {
     const val SCALE_FILTER_BILINEAR = 2 // Faster than box, but lower quality scaling down.
     const val SCALE_FILTER_BOX = 3 // Highest quality.
 
+    /**
+     * Run [scaleI420], [rotateI420], [convertToI420], [android420ToI420] and [YuvPipeline]
+     * on multiple threads by splitting the frames into horizontal bands.
+     * The results are the same as the single threaded ones.
+     * [scaleI420] is only split when the source height times 65536 is a multiple of the destination
+     * height, e.g. 2160 -> 1080, and never for a filtered upscale.
+     * Other sizes are scaled on the calling thread.
+     *
+     * It pays off for large frames like 4K. Small frames are still processed on the calling thread.
+     *
+     * @param threadCount The number of threads used by each call, including the calling thread.
+     * 0 or 1 turns the worker pool off, which is the default.
+     * [Runtime.availableProcessors] is a reasonable value.
+     */
+    external fun setThreadCount(threadCount: Int)
+
+    /** @return The number of threads used by each call. 1 if the worker pool is off. */
+    external fun getThreadCount(): Int
+
     /**
      * Maybe the [convertToI420] method is what you want unless you find a way to get
      * [pixelStrideUV] automatically.
@@ -191,4 +213,236 @@ object YuvUtil {
      * The `libyuv` doesn't include the jpeg library. So it doesn't work now.
      */
     external fun i420ToRgb24(i420ByteArray: ByteArray, width: Int, height: Int): ByteArray
+
+    // ==================================================
+    // Direct ByteBuffer variants
+    // ==================================================
+    //
+    // The following methods are the zero-copy counterparts of the methods above.
+    // Both `srcBuffer` and `dstBuffer` must be direct [ByteBuffer]s which are created by
+    // [ByteBuffer.allocateDirect] or come from camera/codec, and they must not overlap.
+    // The data is always read from and written to the beginning of the buffers,
+    // the buffer position and limit are ignored.
+    //
+    // The result is written into `dstBuffer` in place, so the same buffers can be reused for
+    // every frame without any allocation.
+    // If a width or height is not positive, a buffer is too small or is not a direct buffer,
+    // or the crop rectangle of [cropI420] is outside the source or not on even coordinates,
+    // an [IllegalArgumentException] will be thrown.
+    //
+    // All methods return the number of bytes written into `dstBuffer`,
+    // or -1 if an exception has been thrown.
+
+    /**
+     * @see android420ToI420
+     */
+    external fun android420ToI420(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        pixelStrideUV: Int,
+        width: Int,
+        height: Int,
+        verticallyFlip: Boolean,
+        degree: Int = ROTATE_0
+    ): Int
+
+    /**
+     * Convert the separate Y, U and V planes of an YUV 4:2:0 image into I420 with vertically
+     * flipping and rotating at the same time.
+     *
+     * The planes are consumed directly, padded rows (`rowStride > width`) and interleaved chroma
+     * (`pixelStride == 2`) are both supported. So the planes from `ImageReader` or `MediaCodec`
+     * don't need to be repacked into a contiguous array before calling this method.
+     *
+     * @param uvPixelStride The pixel stride of U and V planes.
+     * ```
+     *                      1: Planar
+     *                      2: Semi-planar (NV12/NV21)
+     * ```
+     * @param width The original image width.
+     * @param height The original image height.
+     * @param dstBuffer The capacity must be at least `width * height * 3 / 2` bytes.
+     * @see android420ToI420
+     */
+    external fun android420ToI420(
+        yBuffer: ByteBuffer,
+        yRowStride: Int,
+        uBuffer: ByteBuffer,
+        uRowStride: Int,
+        vBuffer: ByteBuffer,
+        vRowStride: Int,
+        uvPixelStride: Int,
+        width: Int,
+        height: Int,
+        dstBuffer: ByteBuffer,
+        verticallyFlip: Boolean,
+        degree: Int = ROTATE_0
+    ): Int
+
+    /**
+     * Convert an [ImageFormat.YUV_420_888] [image] into I420 without repacking its planes.
+     *
+     * @see android420ToI420
+     */
+    fun android420ToI420(
+        image: Image,
+        dstBuffer: ByteBuffer,
+        verticallyFlip: Boolean,
+        degree: Int = ROTATE_0
+    ): Int {
+        require(image.format == ImageFormat.YUV_420_888) { "Image format must be YUV_420_888." }
+        val planes = image.planes
+        return android420ToI420(
+            planes[0].buffer, planes[0].rowStride,
+            planes[1].buffer, planes[1].rowStride,
+            planes[2].buffer, planes[2].rowStride,
+            planes[1].pixelStride,
+            image.width, image.height,
+            dstBuffer, verticallyFlip, degree
+        )
+    }
+
+    /**
+     * @param dstBuffer The capacity must be at least `width * height * 3 / 2` bytes.
+     * @see convertToI420
+     */
+    external fun convertToI420(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        format: Int,
+        width: Int,
+        height: Int,
+        verticallyFlip: Boolean,
+        degree: Int = ROTATE_0
+    ): Int
+
+    /**
+     * @see rotateI420
+     */
+    external fun rotateI420(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        width: Int,
+        height: Int,
+        degree: Int
+    ): Int
+
+    /**
+     * @see mirrorI420
+     */
+    external fun mirrorI420(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        width: Int,
+        height: Int
+    ): Int
+
+    /**
+     * @see flipVerticallyI420
+     */
+    external fun flipVerticallyI420(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        width: Int,
+        height: Int
+    ): Int
+
+    /**
+     * @param dstBuffer The capacity must be at least `dstWidth * dstHeight * 3 / 2` bytes.
+     * @see scaleI420
+     */
+    external fun scaleI420(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        srcWidth: Int,
+        srcHeight: Int,
+        dstWidth: Int,
+        dstHeight: Int,
+        mode: Int = SCALE_FILTER_NONE
+    ): Int
+
+    /**
+     * @param dstBuffer The capacity must be at least `dstWidth * dstHeight * 3 / 2` bytes.
+     * @see cropI420
+     */
+    external fun cropI420(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        srcWidth: Int,
+        srcHeight: Int,
+        dstWidth: Int,
+        dstHeight: Int,
+        left: Int,
+        top: Int
+    ): Int
+
+    external fun i420ToNv21(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        width: Int,
+        height: Int
+    ): Int
+
+    external fun i420ToNv12(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        width: Int,
+        height: Int
+    ): Int
+
+    external fun nv21ToI420(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        width: Int,
+        height: Int
+    ): Int
+
+    external fun nv12ToI420(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        width: Int,
+        height: Int,
+        degree: Int = ROTATE_0
+    ): Int
+
+    /**
+     * @see mirrorNv12
+     */
+    external fun mirrorNv12(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        width: Int,
+        height: Int
+    ): Int
+
+    /**
+     * @param dstBuffer The capacity must be at least `dstWidth * dstHeight * 3 / 2` bytes.
+     * @see scaleNv12
+     */
+    external fun scaleNv12(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        srcWidth: Int,
+        srcHeight: Int,
+        dstWidth: Int,
+        dstHeight: Int,
+        mode: Int = SCALE_FILTER_NONE
+    ): Int
+
+    external fun nv21ToNv12(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        width: Int,
+        height: Int
+    ): Int
+
+    /**
+     * @param dstBuffer The capacity must be at least `width * height * 3` bytes.
+     */
+    external fun i420ToRgb24(
+        srcBuffer: ByteBuffer,
+        dstBuffer: ByteBuffer,
+        width: Int,
+        height: Int
+    ): Int
 }
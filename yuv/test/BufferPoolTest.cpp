@@ -0,0 +1,117 @@
+// The pool must hand back released buffers of the same size class and keep its byte accounting exact.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "BufferPool.h"
+
+namespace {
+
+const size_t kFrameSize = 1920 * 1080 * 3 / 2;
+
+TEST(BufferPoolTest, ReleasedBufferIsReused) {
+    BufferPool pool;
+    uint8_t *first = pool.acquire(kFrameSize);
+    ASSERT_NE(nullptr, first);
+    EXPECT_EQ(0u, (uintptr_t) first % BufferPool::kAlignment);
+    pool.release(first, kFrameSize);
+
+    // Any size rounding up to the same size class gets the same buffer.
+    uint8_t *second = pool.acquire(kFrameSize - 1);
+    EXPECT_EQ(first, second);
+    pool.release(second, kFrameSize - 1);
+
+    BufferPoolStats stats = pool.stats();
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(1u, stats.misses);
+}
+
+TEST(BufferPoolTest, OtherSizeClassMisses) {
+    BufferPool pool;
+    uint8_t *small = pool.acquire(BufferPool::kAlignment);
+    pool.release(small, BufferPool::kAlignment);
+    uint8_t *large = pool.acquire(BufferPool::kAlignment + 1);
+    ASSERT_NE(nullptr, large);
+    pool.release(large, BufferPool::kAlignment + 1);
+
+    BufferPoolStats stats = pool.stats();
+    EXPECT_EQ(0u, stats.hits);
+    EXPECT_EQ(2u, stats.misses);
+    EXPECT_EQ(3 * BufferPool::kAlignment, stats.bytes_held);
+}
+
+TEST(BufferPoolTest, BytesHeldAndInUse) {
+    BufferPool pool;
+    // 100 bytes round up to 128.
+    uint8_t *a = pool.acquire(100);
+    uint8_t *b = pool.acquire(100);
+    BufferPoolStats stats = pool.stats();
+    EXPECT_EQ(256u, stats.bytes_in_use);
+    EXPECT_EQ(0u, stats.bytes_held);
+
+    pool.release(a, 100);
+    stats = pool.stats();
+    EXPECT_EQ(128u, stats.bytes_in_use);
+    EXPECT_EQ(128u, stats.bytes_held);
+
+    pool.release(b, 100);
+    stats = pool.stats();
+    EXPECT_EQ(0u, stats.bytes_in_use);
+    EXPECT_EQ(256u, stats.bytes_held);
+
+    pool.trim();
+    EXPECT_EQ(0u, pool.stats().bytes_held);
+}
+
+TEST(BufferPoolTest, ReleaseBeyondMaxBytesHeldFrees) {
+    BufferPool pool(2 * BufferPool::kAlignment);
+    uint8_t *buffers[3];
+    for (auto &buffer : buffers) buffer = pool.acquire(BufferPool::kAlignment);
+    for (auto &buffer : buffers) pool.release(buffer, BufferPool::kAlignment);
+    EXPECT_EQ(2 * BufferPool::kAlignment, pool.stats().bytes_held);
+
+    // Only the two kept buffers are hits.
+    for (auto &buffer : buffers) buffer = pool.acquire(BufferPool::kAlignment);
+    BufferPoolStats stats = pool.stats();
+    EXPECT_EQ(2u, stats.hits);
+    EXPECT_EQ(4u, stats.misses);
+    for (auto &buffer : buffers) pool.release(buffer, BufferPool::kAlignment);
+}
+
+TEST(BufferPoolTest, LoweringMaxBytesHeldTrims) {
+    BufferPool pool;
+    uint8_t *buffers[4];
+    for (auto &buffer : buffers) buffer = pool.acquire(1000);
+    for (auto &buffer : buffers) pool.release(buffer, 1000);
+    // 1000 bytes round up to 1024.
+    EXPECT_EQ(4096u, pool.stats().bytes_held);
+
+    pool.setMaxBytesHeld(2500);
+    EXPECT_EQ(2500u, pool.maxBytesHeld());
+    EXPECT_EQ(2048u, pool.stats().bytes_held);
+
+    pool.setMaxBytesHeld(0);
+    EXPECT_EQ(0u, pool.stats().bytes_held);
+}
+
+TEST(BufferPoolTest, PooledBufferReleasesOnScopeExit) {
+    BufferPool pool;
+    uint8_t *data;
+    {
+        PooledBuffer buffer(pool, kFrameSize);
+        data = buffer.data();
+        ASSERT_NE(nullptr, data);
+        EXPECT_LE(kFrameSize, pool.stats().bytes_in_use);
+        EXPECT_EQ(0u, pool.stats().bytes_held);
+    }
+    BufferPoolStats stats = pool.stats();
+    EXPECT_EQ(0u, stats.bytes_in_use);
+    EXPECT_LE(kFrameSize, stats.bytes_held);
+
+    PooledBuffer again(pool, kFrameSize);
+    EXPECT_EQ(data, again.data());
+    EXPECT_EQ(1u, pool.stats().hits);
+}
+
+}  // namespace
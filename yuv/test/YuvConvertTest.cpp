@@ -0,0 +1,147 @@
+// The band-parallel routines must produce exactly the bytes of the single threaded calls.
+//
+// Every case runs once without a pool and once on pools of several sizes, and compares the whole destination.
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "YuvConvert.h"
+
+namespace {
+
+const int32_t kThreadCounts[] = {2, 3, 4, 8};
+
+std::vector<uint8_t> makeFrame(int32_t width, int32_t height) {
+    std::vector<uint8_t> data((size_t) width * height * 3 / 2);
+    srand((unsigned) (width * 31 + height));
+    for (auto &b : data) b = (uint8_t) rand();
+    return data;
+}
+
+size_t i420Size(int32_t width, int32_t height) {
+    return (size_t) width * height + 2 * (size_t) ((width + 1) / 2) * ((height + 1) / 2);
+}
+
+/** The index of the first differing byte, or -1. */
+int64_t firstDifference(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b) {
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i] != b[i]) return (int64_t) i;
+    }
+    return -1;
+}
+
+struct ScaleCase {
+    int32_t src_width, src_height, dst_width, dst_height;
+};
+
+const ScaleCase kScaleCases[] = {
+        {3840, 2160, 1920, 1080},
+        {3840, 2160, 3840, 1542},
+        {1920, 1080, 1920, 770},
+        {1920, 1080, 1280, 720},
+        {1920, 1080, 640, 360},
+        {1920, 1080, 3840, 2160},
+        {640, 480, 640, 360},
+        {640, 480, 320, 240},
+        {1280, 720, 1920, 1080},
+};
+
+const int32_t kFilterModes[] = {libyuv::kFilterNone, libyuv::kFilterLinear, libyuv::kFilterBilinear,
+                                libyuv::kFilterBox};
+
+TEST(YuvConvertTest, ScaleI420ThreadedMatchesSerial) {
+    for (const ScaleCase &c : kScaleCases) {
+        std::vector<uint8_t> src = makeFrame(c.src_width, c.src_height);
+        for (int32_t mode : kFilterModes) {
+            std::vector<uint8_t> expected(i420Size(c.dst_width, c.dst_height));
+            scaleI420(src.data(), c.src_width, c.src_height, expected.data(), c.dst_width, c.dst_height, mode);
+            for (int32_t threads : kThreadCounts) {
+                WorkerPool workers(threads);
+                std::vector<uint8_t> actual(expected.size());
+                scaleI420(src.data(), c.src_width, c.src_height, actual.data(), c.dst_width, c.dst_height, mode,
+                          &workers);
+                EXPECT_EQ(-1, firstDifference(expected, actual))
+                        << c.src_width << "x" << c.src_height << " -> " << c.dst_width << "x" << c.dst_height
+                        << " mode " << mode << " threads " << threads;
+            }
+        }
+    }
+}
+
+TEST(YuvConvertTest, ConvertToI420ThreadedMatchesSerial) {
+    const int32_t width = 1920;
+    const int32_t height = 1080;
+    std::vector<uint8_t> src = makeFrame(width, height);
+    // I420, NV21 and NV12
+    for (int32_t format = 1; format <= 3; format++) {
+        for (int32_t degree = 0; degree < 360; degree += 90) {
+            for (bool flip : {false, true}) {
+                std::vector<uint8_t> expected(src.size());
+                convertToI420(src.data(), (int32_t) src.size(), format, width, height, expected.data(), flip, degree);
+                for (int32_t threads : kThreadCounts) {
+                    WorkerPool workers(threads);
+                    std::vector<uint8_t> actual(src.size());
+                    convertToI420(src.data(), (int32_t) src.size(), format, width, height, actual.data(), flip, degree,
+                                  &workers);
+                    EXPECT_EQ(-1, firstDifference(expected, actual))
+                            << "format " << format << " degree " << degree << " flip " << flip << " threads "
+                            << threads;
+                }
+            }
+        }
+    }
+}
+
+TEST(YuvConvertTest, RotateI420ThreadedMatchesSerial) {
+    const int32_t width = 1280;
+    const int32_t height = 720;
+    std::vector<uint8_t> src = makeFrame(width, height);
+    for (int32_t degree = 0; degree < 360; degree += 90) {
+        std::vector<uint8_t> expected(src.size());
+        rotateI420(src.data(), width, height, expected.data(), degree);
+        for (int32_t threads : kThreadCounts) {
+            WorkerPool workers(threads);
+            std::vector<uint8_t> actual(src.size());
+            rotateI420(src.data(), width, height, actual.data(), degree, &workers);
+            EXPECT_EQ(-1, firstDifference(expected, actual)) << "degree " << degree << " threads " << threads;
+        }
+    }
+}
+
+TEST(YuvConvertTest, PipelineThreadedMatchesSerial) {
+    const int32_t width = 1920;
+    const int32_t height = 1080;
+    std::vector<uint8_t> src_data = makeFrame(width, height);
+    YuvFrame src = makeNv21Frame(src_data.data(), width, height);
+    // crop, rotate, mirror and scale into sizes which can and cannot be split into bands
+    const int32_t dst_sizes[][2] = {{1280, 720}, {640, 360}, {960, 770}, {1920, 1080}};
+    for (const auto &size : dst_sizes) {
+        for (int32_t degree = 0; degree < 360; degree += 90) {
+            for (int32_t mode : kFilterModes) {
+                YuvPipelineConfig config{};
+                config.crop_left = 0;
+                config.crop_top = 0;
+                config.degree = degree;
+                config.mirror = degree == 90;
+                config.filter_mode = mode;
+                std::vector<uint8_t> expected(i420Size(size[0], size[1]));
+                YuvPipeline serial;
+                ASSERT_TRUE(serial.process(src, config, makeI420Frame(expected.data(), size[0], size[1])));
+                for (int32_t threads : kThreadCounts) {
+                    WorkerPool workers(threads);
+                    std::vector<uint8_t> actual(expected.size());
+                    YuvPipeline threaded;
+                    ASSERT_TRUE(threaded.process(src, config, makeI420Frame(actual.data(), size[0], size[1]),
+                                                 &workers));
+                    EXPECT_EQ(-1, firstDifference(expected, actual))
+                            << size[0] << "x" << size[1] << " degree " << degree << " mode " << mode << " threads "
+                            << threads;
+                }
+            }
+        }
+    }
+}
+
+}  // namespace
@@ -0,0 +1,199 @@
+// The frame descriptor API must read padded and interleaved planes exactly like tightly packed ones.
+//
+// Every padded source is built from a tightly packed frame, so both must give the same destination.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "YuvConvert.h"
+
+namespace {
+
+const int32_t kWidth = 640;
+const int32_t kHeight = 480;
+// Row padding added to every plane, as ImageReader and MediaCodec do for alignment.
+const int32_t kPadding = 24;
+
+std::vector<uint8_t> makeFrame(int32_t width, int32_t height) {
+    std::vector<uint8_t> data((size_t) width * height * 3 / 2);
+    srand((unsigned) (width * 17 + height));
+    for (auto &b : data) b = (uint8_t) rand();
+    return data;
+}
+
+/** Copy [rows] rows of [row_bytes] bytes between two planes of different strides. */
+void copyPlane(const uint8_t *src, int32_t src_stride, uint8_t *dst, int32_t dst_stride, int32_t row_bytes,
+               int32_t rows) {
+    for (int32_t y = 0; y < rows; y++) {
+        memcpy(dst + (size_t) y * dst_stride, src + (size_t) y * src_stride, row_bytes);
+    }
+}
+
+/**
+ * Copy [packed] into [storage] with every row padded by [kPadding] bytes.
+ * [packed] must be planar (pixel_stride_uv == 1) or semi-planar (pixel_stride_uv == 2).
+ */
+YuvFrame makePaddedFrame(const YuvFrame &packed, std::vector<uint8_t> &storage) {
+    int32_t chroma_width = (packed.width + 1) / 2;
+    int32_t chroma_height = (packed.height + 1) / 2;
+    int32_t stride_y = packed.width + kPadding;
+    int32_t stride_uv = chroma_width * packed.pixel_stride_uv + kPadding;
+    size_t size_y = (size_t) stride_y * packed.height;
+    size_t size_uv = (size_t) stride_uv * chroma_height;
+    storage.assign(size_y + 2 * size_uv, 0xEE);
+
+    YuvFrame frame = packed;
+    frame.y = storage.data();
+    frame.stride_y = stride_y;
+    frame.stride_u = stride_uv;
+    frame.stride_v = stride_uv;
+    copyPlane(packed.y, packed.stride_y, frame.y, stride_y, packed.width, packed.height);
+    if (packed.pixel_stride_uv == 1) {
+        frame.u = frame.y + size_y;
+        frame.v = frame.u + size_uv;
+        copyPlane(packed.u, packed.stride_u, frame.u, stride_uv, chroma_width, chroma_height);
+        copyPlane(packed.v, packed.stride_v, frame.v, stride_uv, chroma_width, chroma_height);
+    } else {
+        // Keep the order of the interleaved samples, NV12 has U first and NV21 has V first.
+        const uint8_t *packed_uv = std::min(packed.u, packed.v);
+        uint8_t *uv = frame.y + size_y;
+        frame.u = uv + (packed.u - packed_uv);
+        frame.v = uv + (packed.v - packed_uv);
+        copyPlane(packed_uv, packed.stride_u, uv, stride_uv, chroma_width * 2, chroma_height);
+    }
+    return frame;
+}
+
+size_t i420Size(int32_t width, int32_t height) {
+    return (size_t) width * height + 2 * (size_t) ((width + 1) / 2) * ((height + 1) / 2);
+}
+
+TEST(YuvFrameTest, PackedFrameLayouts) {
+    std::vector<uint8_t> data = makeFrame(kWidth, kHeight);
+    uint8_t *chroma = data.data() + kWidth * kHeight;
+
+    YuvFrame i420 = makeI420Frame(data.data(), kWidth, kHeight);
+    EXPECT_EQ(chroma, i420.u);
+    EXPECT_EQ(chroma + kWidth * kHeight / 4, i420.v);
+    EXPECT_EQ(kWidth, i420.stride_y);
+    EXPECT_EQ(kWidth / 2, i420.stride_u);
+    EXPECT_EQ(kWidth / 2, i420.stride_v);
+    EXPECT_EQ(1, i420.pixel_stride_uv);
+
+    YuvFrame nv12 = makeNv12Frame(data.data(), kWidth, kHeight);
+    EXPECT_EQ(chroma, nv12.u);
+    EXPECT_EQ(chroma + 1, nv12.v);
+    EXPECT_EQ(kWidth, nv12.stride_u);
+    EXPECT_EQ(2, nv12.pixel_stride_uv);
+
+    YuvFrame nv21 = makeNv21Frame(data.data(), kWidth, kHeight);
+    EXPECT_EQ(chroma, nv21.v);
+    EXPECT_EQ(chroma + 1, nv21.u);
+    EXPECT_EQ(kWidth, nv21.stride_v);
+    EXPECT_EQ(2, nv21.pixel_stride_uv);
+}
+
+TEST(YuvFrameTest, CropOffsetsEveryPlane) {
+    std::vector<uint8_t> packed = makeFrame(kWidth, kHeight);
+    std::vector<uint8_t> storage;
+    const int32_t left = 10;
+    const int32_t top = 6;
+    for (int32_t pixel_stride : {1, 2}) {
+        YuvFrame frame = makePaddedFrame(pixel_stride == 1 ? makeI420Frame(packed.data(), kWidth, kHeight)
+                                                           : makeNv12Frame(packed.data(), kWidth, kHeight),
+                                         storage);
+        YuvFrame region = cropYuvFrame(frame, left, top, 100, 50);
+        EXPECT_EQ(frame.y + top * frame.stride_y + left, region.y) << "pixel stride " << pixel_stride;
+        EXPECT_EQ(frame.u + (top / 2) * frame.stride_u + (left / 2) * pixel_stride, region.u);
+        EXPECT_EQ(frame.v + (top / 2) * frame.stride_v + (left / 2) * pixel_stride, region.v);
+        EXPECT_EQ(frame.stride_y, region.stride_y);
+        EXPECT_EQ(100, region.width);
+        EXPECT_EQ(50, region.height);
+    }
+}
+
+TEST(YuvFrameTest, Android420ToI420ReadsPaddedPlanes) {
+    std::vector<uint8_t> packed = makeFrame(kWidth, kHeight);
+    const YuvFrame sources[] = {makeI420Frame(packed.data(), kWidth, kHeight),
+                                makeNv12Frame(packed.data(), kWidth, kHeight),
+                                makeNv21Frame(packed.data(), kWidth, kHeight)};
+    for (const YuvFrame &source : sources) {
+        std::vector<uint8_t> storage;
+        YuvFrame padded = makePaddedFrame(source, storage);
+        for (int32_t degree = 0; degree < 360; degree += 90) {
+            for (bool flip : {false, true}) {
+                bool swap_size = degree == 90 || degree == 270;
+                int32_t dst_width = swap_size ? kHeight : kWidth;
+                int32_t dst_height = swap_size ? kWidth : kHeight;
+                std::vector<uint8_t> expected(i420Size(kWidth, kHeight));
+                std::vector<uint8_t> actual(expected.size());
+                android420ToI420(source, makeI420Frame(expected.data(), dst_width, dst_height), flip, degree);
+                android420ToI420(padded, makeI420Frame(actual.data(), dst_width, dst_height), flip, degree);
+                EXPECT_EQ(expected, actual) << "pixel stride " << source.pixel_stride_uv << " u before v "
+                                            << (source.u < source.v) << " degree " << degree << " flip " << flip;
+
+                WorkerPool workers(3);
+                std::vector<uint8_t> threaded(expected.size());
+                android420ToI420(padded, makeI420Frame(threaded.data(), dst_width, dst_height), flip, degree,
+                                 &workers);
+                EXPECT_EQ(expected, threaded) << "threaded, degree " << degree << " flip " << flip;
+            }
+        }
+    }
+}
+
+TEST(YuvFrameTest, Android420ToI420WritesPaddedDestination) {
+    std::vector<uint8_t> packed = makeFrame(kWidth, kHeight);
+    YuvFrame source = makeNv21Frame(packed.data(), kWidth, kHeight);
+    std::vector<uint8_t> expected(i420Size(kWidth, kHeight));
+    android420ToI420(source, makeI420Frame(expected.data(), kWidth, kHeight), false, 0);
+
+    std::vector<uint8_t> storage;
+    YuvFrame padded_dst = makePaddedFrame(makeI420Frame(expected.data(), kWidth, kHeight), storage);
+    std::vector<uint8_t> untouched = storage;
+    // Scramble the pixels, only the padding keeps its value.
+    for (int32_t y = 0; y < kHeight; y++) memset(padded_dst.y + y * padded_dst.stride_y, 0, kWidth);
+    for (int32_t y = 0; y < kHeight / 2; y++) {
+        memset(padded_dst.u + y * padded_dst.stride_u, 0, kWidth / 2);
+        memset(padded_dst.v + y * padded_dst.stride_v, 0, kWidth / 2);
+    }
+    android420ToI420(source, padded_dst, false, 0);
+    // Every pixel is back and the padding was not written.
+    EXPECT_EQ(untouched, storage);
+}
+
+TEST(YuvFrameTest, PipelineRejectsInvalidCrop) {
+    std::vector<uint8_t> src_data = makeFrame(kWidth, kHeight);
+    YuvFrame src = makeNv12Frame(src_data.data(), kWidth, kHeight);
+    std::vector<uint8_t> dst_data(i420Size(320, 240));
+    YuvFrame dst = makeI420Frame(dst_data.data(), 320, 240);
+    // left, top, width, height
+    const int32_t invalid[][4] = {{-2, 0, 320, 240}, {0, -2, 320, 240}, {1, 0, 320, 240}, {0, 1, 320, 240},
+                                  {322, 0, 320, 240}, {0, 242, 320, 240}, {2, 0, 640, 240}, {640, 0, 0, 240}};
+    YuvPipeline pipeline;
+    for (const auto &crop : invalid) {
+        YuvPipelineConfig config{};
+        config.crop_left = crop[0];
+        config.crop_top = crop[1];
+        config.crop_width = crop[2];
+        config.crop_height = crop[3];
+        EXPECT_FALSE(pipeline.process(src, config, dst))
+                << crop[0] << "," << crop[1] << " " << crop[2] << "x" << crop[3];
+    }
+    YuvPipelineConfig config{};
+    config.crop_left = 320;
+    config.crop_top = 240;
+    config.crop_width = 320;
+    config.crop_height = 240;
+    EXPECT_TRUE(pipeline.process(src, config, dst));
+    // A crop size of 0 extends to the right and bottom edges.
+    config.crop_width = 0;
+    config.crop_height = 0;
+    EXPECT_TRUE(pipeline.process(src, config, dst));
+}
+
+}  // namespace